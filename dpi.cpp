@@ -0,0 +1,341 @@
+/**
+ * \file dpi.cpp
+ * \brief Pool of threads running payload inspecting process plugins apart from flow cache
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <cstring>
+#include <unistd.h>
+
+#include <ipfixprobe/dpi.hpp>
+#include <ipfixprobe/plugin.hpp>
+#include "storage/xxhash.h"
+
+namespace ipxp {
+
+/**
+ * \brief Number of empty polls after which idle worker starts sleeping.
+ */
+#define DPI_IDLE_SPINS 1024
+
+/**
+ * \brief Compute hash of flow key which is equal for both directions of a biflow.
+ */
+static uint64_t flow_hash(const Flow &rec)
+{
+   size_t ip_len = rec.ip_version == IP::v4 ? 4 : 16;
+   uint8_t key[18];
+
+   memcpy(key, &rec.src_ip, ip_len);
+   memcpy(key + ip_len, &rec.src_port, 2);
+   uint64_t hash = XXH64(key, ip_len + 2, 0);
+   memcpy(key, &rec.dst_ip, ip_len);
+   memcpy(key + ip_len, &rec.dst_port, 2);
+   hash += XXH64(key, ip_len + 2, 0);
+   return hash ^ (static_cast<uint64_t>(rec.ip_proto) * 0x9E3779B97F4A7C15ULL);
+}
+
+DpiWorkers::DpiWorkers(ProcessPlugin **plugins, uint32_t plugin_cnt, uint64_t offload, uint32_t workers,
+   uint32_t queue_size, uint32_t buffer_size) : m_offload(offload), m_stop(false), m_failed(false)
+{
+   for (uint32_t i = 0; i < workers; i++) {
+      Worker *worker = new Worker(queue_size, buffer_size);
+      worker->plugins.assign(plugin_cnt, nullptr);
+      for (uint32_t j = 0; j < plugin_cnt; j++) {
+         if (offload & (1ULL << j)) {
+            worker->plugins[j] = plugins[j]->copy();
+         }
+      }
+      m_workers.push_back(worker);
+   }
+   for (auto worker : m_workers) {
+      worker->thread = std::thread(&DpiWorkers::run, this, worker);
+   }
+}
+
+DpiWorkers::~DpiWorkers()
+{
+   m_stop = true;
+   for (auto worker : m_workers) {
+      worker->thread.join();
+      for (auto plugin : worker->plugins) {
+         if (plugin != nullptr) {
+            plugin->close();
+            delete plugin;
+         }
+      }
+      delete worker;
+   }
+   for (auto flow : m_flows) {
+      delete flow;
+   }
+}
+
+DpiFlow *DpiWorkers::alloc(Flow &rec)
+{
+   DpiFlow *flow;
+   if (m_free.empty()) {
+      flow = new DpiFlow();
+      m_flows.push_back(flow);
+   } else {
+      flow = m_free.back();
+      m_free.pop_back();
+   }
+   flow->owner = &rec;
+   flow->worker = flow_hash(rec) % m_workers.size();
+   flow->flush = 0;
+   flow->pre_export = false;
+   return flow;
+}
+
+void DpiWorkers::release(DpiFlow *flow)
+{
+   flow->owner = nullptr;
+   flow->gen++;
+   m_free.push_back(flow);
+}
+
+DpiTask *DpiWorkers::acquire(Worker &worker)
+{
+   DpiTask *task;
+   while ((task = worker.tasks.acquire()) == nullptr) {
+      // Worker may wait for free space in its result queue
+      poll(worker);
+      std::this_thread::yield();
+   }
+   return task;
+}
+
+void DpiWorkers::submit(Flow &rec, const Packet &pkt)
+{
+   bool create = rec.dpi == nullptr;
+   if (create) {
+      rec.dpi = alloc(rec);
+   }
+
+   DpiFlow *flow = rec.dpi;
+   Worker &worker = *m_workers[flow->worker];
+   DpiTask *task = acquire(worker);
+
+   task->type = create ? DpiTask::Type::CREATE : DpiTask::Type::UPDATE;
+   task->flow = flow;
+   task->plugins = rec.plugins_active & m_offload;
+   task->rec = rec;
+   task->rec.m_exts = nullptr;
+   task->rec.dpi = nullptr;
+
+   // Packet data are owned by input plugin and reused after the block is processed
+   task->pkt = pkt;
+   task->pkt.custom = nullptr;
+   task->pkt.custom_len = 0;
+   task->pkt.buffer = nullptr;
+   task->pkt.buffer_size = 0;
+   task->pkt.dns = nullptr;
+   uint8_t *data = task->data.data();
+   size_t size = task->data.size();
+   if (pkt.packet != nullptr && pkt.payload >= pkt.packet && pkt.payload <= pkt.packet + pkt.packet_len) {
+      size_t len = std::min<size_t>(pkt.packet_len, size);
+      size_t offset = pkt.payload - pkt.packet;
+      memcpy(data, pkt.packet, len);
+      task->pkt.packet = data;
+      task->pkt.packet_len = len;
+      task->pkt.payload = data + std::min(offset, len);
+      task->pkt.payload_len = offset < len ? std::min<size_t>(pkt.payload_len, len - offset) : 0;
+   } else {
+      size_t len = std::min<size_t>(pkt.payload_len, size);
+      memcpy(data, pkt.payload, len);
+      task->pkt.packet = nullptr;
+      task->pkt.packet_len = 0;
+      task->pkt.payload = data;
+      task->pkt.payload_len = len;
+   }
+
+   worker.tasks.commit();
+   flow->seq = ++worker.seq;
+}
+
+void DpiWorkers::merge(Flow &rec)
+{
+   DpiFlow *flow = rec.dpi;
+   if (flow == nullptr) {
+      return;
+   }
+
+   Worker &worker = *m_workers[flow->worker];
+   if (flow->pre_export) {
+      DpiTask *task = acquire(worker);
+      task->type = DpiTask::Type::EXPORT;
+      task->flow = flow;
+      task->pre_export = true;
+      worker.tasks.commit();
+      flow->seq = ++worker.seq;
+   }
+   while (worker.done.load(std::memory_order_acquire) < flow->seq) {
+      poll(worker);
+      std::this_thread::yield();
+   }
+
+   if (flow->shadow.m_exts != nullptr) {
+      rec.add_extension(flow->shadow.m_exts);
+      flow->shadow.m_exts = nullptr;
+   }
+   rec.plugins_active &= ~m_offload;
+   rec.dpi = nullptr;
+   release(flow);
+}
+
+void DpiWorkers::poll(Worker &worker)
+{
+   DpiResult *res;
+   while ((res = worker.results.front()) != nullptr) {
+      DpiFlow *flow = res->flow;
+      if (flow->owner != nullptr && flow->gen == res->gen) {
+         flow->flush |= res->ret & FLOW_FLUSH_WITH_REINSERT;
+         flow->owner->plugins_active &= ~res->detached;
+      }
+      worker.results.release();
+   }
+}
+
+void DpiWorkers::poll()
+{
+   for (auto worker : m_workers) {
+      poll(*worker);
+   }
+   if (m_failed.load(std::memory_order_acquire)) {
+      std::lock_guard<std::mutex> lock(m_lock);
+      throw PluginError(m_error);
+   }
+}
+
+void DpiWorkers::send(Worker &worker, DpiTask &task, int ret, uint64_t detached)
+{
+   DpiResult *res;
+   while ((res = worker.results.acquire()) == nullptr) {
+      std::this_thread::yield();
+   }
+   res->flow = task.flow;
+   res->gen = task.flow->gen;
+   res->ret = ret;
+   res->detached = detached;
+   worker.results.commit();
+}
+
+void DpiWorkers::process(Worker &worker, DpiTask &task)
+{
+   Flow &shadow = task.flow->shadow;
+   auto &plugins = worker.plugins;
+   int ret = 0;
+
+   if (task.type == DpiTask::Type::EXPORT) {
+      for (uint64_t offload = m_offload & shadow.plugins_created; offload; offload &= offload - 1) {
+         plugins[__builtin_ctzll(offload)]->pre_export(shadow);
+      }
+      return;
+   }
+
+   RecordExt *exts = shadow.m_exts;
+   uint64_t active = task.type == DpiTask::Type::CREATE ? task.plugins : shadow.plugins_active;
+   shadow = task.rec;
+   shadow.m_exts = exts;
+   shadow.plugins_active = active;
+
+   auto call = [&shadow, &ret](unsigned int idx, int opts) {
+      if (opts & FLOW_PLUGIN_DETACH) {
+         shadow.plugins_active &= ~(1ULL << idx);
+      }
+      ret |= opts & ~FLOW_PLUGIN_DETACH;
+   };
+   if (task.type == DpiTask::Type::CREATE) {
+      for (uint64_t it = shadow.plugins_active; it; it &= it - 1) {
+         unsigned int i = __builtin_ctzll(it);
+         call(i, plugins[i]->post_create(shadow, task.pkt));
+      }
+   } else {
+      for (uint64_t it = shadow.plugins_active; it; it &= it - 1) {
+         unsigned int i = __builtin_ctzll(it);
+         call(i, plugins[i]->pre_update(shadow, task.pkt));
+      }
+      for (uint64_t it = shadow.plugins_active; it; it &= it - 1) {
+         unsigned int i = __builtin_ctzll(it);
+         call(i, plugins[i]->post_update(shadow, task.pkt));
+      }
+   }
+
+   uint64_t detached = active & ~shadow.plugins_active;
+   if (ret & FLOW_FLUSH || detached) {
+      send(worker, task, ret, detached);
+   }
+}
+
+void DpiWorkers::run(Worker *worker)
+{
+   unsigned idle = 0;
+   while (1) {
+      DpiTask *task = worker->tasks.front();
+      if (task == nullptr) {
+         if (m_stop) {
+            break;
+         }
+         if (++idle < DPI_IDLE_SPINS) {
+            std::this_thread::yield();
+         } else {
+            usleep(1);
+         }
+         continue;
+      }
+      idle = 0;
+
+      if (!m_failed.load(std::memory_order_relaxed)) {
+         try {
+            process(*worker, *task);
+         } catch (PluginError &e) {
+            // Keep consuming tasks so that storage thread waiting for flows does not block
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_error = e.what();
+            m_failed.store(true, std::memory_order_release);
+         }
+      }
+      worker->tasks.release();
+      worker->done.store(worker->done.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+   }
+}
+
+}
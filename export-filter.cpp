@@ -0,0 +1,546 @@
+/**
+ * \file export-filter.cpp
+ * \brief Filter and projection of exported flows compiled to branch bytecode.
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <arpa/inet.h>
+
+#include <ipfixprobe/plugin.hpp>
+#include <ipfixprobe/process.hpp>
+#include <ipfixprobe/utils.hpp>
+
+#include "export-filter.hpp"
+
+namespace ipxp {
+
+enum FilterOp : uint8_t {
+   FILTER_JEQ,
+   FILTER_JGT,
+   FILTER_JGE,
+   FILTER_JSET,
+   FILTER_JNET,
+   FILTER_JHAS,
+   FILTER_JTEXT
+};
+
+enum FilterField : uint8_t {
+   FIELD_NONE,
+   FIELD_PROTO,
+   FIELD_IP_VERSION,
+   FIELD_SRC_PORT,
+   FIELD_DST_PORT,
+   FIELD_SRC_PACKETS,
+   FIELD_DST_PACKETS,
+   FIELD_PACKETS,
+   FIELD_SRC_BYTES,
+   FIELD_DST_BYTES,
+   FIELD_BYTES,
+   FIELD_SRC_TCP_FLAGS,
+   FIELD_DST_TCP_FLAGS,
+   FIELD_TCP_FLAGS,
+   FIELD_DURATION,
+   FIELD_END_REASON,
+   FIELD_SRC_IP,
+   FIELD_DST_IP,
+   /* Fields tested in both directions, expanded by compiler. */
+   FIELD_PORT,
+   FIELD_IP
+};
+
+struct FilterFieldName {
+   const char *name;
+   FilterField field;
+};
+
+static const FilterFieldName filter_fields[] = {
+   { "proto",         FIELD_PROTO },
+   { "ip_version",    FIELD_IP_VERSION },
+   { "src_port",      FIELD_SRC_PORT },
+   { "dst_port",      FIELD_DST_PORT },
+   { "port",          FIELD_PORT },
+   { "src_packets",   FIELD_SRC_PACKETS },
+   { "dst_packets",   FIELD_DST_PACKETS },
+   { "packets",       FIELD_PACKETS },
+   { "src_bytes",     FIELD_SRC_BYTES },
+   { "dst_bytes",     FIELD_DST_BYTES },
+   { "bytes",         FIELD_BYTES },
+   { "src_tcp_flags", FIELD_SRC_TCP_FLAGS },
+   { "dst_tcp_flags", FIELD_DST_TCP_FLAGS },
+   { "tcp_flags",     FIELD_TCP_FLAGS },
+   { "duration",      FIELD_DURATION },
+   { "end_reason",    FIELD_END_REASON },
+   { "src_ip",        FIELD_SRC_IP },
+   { "dst_ip",        FIELD_DST_IP },
+   { "ip",            FIELD_IP },
+};
+
+/**
+ * \brief Node of parsed expression.
+ */
+struct FilterNode {
+   enum Type { TEST, AND, OR, NOT } type;
+   FilterInsn test;
+   std::unique_ptr<FilterNode> left;
+   std::unique_ptr<FilterNode> right;
+
+   FilterNode(Type t, FilterNode *l = nullptr, FilterNode *r = nullptr) : type(t), test(), left(l), right(r)
+   {
+   }
+};
+
+/**
+ * \brief Recursive descent parser of rules.
+ *
+ * expr := term { "or" term }, term := factor { "and" factor },
+ * factor := "not" factor | "(" expr ")" | "has" PLUGIN | PLUGIN "contains" STRING | FIELD OP VALUE
+ */
+class FilterCompiler
+{
+public:
+   FilterCompiler(ExportFilter &filter, const std::string &rule) : m_filter(filter), m_rule(rule), m_pos(0)
+   {
+   }
+
+   void compile()
+   {
+      ExportFilter::Rule rule = {ExportFilter::FILTER_TRUE, false, 0};
+      std::string action = next();
+      if (action == "drop") {
+         rule.drop = true;
+      } else if (action != "keep") {
+         error("expected drop or keep");
+      }
+      if (peek() == "if") {
+         next();
+         std::unique_ptr<FilterNode> expr(parse_expr());
+         rule.entry = m_filter.emit(expr.get(), ExportFilter::FILTER_TRUE, ExportFilter::FILTER_FALSE);
+      }
+      if (peek() == "strip") {
+         next();
+         if (rule.drop) {
+            error("dropped flows cannot be stripped");
+         }
+         do {
+            if (peek() == ",") {
+               next();
+            }
+            rule.strip |= static_cast<uint64_t>(1) << ext_id(next());
+         } while (peek() == ",");
+      }
+      if (!peek().empty()) {
+         error("unexpected " + peek());
+      }
+      m_filter.m_rules.push_back(rule);
+   }
+
+private:
+   ExportFilter &m_filter;
+   std::string m_rule;
+   size_t m_pos;
+
+   [[noreturn]] void error(const std::string &msg) const
+   {
+      throw PluginError("invalid rule '" + m_rule + "': " + msg);
+   }
+
+   std::string token(size_t &pos) const
+   {
+      while (pos < m_rule.size() && isspace(m_rule[pos])) {
+         pos++;
+      }
+      if (pos >= m_rule.size()) {
+         return "";
+      }
+      size_t begin = pos;
+      char c = m_rule[pos];
+      if (c == '"') {
+         size_t end = m_rule.find('"', pos + 1);
+         if (end == std::string::npos) {
+            error("unterminated string");
+         }
+         pos = end + 1;
+      } else if (isalnum(c) || c == '_' || c == ':') {
+         while (pos < m_rule.size() && (isalnum(m_rule[pos]) || strchr("_.:/-", m_rule[pos]))) {
+            pos++;
+         }
+      } else if (strchr("=!<>", c) && pos + 1 < m_rule.size() && m_rule[pos + 1] == '=') {
+         pos += 2;
+      } else {
+         pos++;
+      }
+      return m_rule.substr(begin, pos - begin);
+   }
+
+   std::string next()
+   {
+      return token(m_pos);
+   }
+
+   std::string peek() const
+   {
+      size_t pos = m_pos;
+      return token(pos);
+   }
+
+   int ext_id(const std::string &name) const
+   {
+      if (name.empty()) {
+         error("expected process plugin name");
+      }
+      auto it = m_filter.m_ext_ids.find(name);
+      if (it == m_filter.m_ext_ids.end()) {
+         error("unknown process plugin " + name);
+      }
+      return it->second;
+   }
+
+   FilterNode *parse_expr()
+   {
+      std::unique_ptr<FilterNode> node(parse_term());
+      while (peek() == "or") {
+         next();
+         FilterNode *right = parse_term();
+         node.reset(new FilterNode(FilterNode::OR, node.release(), right));
+      }
+      return node.release();
+   }
+
+   FilterNode *parse_term()
+   {
+      std::unique_ptr<FilterNode> node(parse_factor());
+      while (peek() == "and") {
+         next();
+         FilterNode *right = parse_factor();
+         node.reset(new FilterNode(FilterNode::AND, node.release(), right));
+      }
+      return node.release();
+   }
+
+   FilterNode *parse_factor()
+   {
+      std::string tok = next();
+      if (tok == "not") {
+         return new FilterNode(FilterNode::NOT, parse_factor());
+      }
+      if (tok == "(") {
+         std::unique_ptr<FilterNode> node(parse_expr());
+         if (next() != ")") {
+            error("expected )");
+         }
+         return node.release();
+      }
+      if (tok == "has") {
+         FilterNode *node = new FilterNode(FilterNode::TEST);
+         node->test.op = FILTER_JHAS;
+         node->test.arg = ext_id(next());
+         return node;
+      }
+      if (peek() == "contains") {
+         next();
+         int id = ext_id(tok);
+         std::string str = next();
+         if (str.size() < 2 || str[0] != '"') {
+            error("expected string after contains");
+         }
+         FilterNode *node = new FilterNode(FilterNode::TEST);
+         node->test.op = FILTER_JTEXT;
+         node->test.arg = id;
+         node->test.k = m_filter.m_strings.size();
+         m_filter.m_strings.push_back(str.substr(1, str.size() - 2));
+         return node;
+      }
+
+      FilterField field = FIELD_NONE;
+      for (const auto &it : filter_fields) {
+         if (tok == it.name) {
+            field = it.field;
+         }
+      }
+      if (field == FIELD_NONE) {
+         error(tok.empty() ? "unexpected end of rule" : "unknown field " + tok);
+      }
+      std::string op = next();
+      std::string value = next();
+
+      if (field == FIELD_SRC_IP || field == FIELD_DST_IP || field == FIELD_IP) {
+         if (op != "==" && op != "!=") {
+            error("addresses can be compared only by == and !=");
+         }
+         return expand(field, FILTER_JNET, parse_network(value), op == "!=");
+      }
+
+      uint64_t k;
+      try {
+         k = str2num<uint64_t>(value);
+      } catch (std::invalid_argument &e) {
+         error("invalid number " + value);
+      }
+      if (op == "==" || op == "!=") {
+         return expand(field, FILTER_JEQ, k, op == "!=");
+      } else if (op == ">" || op == "<=") {
+         return expand(field, FILTER_JGT, k, false, op == "<=");
+      } else if (op == ">=" || op == "<") {
+         return expand(field, FILTER_JGE, k, false, op == "<");
+      } else if (op == "&") {
+         return expand(field, FILTER_JSET, k, false);
+      }
+      error("unknown operator " + op);
+   }
+
+   /**
+    * \brief Create test, fields of both directions match when either direction matches.
+    * Negated test of such field holds only when neither direction matches. Inverted
+    * comparison (< and <= are tested as not >= and not >) is applied to each direction.
+    */
+   FilterNode *expand(FilterField field, FilterOp op, uint64_t k, bool negate, bool invert = false)
+   {
+      FilterNode *node;
+      if (field == FIELD_PORT) {
+         node = new FilterNode(FilterNode::OR, test(FIELD_SRC_PORT, op, k, invert), test(FIELD_DST_PORT, op, k, invert));
+      } else if (field == FIELD_IP) {
+         node = new FilterNode(FilterNode::OR, test(FIELD_SRC_IP, op, k, invert), test(FIELD_DST_IP, op, k, invert));
+      } else {
+         node = test(field, op, k, invert);
+      }
+      return negate ? new FilterNode(FilterNode::NOT, node) : node;
+   }
+
+   FilterNode *test(FilterField field, FilterOp op, uint64_t k, bool invert)
+   {
+      FilterNode *node = new FilterNode(FilterNode::TEST);
+      node->test.op = op;
+      node->test.field = field;
+      if (op == FILTER_JNET) {
+         node->test.arg = k;
+      } else {
+         node->test.k = k;
+      }
+      return invert ? new FilterNode(FilterNode::NOT, node) : node;
+   }
+
+   uint64_t parse_network(const std::string &value)
+   {
+      ExportFilter::Network net;
+      memset(&net, 0, sizeof(net));
+      size_t slash = value.find('/');
+      std::string addr = value.substr(0, slash);
+      if (inet_pton(AF_INET, addr.c_str(), net.addr) == 1) {
+         net.ip_version = IP::v4;
+         net.prefix = 32;
+      } else if (inet_pton(AF_INET6, addr.c_str(), net.addr) == 1) {
+         net.ip_version = IP::v6;
+         net.prefix = 128;
+      } else {
+         error("invalid address " + value);
+      }
+      if (slash != std::string::npos) {
+         try {
+            uint8_t prefix = str2num<uint8_t>(value.substr(slash + 1));
+            if (prefix > net.prefix) {
+               throw std::invalid_argument(value);
+            }
+            net.prefix = prefix;
+         } catch (std::invalid_argument &e) {
+            error("invalid prefix length " + value);
+         }
+      }
+      m_filter.m_networks.push_back(net);
+      return m_filter.m_networks.size() - 1;
+   }
+};
+
+ExportFilter::ExportFilter(const std::vector<std::string> &rules, const OutputPlugin::Plugins &plugins) :
+   m_code(), m_rules(), m_networks(), m_strings(), m_ext_ids(), m_seen(0), m_dropped(0), m_stripped(0)
+{
+   for (auto &it : plugins) {
+      RecordExt *ext = it.second->get_ext();
+      if (ext == nullptr) {
+         continue;
+      }
+      if (ext->m_ext_id < 64) {
+         m_ext_ids[it.first] = ext->m_ext_id;
+      }
+      delete ext;
+   }
+
+   for (auto &it : rules) {
+      FilterCompiler compiler(*this, it);
+      compiler.compile();
+   }
+}
+
+ExportFilter::~ExportFilter()
+{
+}
+
+/**
+ * \brief Emit instructions of expression, code is emitted from the last test, so jump targets are always known.
+ * \param [in] node Expression.
+ * \param [in] jt Target when expression holds.
+ * \param [in] jf Target otherwise.
+ * \return Index of the first instruction of expression.
+ */
+uint16_t ExportFilter::emit(const FilterNode *node, uint16_t jt, uint16_t jf)
+{
+   switch (node->type) {
+   case FilterNode::AND:
+      return emit(node->left.get(), emit(node->right.get(), jt, jf), jf);
+   case FilterNode::OR:
+      return emit(node->left.get(), jt, emit(node->right.get(), jt, jf));
+   case FilterNode::NOT:
+      return emit(node->left.get(), jf, jt);
+   default:
+      break;
+   }
+
+   if (m_code.size() >= FILTER_FALSE) {
+      throw PluginError("export filter is too long");
+   }
+   FilterInsn insn = node->test;
+   insn.jt = jt;
+   insn.jf = jf;
+   m_code.push_back(insn);
+   return m_code.size() - 1;
+}
+
+static inline uint64_t filter_load(uint8_t field, const Flow &flow)
+{
+   switch (field) {
+   case FIELD_PROTO:
+      return flow.ip_proto;
+   case FIELD_IP_VERSION:
+      return flow.ip_version;
+   case FIELD_SRC_PORT:
+      return flow.src_port;
+   case FIELD_DST_PORT:
+      return flow.dst_port;
+   case FIELD_SRC_PACKETS:
+      return flow.src_packets;
+   case FIELD_DST_PACKETS:
+      return flow.dst_packets;
+   case FIELD_PACKETS:
+      return static_cast<uint64_t>(flow.src_packets) + flow.dst_packets;
+   case FIELD_SRC_BYTES:
+      return flow.src_bytes;
+   case FIELD_DST_BYTES:
+      return flow.dst_bytes;
+   case FIELD_BYTES:
+      return flow.src_bytes + flow.dst_bytes;
+   case FIELD_SRC_TCP_FLAGS:
+      return flow.src_tcp_flags;
+   case FIELD_DST_TCP_FLAGS:
+      return flow.dst_tcp_flags;
+   case FIELD_TCP_FLAGS:
+      return flow.src_tcp_flags | flow.dst_tcp_flags;
+   case FIELD_DURATION:
+      return ((flow.time_last.tv_sec - flow.time_first.tv_sec) * 1000000 +
+         (flow.time_last.tv_usec - flow.time_first.tv_usec)) / 1000;
+   case FIELD_END_REASON:
+      return flow.end_reason;
+   default:
+      return 0;
+   }
+}
+
+bool ExportFilter::match_network(const Network &net, const Flow &flow, uint8_t field) const
+{
+   if (flow.ip_version != net.ip_version) {
+      return false;
+   }
+   const uint8_t *addr = field == FIELD_SRC_IP ?
+      reinterpret_cast<const uint8_t *>(&flow.src_ip) : reinterpret_cast<const uint8_t *>(&flow.dst_ip);
+   uint8_t bytes = net.prefix / 8;
+   uint8_t bits = net.prefix % 8;
+   if (memcmp(addr, net.addr, bytes)) {
+      return false;
+   }
+   return !bits || !((addr[bytes] ^ net.addr[bytes]) & (0xFF00 >> bits));
+}
+
+bool ExportFilter::match(uint16_t pc, const Flow &flow) const
+{
+   while (pc < FILTER_FALSE) {
+      const FilterInsn &insn = m_code[pc];
+      bool res;
+      switch (insn.op) {
+      case FILTER_JEQ:
+         res = filter_load(insn.field, flow) == insn.k;
+         break;
+      case FILTER_JGT:
+         res = filter_load(insn.field, flow) > insn.k;
+         break;
+      case FILTER_JGE:
+         res = filter_load(insn.field, flow) >= insn.k;
+         break;
+      case FILTER_JSET:
+         res = (filter_load(insn.field, flow) & insn.k) != 0;
+         break;
+      case FILTER_JNET:
+         res = match_network(m_networks[insn.arg], flow, insn.field);
+         break;
+      case FILTER_JHAS:
+         res = flow.get_extension(insn.arg) != nullptr;
+         break;
+      case FILTER_JTEXT: {
+         RecordExt *ext = flow.get_extension(insn.arg);
+         res = ext != nullptr && ext->get_text().find(m_strings[insn.k]) != std::string::npos;
+         break;
+      }
+      default:
+         res = false;
+         break;
+      }
+      pc = res ? insn.jt : insn.jf;
+   }
+   return pc == FILTER_TRUE;
+}
+
+void ExportFilter::print_stats() const
+{
+   std::cerr << "export filter: dropped " << m_dropped << " of " << m_seen << " flows, stripped " <<
+      m_stripped << " extensions (" << m_code.size() << " instructions)" << std::endl;
+}
+
+}
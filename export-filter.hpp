@@ -0,0 +1,149 @@
+/**
+ * \file export-filter.hpp
+ * \brief Filter and projection of exported flows compiled to branch bytecode.
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef IPXP_EXPORT_FILTER_HPP
+#define IPXP_EXPORT_FILTER_HPP
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <ipfixprobe/flowifc.hpp>
+#include <ipfixprobe/output.hpp>
+
+namespace ipxp {
+
+/**
+ * \brief Instruction of compiled filter expression.
+ *
+ * Every instruction tests one condition and continues at jt or jf, expression
+ * is finished when the target is FILTER_TRUE or FILTER_FALSE.
+ */
+struct FilterInsn {
+   uint8_t op; /**< FilterOp. */
+   uint8_t field; /**< FilterField tested by comparison. */
+   uint16_t jt; /**< Next instruction when condition holds. */
+   uint16_t jf; /**< Next instruction otherwise. */
+   uint16_t arg; /**< Index of network or string constant, extension ID. */
+   uint64_t k; /**< Compared value. */
+};
+
+struct FilterNode;
+
+/**
+ * \brief Ordered list of export rules, first matching rule decides.
+ *
+ * Rule syntax: `drop [if EXPR]` or `keep [if EXPR] [strip PLUGIN[,PLUGIN...]]`.
+ * Flows matching no rule are exported unchanged.
+ */
+class ExportFilter
+{
+public:
+   static constexpr uint16_t FILTER_TRUE = 0xFFFF;
+   static constexpr uint16_t FILTER_FALSE = 0xFFFE;
+
+   /**
+    * \brief Constructor.
+    * \param [in] rules Rules in order of evaluation.
+    * \param [in] plugins Active process plugins, their names are used in rules.
+    */
+   ExportFilter(const std::vector<std::string> &rules, const OutputPlugin::Plugins &plugins);
+   ~ExportFilter();
+
+   /**
+    * \brief Apply rules to flow, extensions stripped by matching rule are removed from flow.
+    * \param [in,out] flow Flow record owned by output worker.
+    * \return False when flow is not exported.
+    */
+   bool apply(Flow &flow)
+   {
+      m_seen++;
+      for (const auto &rule : m_rules) {
+         if (!match(rule.entry, flow)) {
+            continue;
+         }
+         if (rule.drop) {
+            m_dropped++;
+            return false;
+         }
+         for (uint64_t strip = rule.strip; strip; strip &= strip - 1) {
+            m_stripped += flow.remove_extension(__builtin_ctzll(strip));
+         }
+         return true;
+      }
+      return true;
+   }
+
+   void print_stats() const;
+
+private:
+   struct Rule {
+      uint16_t entry; /**< First instruction of condition. */
+      bool drop;
+      uint64_t strip; /**< Bitmask of extension IDs removed from kept flow. */
+   };
+   struct Network {
+      uint8_t addr[16];
+      uint8_t prefix;
+      uint8_t ip_version;
+   };
+
+   std::vector<FilterInsn> m_code;
+   std::vector<Rule> m_rules;
+   std::vector<Network> m_networks;
+   std::vector<std::string> m_strings;
+   std::map<std::string, int> m_ext_ids; /**< Extension IDs by process plugin name. */
+   uint64_t m_seen;
+   uint64_t m_dropped;
+   uint64_t m_stripped;
+
+   bool match(uint16_t pc, const Flow &flow) const;
+   bool match_network(const Network &net, const Flow &flow, uint8_t field) const;
+   uint16_t emit(const FilterNode *node, uint16_t jt, uint16_t jf);
+
+   friend class FilterCompiler;
+};
+
+}
+#endif /* IPXP_EXPORT_FILTER_HPP */
@@ -0,0 +1,214 @@
+/**
+ * \file dpi.hpp
+ * \brief Pool of threads running payload inspecting process plugins apart from flow cache
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef IPXP_DPI_HPP
+#define IPXP_DPI_HPP
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "packet.hpp"
+#include "flowifc.hpp"
+#include "process.hpp"
+#include "spsc.hpp"
+
+namespace ipxp {
+
+/**
+ * \brief State of a flow inspected by DPI worker.
+ *
+ * Shadow flow is accessed only by the worker the flow is assigned to, other members only by storage thread.
+ */
+struct DpiFlow {
+   Flow shadow;     /**< Flow passed to plugins of worker, holds extensions created by them */
+   Flow *owner;     /**< Flow record of storage plugin, nullptr when unused */
+   uint64_t seq;    /**< Sequence number of last task of the flow */
+   uint32_t gen;    /**< Generation of the state, incremented on release */
+   uint32_t worker; /**< Index of worker inspecting the flow */
+   int flush;       /**< Flush options returned by plugins and not applied yet */
+   bool pre_export; /**< Storage plugin requested pre_export call */
+
+   DpiFlow() : shadow(), owner(nullptr), seq(0), gen(0), worker(0), flush(0), pre_export(false)
+   {
+   }
+};
+
+/**
+ * \brief Work item passed from storage thread to DPI worker.
+ */
+struct DpiTask {
+   enum class Type : uint8_t {
+      CREATE, /**< First packet of flow, post_create is called */
+      UPDATE, /**< Next packet of flow, pre_update and post_update are called */
+      EXPORT  /**< Flow is about to be exported */
+   };
+
+   Type type;
+   DpiFlow *flow;
+   uint64_t plugins;  /**< Plugins interested in flow */
+   bool pre_export;
+   Flow rec;          /**< Copy of flow record fields without extensions */
+   Packet pkt;        /**< Copy of packet pointing to data */
+   std::vector<uint8_t> data;
+
+   DpiTask(size_t size = 0) : type(Type::UPDATE), flow(nullptr), plugins(0), pre_export(false), rec(), pkt(), data(size)
+   {
+   }
+};
+
+/**
+ * \brief Options and plugins detached in DPI worker, sent back to storage thread.
+ */
+struct DpiResult {
+   DpiFlow *flow;
+   uint32_t gen;
+   int ret;
+   uint64_t detached;
+};
+
+/**
+ * \brief Pool of threads running process plugins which inspect packet payload.
+ *
+ * Storage thread keeps flow records, counters and timeouts and submits payload carrying packets of flows
+ * with active offloaded plugins to workers through per-worker queues, flows are sharded by symmetric flow hash.
+ * Extensions created by workers are merged into flow record before it is exported. Flush requested by
+ * offloaded plugin is applied when the next packet of flow arrives.
+ */
+class DpiWorkers
+{
+public:
+   /**
+    * \brief Constructor, starts worker threads.
+    * \param [in] plugins Plugins of storage plugin, offloaded ones are copied to each worker.
+    * \param [in] plugin_cnt Number of plugins.
+    * \param [in] offload Bitmask of plugins to offload.
+    * \param [in] workers Number of worker threads.
+    * \param [in] queue_size Number of packets queued to one worker.
+    * \param [in] buffer_size Size of packet copies.
+    */
+   DpiWorkers(ProcessPlugin **plugins, uint32_t plugin_cnt, uint64_t offload, uint32_t workers,
+      uint32_t queue_size, uint32_t buffer_size);
+   ~DpiWorkers();
+
+   /**
+    * \brief Submit packet of flow to worker.
+    * \param [in,out] rec Flow record updated by packet.
+    * \param [in] pkt Packet with payload.
+    */
+   void submit(Flow &rec, const Packet &pkt);
+
+   /**
+    * \brief Wait for worker to finish flow and move its extensions to flow record.
+    * \param [in,out] rec Flow record about to be exported.
+    */
+   void merge(Flow &rec);
+
+   /**
+    * \brief Apply results sent back by workers.
+    * \throws PluginError When plugin of a worker failed.
+    */
+   void poll();
+
+   /**
+    * \brief Get flush options requested by offloaded plugins and not applied yet.
+    * \param [in,out] rec Flow record.
+    * \return FLOW_FLUSH_WITH_REINSERT or 0.
+    */
+   int take_flush(Flow &rec)
+   {
+      if (rec.dpi == nullptr || rec.dpi->flush == 0) {
+         return 0;
+      }
+      rec.dpi->flush = 0;
+      return FLOW_FLUSH_WITH_REINSERT;
+   }
+
+   /**
+    * \brief Request pre_export call of offloaded plugins.
+    * \param [in,out] rec Flow record.
+    */
+   void pre_export(Flow &rec)
+   {
+      if (rec.dpi != nullptr) {
+         rec.dpi->pre_export = true;
+      }
+   }
+
+private:
+   struct Worker {
+      SpscRing<DpiTask> tasks;
+      SpscRing<DpiResult> results;
+      std::atomic<uint64_t> done; /**< Number of processed tasks */
+      uint64_t seq;               /**< Number of submitted tasks */
+      std::vector<ProcessPlugin *> plugins; /**< Copies of offloaded plugins, nullptr for others */
+      std::thread thread;
+
+      Worker(uint32_t queue_size, uint32_t buffer_size) :
+         tasks(queue_size, DpiTask(buffer_size)), results(queue_size), done(0), seq(0), plugins()
+      {
+      }
+   };
+
+   std::vector<Worker *> m_workers;
+   std::vector<DpiFlow *> m_flows; /**< All allocated states */
+   std::vector<DpiFlow *> m_free;  /**< Unused states */
+   uint64_t m_offload;
+   std::atomic<bool> m_stop;
+   std::atomic<bool> m_failed;
+   std::mutex m_lock;              /**< Protects m_error */
+   std::string m_error;
+
+   DpiFlow *alloc(Flow &rec);
+   void release(DpiFlow *flow);
+   DpiTask *acquire(Worker &worker);
+   void poll(Worker &worker);
+   void run(Worker *worker);
+   void process(Worker &worker, DpiTask &task);
+   void send(Worker &worker, DpiTask &task, int ret, uint64_t detached);
+};
+
+}
+#endif /* IPXP_DPI_HPP */
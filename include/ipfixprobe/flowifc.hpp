@@ -52,7 +52,9 @@
 #include <config.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
+#include <string>
 
 #ifdef WITH_NEMEA
 #include <unirec/unirec.h>
@@ -135,6 +137,38 @@ struct RecordExt {
       return "";
    }
 
+   /**
+    * \brief Get version of data written by save_snapshot().
+    * Version must be changed whenever layout or meaning of saved data changes.
+    * \return Version or 0 when extension cannot be stored in flow cache snapshot.
+    */
+   virtual uint16_t snapshot_version() const
+   {
+      return 0;
+   }
+
+   /**
+    * \brief Serialize extension data to flow cache snapshot.
+    * \param [out] buffer Snapshot buffer.
+    * \param [in] size Snapshot buffer size.
+    * \return Number of bytes written to buffer or -1 if data cannot be written.
+    */
+   virtual int save_snapshot(uint8_t *buffer, int size) const
+   {
+      return -1;
+   }
+
+   /**
+    * \brief Restore extension data from flow cache snapshot of the same version.
+    * \param [in] buffer Data written by save_snapshot().
+    * \param [in] size Size of data.
+    * \return True on success.
+    */
+   virtual bool load_snapshot(const uint8_t *buffer, int size)
+   {
+      return false;
+   }
+
    /**
     * \brief Add extension at the end of linked list.
     * \param [in] ext Extension to add.
@@ -159,6 +193,40 @@ struct RecordExt {
    }
 };
 
+/**
+ * \brief Implement snapshot hooks of extension holding only plain data members (no pointers nor containers).
+ *
+ * Members following the base struct are copied byte by byte, data saved by a different
+ * build are rejected by size check or by version, which has to be bumped on semantic changes.
+ * \param [in] type Extension struct.
+ * \param [in] version Version of extension data.
+ */
+#define RECORD_EXT_PLAIN_SNAPSHOT(type, version) \
+   uint16_t snapshot_version() const \
+   { \
+      return version; \
+   } \
+   int save_snapshot(uint8_t *buffer, int size) const \
+   { \
+      const uint8_t *begin = reinterpret_cast<const uint8_t *>(&m_ext_id + 1); \
+      const uint8_t *end = reinterpret_cast<const uint8_t *>(this) + sizeof(type); \
+      if (end - begin > size) { \
+         return -1; \
+      } \
+      memcpy(buffer, begin, end - begin); \
+      return end - begin; \
+   } \
+   bool load_snapshot(const uint8_t *buffer, int size) \
+   { \
+      uint8_t *begin = reinterpret_cast<uint8_t *>(&m_ext_id + 1); \
+      uint8_t *end = reinterpret_cast<uint8_t *>(this) + sizeof(type); \
+      if (end - begin != size) { \
+         return false; \
+      } \
+      memcpy(begin, buffer, size); \
+      return true; \
+   }
+
 struct Record {
    RecordExt *m_exts; /**< Extension headers. */
 
@@ -244,43 +312,70 @@ struct Record {
 
    /**
     * \brief Destructor.
+    *
+    * Record is not polymorphic, so zero filled memory is a valid record without extensions.
     */
-   virtual ~Record()
+   ~Record()
    {
       remove_extensions();
    }
 };
 
+struct DpiFlow;
+
 #define FLOW_END_INACTIVE 0x01
 #define FLOW_END_ACTIVE   0x02
 #define FLOW_END_EOF      0x03
 #define FLOW_END_FORCED   0x04
 #define FLOW_END_NO_RES   0x05
 
+#define FLOW_DEGRADED_DPI     0x01 /**< Process plugins interested in flow were disabled by overload control. */
+#define FLOW_DEGRADED_SAMPLED 0x02 /**< Packets of flow were sampled by overload control. */
+
+/**
+ * \brief Packet selection applied by storage before flows are built.
+ *
+ * Values follow PSAMP selectorAlgorithm registry (RFC 5477).
+ */
+enum class SamplingMode : uint16_t {
+   NONE = 0,
+   COUNT = 1,  /**< Systematic count-based sampling, every N-th packet is selected. */
+   RANDOM = 4, /**< Uniform probabilistic sampling, packet is selected with probability 1/N. */
+   FLOW = 6    /**< Hash-based filtering on symmetric flow key, one of N flows is selected with both directions. */
+};
+
 /**
  * \brief Flow record struct constaining basic flow record data and extension headers.
+ *
+ * Fields used on every packet are grouped in the first 64 bytes together with
+ * extension pointer of Record, flow key and other fields set only on flow
+ * creation follow. Zero filled Flow is a valid empty record.
  */
 struct Flow : public Record {
-   struct timeval time_first;
    struct timeval time_last;
    uint64_t src_bytes;
    uint64_t dst_bytes;
    uint32_t src_packets;
    uint32_t dst_packets;
+   uint64_t plugins_active; /**< Bitmask of process plugins called on flow update */
    uint8_t  src_tcp_flags;
    uint8_t  dst_tcp_flags;
-
    uint8_t  ip_version;
-
    uint8_t  ip_proto;
    uint16_t src_port;
    uint16_t dst_port;
+
+   struct timeval time_first;
    ipaddr_t src_ip;
    ipaddr_t dst_ip;
 
    uint8_t src_mac[6];
    uint8_t dst_mac[6];
    uint8_t end_reason;
+   uint8_t degraded; /**< FLOW_DEGRADED_* features reduced by overload control. */
+   uint64_t plugins_created; /**< Bitmask of process plugins which created flow state, they are called on export */
+
+   DpiFlow *dpi = nullptr; /**< State of flow in DPI workers */
 };
 
 }
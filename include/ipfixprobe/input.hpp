@@ -73,7 +73,42 @@ public:
    InputPlugin() : m_seen(0), m_parsed(0), m_dropped(0) {}
    virtual ~InputPlugin() {}
 
+   /**
+    * \brief Receive block of packets.
+    *
+    * Packets may reference memory owned by the plugin (e.g. NIC buffers), which has to stay valid
+    * until the next get() call. Storage plugin processes the whole block before calling get() again.
+    * \param [out] packets Block to fill.
+    * \return Result of the receive.
+    */
    virtual Result get(PacketBlock &packets) = 0;
+
+   /**
+    * \brief Check whether plugin delivers packets in deterministic blocks shared by several pipelines.
+    *
+    * Every get() call of such plugin returns one block of a sequence which is the same on every run,
+    * blocks may be empty. Pipelines of ordered plugins export flows to separate queues and output
+    * plugin reads them round-robin, one packet block at a time, so flows are exported in deterministic order.
+    * Storage plugins of ordered pipelines never export flows based on wall clock timeouts.
+    * \return True for ordered plugins.
+    */
+   virtual bool ordered() const
+   {
+      return false;
+   }
+
+   /**
+    * \brief Get number of input queues configured by the plugin which are not read by any instance yet.
+    *
+    * Called after init(). When the next input specified on command line is not the same plugin,
+    * one additional pipeline with an instance of the plugin initialized without parameters
+    * is created for every pending queue.
+    * \return Number of pending queues.
+    */
+   virtual size_t pending_queues() const
+   {
+      return 0;
+   }
 };
 
 }
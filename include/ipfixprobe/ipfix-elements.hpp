@@ -95,6 +95,7 @@ namespace ipxp {
 #define INPUT_INTERFACE(F)            F(0,       10,    2,   &this->dir_bit_field)
 #define OUTPUT_INTERFACE(F)           F(0,       14,    2,   nullptr)
 #define FLOW_END_REASON(F)            F(0,      136,    1,   &flow.end_reason)
+#define FLOW_DEGRADED(F)              F(8057,  1110,    1,   &flow.degraded)
 
 #define ETHERTYPE(F)                  F(0,      256,    2,   nullptr)
 
@@ -193,6 +194,7 @@ namespace ipxp {
 #define ARP_DST_PA(F)                 F(8057,    37,   -1,   nullptr)
 
 #define TLS_SNI(F)                    F(8057,   808,   -1,   nullptr)
+#define TLS_JA4(F)                    F(8057,   809,   -1,   nullptr)
 #define TLS_VERSION(F)                F(39499,  333,    2,   nullptr)
 #define TLS_ALPN(F)                   F(39499,  337,   -1,   nullptr)
 #define TLS_JA3(F)                    F(39499,  357,   -1,   nullptr)
@@ -272,6 +274,9 @@ namespace ipxp {
 #define WG_SRC_PEER(F)                F(8057,    1101,   4,   nullptr)
 #define WG_DST_PEER(F)                F(8057,    1102,   4,   nullptr)
 
+#define APP_ID(F)                     F(0,        95,    3,   nullptr)
+#define APP_NAME(F)                   F(0,        96,   -1,   nullptr)
+
 /**
  * IPFIX Templates - list of elements
  *
@@ -332,6 +337,15 @@ namespace ipxp {
    F(L2_SRC_MAC) \
    F(L2_DST_MAC)
 
+/**
+ * Elements appended to basic templates when overload control is enabled.
+ *
+ * FLOW_DEGRADED is a private element of CESNET enterprise 8057, not registered by IANA: unsigned8 bit field,
+ * 1 process plugins were disabled for the flow, 2 packets of the flow were sampled.
+ */
+#define OVERLOAD_TMPLT(F) \
+   F(FLOW_DEGRADED)
+
 #define IPFIX_HTTP_TEMPLATE(F) \
    F(HTTP_USERAGENT) \
    F(HTTP_METHOD) \
@@ -355,6 +369,9 @@ namespace ipxp {
    F(TLS_ALPN) \
    F(TLS_JA3)
 
+#define IPFIX_TLS_JA4_TEMPLATE(F) \
+   F(TLS_JA4)
+
 #define IPFIX_NTP_TEMPLATE(F) \
    F(NTP_LEAP) \
    F(NTP_VERSION) \
@@ -485,6 +502,10 @@ namespace ipxp {
   F(QUIC_USER_AGENT) \
   F(QUIC_VERSION)
 
+#define IPFIX_APPID_TEMPLATE(F) \
+  F(APP_ID) \
+  F(APP_NAME)
+
 #define IPFIX_OSQUERY_TEMPLATE(F) \
    F(OSQUERY_PROGRAM_NAME) \
    F(OSQUERY_USERNAME) \
@@ -517,9 +538,11 @@ namespace ipxp {
 #define IPFIX_ENABLED_TEMPLATES(F) \
    BASIC_TMPLT_V4(F) \
    BASIC_TMPLT_V6(F) \
+   OVERLOAD_TMPLT(F) \
    IPFIX_HTTP_TEMPLATE(F) \
    IPFIX_RTSP_TEMPLATE(F) \
    IPFIX_TLS_TEMPLATE(F) \
+   IPFIX_TLS_JA4_TEMPLATE(F) \
    IPFIX_NTP_TEMPLATE(F) \
    IPFIX_SIP_TEMPLATE(F) \
    IPFIX_DNS_TEMPLATE(F) \
@@ -536,6 +559,7 @@ namespace ipxp {
    IPFIX_PHISTS_TEMPLATE(F) \
    IPFIX_WG_TEMPLATE(F) \
    IPFIX_QUIC_TEMPLATE(F) \
+   IPFIX_APPID_TEMPLATE(F) \
    IPFIX_OSQUERY_TEMPLATE(F) \
    IPFIX_FLEXPROBE_DATA_TEMPLATE(F) \
    IPFIX_FLEXPROBE_TCP_TEMPLATE(F) \
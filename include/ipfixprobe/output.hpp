@@ -85,6 +85,26 @@ public:
    virtual void flush()
    {
    }
+
+   /**
+    * \brief Announce packet sampling applied by storage of a pipeline, so counters can be scaled by collector.
+    * Called before the first sampled flow is exported and whenever sampling of the pipeline changes,
+    * possibly from storage thread while output worker runs.
+    * \param [in] pipeline Index of pipeline.
+    * \param [in] mode Sampling mode, SamplingMode::NONE when all packets are processed.
+    * \param [in] interval One of interval packets (or flows) is selected.
+    */
+   virtual void set_sampling(uint32_t pipeline, SamplingMode mode, uint32_t interval)
+   {
+   }
+
+   /**
+    * \brief Announce overload control, flows then carry FLOW_DEGRADED_* flags worth exporting.
+    * Called before output worker starts.
+    */
+   virtual void set_overload_control()
+   {
+   }
 };
 
 }
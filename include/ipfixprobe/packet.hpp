@@ -55,6 +55,29 @@
 
 namespace ipxp {
 
+struct DnsMessage;
+
+/**
+ * \brief Flags of packet fields filled by input plugin.
+ *
+ * Inputs receiving packets pre-parsed by hardware fill Packet fields directly and mark
+ * the valid ones, packet parser is skipped when all fields required by the input are valid.
+ * Fields without flag are cleared, plugins inspecting payload are not called without PKT_META_PAYLOAD.
+ */
+enum PacketMeta : uint16_t {
+   PKT_META_NONE = 0,
+   PKT_META_TS = 1 << 0, /**< ts */
+   PKT_META_L2 = 1 << 1, /**< dst_mac, src_mac, ethertype */
+   PKT_META_L3 = 1 << 2, /**< ip_len, ip_payload_len, ip_version, ip_proto, src_ip, dst_ip, packet_len_wire */
+   PKT_META_L3_EXT = 1 << 3, /**< ip_ttl, ip_tos, ip_flags */
+   PKT_META_L4 = 1 << 4, /**< src_port, dst_port, tcp_flags */
+   PKT_META_TCP = 1 << 5, /**< tcp_window, tcp_options, tcp_mss, tcp_seq, tcp_ack */
+   PKT_META_PAYLOAD = 1 << 6, /**< packet, packet_len, payload, payload_len, payload_len_wire */
+
+   PKT_META_FLOW = PKT_META_TS | PKT_META_L3 | PKT_META_L4, /**< Fields needed to create and update flow */
+   PKT_META_ALL = 0x7F
+};
+
 /**
  * \brief Structure for storing parsed packet fields
  */
@@ -100,6 +123,9 @@ struct Packet : public Record {
    uint16_t    buffer_size; /**< Size of buffer */
 
    bool        source_pkt; /**< Direction of packet from flow point of view */
+   uint16_t    meta; /**< PacketMeta flags of valid fields, PKT_META_ALL when packet was parsed */
+
+   mutable const DnsMessage *dns; /**< DNS payload decoded by first DNS plugin, shared with the others */
 
    /**
     * \brief Constructor.
@@ -115,7 +141,8 @@ struct Packet : public Record {
       payload(nullptr), payload_len(0), payload_len_wire(0),
       custom(nullptr), custom_len(0),
       buffer(nullptr), buffer_size(0),
-      source_pkt(true)
+      source_pkt(true), meta(PKT_META_ALL),
+      dns(nullptr)
    {
    }
 };
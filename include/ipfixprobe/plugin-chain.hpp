@@ -0,0 +1,306 @@
+/**
+ * \file plugin-chain.hpp
+ * \brief Process plugins composed at compile time
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef IPXP_PLUGIN_CHAIN_HPP
+#define IPXP_PLUGIN_CHAIN_HPP
+
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+#include "options.hpp"
+#include "output.hpp"
+#include "process.hpp"
+
+namespace ipxp {
+
+/**
+ * \brief Chain of process plugins called without virtual dispatch.
+ *
+ * Storage plugin sees the chain as a single process plugin. Hooks of members are called by qualified
+ * names, so they are inlined into the chain and default empty hooks are optimized out. Members are copies
+ * of process plugins initialized from command line, so options of plugins keep working.
+ * Flow is detached from the chain when all members detach in the same call. Members are not dispatched
+ * by their interests, each one checks relevance of packets itself as usual.
+ */
+template<typename... Plugins>
+class PluginChain : public ProcessPlugin
+{
+public:
+   /**
+    * \brief Create chain from configured process plugins, all members have to be available.
+    * \param [in] plugins Initialized process plugins.
+    */
+   PluginChain(const OutputPlugin::Plugins &plugins) : m_members(*find<Plugins>(plugins)...)
+   {
+   }
+
+   /**
+    * \brief Check whether every member of the chain is among configured process plugins.
+    * \param [in] plugins Initialized process plugins.
+    * \return True when chain can be created.
+    */
+   static bool available(const OutputPlugin::Plugins &plugins)
+   {
+      return all_found<Plugins...>(plugins);
+   }
+
+   /**
+    * \brief Check whether plugin is replaced by a member of the chain.
+    * \param [in] plugin Process plugin.
+    * \return True for members.
+    */
+   static bool member(const ProcessPlugin *plugin)
+   {
+      return is_member<Plugins...>(plugin);
+   }
+
+   OptionsParser *get_parser() const { return new OptionsParser("chain", "Statically composed process plugins"); }
+   std::string get_name() const { return "chain"; }
+   ProcessPlugin *copy() { return new PluginChain(*this); }
+
+   PluginInterest get_interest() const
+   {
+      PluginInterest interest({}, {}, true);
+      bool any_proto = false;
+      bool any_port = false;
+      call_all(MergeInterest{interest, any_proto, any_port});
+      if (any_proto) {
+         interest.protocols.clear();
+      }
+      if (any_port) {
+         interest.ports.clear();
+      }
+      return interest;
+   }
+
+   bool has_name(const std::string &name) const
+   {
+      bool found = name == get_name();
+      call_all(MatchName{name, found});
+      return found;
+   }
+
+   void close()
+   {
+      call_all(Close{});
+   }
+
+   int pre_create(Packet &pkt)
+   {
+      return options(call_all(PreCreate{pkt}));
+   }
+
+   int post_create(Flow &rec, const Packet &pkt)
+   {
+      return options(call_all(PostCreate{rec, pkt}));
+   }
+
+   int pre_update(Flow &rec, Packet &pkt)
+   {
+      return options(call_all(PreUpdate{rec, pkt}));
+   }
+
+   int post_update(Flow &rec, const Packet &pkt)
+   {
+      return options(call_all(PostUpdate{rec, pkt}));
+   }
+
+   void pre_export(Flow &rec)
+   {
+      call_all(PreExport{rec});
+   }
+
+private:
+   std::tuple<Plugins...> m_members;
+
+   /**
+    * \brief Options returned by members merged, detach bit is set only when all members detached.
+    */
+   struct Result {
+      int ret;
+      int detach;
+   };
+
+   struct PreCreate {
+      Packet &pkt;
+      template<typename T> int operator()(T &plugin) const { return plugin.T::pre_create(pkt); }
+   };
+
+   struct PostCreate {
+      Flow &rec;
+      const Packet &pkt;
+      template<typename T> int operator()(T &plugin) const { return plugin.T::post_create(rec, pkt); }
+   };
+
+   struct PreUpdate {
+      Flow &rec;
+      Packet &pkt;
+      template<typename T> int operator()(T &plugin) const { return plugin.T::pre_update(rec, pkt); }
+   };
+
+   struct PostUpdate {
+      Flow &rec;
+      const Packet &pkt;
+      template<typename T> int operator()(T &plugin) const { return plugin.T::post_update(rec, pkt); }
+   };
+
+   struct PreExport {
+      Flow &rec;
+      template<typename T> int operator()(T &plugin) const { plugin.T::pre_export(rec); return 0; }
+   };
+
+   struct Close {
+      template<typename T> int operator()(T &plugin) const { plugin.T::close(); return 0; }
+   };
+
+   struct MergeInterest {
+      PluginInterest &interest;
+      bool &any_proto;
+      bool &any_port;
+      template<typename T> int operator()(const T &plugin) const
+      {
+         PluginInterest member = plugin.T::get_interest();
+         any_proto |= member.protocols.empty();
+         any_port |= member.ports.empty();
+         interest.payload_only &= member.payload_only;
+         interest.protocols.insert(interest.protocols.end(), member.protocols.begin(), member.protocols.end());
+         interest.ports.insert(interest.ports.end(), member.ports.begin(), member.ports.end());
+         return 0;
+      }
+   };
+
+   struct MatchName {
+      const std::string &name;
+      bool &found;
+      template<typename T> int operator()(const T &plugin) const
+      {
+         found |= plugin.T::get_name() == name;
+         return 0;
+      }
+   };
+
+   static int options(const Result &res)
+   {
+      return (res.ret & ~FLOW_PLUGIN_DETACH) | res.detach;
+   }
+
+   template<size_t I = 0, typename Hook>
+   typename std::enable_if<(I == sizeof...(Plugins)), Result>::type call_all(const Hook &hook)
+   {
+      return Result{0, FLOW_PLUGIN_DETACH};
+   }
+
+   template<size_t I = 0, typename Hook>
+   typename std::enable_if<(I < sizeof...(Plugins)), Result>::type call_all(const Hook &hook)
+   {
+      int ret = hook(std::get<I>(m_members));
+      Result res = call_all<I + 1>(hook);
+      return Result{ret | res.ret, ret & res.detach};
+   }
+
+   template<size_t I = 0, typename Hook>
+   typename std::enable_if<(I == sizeof...(Plugins)), void>::type call_all(const Hook &hook) const
+   {
+   }
+
+   template<size_t I = 0, typename Hook>
+   typename std::enable_if<(I < sizeof...(Plugins)), void>::type call_all(const Hook &hook) const
+   {
+      hook(std::get<I>(m_members));
+      call_all<I + 1>(hook);
+   }
+
+   template<typename T>
+   static const T *find(const OutputPlugin::Plugins &plugins)
+   {
+      for (const auto &it : plugins) {
+         const T *plugin = dynamic_cast<const T *>(it.second);
+         if (plugin != nullptr) {
+            return plugin;
+         }
+      }
+      return nullptr;
+   }
+
+   template<typename T>
+   static bool all_found(const OutputPlugin::Plugins &plugins)
+   {
+      return find<T>(plugins) != nullptr;
+   }
+
+   template<typename T, typename U, typename... Rest>
+   static bool all_found(const OutputPlugin::Plugins &plugins)
+   {
+      return find<T>(plugins) != nullptr && all_found<U, Rest...>(plugins);
+   }
+
+   template<typename T>
+   static bool is_member(const ProcessPlugin *plugin)
+   {
+      return dynamic_cast<const T *>(plugin) != nullptr;
+   }
+
+   template<typename T, typename U, typename... Rest>
+   static bool is_member(const ProcessPlugin *plugin)
+   {
+      return is_member<T>(plugin) || is_member<U, Rest...>(plugin);
+   }
+};
+
+/**
+ * \brief Create the plugin chain selected by configure option --with-pluginchain.
+ * \param [in] plugins Initialized process plugins.
+ * \return New chain or nullptr when no chain is compiled in or some of its members is not configured.
+ */
+ProcessPlugin *create_plugin_chain(const OutputPlugin::Plugins &plugins);
+
+/**
+ * \brief Check whether process plugin is a member of the chain selected by configure option.
+ * \param [in] plugin Process plugin.
+ * \return True for members.
+ */
+bool plugin_chain_member(const ProcessPlugin *plugin);
+
+}
+#endif /* IPXP_PLUGIN_CHAIN_HPP */
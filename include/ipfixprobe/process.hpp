@@ -67,6 +67,30 @@ namespace ipxp {
  */
 #define FLOW_FLUSH_WITH_REINSERT    0x3
 
+/**
+ * \brief Tell storage plugin to stop calling pre_update and post_update of the plugin for current flow.
+ * Can be combined with other options, pre_export is still called. Plugins which have nothing more
+ * to extract from a flow should return it to save per-packet calls.
+ */
+#define FLOW_PLUGIN_DETACH          0x4
+
+/**
+ * \brief Flows a process plugin wants to receive.
+ * Storage plugin calls post_create, pre_update and post_update only for flows with a matching
+ * L4 protocol and a matching source or destination port. pre_create and pre_export are called for all flows.
+ */
+struct PluginInterest {
+   std::vector<uint8_t> protocols; /**< L4 protocols, empty for any protocol. */
+   std::vector<uint16_t> ports; /**< Ports of either flow endpoint, empty for any port. */
+   bool payload_only; /**< Plugin inspects only packets carrying payload and can run in a DPI worker thread,
+                           where the first packet with payload of a flow is passed to post_create. */
+
+   PluginInterest(std::vector<uint8_t> protocols = {}, std::vector<uint16_t> ports = {}, bool payload_only = false) :
+      protocols(protocols), ports(ports), payload_only(payload_only)
+   {
+   }
+};
+
 /**
  * \brief Class template for flow cache plugins.
  */
@@ -82,6 +106,25 @@ public:
       return nullptr;
    }
 
+   /**
+    * \brief Get flows the plugin is interested in, queried once when plugin is added to storage plugin.
+    * \return Interest predicate, all flows by default.
+    */
+   virtual PluginInterest get_interest() const
+   {
+      return PluginInterest();
+   }
+
+   /**
+    * \brief Check whether plugin answers to given name, composed plugins also answer to names of their members.
+    * \param [in] name Plugin name.
+    * \return True when plugin is or contains plugin of given name.
+    */
+   virtual bool has_name(const std::string &name) const
+   {
+      return get_name() == name;
+   }
+
    /**
     * \brief Called before a new flow record is created.
     * \param [in] pkt Parsed packet.
@@ -96,7 +139,7 @@ public:
     * \brief Called after a new flow record is created.
     * \param [in,out] rec Reference to flow record.
     * \param [in] pkt Parsed packet.
-    * \return 0 on success or FLOW_FLUSH option.
+    * \return 0 on success, FLOW_FLUSH or FLOW_PLUGIN_DETACH option.
     */
    virtual int post_create(Flow &rec, const Packet &pkt)
    {
@@ -107,7 +150,7 @@ public:
     * \brief Called before an existing record is update.
     * \param [in,out] rec Reference to flow record.
     * \param [in,out] pkt Parsed packet.
-    * \return 0 on success or FLOW_FLUSH option.
+    * \return 0 on success, FLOW_FLUSH or FLOW_PLUGIN_DETACH option.
     */
    virtual int pre_update(Flow &rec, Packet &pkt)
    {
@@ -118,7 +161,7 @@ public:
     * \brief Called after an existing record is updated.
     * \param [in,out] rec Reference to flow record.
     * \param [in,out] pkt Parsed packet.
-    * \return 0 on success or FLOW_FLUSH option.
+    * \return 0 on success, FLOW_FLUSH or FLOW_PLUGIN_DETACH option.
     */
    virtual int post_update(Flow &rec, const Packet &pkt)
    {
@@ -0,0 +1,138 @@
+/**
+ * \file spsc.hpp
+ * \brief Lock-free single producer single consumer ring of preallocated slots
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef IPXP_SPSC_HPP
+#define IPXP_SPSC_HPP
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+namespace ipxp {
+
+/**
+ * \brief Bounded ring of preallocated slots shared by exactly one producer and one consumer thread.
+ *
+ * Slots are reused, producer fills a slot in place obtained by acquire() and publishes it by commit(),
+ * consumer reads a slot obtained by front() and returns it by release(). No memory is allocated after
+ * construction.
+ */
+template <typename T>
+class SpscRing
+{
+public:
+   /**
+    * \brief Constructor.
+    * \param [in] size Requested number of slots, rounded up to power of two.
+    * \param [in] slot Value used to initialize all slots.
+    */
+   explicit SpscRing(size_t size, const T &slot = T()) : m_mask(0), m_head(0), m_pad(), m_tail(0)
+   {
+      size_t real = 1;
+      while (real < size) {
+         real <<= 1;
+      }
+      m_slots.assign(real, slot);
+      m_mask = real - 1;
+   }
+
+   /**
+    * \brief Get free slot to be filled by producer.
+    * \return Pointer to the slot or nullptr when ring is full.
+    */
+   T *acquire()
+   {
+      size_t tail = m_tail.load(std::memory_order_relaxed);
+      if (tail - m_head.load(std::memory_order_acquire) > m_mask) {
+         return nullptr;
+      }
+      return &m_slots[tail & m_mask];
+   }
+
+   /**
+    * \brief Publish slot obtained by last acquire() call.
+    */
+   void commit()
+   {
+      m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+   }
+
+   /**
+    * \brief Get oldest published slot.
+    * \return Pointer to the slot or nullptr when ring is empty.
+    */
+   T *front()
+   {
+      size_t head = m_head.load(std::memory_order_relaxed);
+      if (head == m_tail.load(std::memory_order_acquire)) {
+         return nullptr;
+      }
+      return &m_slots[head & m_mask];
+   }
+
+   /**
+    * \brief Return slot obtained by last front() call back to producer.
+    */
+   void release()
+   {
+      m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+   }
+
+   /**
+    * \brief Get number of slots of the ring.
+    */
+   size_t size() const
+   {
+      return m_mask + 1;
+   }
+
+private:
+   std::vector<T> m_slots;
+   size_t m_mask;
+   std::atomic<size_t> m_head; /**< Written only by consumer */
+   char m_pad[64];             /**< Keeps indexes in separate cache lines */
+   std::atomic<size_t> m_tail; /**< Written only by producer */
+};
+
+}
+#endif /* IPXP_SPSC_HPP */
@@ -46,12 +46,15 @@
 #define IPXP_STORAGE_HPP
 
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "plugin.hpp"
 #include "packet.hpp"
 #include "flowifc.hpp"
 #include "ring.h"
 #include "process.hpp"
+#include "dpi.hpp"
 
 namespace ipxp {
 
@@ -67,13 +70,29 @@ private:
    ProcessPlugin **m_plugins; /**< Array of plugins. */
    uint32_t m_plugin_cnt;
 
+   static constexpr uint16_t PORT_BUCKETS = 64;
+   uint64_t m_proto_plugins[256]; /**< Plugins interested in L4 protocol. */
+   uint64_t m_proto_any_port[256]; /**< Plugins interested in L4 protocol regardless of ports. */
+   std::vector<std::pair<uint16_t, uint64_t>> m_port_plugins[PORT_BUCKETS]; /**< Plugins interested in port, indexed by port bucket. */
+   uint64_t m_payload_plugins; /**< Plugins inspecting only packets with payload. */
+   uint64_t m_offload; /**< Plugins running in DPI workers. */
+   uint64_t m_shed; /**< Plugins not activated on new flows by overload control. */
+   uint8_t m_degraded; /**< FLOW_DEGRADED_* flags of flows updated in current overload state. */
+   DpiWorkers *m_dpi;
+
 public:
-   StoragePlugin() : m_export_queue(nullptr), m_plugins(nullptr), m_plugin_cnt(0)
+   static constexpr uint32_t MAX_PLUGINS = 64;
+
+   StoragePlugin() : m_export_queue(nullptr), m_plugins(nullptr), m_plugin_cnt(0),
+      m_proto_plugins(), m_proto_any_port(), m_payload_plugins(0), m_offload(0), m_shed(0), m_degraded(0), m_dpi(nullptr)
    {
    }
 
    virtual ~StoragePlugin()
    {
+      if (m_dpi != nullptr) {
+         delete m_dpi;
+      }
       if (m_plugins != nullptr) {
          delete [] m_plugins;
       }
@@ -105,16 +124,74 @@ public:
    virtual void export_expired(time_t ts)
    {
    }
+
+   /**
+    * \brief Called by storage worker before the first packet is put into the cache.
+    * Plugins and DPI workers are already set at this point.
+    */
+   virtual void start()
+   {
+   }
    virtual void finish()
    {
    }
 
+   /**
+    * \brief Request change of number of flow records, can be called from any thread.
+    * Storage plugin applies the request asynchronously without interrupting packet processing.
+    * \param [in] size Requested number of flow records.
+    * \return False when size is invalid or storage plugin cannot be resized.
+    */
+   virtual bool resize(uint32_t size)
+   {
+      return false;
+   }
+
+   /**
+    * \brief Get packet sampling applied by storage plugin.
+    * \param [out] interval One of interval packets (or flows) is selected.
+    * \return Sampling mode, SamplingMode::NONE when all packets are processed.
+    */
+   virtual SamplingMode get_sampling(uint32_t &interval) const
+   {
+      interval = 1;
+      return SamplingMode::NONE;
+   }
+
+   /**
+    * \brief Degrade processing of new flows, used by overload control from storage thread.
+    * \param [in] shed Bitmask of plugins which are not activated on new flows.
+    * \param [in] sampling Process one of sampling packets, 1 processes all packets.
+    */
+   void set_degradation(uint64_t shed, uint32_t sampling)
+   {
+      m_shed = shed;
+      m_degraded = set_overload_sampling(sampling) && sampling > 1 ? FLOW_DEGRADED_SAMPLED : 0;
+   }
+
+   /**
+    * \brief Find added plugin by name, members of a plugin chain resolve to the chain.
+    * \return Index of plugin or -1 when plugin was not added.
+    */
+   int find_plugin(const std::string &name) const
+   {
+      for (uint32_t i = 0; i < m_plugin_cnt; i++) {
+         if (m_plugins[i]->has_name(name)) {
+            return i;
+         }
+      }
+      return -1;
+   }
+
    /**
     * \brief Add plugin to internal list of plugins.
     * Plugins are always called in the same order, as they were added.
     */
    void add_plugin(ProcessPlugin *plugin)
    {
+      if (m_plugin_cnt == MAX_PLUGINS) {
+         throw PluginError("too many process plugins, at most " + std::to_string(MAX_PLUGINS) + " are supported");
+      }
       if (m_plugins == nullptr) {
          m_plugins = new ProcessPlugin*[8];
       } else {
@@ -128,28 +205,65 @@ public:
 
          }
       }
+      add_interest(m_plugin_cnt, plugin->get_interest());
       m_plugins[m_plugin_cnt++] = plugin;
    }
 
+   /**
+    * \brief Run plugins inspecting only packets with payload in separate DPI worker threads.
+    * Must be called after all plugins were added and before first packet is put into the cache.
+    * \param [in] workers Number of worker threads, 0 runs all plugins in storage thread.
+    * \param [in] queue_size Number of packets queued to one worker.
+    * \param [in] buffer_size Size of packet data copied to worker.
+    */
+   void set_dpi_workers(uint32_t workers, uint32_t queue_size, uint32_t buffer_size)
+   {
+      if (workers == 0 || m_payload_plugins == 0 || m_dpi != nullptr) {
+         return;
+      }
+      m_dpi = new DpiWorkers(m_plugins, m_plugin_cnt, m_payload_plugins, workers, queue_size, buffer_size);
+      m_offload = m_payload_plugins;
+   }
+
 protected:
+   /**
+    * \brief Sample packets on behalf of overload control.
+    * \param [in] interval Process one of interval packets, 1 processes all packets.
+    * \return False when storage plugin does not sample on behalf of overload control.
+    */
+   virtual bool set_overload_sampling(uint32_t interval)
+   {
+      return false;
+   }
+
    //Every StoragePlugin implementation should call these functions at appropriate places
 
    /**
     * \brief Call pre_create function for each added plugin.
+    * Drops payload views cached on reused packet structure by plugins of previous packet.
     * \param [in] pkt Input parsed packet.
     * \return Options for flow cache.
     */
    int plugins_pre_create(Packet &pkt)
    {
       int ret = 0;
+      pkt.dns = nullptr;
+      if (m_dpi != nullptr) {
+         m_dpi->poll();
+      }
+      uint64_t skipped = skipped_plugins(pkt);
       for (unsigned int i = 0; i < m_plugin_cnt; i++) {
+         if (skipped & (1ULL << i)) {
+            continue;
+         }
          ret |= m_plugins[i]->pre_create(pkt);
       }
       return ret;
    }
 
    /**
-    * \brief Call post_create function for each added plugin.
+    * \brief Call post_create function for each plugin interested in flow.
+    * Plugin stays active in flow until it returns FLOW_PLUGIN_DETACH.
     * \param [in,out] rec Stored flow record.
     * \param [in] pkt Input parsed packet.
     * \return Options for flow cache.
@@ -157,14 +271,20 @@ protected:
    int plugins_post_create(Flow &rec, const Packet &pkt)
    {
       int ret = 0;
-      for (unsigned int i = 0; i < m_plugin_cnt; i++) {
-         ret |= m_plugins[i]->post_create(rec, pkt);
+      uint64_t interested = interested_plugins(pkt);
+      rec.plugins_active = interested & ~m_shed;
+      rec.plugins_created = rec.plugins_active;
+      rec.degraded = m_degraded | ((interested & m_shed) ? FLOW_DEGRADED_DPI : 0);
+      for (uint64_t active = rec.plugins_active & ~skipped_plugins(pkt); active; active &= active - 1) {
+         unsigned int i = __builtin_ctzll(active);
+         ret |= detach_plugin(rec, i, m_plugins[i]->post_create(rec, pkt));
       }
+      plugins_offload(rec, pkt);
       return ret;
    }
 
    /**
-    * \brief Call pre_update function for each added plugin.
+    * \brief Call pre_update function for each plugin active in flow.
     * \param [in,out] rec Stored flow record.
     * \param [in] pkt Input parsed packet.
     * \return Options for flow cache.
@@ -172,35 +292,192 @@ protected:
    int plugins_pre_update(Flow &rec, Packet &pkt)
    {
       int ret = 0;
-      for (unsigned int i = 0; i < m_plugin_cnt; i++) {
-         ret |= m_plugins[i]->pre_update(rec, pkt);
+      if (m_dpi != nullptr) {
+         // Flush requested by offloaded plugin starts a new flow with current packet
+         ret = m_dpi->take_flush(rec);
+         if (ret) {
+            return ret;
+         }
+      }
+      for (uint64_t active = rec.plugins_active & ~skipped_plugins(pkt); active; active &= active - 1) {
+         unsigned int i = __builtin_ctzll(active);
+         ret |= detach_plugin(rec, i, m_plugins[i]->pre_update(rec, pkt));
       }
       return ret;
    }
 
    /**
-    * \brief Call post_update function for each added plugin.
+    * \brief Call post_update function for each plugin active in flow.
     * \param [in,out] rec Stored flow record.
     * \param [in] pkt Input parsed packet.
     */
    int plugins_post_update(Flow &rec, const Packet &pkt)
    {
       int ret = 0;
-      for (unsigned int i = 0; i < m_plugin_cnt; i++) {
-         ret |= m_plugins[i]->post_update(rec, pkt);
+      if (m_degraded) {
+         rec.degraded |= m_degraded;
       }
+      for (uint64_t active = rec.plugins_active & ~skipped_plugins(pkt); active; active &= active - 1) {
+         unsigned int i = __builtin_ctzll(active);
+         ret |= detach_plugin(rec, i, m_plugins[i]->post_update(rec, pkt));
+      }
+      plugins_offload(rec, pkt);
       return ret;
    }
 
    /**
-    * \brief Call pre_export function for each added plugin.
+    * \brief Call pre_export function for each plugin which got post_create on flow.
+    * Plugins detached from flow are called too, plugins skipped on creation never created their extension.
     * \param [in,out] rec Stored flow record.
     */
    void plugins_pre_export(Flow &rec)
    {
-      for (unsigned int i = 0; i < m_plugin_cnt; i++) {
-         m_plugins[i]->pre_export(rec);
+      for (uint64_t created = rec.plugins_created & ~m_offload; created; created &= created - 1) {
+         m_plugins[__builtin_ctzll(created)]->pre_export(rec);
+      }
+      if (m_dpi != nullptr) {
+         m_dpi->pre_export(rec);
+      }
+   }
+
+   /**
+    * \brief Get number of added plugins.
+    */
+   uint32_t get_plugin_cnt() const
+   {
+      return m_plugin_cnt;
+   }
+
+   /**
+    * \brief Get plugin by index in order of adding.
+    */
+   ProcessPlugin *get_plugin(uint32_t idx) const
+   {
+      return m_plugins[idx];
+   }
+
+   /**
+    * \brief Check whether plugin runs in DPI workers.
+    */
+   bool plugin_offloaded(uint32_t idx) const
+   {
+      return m_offload & (1ULL << idx);
+   }
+
+   /**
+    * \brief Move extensions created by DPI workers to flow record.
+    * Must be called before every export of a flow record, waits until workers processed the flow.
+    * \param [in,out] rec Stored flow record.
+    */
+   void plugins_merge(Flow &rec)
+   {
+      if (m_dpi != nullptr) {
+         m_dpi->merge(rec);
+      }
+   }
+
+private:
+   /**
+    * \brief Get plugins not called by storage thread for packet.
+    * Offloaded plugins run in DPI workers, plugins inspecting payload skip packets whose input provided no payload.
+    * \param [in] pkt Input parsed packet.
+    * \return Bitmask of plugins.
+    */
+   uint64_t skipped_plugins(const Packet &pkt) const
+   {
+      return (pkt.meta & PKT_META_PAYLOAD) ? m_offload : m_offload | m_payload_plugins;
+   }
+
+   /**
+    * \brief Submit packet with payload to DPI workers when an offloaded plugin is active in flow.
+    * \param [in,out] rec Stored flow record.
+    * \param [in] pkt Input parsed packet.
+    */
+   void plugins_offload(Flow &rec, const Packet &pkt)
+   {
+      if ((rec.plugins_active & m_offload) && pkt.payload_len) {
+         m_dpi->submit(rec, pkt);
+      }
+   }
+
+   /**
+    * \brief Add plugin interest to dispatch tables.
+    * \param [in] idx Index of plugin.
+    * \param [in] interest Interest of plugin.
+    */
+   void add_interest(unsigned int idx, const PluginInterest &interest)
+   {
+      uint64_t bit = 1ULL << idx;
+      if (interest.payload_only) {
+         m_payload_plugins |= bit;
+      }
+      for (unsigned int proto = 0; proto < 256; proto++) {
+         bool match = interest.protocols.empty();
+         for (auto it : interest.protocols) {
+            match |= it == proto;
+         }
+         if (!match) {
+            continue;
+         }
+         m_proto_plugins[proto] |= bit;
+         if (interest.ports.empty()) {
+            m_proto_any_port[proto] |= bit;
+         }
+      }
+      for (auto port : interest.ports) {
+         auto &bucket = m_port_plugins[port % PORT_BUCKETS];
+         auto it = bucket.begin();
+         while (it != bucket.end() && it->first != port) {
+            it++;
+         }
+         if (it == bucket.end()) {
+            bucket.push_back(std::make_pair(port, bit));
+         } else {
+            it->second |= bit;
+         }
+      }
+   }
+
+   /**
+    * \brief Get plugins interested in port.
+    * \param [in] port Port of flow endpoint.
+    * \return Bitmask of plugins.
+    */
+   uint64_t port_plugins(uint16_t port) const
+   {
+      uint64_t mask = 0;
+      for (const auto &it : m_port_plugins[port % PORT_BUCKETS]) {
+         if (it.first == port) {
+            mask |= it.second;
+         }
+      }
+      return mask;
+   }
+
+   /**
+    * \brief Get plugins interested in flow of a packet.
+    * \param [in] pkt Input parsed packet.
+    * \return Bitmask of plugins.
+    */
+   uint64_t interested_plugins(const Packet &pkt) const
+   {
+      return m_proto_any_port[pkt.ip_proto] |
+         ((port_plugins(pkt.src_port) | port_plugins(pkt.dst_port)) & m_proto_plugins[pkt.ip_proto]);
+   }
+
+   /**
+    * \brief Remove plugin from active plugins of flow when requested.
+    * \param [in,out] rec Stored flow record.
+    * \param [in] idx Index of plugin.
+    * \param [in] ret Options returned by plugin.
+    * \return Options for flow cache.
+    */
+   int detach_plugin(Flow &rec, unsigned int idx, int ret)
+   {
+      if (ret & FLOW_PLUGIN_DETACH) {
+         rec.plugins_active &= ~(1ULL << idx);
       }
+      return ret & ~FLOW_PLUGIN_DETACH;
    }
 };
 
@@ -0,0 +1,343 @@
+/**
+ * \file benchmark-payloads.cpp
+ * \brief Payload templates for benchmark traffic generator
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <cstring>
+#include <string>
+#include <netinet/in.h>
+
+#include "benchmark-payloads.hpp"
+
+namespace ipxp {
+
+/**
+ * \brief QUIC draft-29 client Initial packet (www.google.com).
+ */
+static const uint8_t quic_initial[] = {
+   0xc0, 0xff, 0x00, 0x00, 0x1d, 0x08, 0xd3, 0xe8, 0xe0, 0x60, 0x49, 0xa4, 0xf6, 0xb2, 0x00, 0x37,
+   0x00, 0xa0, 0x1b, 0xda, 0x98, 0x62, 0x45, 0x77, 0x5a, 0x00, 0x58, 0xb2, 0xf4, 0x98, 0xf2, 0x28,
+   0xca, 0xc5, 0xa5, 0x12, 0x02, 0x11, 0xa3, 0x75, 0x18, 0x05, 0xf7, 0x6e, 0xaf, 0xd9, 0x39, 0x95,
+   0x62, 0x60, 0x9c, 0x43, 0xf4, 0xc8, 0xe5, 0xce, 0xbf, 0x75, 0x98, 0x0e, 0xba, 0x52, 0x8c, 0x3c,
+   0x1e, 0xd5, 0xf5, 0x69, 0x1e, 0xd3, 0x89, 0x44, 0xe9, 0x6c, 0x66, 0x71, 0xa8, 0xcd, 0x4d, 0x47,
+   0xbc, 0x25, 0x03, 0x05, 0x3c, 0x73, 0x52, 0x68, 0x15, 0x98, 0x78, 0x49, 0x45, 0x18, 0xaf, 0xf9,
+   0xda, 0x7b, 0xcf, 0x18, 0x29, 0x82, 0x6e, 0x7c, 0x34, 0x4a, 0xd4, 0xd9, 0xc9, 0x10, 0xd3, 0x4a,
+   0xb8, 0x9e, 0x2e, 0x2f, 0xd3, 0x08, 0x84, 0xb4, 0xd6, 0x2a, 0xf5, 0xb7, 0x83, 0x47, 0x0e, 0x3a,
+   0x0a, 0xd3, 0x69, 0x59, 0xe1, 0xad, 0xe4, 0x30, 0x75, 0x5d, 0x9b, 0x7f, 0xfb, 0xb9, 0x99, 0xb6,
+   0x0f, 0x51, 0xe2, 0x20, 0xf2, 0x5f, 0x09, 0x72, 0xcb, 0x7c, 0x07, 0xea, 0xe6, 0x5a, 0xc8, 0xae,
+   0xac, 0x36, 0x85, 0xca, 0x69, 0xde, 0xe5, 0x43, 0x54, 0x78, 0x4e, 0xc2, 0x9e, 0x43, 0x07, 0xa6,
+   0xf1, 0xbe, 0x96, 0xf2, 0xc3, 0xe4, 0xe2, 0xe2, 0x58, 0x82, 0x6e, 0x98, 0x34, 0x39, 0xb8, 0xc6,
+   0x0f, 0x15, 0xa6, 0xa9, 0xc5, 0x8d, 0xc6, 0xb4, 0x35, 0x66, 0x72, 0xff, 0xd0, 0x25, 0xb1, 0x13,
+   0x04, 0x1f, 0x6a, 0x7d, 0x80, 0xbb, 0x72, 0x88, 0x5b, 0xa9, 0xc4, 0x8e, 0xa4, 0x6c, 0x5d, 0x66,
+   0xca, 0x71, 0x85, 0x01, 0x12, 0xba, 0x22, 0xa0, 0xdf, 0xc6, 0x17, 0x72, 0x41, 0x0c, 0xb0, 0xf0,
+   0x92, 0x76, 0xe3, 0x28, 0x50, 0x74, 0x3f, 0xb2, 0xd2, 0xf2, 0x42, 0x56, 0x4b, 0xaf, 0x84, 0x63,
+   0x54, 0xfe, 0xb5, 0xe0, 0xa2, 0xb6, 0x03, 0xf9, 0x4f, 0x06, 0xbe, 0xfc, 0x19, 0x2a, 0x49, 0x83,
+   0xf4, 0xe0, 0x43, 0x23, 0x00, 0x12, 0xee, 0x41, 0x02, 0x8c, 0x8c, 0xad, 0x19, 0xdd, 0x77, 0x0a,
+   0x7b, 0x20, 0x55, 0x4b, 0x5c, 0x19, 0x60, 0x28, 0x72, 0x89, 0x97, 0xc4, 0x95, 0x6b, 0xb9, 0x21,
+   0x96, 0x71, 0x24, 0xc6, 0x25, 0x34, 0x92, 0xb1, 0x94, 0x59, 0x2f, 0xd6, 0xe6, 0x13, 0x43, 0xd7,
+   0xa6, 0x79, 0x25, 0x16, 0x0c, 0x22, 0x76, 0xb2, 0x6f, 0xb4, 0x6e, 0xe2, 0x78, 0x34, 0xe6, 0xba,
+   0x0c, 0xf6, 0x4c, 0x4c, 0x03, 0xe7, 0x2d, 0xe7, 0xa6, 0x8c, 0x42, 0x07, 0xe4, 0x2d, 0x07, 0x28,
+   0x28, 0x86, 0xd6, 0x57, 0x9e, 0x2e, 0xda, 0x97, 0x95, 0x87, 0x79, 0x71, 0xec, 0x3c, 0xd1, 0x03,
+   0x08, 0xab, 0xd7, 0x35, 0x7c, 0x91, 0xe2, 0x40, 0x08, 0x6d, 0x16, 0x55, 0x86, 0x37, 0xd4, 0x85,
+   0x50, 0x61, 0x7f, 0x19, 0x45, 0x31, 0xd5, 0xca, 0x88, 0x48, 0xe9, 0x47, 0x66, 0x4f, 0x7d, 0xbf,
+   0x97, 0x5d, 0x40, 0xb2, 0xd9, 0x5b, 0xfe, 0xb0, 0xc9, 0xb2, 0xad, 0xbe, 0x63, 0x7a, 0xbf, 0x7c,
+   0x77, 0x07, 0x83, 0x5c, 0xa6, 0x30, 0xd4, 0xea, 0x5d, 0xaa, 0xb6, 0x20, 0x9f, 0x9a, 0xb4, 0x6d,
+   0x90, 0xc2, 0xea, 0x9a, 0x16, 0x3e, 0x25, 0x79, 0xb0, 0xa4, 0x1a, 0x4a, 0xf5, 0x1d, 0x3f, 0xdb,
+   0x07, 0x25, 0xd0, 0xd8, 0x95, 0x8c, 0xd3, 0x4e, 0x1e, 0xe4, 0x25, 0x0e, 0x82, 0x2c, 0xee, 0x21,
+   0xbc, 0xb2, 0xc2, 0x9f, 0x0b, 0x81, 0xe8, 0x88, 0xad, 0x1e, 0x46, 0x87, 0x9f, 0x79, 0xc1, 0xbc,
+   0x6e, 0xb4, 0x52, 0xf3, 0xca, 0x3f, 0x2f, 0xa3, 0x6e, 0x0f, 0xb8, 0x11, 0x96, 0xa4, 0xe7, 0x8a,
+   0x26, 0x38, 0xd4, 0x88, 0xff, 0xc5, 0x45, 0x85, 0x8e, 0x46, 0xc1, 0x07, 0xf7, 0x68, 0xa8, 0x18,
+   0x4e, 0x54, 0xe5, 0x2f, 0xfa, 0xc5, 0x06, 0x4a, 0x56, 0xc2, 0xef, 0x72, 0xff, 0x3d, 0xe3, 0x2c,
+   0xe2, 0xfa, 0xc1, 0xf2, 0x3b, 0xf1, 0x5c, 0x5f, 0x14, 0x64, 0xb6, 0x9f, 0x45, 0x62, 0x46, 0x8b,
+   0xf7, 0x68, 0xce, 0xf9, 0x01, 0xc1, 0x9d, 0x55, 0x7b, 0x29, 0x20, 0x10, 0xc7, 0x65, 0xda, 0x4d,
+   0x21, 0xbd, 0x5c, 0x46, 0x9c, 0xe0, 0x37, 0xc8, 0x2b, 0x8b, 0xfd, 0x48, 0xe3, 0xfe, 0x94, 0xa6,
+   0x82, 0x6e, 0x51, 0x22, 0x43, 0xfa, 0x88, 0x8a, 0xb2, 0x04, 0xa7, 0xe5, 0xe4, 0xc3, 0x05, 0xd2,
+   0x80, 0xc2, 0x53, 0x02, 0xc4, 0x70, 0x82, 0x67, 0xa0, 0xd8, 0xe1, 0x5e, 0x04, 0x3d, 0x13, 0xf6,
+   0xdc, 0x3f, 0x18, 0x1f, 0xdc, 0x8d, 0x39, 0x12, 0xdb, 0x8e, 0xf4, 0xec, 0xb5, 0x24, 0x78, 0x1e,
+   0x3a, 0x6b, 0x2a, 0xb1, 0xfb, 0x76, 0x62, 0x14, 0x5a, 0xcf, 0xf5, 0x1e, 0x2a, 0x18, 0xb9, 0xdd,
+   0x9e, 0xf4, 0xaf, 0xdd, 0xb3, 0x1f, 0x10, 0x29, 0x81, 0x2a, 0x0c, 0x1f, 0x7e, 0xf8, 0x5e, 0x8e,
+   0xb9, 0x09, 0x27, 0x85, 0xd6, 0x78, 0xf3, 0x74, 0xd8, 0xdf, 0x22, 0x58, 0x11, 0xab, 0x22, 0x1f,
+   0x02, 0x35, 0x70, 0x95, 0x5e, 0xf5, 0xa6, 0x5b, 0x54, 0x7a, 0x6f, 0x8d, 0x49, 0x21, 0xc6, 0xfb,
+   0x32, 0xb1, 0x12, 0x05, 0xb1, 0xb7, 0xdb, 0x39, 0xf0, 0x2d, 0x47, 0x83, 0x92, 0x2e, 0xd6, 0xb1,
+   0x0a, 0xae, 0x33, 0x33, 0xdc, 0x3c, 0x5f, 0x39, 0x35, 0xa7, 0xf5, 0xed, 0x09, 0x3d, 0x2a, 0x51,
+   0xae, 0x3f, 0xf1, 0x03, 0x16, 0xe8, 0xf9, 0xde, 0xa9, 0x4e, 0xa9, 0x21, 0xff, 0x4b, 0xe0, 0xf2,
+   0x83, 0x4e, 0xe5, 0xd5, 0xde, 0x0f, 0x83, 0x4c, 0x60, 0xa4, 0x45, 0x8f, 0xf9, 0x6f, 0xb6, 0x6f,
+   0x52, 0xc3, 0x2f, 0x8c, 0x9c, 0xbb, 0x23, 0x00, 0x24, 0xe7, 0x53, 0xd0, 0xcf, 0x6c, 0x26, 0x6f,
+   0x08, 0x82, 0xa4, 0xeb, 0x47, 0x0d, 0x1d, 0xca, 0x01, 0x1e, 0x54, 0x7c, 0x63, 0xd4, 0xa9, 0x66,
+   0xa7, 0x64, 0xaf, 0xfe, 0x85, 0x77, 0x2d, 0xf9, 0x0d, 0xc4, 0x0d, 0x6e, 0x69, 0xf8, 0x92, 0x56,
+   0x76, 0x09, 0xb5, 0x38, 0x34, 0x1a, 0x5e, 0xa0, 0xce, 0xb7, 0x1c, 0xb2, 0x83, 0x7c, 0x10, 0xe7,
+   0xb2, 0x21, 0x3f, 0xb4, 0x7c, 0xf3, 0xc7, 0xb5, 0xc0, 0x1a, 0xcd, 0x56, 0xa2, 0x9e, 0x54, 0x28,
+   0xf5, 0x98, 0x73, 0xbf, 0x4d, 0x5e, 0x81, 0xc9, 0xf5, 0x97, 0x80, 0x2d, 0x73, 0x40, 0x0f, 0x64,
+   0xbf, 0x63, 0x10, 0xe2, 0xb7, 0x6d, 0xd9, 0x72, 0xcd, 0x9e, 0x6e, 0x20, 0x5f, 0xea, 0x47, 0xcf,
+   0xef, 0x09, 0xda, 0xde, 0xaf, 0x50, 0xe8, 0x27, 0xd4, 0xad, 0x17, 0xda, 0x58, 0x66, 0x51, 0x0c,
+   0x98, 0x21, 0x6b, 0xdf, 0xe0, 0xe6, 0x43, 0x21, 0x7d, 0x8f, 0x7e, 0x1d, 0x8c, 0xf9, 0xe1, 0x73,
+   0x46, 0x12, 0x00, 0xec, 0xf1, 0xb3, 0xd5, 0xd1, 0x60, 0x57, 0x69, 0xce, 0x1d, 0x1f, 0xdb, 0x8f,
+   0x73, 0x28, 0xa1, 0x3e, 0xc9, 0x4b, 0x7c, 0x00, 0x3a, 0xc9, 0x04, 0x1c, 0x64, 0x06, 0x57, 0xa0,
+   0x85, 0x84, 0xac, 0x78, 0x0c, 0xad, 0x8a, 0x00, 0xa0, 0x9e, 0x1b, 0x0e, 0x4f, 0x17, 0x3b, 0x0c,
+   0x23, 0x76, 0xd3, 0xfb, 0xa8, 0x29, 0xb2, 0x65, 0x2e, 0x46, 0x37, 0x80, 0x85, 0x37, 0x8a, 0x29,
+   0xdd, 0xc1, 0x5c, 0xd4, 0xee, 0x9c, 0x91, 0x98, 0x85, 0x59, 0x97, 0x8c, 0xbd, 0x22, 0xf4, 0xde,
+   0x03, 0x9a, 0x88, 0x3b, 0x8e, 0xe7, 0x8b, 0x50, 0x0a, 0x00, 0x10, 0x3a, 0x96, 0xd4, 0xbc, 0xf0,
+   0x6d, 0x51, 0xd2, 0x7c, 0xfb, 0xcc, 0xa5, 0x3b, 0x8b, 0x4e, 0x53, 0x71, 0x39, 0x9a, 0x6e, 0xc1,
+   0xb4, 0xb9, 0xfa, 0x08, 0x2f, 0x1c, 0xea, 0x97, 0x57, 0x21, 0x03, 0x4c, 0x32, 0x90, 0x4f, 0xaf,
+   0xf9, 0x2e, 0xd9, 0x62, 0x3c, 0xf4, 0xd2, 0x7f, 0x32, 0xe4, 0x69, 0x03, 0x19, 0x3f, 0xf8, 0x5c,
+   0x46, 0x9b, 0xac, 0x8f, 0x8c, 0x04, 0x3d, 0xab, 0x4a, 0xf9, 0xcf, 0xb6, 0xae, 0x25, 0x99, 0xb3,
+   0x3e, 0xe1, 0xbf, 0x1f, 0xec, 0xf0, 0xb2, 0xd0, 0x23, 0xe7, 0xae, 0x19, 0x57, 0x8f, 0x86, 0x0b,
+   0xb2, 0x59, 0xfb, 0x0c, 0x81, 0xa1, 0x1c, 0xd8, 0xae, 0xe5, 0x9b, 0x1f, 0x78, 0xaa, 0x72, 0x81,
+   0xc7, 0x93, 0x11, 0x5c, 0x94, 0xd9, 0x16, 0x66, 0xe3, 0xca, 0x5f, 0x30, 0xa9, 0x14, 0x6a, 0xfe,
+   0x42, 0x05, 0x72, 0xe3, 0x5c, 0x25, 0xed, 0x5a, 0x38, 0xd7, 0xec, 0xea, 0x09, 0x3a, 0x15, 0x36,
+   0x89, 0x79, 0xb4, 0xea, 0xbb, 0x72, 0xb7, 0xf2, 0xd3, 0x1e, 0x14, 0x66, 0x6e, 0xab, 0xb6, 0xa5,
+   0xcd, 0xe6, 0xea, 0xd7, 0xf9, 0x96, 0x90, 0xd6, 0xcf, 0xad, 0xbf, 0x33, 0xa3, 0x00, 0xf8, 0xbb,
+   0x54, 0xdd, 0x39, 0x48, 0x5e, 0xc1, 0x2e, 0xc9, 0x4d, 0x59, 0xf2, 0xcb, 0x89, 0x22, 0x7d, 0xc3,
+   0x47, 0xfa, 0x7d, 0x4f, 0x8b, 0x73, 0x48, 0x79, 0x86, 0x91, 0xf5, 0xd1, 0x29, 0xae, 0x63, 0x4f,
+   0x26, 0xdf, 0xb7, 0xe3, 0xf9, 0x4c, 0x3a, 0x66, 0x80, 0x07, 0xed, 0x8c, 0xca, 0xa4, 0x17, 0xf2,
+   0xbf, 0x7d, 0xe0, 0xc6, 0xce, 0x30, 0x90, 0x55, 0x4c, 0x0c, 0x56, 0x79, 0x94, 0xde, 0x17, 0x7e,
+   0x45, 0xaa, 0x90, 0x11, 0xdc, 0xff, 0xce, 0xbc, 0x9d, 0xaf, 0xe0, 0x0f, 0x50, 0x34, 0x57, 0x64,
+   0x5d, 0x73, 0x6c, 0xb0, 0x32, 0xd5, 0xda, 0x58, 0x1b, 0xcc, 0xa8, 0x8a, 0x52, 0x05, 0xea, 0x59,
+   0x91, 0x81, 0xc3, 0xfa, 0x4d, 0xd0, 0xfb, 0x3f, 0xf2, 0x43, 0x0c, 0xec, 0x8c, 0x36, 0xad, 0xc3,
+   0xe8, 0x16, 0x2b, 0xce, 0x0b, 0xa8, 0xab, 0xdd, 0x10, 0xef, 0xef, 0x65, 0x61, 0x3c, 0x5d, 0x5f,
+   0x98, 0xe7, 0xee, 0xa6, 0xd9, 0xac, 0x07, 0x8e, 0xfb, 0x03, 0x25, 0x18, 0xc6, 0x9f, 0xe8, 0x53,
+   0x16, 0x3b, 0x9b, 0x40, 0xbc, 0x1f, 0x33, 0xc9, 0xd9, 0x04, 0xc5, 0x18, 0x5e, 0xc2, 0x77, 0xd1,
+   0xfd, 0x2c, 0xd1, 0x07, 0x27, 0xb8, 0xf9, 0x40, 0xf9, 0x42, 0xfd, 0x00, 0x66, 0x8b, 0x0f, 0xa7,
+   0x48, 0xef,
+};
+
+static void put_u8(std::vector<uint8_t> &buf, uint8_t val)
+{
+   buf.push_back(val);
+}
+
+static void put_u16(std::vector<uint8_t> &buf, uint16_t val)
+{
+   buf.push_back(val >> 8);
+   buf.push_back(val & 0xFF);
+}
+
+static void put_str(std::vector<uint8_t> &buf, const std::string &str)
+{
+   buf.insert(buf.end(), str.begin(), str.end());
+}
+
+static void set_u16(std::vector<uint8_t> &buf, size_t offset, uint16_t val)
+{
+   buf[offset] = val >> 8;
+   buf[offset + 1] = val & 0xFF;
+}
+
+static void put_dns_name(std::vector<uint8_t> &buf, const std::string &name)
+{
+   size_t begin = 0;
+   size_t end;
+   while ((end = name.find('.', begin)) != std::string::npos) {
+      put_u8(buf, end - begin);
+      put_str(buf, name.substr(begin, end - begin));
+      begin = end + 1;
+   }
+   put_u8(buf, name.size() - begin);
+   put_str(buf, name.substr(begin));
+   put_u8(buf, 0);
+}
+
+static BenchmarkPayload payload_http()
+{
+   BenchmarkPayload p;
+   p.ip_proto = IPPROTO_TCP;
+   p.port = 80;
+   put_str(p.request,
+      "GET /index.html HTTP/1.1\r\n"
+      "Host: www.example.com\r\n"
+      "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:102.0) Gecko/20100101 Firefox/102.0\r\n"
+      "Accept: text/html,application/xhtml+xml\r\n"
+      "Referer: http://www.example.com/\r\n"
+      "Connection: keep-alive\r\n"
+      "\r\n");
+   put_str(p.response,
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Type: text/html; charset=UTF-8\r\n"
+      "Content-Length: 1256\r\n"
+      "Server: ECS (dcb/7EA3)\r\n"
+      "\r\n");
+   return p;
+}
+
+static BenchmarkPayload payload_dns()
+{
+   BenchmarkPayload p;
+   p.ip_proto = IPPROTO_UDP;
+   p.port = 53;
+   const uint8_t query_hdr[] = {0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+   const uint8_t resp_hdr[] = {0x12, 0x34, 0x81, 0x80, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00};
+
+   p.request.assign(query_hdr, query_hdr + sizeof(query_hdr));
+   put_dns_name(p.request, "www.example.com");
+   put_u16(p.request, 1); // A
+   put_u16(p.request, 1); // IN
+
+   p.response.assign(resp_hdr, resp_hdr + sizeof(resp_hdr));
+   put_dns_name(p.response, "www.example.com");
+   put_u16(p.response, 1);
+   put_u16(p.response, 1);
+   put_u16(p.response, 0xC00C); // Name pointer to question
+   put_u16(p.response, 1);
+   put_u16(p.response, 1);
+   put_u16(p.response, 0);
+   put_u16(p.response, 300); // TTL
+   put_u16(p.response, 4);
+   put_u8(p.response, 93);
+   put_u8(p.response, 184);
+   put_u8(p.response, 216);
+   put_u8(p.response, 34);
+   return p;
+}
+
+static BenchmarkPayload payload_tls()
+{
+   BenchmarkPayload p;
+   p.ip_proto = IPPROTO_TCP;
+   p.port = 443;
+   std::vector<uint8_t> &buf = p.request;
+   const uint16_t ciphers[] = {0x1301, 0x1302, 0x1303, 0xC02B, 0xC02F, 0xC02C, 0xC030, 0xCCA9, 0xCCA8};
+   const std::string sni = "www.example.com";
+   size_t rec_len;
+   size_t hs_len;
+   size_t ext_len;
+   size_t tmp;
+
+   put_u8(buf, 0x16); // Handshake record
+   put_u16(buf, 0x0301);
+   rec_len = buf.size();
+   put_u16(buf, 0);
+
+   put_u8(buf, 0x01); // ClientHello
+   put_u8(buf, 0);
+   hs_len = buf.size();
+   put_u16(buf, 0);
+   put_u16(buf, 0x0303);
+   for (int i = 0; i < 32; i++) {
+      put_u8(buf, i * 7 + 1); // Random
+   }
+   put_u8(buf, 32);
+   for (int i = 0; i < 32; i++) {
+      put_u8(buf, 0xA0 + i); // Session ID
+   }
+   put_u16(buf, sizeof(ciphers));
+   for (size_t i = 0; i < sizeof(ciphers) / sizeof(ciphers[0]); i++) {
+      put_u16(buf, ciphers[i]);
+   }
+   put_u8(buf, 1); // Compression methods
+   put_u8(buf, 0);
+
+   ext_len = buf.size();
+   put_u16(buf, 0);
+
+   put_u16(buf, 0); // server_name
+   put_u16(buf, sni.size() + 5);
+   put_u16(buf, sni.size() + 3);
+   put_u8(buf, 0);
+   put_u16(buf, sni.size());
+   put_str(buf, sni);
+
+   put_u16(buf, 11); // ec_point_formats
+   put_u16(buf, 2);
+   put_u8(buf, 1);
+   put_u8(buf, 0);
+
+   put_u16(buf, 10); // supported_groups
+   put_u16(buf, 8);
+   put_u16(buf, 6);
+   put_u16(buf, 29);
+   put_u16(buf, 23);
+   put_u16(buf, 24);
+
+   put_u16(buf, 16); // application_layer_protocol_negotiation
+   tmp = buf.size();
+   put_u16(buf, 0);
+   put_u16(buf, 0);
+   put_u8(buf, 2);
+   put_str(buf, "h2");
+   put_u8(buf, 8);
+   put_str(buf, "http/1.1");
+   set_u16(buf, tmp, buf.size() - tmp - 2);
+   set_u16(buf, tmp + 2, buf.size() - tmp - 4);
+
+   put_u16(buf, 13); // signature_algorithms
+   put_u16(buf, 8);
+   put_u16(buf, 6);
+   put_u16(buf, 0x0403);
+   put_u16(buf, 0x0804);
+   put_u16(buf, 0x0401);
+
+   put_u16(buf, 43); // supported_versions
+   put_u16(buf, 5);
+   put_u8(buf, 4);
+   put_u16(buf, 0x0304);
+   put_u16(buf, 0x0303);
+
+   set_u16(buf, ext_len, buf.size() - ext_len - 2);
+   set_u16(buf, hs_len, buf.size() - hs_len - 2);
+   set_u16(buf, rec_len, buf.size() - rec_len - 2);
+   return p;
+}
+
+static BenchmarkPayload payload_quic()
+{
+   BenchmarkPayload p;
+   p.ip_proto = IPPROTO_UDP;
+   p.port = 443;
+   p.request.assign(quic_initial, quic_initial + sizeof(quic_initial));
+   return p;
+}
+
+BenchmarkPayload benchmark_payload(BenchmarkApp app)
+{
+   switch (app) {
+   case BenchmarkApp::HTTP:
+      return payload_http();
+   case BenchmarkApp::TLS:
+      return payload_tls();
+   case BenchmarkApp::DNS:
+      return payload_dns();
+   case BenchmarkApp::QUIC:
+      return payload_quic();
+   }
+   return BenchmarkPayload();
+}
+
+}
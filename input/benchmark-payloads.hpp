@@ -0,0 +1,80 @@
+/**
+ * \file benchmark-payloads.hpp
+ * \brief Payload templates for benchmark traffic generator
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef IPXP_INPUT_BENCHMARK_PAYLOADS_HPP
+#define IPXP_INPUT_BENCHMARK_PAYLOADS_HPP
+
+#include <vector>
+#include <cstdint>
+
+namespace ipxp {
+
+/**
+ * \brief Application protocols synthesized by benchmark plugin.
+ */
+enum class BenchmarkApp {
+   HTTP,
+   TLS,
+   DNS,
+   QUIC
+};
+
+/**
+ * \brief Payload template pair of one application exchange.
+ */
+struct BenchmarkPayload {
+   std::vector<uint8_t> request;  /**< Payload of first client packet. */
+   std::vector<uint8_t> response; /**< Payload of first server packet, may be empty. */
+   uint8_t ip_proto;              /**< Transport protocol of the exchange. */
+   uint16_t port;                 /**< Server port of the exchange. */
+};
+
+/**
+ * \brief Build payload templates for given application protocol.
+ * \param [in] app Application protocol.
+ * \return Payload templates which are valid for the corresponding process plugin.
+ */
+BenchmarkPayload benchmark_payload(BenchmarkApp app);
+
+}
+#endif /* IPXP_INPUT_BENCHMARK_PAYLOADS_HPP */
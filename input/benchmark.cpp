@@ -44,6 +44,9 @@
 #include <random>
 #include <chrono>
 #include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <sstream>
 #include <sys/time.h>
 
 #include "benchmark.hpp"
@@ -61,7 +64,8 @@ __attribute__((constructor)) static void register_this_plugin()
 
 Benchmark::Benchmark()
    : m_generatePacketFunc(nullptr), m_flowMode(BenchmarkMode::FLOW_1), m_maxDuration(BENCHMARK_DEFAULT_DURATION), m_maxPktCnt(BENCHMARK_DEFAULT_PKT_CNT),
-     m_packetSizeFrom(BENCHMARK_DEFAULT_SIZE_FROM), m_packetSizeTo(BENCHMARK_DEFAULT_SIZE_TO), m_firstTs({0}), m_currentTs({0}), m_pktCnt(0)
+     m_packetSizeFrom(BENCHMARK_DEFAULT_SIZE_FROM), m_packetSizeTo(BENCHMARK_DEFAULT_SIZE_TO), m_firstTs({0}), m_currentTs({0}), m_pktCnt(0),
+     m_alpha(BENCHMARK_DEFAULT_ALPHA), m_maxFlowSize(BENCHMARK_DEFAULT_MAX_FLOW)
 {
 }
 
@@ -86,6 +90,12 @@ void Benchmark::init(const char *params)
    } else if (parser.m_mode == "nf") {
       m_flowMode = BenchmarkMode::FLOW_N;
       m_generatePacketFunc = &Benchmark::generatePacketFlowN;
+   } else if (parser.m_mode == "zipf") {
+      m_flowMode = BenchmarkMode::ZIPF;
+      m_generatePacketFunc = &Benchmark::generatePacketActive;
+   } else if (parser.m_mode == "pareto") {
+      m_flowMode = BenchmarkMode::PARETO;
+      m_generatePacketFunc = &Benchmark::generatePacketActive;
    } else {
       throw PluginError("invalid benchmark mode specified");
    }
@@ -106,10 +116,60 @@ void Benchmark::init(const char *params)
       m_rndGen = std::mt19937(seed);
    }
    gettimeofday(&m_firstTs, nullptr);
+
+   if (m_flowMode == BenchmarkMode::ZIPF || m_flowMode == BenchmarkMode::PARETO) {
+      m_alpha = parser.m_alpha;
+      m_maxFlowSize = parser.m_max_flow;
+      parse_apps(parser.m_apps);
+      m_zeroBuf.assign(65536, 0);
+
+      if (m_flowMode == BenchmarkMode::ZIPF) {
+         double sum = 0;
+         m_zipfCdf.resize(m_maxFlowSize);
+         for (uint32_t i = 0; i < m_maxFlowSize; i++) {
+            sum += 1.0 / std::pow(i + 1, m_alpha);
+            m_zipfCdf[i] = sum;
+         }
+         for (auto &it : m_zipfCdf) {
+            it /= sum;
+         }
+      }
+
+      m_flows.resize(parser.m_flows);
+      for (auto &it : m_flows) {
+         newFlow(it);
+      }
+   }
 }
 
 void Benchmark::close()
 {
+   m_zipfCdf.clear();
+   m_flows.clear();
+   m_apps.clear();
+   m_zeroBuf.clear();
+}
+
+void Benchmark::parse_apps(const std::string &apps)
+{
+   std::istringstream ss(apps);
+   std::string app;
+
+   m_apps.clear();
+   while (std::getline(ss, app, ',')) {
+      trim_str(app);
+      if (app == "http") {
+         m_apps.push_back(benchmark_payload(BenchmarkApp::HTTP));
+      } else if (app == "tls") {
+         m_apps.push_back(benchmark_payload(BenchmarkApp::TLS));
+      } else if (app == "dns") {
+         m_apps.push_back(benchmark_payload(BenchmarkApp::DNS));
+      } else if (app == "quic") {
+         m_apps.push_back(benchmark_payload(BenchmarkApp::QUIC));
+      } else if (app != "none" && !app.empty()) {
+         throw PluginError("unknown benchmark application: " + app);
+      }
+   }
 }
 
 InputPlugin::Result Benchmark::get(PacketBlock &packets)
@@ -228,4 +288,103 @@ void Benchmark::generatePacketFlowN(Packet *pkt)
    generatePacket(pkt);
 }
 
+uint32_t Benchmark::flowSize()
+{
+   double u = std::uniform_real_distribution<double>(0, 1)(m_rndGen);
+
+   if (m_flowMode == BenchmarkMode::ZIPF) {
+      return std::lower_bound(m_zipfCdf.begin(), m_zipfCdf.end(), u) - m_zipfCdf.begin() + 1;
+   }
+   double size = std::ceil(1.0 / std::pow(1.0 - u, 1.0 / m_alpha));
+   return size >= m_maxFlowSize ? m_maxFlowSize : static_cast<uint32_t>(size);
+}
+
+void Benchmark::newFlow(ActiveFlow &flow)
+{
+   std::uniform_int_distribution<uint32_t> distrib;
+
+   if (distrib(m_rndGen) & 1) {
+      flow.ip_version = IP::v4;
+      flow.src_ip.v4 = distrib(m_rndGen);
+      flow.dst_ip.v4 = distrib(m_rndGen);
+   } else {
+      flow.ip_version = IP::v6;
+      for (int i = 0; i < 4; i++) {
+         reinterpret_cast<uint32_t *>(flow.src_ip.v6)[i] = distrib(m_rndGen);
+         reinterpret_cast<uint32_t *>(flow.dst_ip.v6)[i] = distrib(m_rndGen);
+      }
+   }
+   flow.src_port = std::uniform_int_distribution<uint16_t>(1024, 65535)(m_rndGen);
+
+   if (m_apps.empty()) {
+      flow.app = nullptr;
+      flow.ip_proto = (distrib(m_rndGen) & 1) ? IPPROTO_TCP : IPPROTO_UDP;
+      flow.dst_port = distrib(m_rndGen);
+   } else {
+      size_t idx = std::uniform_int_distribution<size_t>(0, m_apps.size() - 1)(m_rndGen);
+      flow.app = &m_apps[idx];
+      flow.ip_proto = flow.app->ip_proto;
+      flow.dst_port = flow.app->port;
+   }
+   flow.remaining = flowSize();
+   flow.sent = 0;
+}
+
+void Benchmark::generatePacketActive(Packet *pkt)
+{
+   ActiveFlow &flow = m_flows[std::uniform_int_distribution<size_t>(0, m_flows.size() - 1)(m_rndGen)];
+   bool from_client = !(flow.sent & 1);
+   uint16_t l3_size = flow.ip_version == IP::v4 ? BENCHMARK_L3_SIZE : BENCHMARK_L3_SIZE_V6;
+   uint16_t l4_size = flow.ip_proto == IPPROTO_TCP ? BENCHMARK_L4_SIZE_TCP : BENCHMARK_L4_SIZE_UDP;
+   const std::vector<uint8_t> *tmplt = nullptr;
+
+   if (flow.app != nullptr) {
+      if (flow.sent == 0) {
+         tmplt = &flow.app->request;
+      } else if (flow.sent == 1 && !flow.app->response.empty()) {
+         tmplt = &flow.app->response;
+      }
+   }
+
+   pkt->ts = m_currentTs;
+   pkt->ethertype = flow.ip_version == IP::v4 ? 0x0800 : 0x86DD;
+   pkt->ip_version = flow.ip_version;
+   pkt->ip_proto = flow.ip_proto;
+   pkt->ip_ttl = 64;
+   pkt->ip_tos = 0;
+   pkt->ip_flags = 0;
+   pkt->src_ip = from_client ? flow.src_ip : flow.dst_ip;
+   pkt->dst_ip = from_client ? flow.dst_ip : flow.src_ip;
+   pkt->src_port = from_client ? flow.src_port : flow.dst_port;
+   pkt->dst_port = from_client ? flow.dst_port : flow.src_port;
+   pkt->source_pkt = from_client;
+   if (flow.ip_proto == IPPROTO_TCP) {
+      pkt->tcp_flags = flow.remaining == 1 ? 0x11 : 0x18; // FIN ACK : PSH ACK
+      pkt->tcp_window = 65535;
+   } else {
+      pkt->tcp_flags = 0;
+      pkt->tcp_window = 0;
+   }
+
+   if (tmplt != nullptr) {
+      pkt->payload = tmplt->data();
+      pkt->payload_len = tmplt->size();
+   } else {
+      int tmp = BENCHMARK_L2_SIZE + l3_size + l4_size;
+      pkt->payload = m_zeroBuf.data();
+      pkt->payload_len = std::uniform_int_distribution<uint16_t>(max(m_packetSizeFrom - tmp, 0), max(m_packetSizeTo - tmp, 0))(m_rndGen);
+   }
+   pkt->payload_len_wire = pkt->payload_len;
+   pkt->ip_payload_len = l4_size + pkt->payload_len;
+   pkt->ip_len = l3_size + pkt->ip_payload_len;
+   pkt->packet_len = BENCHMARK_L2_SIZE + pkt->ip_len;
+   pkt->packet_len_wire = pkt->packet_len;
+   pkt->packet = m_zeroBuf.data();
+
+   flow.sent++;
+   if (--flow.remaining == 0) {
+      newFlow(flow);
+   }
+}
+
 }
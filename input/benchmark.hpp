@@ -46,16 +46,19 @@
 #include <random>
 #include <chrono>
 #include <string>
+#include <vector>
 #include <cstdint>
 
 #include <ipfixprobe/input.hpp>
 #include <ipfixprobe/packet.hpp>
 #include <ipfixprobe/utils.hpp>
+#include "benchmark-payloads.hpp"
 
 namespace ipxp {
 
 #define BENCHMARK_L2_SIZE     14
 #define BENCHMARK_L3_SIZE     20
+#define BENCHMARK_L3_SIZE_V6  40
 #define BENCHMARK_L4_SIZE_TCP 20
 #define BENCHMARK_L4_SIZE_UDP 8
 
@@ -69,6 +72,10 @@ namespace ipxp {
 #define BENCHMARK_DEFAULT_PKT_CNT   BENCHMARK_PKT_CNT_INF
 #define BENCHMARK_DEFAULT_SIZE_FROM 512
 #define BENCHMARK_DEFAULT_SIZE_TO   512
+#define BENCHMARK_DEFAULT_FLOWS     10000
+#define BENCHMARK_DEFAULT_ALPHA     1.2
+#define BENCHMARK_DEFAULT_MAX_FLOW  100000
+#define BENCHMARK_DEFAULT_APPS      "http,tls,dns,quic"
 
 class BenchmarkOptParser : public OptionsParser
 {
@@ -79,11 +86,16 @@ public:
    uint64_t m_pkt_cnt;
    uint16_t m_pkt_size;
    uint64_t m_link;
+   uint32_t m_flows;
+   double m_alpha;
+   uint32_t m_max_flow;
+   std::string m_apps;
 
    BenchmarkOptParser() : OptionsParser("benchmark", "Input plugin for various benchmarking purposes"),
-      m_mode("1f"), m_seed(""), m_duration(0), m_pkt_cnt(0), m_pkt_size(BENCHMARK_DEFAULT_SIZE_FROM), m_link(0)
+      m_mode("1f"), m_seed(""), m_duration(0), m_pkt_cnt(0), m_pkt_size(BENCHMARK_DEFAULT_SIZE_FROM), m_link(0),
+      m_flows(BENCHMARK_DEFAULT_FLOWS), m_alpha(BENCHMARK_DEFAULT_ALPHA), m_max_flow(BENCHMARK_DEFAULT_MAX_FLOW), m_apps(BENCHMARK_DEFAULT_APPS)
    {
-      register_option("m", "mode", "STR", "Benchmark mode 1f (1x N-packet flow) or nf (Nx 1-packet flow)", [this](const char *arg){m_mode = arg; return true;}, OptionFlags::RequiredArgument);
+      register_option("m", "mode", "STR", "Benchmark mode 1f (1x N-packet flow), nf (Nx 1-packet flow), zipf or pareto (active flows with heavy-tailed flow sizes)", [this](const char *arg){m_mode = arg; return true;}, OptionFlags::RequiredArgument);
       register_option("S", "seed", "STR", "String seed for random generator", [this](const char *arg){m_seed = arg; return true;}, OptionFlags::RequiredArgument);
       register_option("d", "duration", "TIME", "Duration in seconds",
          [this](const char *arg){try {m_duration = str2num<decltype(m_duration)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
@@ -97,6 +109,17 @@ public:
       register_option("I", "id", "NUM", "Link identifier number",
          [this](const char *arg){try {m_link = str2num<decltype(m_link)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
          OptionFlags::RequiredArgument);
+      register_option("F", "flows", "NUM", "Number of concurrently active flows in zipf and pareto modes",
+         [this](const char *arg){try {m_flows = str2num<decltype(m_flows)>(arg);} catch(std::invalid_argument &e) {return false;} return m_flows != 0;},
+         OptionFlags::RequiredArgument);
+      register_option("a", "alpha", "NUM", "Shape parameter of flow size distribution in zipf and pareto modes",
+         [this](const char *arg){try {m_alpha = str2num<decltype(m_alpha)>(arg);} catch(std::invalid_argument &e) {return false;} return m_alpha > 0;},
+         OptionFlags::RequiredArgument);
+      register_option("M", "max-flow", "NUM", "Maximal flow size in packets in zipf and pareto modes",
+         [this](const char *arg){try {m_max_flow = str2num<decltype(m_max_flow)>(arg);} catch(std::invalid_argument &e) {return false;} return m_max_flow != 0;},
+         OptionFlags::RequiredArgument);
+      register_option("A", "apps", "LIST", "Comma separated list of generated payloads: http,tls,dns,quic or none",
+         [this](const char *arg){m_apps = arg; return true;}, OptionFlags::RequiredArgument);
    }
 };
 
@@ -105,7 +128,9 @@ class Benchmark : public InputPlugin
 public:
    enum class BenchmarkMode {
       FLOW_1, /* 1x N-packet flow */
-      FLOW_N  /* Nx 1-packet flows */
+      FLOW_N, /* Nx 1-packet flows */
+      ZIPF,   /* Active flows with Zipf distributed sizes */
+      PARETO  /* Active flows with Pareto distributed sizes */
    };
    Benchmark();
    ~Benchmark();
@@ -117,6 +142,21 @@ public:
    InputPlugin::Result get(PacketBlock &packets);
 
 private:
+   /**
+    * \brief State of one active flow in zipf and pareto modes.
+    */
+   struct ActiveFlow {
+      ipaddr_t src_ip;
+      ipaddr_t dst_ip;
+      uint16_t src_port;
+      uint16_t dst_port;
+      uint8_t ip_version;
+      uint8_t ip_proto;
+      uint32_t remaining; /**< Packets left to generate. */
+      uint32_t sent;      /**< Packets already generated. */
+      const BenchmarkPayload *app;
+   };
+
    void (Benchmark::*m_generatePacketFunc)(Packet *);
    BenchmarkMode m_flowMode;
    uint64_t m_maxDuration;
@@ -130,11 +170,22 @@ private:
    struct timeval m_currentTs;
    uint64_t m_pktCnt;
 
+   double m_alpha;
+   uint32_t m_maxFlowSize;
+   std::vector<double> m_zipfCdf;
+   std::vector<ActiveFlow> m_flows;
+   std::vector<BenchmarkPayload> m_apps;
+   std::vector<uint8_t> m_zeroBuf;
+
    InputPlugin::Result check_constraints() const;
+   void parse_apps(const std::string &apps);
+   uint32_t flowSize();
+   void newFlow(ActiveFlow &flow);
    void swapEndpoints(Packet *pkt);
    void generatePacket(Packet *pkt);
    void generatePacketFlow1(Packet *pkt);
    void generatePacketFlowN(Packet *pkt);
+   void generatePacketActive(Packet *pkt);
 };
 
 }
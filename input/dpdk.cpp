@@ -41,9 +41,12 @@
  *
  */
 
+#include <algorithm>
 #include <cstring>
 #include <mutex>
 #include <rte_ethdev.h>
+#include <rte_lcore.h>
+#include <rte_prefetch.h>
 #include <rte_version.h>
 #include <unistd.h>
 #include <rte_eal.h>
@@ -120,6 +123,7 @@ static bool convert_from_flexprobe(const rte_mbuf* mbuf, Packet& pkt)
     pkt.payload_len = datalen < data_view->size() ? 0 : datalen - data_view->size();
     pkt.payload_len_wire = rte_pktmbuf_pkt_len(mbuf) - data_view->size();
 
+    pkt.meta = PKT_META_FLOW | PKT_META_TCP | PKT_META_PAYLOAD;
     return true;
 }
 #endif
@@ -131,20 +135,40 @@ DpdkCore& DpdkCore::getInstance()
     if (!m_instance) {
         m_instance = new DpdkCore();
     }
+    m_instance->m_readers++;
     return *m_instance;
 }
 
+DpdkCore::DpdkCore()
+    : is_ifc_ready(false)
+    , m_portId(0)
+    , m_rxQueueCount(0)
+    , m_txQueueCount(0)
+    , m_currentRxId(0)
+    , m_readers(0)
+    , m_rxTimestampOffset(0)
+    , m_isNfbDpdkDriver(false)
+    , m_rxOffloadCapa(0)
+    , m_rssOffloadCapa(0)
+{
+}
+
 DpdkCore::~DpdkCore()
 {
-    rte_eth_dev_stop(m_portId);
-    rte_eth_dev_close(m_portId);
-    rte_eal_cleanup();
+    if (isConfigured) {
+        rte_eth_dev_stop(m_portId);
+        rte_eth_dev_close(m_portId);
+        for (auto& it : m_mempools) {
+            rte_mempool_free(it.second);
+        }
+        rte_eal_cleanup();
+    }
     m_instance = nullptr;
 }
 
 void DpdkCore::deinit()
 {
-    if (m_instance) {
+    if (m_instance && --m_instance->m_readers == 0) {
         delete m_instance;
         m_instance = nullptr;
     }
@@ -152,7 +176,6 @@ void DpdkCore::deinit()
 
 void DpdkCore::initInterface()
 {
-    validatePort();
     auto portConfig = createPortConfig();
     configurePort(portConfig);
 }
@@ -171,8 +194,13 @@ struct rte_eth_conf DpdkCore::createPortConfig()
 #else
     rte_eth_conf portConfig {.rxmode = {.max_rx_pkt_len = RTE_ETHER_MAX_LEN}};
 #endif
-    portConfig.rxmode.mq_mode = ETH_MQ_RX_RSS;
-    portConfig.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_TIMESTAMP;
+    // Virtual devices like net_pcap or net_null support neither RSS nor timestamps
+    if (m_rxQueueCount > 1 && m_rssOffloadCapa) {
+        portConfig.rxmode.mq_mode = ETH_MQ_RX_RSS;
+    }
+    if (hasRxTimestampOffload()) {
+        portConfig.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_TIMESTAMP;
+    }
     return portConfig;
 }
 
@@ -197,7 +225,7 @@ void DpdkCore::configureRSS()
     struct rte_eth_rss_conf rssConfig = {
         .rss_key = rssKey,
         .rss_key_len = RSS_KEY_LEN,
-        .rss_hf = ETH_RSS_IP | ETH_RSS_TCP | ETH_RSS_UDP,
+        .rss_hf = (ETH_RSS_IP | ETH_RSS_TCP | ETH_RSS_UDP) & m_rssOffloadCapa,
     };
 
     if (rte_eth_dev_rss_hash_update(m_portId, &rssConfig)) {
@@ -239,9 +267,13 @@ void DpdkCore::configure(const char* params)
     m_portId = parser.port_num();
     m_rxQueueCount = parser.rx_queues();
     configureEal(parser.eal_params());
-    registerRxTimestamp();
-    initInterface();
+    validatePort();
     recognizeDriver();
+    if (hasRxTimestampOffload()) {
+        registerRxTimestamp();
+    }
+    assignLcores();
+    initInterface();
     isConfigured = true;
 }
 
@@ -254,6 +286,11 @@ void DpdkCore::recognizeDriver()
     if (std::strcmp(rteDevInfo.driver_name, "net_nfb") == 0) {
         m_isNfbDpdkDriver = true;
     }
+    if (m_rxQueueCount > rteDevInfo.max_rx_queues) {
+        throw PluginError("Port supports at most " + std::to_string(rteDevInfo.max_rx_queues) + " RX queues");
+    }
+    m_rxOffloadCapa = rteDevInfo.rx_offload_capa;
+    m_rssOffloadCapa = rteDevInfo.flow_type_rss_offloads;
 }
 
 bool DpdkCore::isNfbDpdkDriver()
@@ -261,6 +298,11 @@ bool DpdkCore::isNfbDpdkDriver()
 	return m_isNfbDpdkDriver;
 }
 
+bool DpdkCore::hasRxTimestampOffload()
+{
+    return m_rxOffloadCapa & RTE_ETH_RX_OFFLOAD_TIMESTAMP;
+}
+
 std::vector<char *> DpdkCore::convertStringToArgvFormat(const std::string& ealParams)
 {
     std::vector<char *> args;
@@ -285,15 +327,70 @@ void DpdkCore::configureEal(const std::string& ealParams)
     }
 }
 
+void DpdkCore::assignLcores()
+{
+    std::vector<unsigned> lcores;
+    unsigned lcore;
+
+    RTE_LCORE_FOREACH(lcore) {
+        lcores.push_back(lcore);
+    }
+
+    m_queueLcores.clear();
+    m_socketQueues.clear();
+    for (uint16_t queue = 0; queue < m_rxQueueCount; queue++) {
+        unsigned queueLcore = lcores[queue % lcores.size()];
+        m_queueLcores.push_back(queueLcore);
+        m_socketQueues[rte_lcore_to_socket_id(queueLcore)]++;
+    }
+}
+
 uint16_t DpdkCore::getRxQueueId()
 {
+    if (m_currentRxId >= m_rxQueueCount) {
+        throw PluginError("More dpdk inputs than configured RX queues");
+    }
     return m_currentRxId++;
 }
 
+uint16_t DpdkCore::getPendingQueueCount() const
+{
+    return m_rxQueueCount - m_currentRxId;
+}
+
+unsigned DpdkCore::getQueueLcore(uint16_t rxQueueId) const
+{
+    return m_queueLcores[rxQueueId];
+}
+
+rte_mempool* DpdkCore::getMempool(unsigned socketId)
+{
+    auto it = m_mempools.find(socketId);
+    if (it != m_mempools.end()) {
+        return it->second;
+    }
+
+    std::string mpool_name = "mbuf_pool_" + std::to_string(socketId);
+    rte_mempool* mempool = rte_pktmbuf_pool_create(
+        mpool_name.c_str(),
+        parser.pkt_mempool_size() * m_socketQueues[socketId],
+        MEMPOOL_CACHE_SIZE,
+        0,
+        RTE_MBUF_DEFAULT_BUF_SIZE,
+        socketId);
+    if (!mempool) {
+        throw PluginError("Unable to create memory pool. " + std::string(rte_strerror(rte_errno)));
+    }
+    m_mempools[socketId] = mempool;
+    return mempool;
+}
+
 void DpdkCore::startIfReady()
 {
     if (m_rxQueueCount == m_currentRxId) {
-        configureRSS();
+        if (m_rxQueueCount > 1 && m_rssOffloadCapa) {
+            configureRSS();
+        }
         enablePort();
         is_ifc_ready = true;
     }
@@ -305,63 +402,60 @@ int DpdkCore::getRxTimestampOffset()
 }
 
 DpdkReader::DpdkReader()
-    : m_dpdkCore(DpdkCore::getInstance())
+    : rteMempool(nullptr)
+    , pkts_read_(0)
+    , m_rxQueueId(0)
+    , m_portId(0)
+    , m_rxDescriptors(0)
+    , m_burstSize(0)
+    , m_prefetch(0)
+    , m_lcore(0)
+    , m_rxTimestampOffset(0)
+    , m_useHwRxTimestamp(false)
+    , m_affinitySet(false)
+    , m_dpdkCore(DpdkCore::getInstance())
 {
-    pkts_read_ = 0;
-    m_useHwRxTimestamp = false;
 }
 
 DpdkReader::~DpdkReader()
 {
+    close();
     m_dpdkCore.deinit();
 }
 
+void DpdkReader::close()
+{
+    // Mbufs of the last block are otherwise held until the next get(), which never comes
+    releaseMbufs();
+    mbufs_.clear();
+    mbufs_.shrink_to_fit();
+}
+
 void DpdkReader::init(const char* params)
 {
     m_dpdkCore.configure(params);
     m_rxQueueId = m_dpdkCore.getRxQueueId();
     m_portId = m_dpdkCore.parser.port_num();
+    m_rxDescriptors = m_dpdkCore.parser.pkt_buffer_size();
+    m_burstSize = m_dpdkCore.parser.rx_burst_size();
+    m_prefetch = m_dpdkCore.parser.prefetch();
     m_rxTimestampOffset = m_dpdkCore.getRxTimestampOffset();
-    m_useHwRxTimestamp = m_dpdkCore.isNfbDpdkDriver();
+    m_useHwRxTimestamp = m_dpdkCore.isNfbDpdkDriver() && m_dpdkCore.hasRxTimestampOffload();
+    m_lcore = m_dpdkCore.getQueueLcore(m_rxQueueId);
 
-    createRteMempool(m_dpdkCore.parser.pkt_mempool_size());
-    createRteMbufs(m_dpdkCore.parser.pkt_buffer_size());
-    setupRxQueue();   
-    set_thread_affinity(m_rxQueueId);
+    // Mbufs are allocated on the NUMA node of the lcore which parses them
+    rteMempool = m_dpdkCore.getMempool(rte_lcore_to_socket_id(m_lcore));
+    setupRxQueue();
 
     m_dpdkCore.startIfReady();
 }
 
-void DpdkReader::createRteMempool(uint16_t mempoolSize)
-{
-    std::string mpool_name = "mbuf_pool_" + std::to_string(m_rxQueueId);
-    rteMempool = rte_pktmbuf_pool_create(
-        mpool_name.c_str(), 
-        mempoolSize, 
-        MEMPOOL_CACHE_SIZE, 
-        0, 
-        RTE_MBUF_DEFAULT_BUF_SIZE, 
-        rte_lcore_to_socket_id(m_rxQueueId));
-    if (!rteMempool) {
-        throw PluginError("Unable to create memory pool. " + std::string(rte_strerror(rte_errno)));
-    }
-}
-
-void DpdkReader::createRteMbufs(uint16_t mbufsSize)
-{
-    try {
-        mbufs_.resize(mbufsSize);
-    } catch (const std::exception& e) {
-        throw PluginError(e.what());
-    }
-}
-
 void DpdkReader::setupRxQueue()
 {
     int ret = rte_eth_rx_queue_setup(
         m_portId, 
         m_rxQueueId, 
-        mbufs_.size(), 
+        m_rxDescriptors, 
         rte_eth_dev_socket_id(m_portId), 
         nullptr, 
         rteMempool);
@@ -370,14 +464,44 @@ void DpdkReader::setupRxQueue()
     }
 }
 
-int DpdkReader::set_thread_affinity(uint16_t thread_id)
+void DpdkReader::setThreadAffinity()
 {
     cpu_set_t cpuset;
 
+    // Called from the pipeline thread, init() runs in the main thread.
+    // Lcore ids match cpu ids unless EAL --lcores remapping is used.
     CPU_ZERO(&cpuset);
-    CPU_SET(thread_id, &cpuset);
+    CPU_SET(m_lcore, &cpuset);
+
+    pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+    m_affinitySet = true;
+}
+
+void DpdkReader::releaseMbufs()
+{
+#if RTE_VERSION >= RTE_VERSION_NUM(20, 2, 0, 0)
+    rte_pktmbuf_free_bulk(mbufs_.data(), pkts_read_);
+#else
+    for (auto i = 0; i < pkts_read_; i++) {
+        rte_pktmbuf_free(mbufs_[i]);
+    }
+#endif
+    pkts_read_ = 0;
+}
 
-    return pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+uint16_t DpdkReader::receiveBurst(uint16_t maxPkts)
+{
+    uint16_t received = 0;
+
+    while (received < maxPkts) {
+        uint16_t burst = std::min<size_t>(m_burstSize, maxPkts - received);
+        uint16_t cnt = rte_eth_rx_burst(m_portId, m_rxQueueId, mbufs_.data() + received, burst);
+        received += cnt;
+        if (cnt < burst) {
+            break;
+        }
+    }
+    return received;
 }
 
 struct timeval DpdkReader::getTimestamp(rte_mbuf* mbuf)
@@ -411,31 +535,40 @@ InputPlugin::Result DpdkReader::get(PacketBlock& packets)
     while (m_dpdkCore.is_ifc_ready == false) {
         usleep(1000);
     }
+    if (!m_affinitySet) {
+        setThreadAffinity();
+    }
 
-#ifndef WITH_FLEXPROBE
     parser_opt_t opt { &packets, false, false, DLT_EN10MB };
-#endif
     packets.cnt = 0;
-    for (auto i = 0; i < pkts_read_; i++) {
-        rte_pktmbuf_free(mbufs_[i]);
+
+    // Packets of the previous block point into mbufs, storage plugin is done with them now
+    releaseMbufs();
+    if (mbufs_.size() < packets.size) {
+        mbufs_.resize(packets.size);
     }
-    pkts_read_ = rte_eth_rx_burst(m_portId, m_rxQueueId, mbufs_.data(), mbufs_.size());
+
+    pkts_read_ = receiveBurst(std::min<size_t>(packets.size, UINT16_MAX));
     if (pkts_read_ == 0) {
-        return Result::NOT_PARSED;
+        return Result::TIMEOUT;
     }
 
+    for (auto i = 0; i < pkts_read_ && i < (int) m_prefetch; i++) {
+        rte_prefetch0(rte_pktmbuf_mtod(mbufs_[i], void*));
+    }
     for (auto i = 0; i < pkts_read_; i++) {
+        if (i + m_prefetch < pkts_read_) {
+            rte_prefetch0(rte_pktmbuf_mtod(mbufs_[i + m_prefetch], void*));
+        }
 #ifdef WITH_FLEXPROBE
-        // Convert Flexprobe pre-parsed packet into IPFIXPROBE packet
+        // Convert Flexprobe pre-parsed packet into IPFIXPROBE packet, raw frame is not available
         auto conv_result = convert_from_flexprobe(mbufs_[i], packets.pkts[packets.cnt]);
-        packets.bytes += packets.pkts[packets.cnt].packet_len_wire;
         m_seen++;
 
-        if (!conv_result) {
+        if (!conv_result || !parse_packet_meta(&opt, nullptr, 0, 0)) {
             continue;
         }
         m_parsed++;
-        packets.cnt++;
 #else
         parse_packet(&opt,
             getTimestamp(mbufs_[i]),
@@ -49,17 +49,24 @@
 #include <ipfixprobe/input.hpp>
 #include <ipfixprobe/utils.hpp>
 
+#include <atomic>
+#include <map>
 #include <memory>
 #include <rte_mbuf.h>
 #include <sstream>
+#include <vector>
 
 namespace ipxp {
 class DpdkOptParser : public OptionsParser {
 private:
     static constexpr size_t DEFAULT_MBUF_BURST_SIZE = 256;
     static constexpr size_t DEFAULT_MBUF_POOL_SIZE = 16384;
+    static constexpr size_t DEFAULT_RX_BURST_SIZE = 64;
+    static constexpr size_t DEFAULT_PREFETCH = 4;
     size_t pkt_buffer_size_;
     size_t pkt_mempool_size_;
+    size_t rx_burst_size_;
+    size_t prefetch_;
     std::uint16_t port_num_;
     uint16_t rx_queues_ = 1;
     std::string eal_;
@@ -69,6 +76,8 @@ public:
         : OptionsParser("dpdk", "Input plugin for reading packets using DPDK interface")
         , pkt_buffer_size_(DEFAULT_MBUF_BURST_SIZE)
         , pkt_mempool_size_(DEFAULT_MBUF_POOL_SIZE)
+        , rx_burst_size_(DEFAULT_RX_BURST_SIZE)
+        , prefetch_(DEFAULT_PREFETCH)
     {
         register_option(
             "b",
@@ -88,15 +97,29 @@ public:
             "m",
             "mem",
             "SIZE",
-            "Size of the memory pool for received packets. Default: " + std::to_string(DEFAULT_MBUF_POOL_SIZE),
+            "Size of the memory pool for received packets per RX queue. Default: " + std::to_string(DEFAULT_MBUF_POOL_SIZE),
             [this](const char* arg) {try{pkt_mempool_size_ = str2num<decltype(pkt_mempool_size_)>(arg);} catch (std::invalid_argument&){return false;} return true; },
             RequiredArgument);
         register_option(
             "q",
             "queue",
             "COUNT",
-            "Number of RX queues. Default: 1",
-            [this](const char* arg) {try{rx_queues_ = str2num<decltype(rx_queues_)>(arg);} catch (std::invalid_argument&){return false;} return true; },
+            "Number of RX queues, each one is read by a separate pipeline. Default: 1",
+            [this](const char* arg) {try{rx_queues_ = str2num<decltype(rx_queues_)>(arg);} catch (std::invalid_argument&){return false;} return rx_queues_ > 0; },
+            RequiredArgument);
+        register_option(
+            "B",
+            "burst",
+            "SIZE",
+            "Maximal number of packets received by a single RX burst. Default: " + std::to_string(DEFAULT_RX_BURST_SIZE),
+            [this](const char* arg) {try{rx_burst_size_ = str2num<decltype(rx_burst_size_)>(arg);} catch (std::invalid_argument&){return false;} return rx_burst_size_ > 0; },
+            RequiredArgument);
+        register_option(
+            "P",
+            "prefetch",
+            "COUNT",
+            "Number of packets prefetched ahead of the parser. Default: " + std::to_string(DEFAULT_PREFETCH),
+            [this](const char* arg) {try{prefetch_ = str2num<decltype(prefetch_)>(arg);} catch (std::invalid_argument&){return false;} return true; },
             RequiredArgument);
         register_option(
             "e", 
@@ -116,6 +139,10 @@ public:
     std::string eal_params() const { return eal_; }
 
     uint16_t rx_queues() const { return rx_queues_; }
+
+    size_t rx_burst_size() const { return rx_burst_size_; }
+
+    size_t prefetch() const { return prefetch_; }
 };
 
 class DpdkCore {
@@ -134,23 +161,53 @@ public:
      */
     uint16_t getRxQueueId();
 
+    /**
+     * @brief Get number of RX queues without a DpdkReader
+     */
+    uint16_t getPendingQueueCount() const;
+
+    /**
+     * @brief Get the lcore assigned to rx queue
+     *
+     * Queues are assigned to lcores enabled by EAL parameters round-robin.
+     *
+     * @param rxQueueId rx queue id
+     * @return unsigned lcore id
+     */
+    unsigned getQueueLcore(uint16_t rxQueueId) const;
+
+    /**
+     * @brief Get the mbuf pool shared by rx queues of a NUMA socket
+     *
+     * @param socketId NUMA socket of the lcores reading the queues
+     * @return rte_mempool* memory pool
+     */
+    rte_mempool* getMempool(unsigned socketId);
+
     int getRxTimestampOffset();
 
     bool isNfbDpdkDriver();
 
+    bool hasRxTimestampOffload();
+
     /**
      * @brief Start receiving on port when all lcores are ready
      * 
      */
     void startIfReady();
 
+    /**
+     * @brief Release the core when the last DpdkReader is destroyed
+     */
     void deinit();
 
     // ready flag
-    bool is_ifc_ready;
+    std::atomic<bool> is_ifc_ready;
 
     /**
      * @brief Get the singleton dpdk core instance
+     *
+     * Every call has to be paired with deinit().
      */
     static DpdkCore& getInstance();
 
@@ -168,15 +225,23 @@ private:
     std::vector<char *> convertStringToArgvFormat(const std::string& ealParams);
     void recognizeDriver();
     void configureEal(const std::string& ealParams);
+    void assignLcores();
 
+    DpdkCore();
     ~DpdkCore();
 
     uint16_t m_portId;
     uint16_t m_rxQueueCount;
     uint16_t m_txQueueCount;
     uint16_t m_currentRxId;
+    uint16_t m_readers;
     int m_rxTimestampOffset;
     bool m_isNfbDpdkDriver;
+    uint64_t m_rxOffloadCapa;
+    uint64_t m_rssOffloadCapa;
+    std::vector<unsigned> m_queueLcores;
+    std::map<unsigned, unsigned> m_socketQueues;
+    std::map<unsigned, rte_mempool*> m_mempools;
     
     bool isConfigured = false;
     static DpdkCore* m_instance;
@@ -188,6 +253,8 @@ public:
 
     void init(const char* params) override;
 
+    void close() override;
+
     OptionsParser* get_parser() const override
     {
         return new DpdkOptParser();
@@ -198,6 +265,11 @@ public:
         return "dpdk";
     }
 
+    size_t pending_queues() const override
+    {
+        return m_dpdkCore.getPendingQueueCount();
+    }
+
     ~DpdkReader();
     DpdkReader();
 
@@ -206,19 +278,22 @@ private:
     std::vector<rte_mbuf*> mbufs_;
     
     std::uint16_t pkts_read_;
-    uint16_t rx_queue_id_;
-    uint16_t total_queues_cnt_;
 
     uint16_t m_rxQueueId;
     uint16_t m_portId;
+    uint16_t m_rxDescriptors;
+    size_t m_burstSize;
+    size_t m_prefetch;
+    unsigned m_lcore;
     int m_rxTimestampOffset;
 
     bool m_useHwRxTimestamp;
+    bool m_affinitySet;
 
-    void createRteMempool(uint16_t mempoolSize);
-    void createRteMbufs(uint16_t mbufsSize);
     void setupRxQueue();
-    int set_thread_affinity(uint16_t thread_id);
+    void setThreadAffinity();
+    void releaseMbufs();
+    uint16_t receiveBurst(uint16_t maxPkts);
     struct timeval getTimestamp(rte_mbuf* mbuf);
 
     DpdkCore& m_dpdkCore;
@@ -46,6 +46,7 @@
 #include <cstring>
 #include <iostream>
 #include <sys/types.h>
+#include <sys/time.h>
 
 #include "parser.hpp"
 #include "headers.hpp"
@@ -631,6 +632,7 @@ void parse_packet(parser_opt_t *opt, struct timeval ts, const uint8_t *data, uin
 
    pkt->packet_len_wire = len;
    pkt->ts = ts;
+   pkt->meta = PKT_META_ALL;
    pkt->src_port = 0;
    pkt->dst_port = 0;
    pkt->ip_proto = 0;
@@ -727,4 +729,87 @@ void parse_packet(parser_opt_t *opt, struct timeval ts, const uint8_t *data, uin
    opt->pblock->bytes += len;
 }
 
+/**
+ * \brief Clear packet fields not marked valid by input, packet structures are reused between blocks.
+ * \param [in,out] pkt Packet filled by input.
+ */
+static void clear_packet_meta(Packet *pkt)
+{
+   uint16_t meta = pkt->meta;
+
+   if (!(meta & PKT_META_TS)) {
+      pkt->ts = {0, 0};
+   }
+   if (!(meta & PKT_META_L2)) {
+      memset(pkt->dst_mac, 0, sizeof(pkt->dst_mac));
+      memset(pkt->src_mac, 0, sizeof(pkt->src_mac));
+      pkt->ethertype = 0;
+   }
+   if (!(meta & PKT_META_L3)) {
+      pkt->ip_len = 0;
+      pkt->ip_payload_len = 0;
+      pkt->ip_version = 0;
+      pkt->ip_proto = 0;
+      memset(&pkt->src_ip, 0, sizeof(pkt->src_ip));
+      memset(&pkt->dst_ip, 0, sizeof(pkt->dst_ip));
+      pkt->packet_len_wire = 0;
+   }
+   if (!(meta & PKT_META_L3_EXT)) {
+      pkt->ip_ttl = 0;
+      pkt->ip_tos = 0;
+      pkt->ip_flags = 0;
+   }
+   if (!(meta & PKT_META_L4)) {
+      pkt->src_port = 0;
+      pkt->dst_port = 0;
+      pkt->tcp_flags = 0;
+   }
+   if (!(meta & PKT_META_TCP)) {
+      pkt->tcp_window = 0;
+      pkt->tcp_options = 0;
+      pkt->tcp_mss = 0;
+      pkt->tcp_seq = 0;
+      pkt->tcp_ack = 0;
+   }
+   if (!(meta & PKT_META_PAYLOAD)) {
+      pkt->packet = nullptr;
+      pkt->packet_len = 0;
+      pkt->payload = nullptr;
+      pkt->payload_len = 0;
+      pkt->payload_len_wire = 0;
+   }
+}
+
+bool parse_packet_meta(parser_opt_t *opt, const uint8_t *data, uint16_t len, uint16_t caplen, uint16_t required)
+{
+   if (opt->pblock->cnt >= opt->pblock->size) {
+      return false;
+   }
+   Packet *pkt = &opt->pblock->pkts[opt->pblock->cnt];
+
+   if ((pkt->meta & required) != required) {
+      size_t cnt = opt->pblock->cnt;
+      if (data == nullptr) {
+         DEBUG_MSG("Incomplete packet metadata %#x, required %#x\n", pkt->meta, required);
+         return false;
+      }
+      struct timeval ts;
+      if (pkt->meta & PKT_META_TS) {
+         ts = pkt->ts;
+      } else {
+         gettimeofday(&ts, nullptr);
+      }
+      parse_packet(opt, ts, data, len, caplen);
+      return opt->pblock->cnt != cnt;
+   }
+
+   if (pkt->meta != PKT_META_ALL) {
+      clear_packet_meta(pkt);
+   }
+   opt->packet_valid = true;
+   opt->pblock->cnt++;
+   opt->pblock->bytes += pkt->packet_len_wire;
+   return true;
+}
+
 }
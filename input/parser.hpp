@@ -82,5 +82,21 @@ typedef struct parser_opt_s {
 
 void parse_packet(parser_opt_t *opt, struct timeval ts, const uint8_t *data, uint16_t len, uint16_t caplen);
 
+/**
+ * \brief Add packet pre-parsed by input plugin to block.
+ *
+ * Input fills fields of the next packet in block and sets its `meta` flags. When all `required`
+ * fields are valid, packet is added without touching packet data and fields without flag are
+ * cleared. Otherwise the packet is parsed from `data` if available, with the input timestamp
+ * when it is valid or the current time.
+ * \param [in,out] opt Parser options.
+ * \param [in] data Packet data for fallback parsing, can be NULL.
+ * \param [in] len Original packet length.
+ * \param [in] caplen Length of `data`.
+ * \param [in] required PacketMeta flags of fields needed by the input.
+ * \return True when packet was added to block.
+ */
+bool parse_packet_meta(parser_opt_t *opt, const uint8_t *data, uint16_t len, uint16_t caplen, uint16_t required = PKT_META_FLOW);
+
 }
 #endif /* IPXP_INPUT_PARSER_HPP */
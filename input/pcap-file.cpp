@@ -0,0 +1,274 @@
+/**
+ * \file pcap-file.cpp
+ * \brief Parser of pcap and pcapng files stored in memory
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <config.h>
+#include <iostream>
+
+#include <ipfixprobe/plugin.hpp>
+
+#include "pcap-file.hpp"
+#include "parser.hpp"
+
+namespace ipxp {
+
+#define PCAP_MAGIC          0xA1B2C3D4
+#define PCAP_MAGIC_SWAPPED  0xD4C3B2A1
+#define PCAP_MAGIC_NSEC     0xA1B23C4D
+#define PCAP_MAGIC_NSEC_SWAPPED 0x4D3CB2A1
+
+#define PCAPNG_BLOCK_SHB    0x0A0D0D0A
+#define PCAPNG_BLOCK_IDB    0x00000001
+#define PCAPNG_BLOCK_EPB    0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4D
+#define PCAPNG_BLOCK_MIN_LEN 12
+#define PCAPNG_OPT_IF_TSRESOL 9
+
+struct __attribute__((packed)) pcap_file_hdr_t {
+   uint32_t magic;
+   uint16_t version_major;
+   uint16_t version_minor;
+   int32_t thiszone;
+   uint32_t sigfigs;
+   uint32_t snaplen;
+   uint32_t linktype;
+};
+
+struct __attribute__((packed)) pcap_pkt_hdr_t {
+   uint32_t ts_sec;
+   uint32_t ts_frac;
+   uint32_t caplen;
+   uint32_t len;
+};
+
+PcapFileParser::PcapFileParser(const std::string &file, const uint8_t *data, size_t size)
+   : m_file(file), m_data(data), m_size(size), m_pos(0), m_pcapng(false), m_swapped(false), m_nsec(false),
+   m_datalink(DLT_EN10MB), m_ifcs()
+{
+   if (size >= sizeof(uint32_t) && *reinterpret_cast<const uint32_t *>(data) == PCAPNG_BLOCK_SHB) {
+      m_pcapng = true;
+   } else {
+      parse_pcap_hdr();
+   }
+}
+
+uint32_t PcapFileParser::conv32(const uint8_t *ptr) const
+{
+   uint32_t val = *reinterpret_cast<const uint32_t *>(ptr);
+   return m_swapped ? __builtin_bswap32(val) : val;
+}
+
+uint16_t PcapFileParser::conv16(const uint8_t *ptr) const
+{
+   uint16_t val = *reinterpret_cast<const uint16_t *>(ptr);
+   return m_swapped ? __builtin_bswap16(val) : val;
+}
+
+void PcapFileParser::check_datalink(int datalink) const
+{
+#ifdef WITH_PCAP
+   if (datalink != DLT_EN10MB && datalink != DLT_LINUX_SLL && datalink != DLT_RAW
+# ifdef DLT_LINUX_SLL2
+      && datalink != DLT_LINUX_SLL2
+# endif /* DLT_LINUX_SLL2 */
+      ) {
+#else
+   if (datalink != DLT_EN10MB) {
+#endif /* WITH_PCAP */
+      throw PluginError("unsupported link type detected in file " + m_file);
+   }
+}
+
+void PcapFileParser::parse_pcap_hdr()
+{
+   if (m_size < sizeof(pcap_file_hdr_t)) {
+      throw PluginError("file " + m_file + " is not a pcap file");
+   }
+
+   const pcap_file_hdr_t *hdr = reinterpret_cast<const pcap_file_hdr_t *>(m_data);
+   switch (hdr->magic) {
+   case PCAP_MAGIC:
+      m_swapped = false;
+      m_nsec = false;
+      break;
+   case PCAP_MAGIC_SWAPPED:
+      m_swapped = true;
+      m_nsec = false;
+      break;
+   case PCAP_MAGIC_NSEC:
+      m_swapped = false;
+      m_nsec = true;
+      break;
+   case PCAP_MAGIC_NSEC_SWAPPED:
+      m_swapped = true;
+      m_nsec = true;
+      break;
+   default:
+      throw PluginError("file " + m_file + " is not a pcap or pcapng file");
+   }
+
+   m_datalink = conv32(reinterpret_cast<const uint8_t *>(&hdr->linktype));
+   check_datalink(m_datalink);
+   m_pos = sizeof(pcap_file_hdr_t);
+}
+
+bool PcapFileParser::next(PcapFilePacket &pkt)
+{
+   return m_pcapng ? next_pcapng(pkt) : next_pcap(pkt);
+}
+
+bool PcapFileParser::next_pcap(PcapFilePacket &pkt)
+{
+   if (m_pos + sizeof(pcap_pkt_hdr_t) > m_size) {
+      return false;
+   }
+
+   const pcap_pkt_hdr_t *phdr = reinterpret_cast<const pcap_pkt_hdr_t *>(m_data + m_pos);
+   uint32_t caplen = conv32(reinterpret_cast<const uint8_t *>(&phdr->caplen));
+   if (m_pos + sizeof(pcap_pkt_hdr_t) + caplen > m_size) {
+      std::cerr << "file " << m_file << " is truncated" << std::endl;
+      m_pos = m_size;
+      return false;
+   }
+
+   pkt.data = m_data + m_pos + sizeof(pcap_pkt_hdr_t);
+   pkt.ts.tv_sec = conv32(reinterpret_cast<const uint8_t *>(&phdr->ts_sec));
+   pkt.ts.tv_usec = conv32(reinterpret_cast<const uint8_t *>(&phdr->ts_frac));
+   if (m_nsec) {
+      pkt.ts.tv_usec /= 1000;
+   }
+   pkt.len = conv32(reinterpret_cast<const uint8_t *>(&phdr->len));
+   pkt.caplen = caplen;
+   pkt.datalink = m_datalink;
+
+   m_pos += sizeof(pcap_pkt_hdr_t) + caplen;
+   return true;
+}
+
+void PcapFileParser::parse_idb(const uint8_t *block, uint32_t block_len)
+{
+   Interface ifc = {conv16(block + 8), 1, 1};
+   size_t opt = 16;
+
+   while (opt + 4 <= block_len - 4) {
+      uint16_t code = conv16(block + opt);
+      uint16_t len = conv16(block + opt + 2);
+      if (code == 0) {
+         break;
+      }
+      if (code == PCAPNG_OPT_IF_TSRESOL && len >= 1) {
+         uint8_t res = block[opt + 4];
+         uint64_t units = 1;
+         // Resolutions finer than 2^-63 or 10^-19 s do not fit 64-bit timestamps
+         if ((res & 0x80) ? (res & 0x7F) > 63 : res > 19) {
+            throw PluginError("file " + m_file + " has unsupported timestamp resolution");
+         }
+         if (res & 0x80) {
+            units = static_cast<uint64_t>(1) << (res & 0x7F);
+         } else {
+            for (uint8_t i = 0; i < res; i++) {
+               units *= 10;
+            }
+         }
+         ifc.ts_div = units > 1000000 ? units / 1000000 : 1;
+         ifc.ts_mul = units < 1000000 ? 1000000 / units : 1;
+      }
+      opt += 4 + ((len + 3) & ~3);
+   }
+   check_datalink(ifc.datalink);
+   m_ifcs.push_back(ifc);
+}
+
+bool PcapFileParser::next_pcapng(PcapFilePacket &pkt)
+{
+   while (m_pos + PCAPNG_BLOCK_MIN_LEN <= m_size) {
+      const uint8_t *block = m_data + m_pos;
+      uint32_t type = *reinterpret_cast<const uint32_t *>(block);
+
+      if (type == PCAPNG_BLOCK_SHB) {
+         uint32_t magic = *reinterpret_cast<const uint32_t *>(block + 8);
+         if (magic == PCAPNG_BYTE_ORDER_MAGIC) {
+            m_swapped = false;
+         } else if (magic == __builtin_bswap32(PCAPNG_BYTE_ORDER_MAGIC)) {
+            m_swapped = true;
+         } else {
+            throw PluginError("file " + m_file + " has invalid pcapng section header");
+         }
+         // Interface IDs are local to a section
+         m_ifcs.clear();
+      }
+
+      type = conv32(block);
+      uint32_t block_len = conv32(block + 4);
+      if (block_len < PCAPNG_BLOCK_MIN_LEN || m_pos + block_len > m_size) {
+         std::cerr << "file " << m_file << " is truncated" << std::endl;
+         m_pos = m_size;
+         return false;
+      }
+      m_pos += block_len;
+
+      if (type == PCAPNG_BLOCK_IDB && block_len >= 20) {
+         parse_idb(block, block_len);
+      } else if (type == PCAPNG_BLOCK_EPB && block_len >= 32) {
+         uint32_t ifc_id = conv32(block + 8);
+         uint32_t caplen = conv32(block + 20);
+         // Packet data are followed by the trailing block length, block_len >= 32 is checked above
+         if (ifc_id >= m_ifcs.size() || caplen > block_len - 32) {
+            throw PluginError("file " + m_file + " contains invalid packet block");
+         }
+         const Interface &ifc = m_ifcs[ifc_id];
+         uint64_t ts_units = (static_cast<uint64_t>(conv32(block + 12)) << 32) | conv32(block + 16);
+         uint64_t ts_usec = ts_units / ifc.ts_div * ifc.ts_mul;
+
+         pkt.data = block + 28;
+         pkt.ts.tv_sec = ts_usec / 1000000;
+         pkt.ts.tv_usec = ts_usec % 1000000;
+         pkt.len = conv32(block + 24);
+         pkt.caplen = caplen;
+         pkt.datalink = ifc.datalink;
+         return true;
+      }
+   }
+   return false;
+}
+
+}
@@ -0,0 +1,118 @@
+/**
+ * \file pcap-file.hpp
+ * \brief Parser of pcap and pcapng files stored in memory
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef IPXP_INPUT_PCAP_FILE_HPP
+#define IPXP_INPUT_PCAP_FILE_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <sys/time.h>
+
+namespace ipxp {
+
+/**
+ * \brief Packet record read from a capture file.
+ */
+struct PcapFilePacket {
+   const uint8_t *data; /**< Captured packet data, points into the parsed memory */
+   struct timeval ts;
+   uint32_t len;        /**< Original packet length */
+   uint32_t caplen;     /**< Captured packet length */
+   int datalink;
+};
+
+/**
+ * \brief Sequential parser of pcap and pcapng files.
+ *
+ * Parser does not copy anything, returned packets point directly into the parsed memory
+ * so the memory has to be kept valid as long as the packets are used.
+ */
+class PcapFileParser
+{
+public:
+   /**
+    * \brief Constructor.
+    * \param [in] file File name used in error messages.
+    * \param [in] data Content of the file.
+    * \param [in] size Size of the content.
+    * \throw PluginError when the content is not a pcap or pcapng file.
+    */
+   PcapFileParser(const std::string &file, const uint8_t *data, size_t size);
+
+   /**
+    * \brief Read next packet.
+    * \param [out] pkt Packet record.
+    * \return False when there are no more packets.
+    * \throw PluginError when the file is malformed or uses unsupported link type.
+    */
+   bool next(PcapFilePacket &pkt);
+
+private:
+   struct Interface {
+      int datalink;
+      uint64_t ts_div; /**< Divisor converting timestamp units to microseconds */
+      uint64_t ts_mul; /**< Multiplier converting timestamp units to microseconds */
+   };
+
+   std::string m_file;
+   const uint8_t *m_data;
+   size_t m_size;
+   size_t m_pos;
+   bool m_pcapng;
+   bool m_swapped;
+   bool m_nsec;
+   int m_datalink;
+   std::vector<Interface> m_ifcs;
+
+   uint32_t conv32(const uint8_t *ptr) const;
+   uint16_t conv16(const uint8_t *ptr) const;
+   void check_datalink(int datalink) const;
+   void parse_pcap_hdr();
+   bool next_pcap(PcapFilePacket &pkt);
+   bool next_pcapng(PcapFilePacket &pkt);
+   void parse_idb(const uint8_t *block, uint32_t block_len);
+};
+
+}
+#endif /* IPXP_INPUT_PCAP_FILE_HPP */
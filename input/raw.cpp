@@ -56,9 +56,14 @@
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/filter.h>
 #include <net/ethernet.h>
 #include <net/if.h>
 #include <ifaddrs.h>
+#ifdef WITH_PCAP
+#include <pcap/pcap.h>
+#endif
 
 #include "raw.hpp"
 #include "parser.hpp"
@@ -69,6 +74,15 @@ namespace ipxp {
 #error "raw plugin is supported with TPACKET3 only"
 #endif
 
+/* linux/bpf.h cannot be included together with pcap/bpf.h, only BPF_OBJ_GET command is needed. */
+#define RAW_BPF_OBJ_GET 7
+
+struct raw_bpf_obj_attr {
+   uint64_t pathname;
+   uint32_t bpf_fd;
+   uint32_t file_flags;
+};
+
 // Read only 1 packet into packet block
 constexpr size_t RAW_PACKET_BLOCK_SIZE = 1;
 
@@ -106,6 +120,9 @@ void RawReader::init(const char *params)
    if (parser.m_ifc.empty()) {
       throw PluginError("specify network interface");
    }
+   if (!parser.m_filter.empty() && !parser.m_ebpf.empty()) {
+      throw PluginError("filter and ebpf options are mutually exclusive");
+   }
 
    long pagesize = sysconf(_SC_PAGESIZE);
    if (pagesize == -1) {
@@ -120,7 +137,7 @@ void RawReader::init(const char *params)
       m_framesize = pagesize;
    }
 
-   open_ifc(parser.m_ifc);
+   open_ifc(parser.m_ifc, parser.m_filter, parser.m_ebpf);
 }
 
 void RawReader::close()
@@ -139,9 +156,66 @@ void RawReader::close()
    }
 }
 
-void RawReader::open_ifc(const std::string &ifc)
+/**
+ * \brief Attach socket filter, so unwanted packets are dropped before they are copied to the ring.
+ * \param [in] sock AF_PACKET socket.
+ * \param [in] ifc Interface the filter is compiled for.
+ * \param [in] filter Filter in pcap syntax compiled to classic BPF, ignored when empty.
+ * \param [in] ebpf Path to pinned eBPF socket filter program, ignored when empty.
+ */
+void RawReader::attach_filter(int sock, const std::string &ifc, const std::string &filter, const std::string &ebpf)
+{
+   if (!filter.empty()) {
+#ifdef WITH_PCAP
+      /* Only filters compiled for a live handle match VLAN tags stripped by NIC or kernel, libpcap reads them
+       * from packet metadata then. Snapshot length is the number of bytes kept by kernel, do not truncate anything. */
+      char errbuf[PCAP_ERRBUF_SIZE];
+      pcap_t *handle = pcap_open_live(ifc.c_str(), 262144, 0, 0, errbuf);
+      if (handle == nullptr) {
+         throw PluginError(std::string("unable to compile filter for ") + ifc + ": " + errbuf);
+      }
+      struct bpf_program prog;
+      if (pcap_compile(handle, &prog, filter.c_str(), 1, PCAP_NETMASK_UNKNOWN) == -1) {
+         std::string err = pcap_geterr(handle);
+         pcap_close(handle);
+         throw PluginError("couldn't parse filter " + filter + ": " + err);
+      }
+      pcap_close(handle);
+
+      struct sock_fprog fprog;
+      fprog.len = prog.bf_len;
+      fprog.filter = reinterpret_cast<struct sock_filter *>(prog.bf_insns);
+      int ret = setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog));
+      pcap_freecode(&prog);
+      if (ret == -1) {
+         throw PluginError(std::string("unable to attach filter: ") + strerror(errno));
+      }
+#else
+      throw PluginError("filter requires ipfixprobe compiled with libpcap (./configure --with-pcap)");
+#endif
+   }
+
+   if (!ebpf.empty()) {
+      struct raw_bpf_obj_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.pathname = reinterpret_cast<uint64_t>(ebpf.c_str());
+      int prog_fd = syscall(__NR_bpf, RAW_BPF_OBJ_GET, &attr, sizeof(attr));
+      if (prog_fd == -1) {
+         throw PluginError("unable to open eBPF program " + ebpf + ": " + strerror(errno));
+      }
+      int ret = setsockopt(sock, SOL_SOCKET, SO_ATTACH_BPF, &prog_fd, sizeof(prog_fd));
+      int err = errno;
+      ::close(prog_fd);
+      if (ret == -1) {
+         throw PluginError(std::string("unable to attach eBPF program: ") + strerror(err));
+      }
+   }
+}
+
+void RawReader::open_ifc(const std::string &ifc, const std::string &filter, const std::string &ebpf)
 {
-   int sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+   /* No packets are received before the socket is bound with protocol, so nothing bypasses the filter. */
+   int sock = socket(AF_PACKET, SOCK_RAW, 0);
    if (sock == -1) {
       throw PluginError(std::string("could not create AF_PACKET socket: ") + strerror(errno));
    }
@@ -153,6 +227,13 @@ void RawReader::open_ifc(const std::string &ifc)
       throw PluginError(std::string("unable to set packet to v3: ") + strerror(errno));
    }
 
+   try {
+      attach_filter(sock, ifc, filter, ebpf);
+   } catch (PluginError &e) {
+      ::close(sock);
+      throw;
+   }
+
    struct ifreq ifr;
    memset(&ifr, 0, sizeof(ifr));
    if (ifc.size() > sizeof(ifr.ifr_name) - 1) {
@@ -231,6 +312,11 @@ void RawReader::open_ifc(const std::string &ifc)
       throw PluginError(std::string("bind failed: ") + strerror(errno));
    }
 
+   /* Drop anything queued outside of the ring before the filter was attached. */
+   uint8_t dummy;
+   while (recv(sock, &dummy, sizeof(dummy), MSG_DONTWAIT | MSG_TRUNC) >= 0) {
+   }
+
    if (m_fanout) {
       int fanout_type = PACKET_FANOUT_CPU;
       int fanout_arg = (m_fanout | (fanout_type << 16));
@@ -57,13 +57,15 @@ class RawOptParser : public OptionsParser
 {
 public:
    std::string m_ifc;
+   std::string m_filter;
+   std::string m_ebpf;
    uint16_t m_fanout;
    uint32_t m_block_cnt;
    uint32_t m_pkt_cnt;
    bool m_list;
 
    RawOptParser() : OptionsParser("raw", "Input plugin for reading packets from a raw socket"),
-      m_ifc(""), m_fanout(0), m_block_cnt(2048), m_pkt_cnt(32), m_list(false)
+      m_ifc(""), m_filter(""), m_ebpf(""), m_fanout(0), m_block_cnt(2048), m_pkt_cnt(32), m_list(false)
    {
       register_option("i", "ifc", "IFC", "Network interface name", [this](const char *arg){m_ifc = arg; return true;}, OptionFlags::RequiredArgument);
       register_option("f", "fanout", "ID", "Enable packet fanout",
@@ -77,6 +79,10 @@ public:
       register_option("p", "pkts", "SIZE", "Number of packets in block (should be power of two num)",
          [this](const char *arg){try {m_pkt_cnt = str2num<decltype(m_pkt_cnt)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
          OptionFlags::RequiredArgument);
+      register_option("F", "filter", "STR", "Filter string in pcap syntax, packets are filtered in kernel (requires libpcap)",
+         [this](const char *arg){m_filter = arg; return true;}, OptionFlags::RequiredArgument);
+      register_option("e", "ebpf", "PATH", "Path to eBPF socket filter program pinned in BPF filesystem",
+         [this](const char *arg){m_ebpf = arg; return true;}, OptionFlags::RequiredArgument);
       register_option("l", "list", "", "Print list of available interfaces", [this](const char *arg){m_list = true; return true;}, OptionFlags::NoArgument);
    }
 };
@@ -110,7 +116,8 @@ private:
    struct tpacket_block_desc *m_pbd;
    uint32_t m_pkts_left;
 
-   void open_ifc(const std::string &ifc);
+   void open_ifc(const std::string &ifc, const std::string &filter, const std::string &ebpf);
+   void attach_filter(int sock, const std::string &ifc, const std::string &filter, const std::string &ebpf);
    bool get_block();
    void return_block();
    int read_packets(PacketBlock &packets);
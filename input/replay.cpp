@@ -0,0 +1,299 @@
+/**
+ * \file replay.cpp
+ * \brief Input plugin replaying pcap files preloaded into memory
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <config.h>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "replay.hpp"
+#include "parser.hpp"
+#include "pcap-file.hpp"
+
+namespace ipxp {
+
+#define HUGEPAGE_SIZE       (2 * 1024 * 1024)
+#define MAX_PACKET_LEN      65535
+
+__attribute__((constructor)) static void register_this_plugin()
+{
+   static PluginRecord rec = PluginRecord("replay", [](){return new ReplayReader();});
+   register_plugin(&rec);
+}
+
+static inline bool ts_less(const struct timeval &a, const struct timeval &b)
+{
+   return a.tv_sec < b.tv_sec || (a.tv_sec == b.tv_sec && a.tv_usec < b.tv_usec);
+}
+
+static inline struct timeval ts_add(const struct timeval &a, const struct timeval &b)
+{
+   struct timeval res = {a.tv_sec + b.tv_sec, a.tv_usec + b.tv_usec};
+   if (res.tv_usec >= 1000000) {
+      res.tv_usec -= 1000000;
+      res.tv_sec++;
+   }
+   return res;
+}
+
+static inline struct timeval ts_sub(const struct timeval &a, const struct timeval &b)
+{
+   struct timeval res = {a.tv_sec - b.tv_sec, a.tv_usec - b.tv_usec};
+   if (res.tv_usec < 0) {
+      res.tv_usec += 1000000;
+      res.tv_sec--;
+   }
+   return res;
+}
+
+ReplayReader::ReplayReader() : m_mem(nullptr), m_mem_size(0), m_pkts(), m_loops(1), m_loop(0), m_idx(0),
+   m_wall_ts(false), m_rewrite(false), m_ts_offset({0}), m_ts_span({0})
+{
+}
+
+ReplayReader::~ReplayReader()
+{
+   close();
+}
+
+void ReplayReader::init(const char *params)
+{
+   ReplayOptParser parser;
+   try {
+      parser.parse(params);
+   } catch (ParserError &e) {
+      throw PluginError(e.what());
+   }
+
+   if (parser.m_files.empty()) {
+      throw PluginError("specify at least one pcap file path");
+   }
+
+   m_loops = parser.m_loops;
+   m_wall_ts = parser.m_ts == "wall";
+   m_rewrite = parser.m_rewrite;
+
+   size_t total = 0;
+   for (const auto &file : parser.m_files) {
+      struct stat st;
+      if (stat(file.c_str(), &st) == -1) {
+         throw PluginError("unable to open file " + file + ": " + strerror(errno));
+      }
+      total += st.st_size;
+   }
+   alloc_mem(total, parser.m_hugepages);
+
+   size_t offset = 0;
+   for (const auto &file : parser.m_files) {
+      offset += load_file(file, offset);
+   }
+   if (m_pkts.empty()) {
+      throw PluginError("no packets found in input files");
+   }
+
+   // Multiple files are merged into one capture ordered by timestamps
+   std::stable_sort(m_pkts.begin(), m_pkts.end(), [](const ReplayPacket &a, const ReplayPacket &b) {
+      return ts_less(a.ts, b.ts);
+   });
+   m_ts_span = ts_add(ts_sub(m_pkts.back().ts, m_pkts.front().ts), {0, 1});
+
+   m_loop = 0;
+   start_loop();
+}
+
+void ReplayReader::close()
+{
+   if (m_mem != nullptr) {
+      munmap(m_mem, m_mem_size);
+      m_mem = nullptr;
+      m_mem_size = 0;
+   }
+   m_pkts.clear();
+}
+
+void ReplayReader::alloc_mem(size_t size, bool hugepages)
+{
+   void *mem = MAP_FAILED;
+
+   if (size == 0) {
+      size = 1;
+   }
+   if (hugepages) {
+      size_t hsize = (size + HUGEPAGE_SIZE - 1) & ~(static_cast<size_t>(HUGEPAGE_SIZE) - 1);
+      mem = mmap(nullptr, hsize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (mem != MAP_FAILED) {
+         m_mem_size = hsize;
+      } else {
+         std::cerr << "replay: unable to allocate hugepages (" << strerror(errno) << "), using regular pages" << std::endl;
+      }
+   }
+   if (mem == MAP_FAILED) {
+      mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (mem == MAP_FAILED) {
+         throw PluginError(std::string("not enough memory to preload pcap files: ") + strerror(errno));
+      }
+      m_mem_size = size;
+#ifdef MADV_HUGEPAGE
+      if (hugepages) {
+         madvise(mem, size, MADV_HUGEPAGE);
+      }
+#endif
+   }
+   m_mem = static_cast<uint8_t *>(mem);
+}
+
+size_t ReplayReader::load_file(const std::string &file, size_t offset)
+{
+   int fd = open(file.c_str(), O_RDONLY);
+   if (fd == -1) {
+      throw PluginError("unable to open file " + file + ": " + strerror(errno));
+   }
+
+   uint8_t *data = m_mem + offset;
+   size_t size = 0;
+   while (offset + size < m_mem_size) {
+      ssize_t ret = read(fd, data + size, m_mem_size - offset - size);
+      if (ret < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         ::close(fd);
+         throw PluginError("unable to read file " + file + ": " + strerror(errno));
+      } else if (ret == 0) {
+         break;
+      }
+      size += ret;
+   }
+   ::close(fd);
+
+   PcapFileParser parser(file, data, size);
+   PcapFilePacket pkt;
+   while (parser.next(pkt)) {
+      add_packet(pkt.data, pkt.ts, pkt.len, pkt.caplen, pkt.datalink);
+   }
+
+   return size;
+}
+
+void ReplayReader::add_packet(const uint8_t *data, struct timeval ts, uint32_t len, uint32_t caplen, int datalink)
+{
+   ReplayPacket pkt;
+   pkt.data = data;
+   pkt.ts = ts;
+   pkt.caplen = caplen > MAX_PACKET_LEN ? MAX_PACKET_LEN : caplen;
+   pkt.len = len > MAX_PACKET_LEN ? MAX_PACKET_LEN : len;
+   pkt.datalink = datalink;
+   m_pkts.push_back(pkt);
+}
+
+void ReplayReader::start_loop()
+{
+   m_idx = 0;
+   if (m_wall_ts) {
+      struct timeval now;
+      gettimeofday(&now, nullptr);
+      m_ts_offset = ts_sub(now, m_pkts.front().ts);
+   } else {
+      // Keep timestamps monotonic when the capture is replayed again
+      m_ts_offset = {0, 0};
+      for (uint64_t i = 0; i < m_loop; i++) {
+         m_ts_offset = ts_add(m_ts_offset, m_ts_span);
+      }
+   }
+}
+
+void ReplayReader::rewrite(Packet &pkt) const
+{
+   // Same transformation is applied to both addresses, so both directions of a biflow stay paired
+   uint32_t mask = htonl(static_cast<uint32_t>(m_loop));
+   if (pkt.ip_version == IP::v4) {
+      pkt.src_ip.v4 ^= mask;
+      pkt.dst_ip.v4 ^= mask;
+   } else if (pkt.ip_version == IP::v6) {
+      reinterpret_cast<uint32_t *>(pkt.src_ip.v6)[3] ^= mask;
+      reinterpret_cast<uint32_t *>(pkt.dst_ip.v6)[3] ^= mask;
+   }
+}
+
+InputPlugin::Result ReplayReader::get(PacketBlock &packets)
+{
+   parser_opt_t opt = {&packets, false, false, DLT_EN10MB};
+   size_t seen = 0;
+
+   packets.cnt = 0;
+   packets.bytes = 0;
+   while (packets.cnt < packets.size) {
+      if (m_idx == m_pkts.size()) {
+         m_loop++;
+         if (m_loops != REPLAY_LOOPS_INF && m_loop >= m_loops) {
+            m_loop = m_loops;
+            break;
+         }
+         start_loop();
+      }
+
+      const ReplayPacket &rpkt = m_pkts[m_idx++];
+      size_t parsed = packets.cnt;
+      opt.datalink = rpkt.datalink;
+      parse_packet(&opt, ts_add(rpkt.ts, m_ts_offset), rpkt.data, rpkt.len, rpkt.caplen);
+      seen++;
+      if (m_rewrite && m_loop && packets.cnt > parsed) {
+         rewrite(packets.pkts[parsed]);
+      }
+   }
+
+   m_seen += seen;
+   m_parsed += packets.cnt;
+   if (packets.cnt) {
+      return Result::PARSED;
+   }
+   return seen ? Result::NOT_PARSED : Result::END_OF_FILE;
+}
+
+}
@@ -0,0 +1,132 @@
+/**
+ * \file replay.hpp
+ * \brief Input plugin replaying pcap files preloaded into memory
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef IPXP_INPUT_REPLAY_HPP
+#define IPXP_INPUT_REPLAY_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <sys/time.h>
+
+#include <ipfixprobe/input.hpp>
+#include <ipfixprobe/packet.hpp>
+#include <ipfixprobe/options.hpp>
+#include <ipfixprobe/utils.hpp>
+
+namespace ipxp {
+
+#define REPLAY_LOOPS_INF 0
+
+class ReplayOptParser : public OptionsParser
+{
+public:
+   std::vector<std::string> m_files;
+   uint64_t m_loops;
+   std::string m_ts;
+   bool m_rewrite;
+   bool m_hugepages;
+
+   ReplayOptParser() : OptionsParser("replay", "Input plugin for replaying pcap files preloaded into memory"),
+      m_files(), m_loops(1), m_ts("orig"), m_rewrite(false), m_hugepages(false)
+   {
+      register_option("f", "file", "PATH", "Path to a pcap or pcapng file, can be specified multiple times",
+         [this](const char *arg){m_files.push_back(arg); return true;}, OptionFlags::RequiredArgument);
+      register_option("n", "loops", "NUM", "Number of replay loops, 0 replays forever (default 1)",
+         [this](const char *arg){try {m_loops = str2num<decltype(m_loops)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("t", "ts", "STR", "Timestamps mode orig (original, shifted by capture length each loop) or wall (rebased to wall clock)",
+         [this](const char *arg){m_ts = arg; return m_ts == "orig" || m_ts == "wall";}, OptionFlags::RequiredArgument);
+      register_option("r", "rewrite", "", "Rewrite IP addresses in every loop so each loop creates new flows",
+         [this](const char *arg){m_rewrite = true; return true;}, OptionFlags::NoArgument);
+      register_option("H", "hugepages", "", "Preload packets into hugepage backed memory",
+         [this](const char *arg){m_hugepages = true; return true;}, OptionFlags::NoArgument);
+   }
+};
+
+/**
+ * \brief Class replaying packets from pcap files loaded into memory.
+ */
+class ReplayReader : public InputPlugin
+{
+public:
+   ReplayReader();
+   ~ReplayReader();
+
+   void init(const char *params);
+   void close();
+   OptionsParser *get_parser() const { return new ReplayOptParser(); }
+   std::string get_name() const { return "replay"; }
+   InputPlugin::Result get(PacketBlock &packets);
+
+private:
+   struct ReplayPacket {
+      const uint8_t *data;
+      struct timeval ts;
+      uint16_t len;
+      uint16_t caplen;
+      int datalink;
+   };
+
+   uint8_t *m_mem;           /**< Memory region with content of all pcap files */
+   size_t m_mem_size;
+   std::vector<ReplayPacket> m_pkts;
+
+   uint64_t m_loops;
+   uint64_t m_loop;
+   size_t m_idx;
+   bool m_wall_ts;
+   bool m_rewrite;
+
+   struct timeval m_ts_offset; /**< Offset added to timestamps in current loop */
+   struct timeval m_ts_span;   /**< Time between first and last packet of loaded files */
+
+   void alloc_mem(size_t size, bool hugepages);
+   size_t load_file(const std::string &file, size_t offset);
+   void add_packet(const uint8_t *data, struct timeval ts, uint32_t len, uint32_t caplen, int datalink);
+   void start_loop();
+   void rewrite(Packet &pkt) const;
+};
+
+}
+#endif /* IPXP_INPUT_REPLAY_HPP */
@@ -0,0 +1,452 @@
+/**
+ * \file rss.cpp
+ * \brief Input plugin distributing packets of pcap files to multiple pipelines by flow hash
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <config.h>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "rss.hpp"
+#include "parser.hpp"
+#include "headers.hpp"
+#include "../storage/xxhash.h"
+
+namespace ipxp {
+
+#define MAX_PACKET_LEN 65535
+
+__attribute__((constructor)) static void register_this_plugin()
+{
+   static PluginRecord rec = PluginRecord("rss", [](){return new RssReader();});
+   register_plugin(&rec);
+}
+
+RssCore *RssCore::m_instance = nullptr;
+size_t RssCore::m_refs = 0;
+std::mutex RssCore::m_lock;
+
+static inline uint16_t read_u16(const uint8_t *ptr)
+{
+   return (ptr[0] << 8) | ptr[1];
+}
+
+static inline uint64_t endpoint_hash(const uint8_t *ip, size_t ip_len, const uint8_t *port)
+{
+   uint8_t key[18];
+   memcpy(key, ip, ip_len);
+   if (port != nullptr) {
+      memcpy(key + ip_len, port, 2);
+   } else {
+      memset(key + ip_len, 0, 2);
+   }
+   return XXH64(key, ip_len + 2, 0);
+}
+
+/**
+ * \brief Compute hash of packet flow key which is equal for both directions of a biflow.
+ * \param [in] pkt Packet record.
+ * \return Hash value, 0 for packets without IP header.
+ */
+static uint64_t rss_hash(const PcapFilePacket &pkt)
+{
+   const uint8_t *ptr = pkt.data;
+   const uint8_t *end = pkt.data + pkt.caplen;
+   uint16_t ethertype = 0;
+
+   if (pkt.datalink == DLT_EN10MB) {
+      if (pkt.caplen < 14) {
+         return 0;
+      }
+      ethertype = read_u16(ptr + 12);
+      ptr += 14;
+   } else if (pkt.datalink == DLT_LINUX_SLL) {
+      if (pkt.caplen < 16) {
+         return 0;
+      }
+      ethertype = read_u16(ptr + 14);
+      ptr += 16;
+#ifdef DLT_LINUX_SLL2
+   } else if (pkt.datalink == DLT_LINUX_SLL2) {
+      if (pkt.caplen < 20) {
+         return 0;
+      }
+      ethertype = read_u16(ptr);
+      ptr += 20;
+#endif /* DLT_LINUX_SLL2 */
+   } else if (pkt.datalink == DLT_RAW && pkt.caplen > 0) {
+      ethertype = (ptr[0] >> 4) == 6 ? ETH_P_IPV6 : ETH_P_IP;
+   }
+
+   while ((ethertype == ETH_P_8021Q || ethertype == ETH_P_8021AD) && ptr + 4 <= end) {
+      ethertype = read_u16(ptr + 2);
+      ptr += 4;
+   }
+   if (ethertype == ETH_P_MPLS_UC || ethertype == ETH_P_MPLS_MC) {
+      bool bottom = false;
+      while (!bottom && ptr + 4 <= end) {
+         bottom = ptr[2] & 0x01;
+         ptr += 4;
+      }
+      if (ptr >= end) {
+         return 0;
+      }
+      ethertype = (ptr[0] >> 4) == 6 ? ETH_P_IPV6 : ETH_P_IP;
+   } else if (ethertype == ETH_P_PPP_SES) {
+      if (ptr + 8 > end) {
+         return 0;
+      }
+      uint16_t proto = read_u16(ptr + 6);
+      ethertype = proto == 0x0021 ? ETH_P_IP : (proto == 0x0057 ? ETH_P_IPV6 : 0);
+      ptr += 8;
+   }
+
+   const uint8_t *src_ip;
+   const uint8_t *dst_ip;
+   const uint8_t *l4 = nullptr;
+   size_t ip_len;
+   uint8_t proto;
+
+   if (ethertype == ETH_P_IP) {
+      if (ptr + 20 > end) {
+         return 0;
+      }
+      size_t ihl = (ptr[0] & 0x0F) * 4;
+      bool first_frag = (read_u16(ptr + 6) & 0x1FFF) == 0;
+      proto = ptr[9];
+      src_ip = ptr + 12;
+      dst_ip = ptr + 16;
+      ip_len = 4;
+      if (first_frag && ihl >= 20) {
+         l4 = ptr + ihl;
+      }
+   } else if (ethertype == ETH_P_IPV6) {
+      if (ptr + 40 > end) {
+         return 0;
+      }
+      proto = ptr[6];
+      src_ip = ptr + 8;
+      dst_ip = ptr + 24;
+      ip_len = 16;
+      l4 = ptr + 40;
+   } else {
+      return 0;
+   }
+
+   const uint8_t *src_port = nullptr;
+   const uint8_t *dst_port = nullptr;
+   if (l4 != nullptr && l4 + 4 <= end &&
+      (proto == IPPROTO_TCP || proto == IPPROTO_UDP || proto == IPPROTO_SCTP)) {
+      src_port = l4;
+      dst_port = l4 + 2;
+   }
+
+   // Sum is commutative, so swapping source and destination gives the same value
+   uint64_t hash = endpoint_hash(src_ip, ip_len, src_port) + endpoint_hash(dst_ip, ip_len, dst_port);
+   return hash ^ (static_cast<uint64_t>(proto) * 0x9E3779B97F4A7C15ULL);
+}
+
+RssCore &RssCore::get_instance()
+{
+   std::lock_guard<std::mutex> guard(m_lock);
+   if (m_instance == nullptr) {
+      m_instance = new RssCore();
+   }
+   m_refs++;
+   return *m_instance;
+}
+
+void RssCore::put_instance()
+{
+   std::lock_guard<std::mutex> guard(m_lock);
+   if (m_refs && --m_refs == 0) {
+      delete m_instance;
+      m_instance = nullptr;
+   }
+}
+
+RssCore::RssCore() : m_configured(false), m_files(), m_queues(), m_attached(0), m_batch(RSS_DEFAULT_BATCH), m_stop(false)
+{
+}
+
+RssCore::~RssCore()
+{
+   m_stop = true;
+   if (m_dispatcher.joinable()) {
+      m_dispatcher.join();
+   }
+   for (auto &it : m_queues) {
+      delete it;
+   }
+   for (auto &it : m_files) {
+      munmap(it.data, it.size);
+   }
+}
+
+void RssCore::configure(const char *params)
+{
+   std::lock_guard<std::mutex> guard(m_lock);
+   if (m_configured) {
+      return;
+   }
+
+   RssOptParser parser;
+   try {
+      parser.parse(params);
+   } catch (ParserError &e) {
+      throw PluginError(e.what());
+   }
+   if (parser.m_files.empty()) {
+      throw PluginError("specify at least one pcap file path in the first rss input plugin");
+   }
+
+   for (const auto &it : parser.m_files) {
+      map_file(it);
+   }
+   m_batch = parser.m_batch;
+
+   RssSlice slice;
+   slice.pkts.resize(m_batch);
+   slice.cnt = 0;
+   slice.eof = false;
+   for (uint16_t i = 0; i < parser.m_queues; i++) {
+      m_queues.push_back(new SpscRing<RssSlice>(parser.m_slices, slice));
+   }
+   m_configured = true;
+}
+
+void RssCore::map_file(const std::string &file)
+{
+   struct stat st;
+   int fd = open(file.c_str(), O_RDONLY);
+   if (fd == -1) {
+      throw PluginError("unable to open file " + file + ": " + strerror(errno));
+   }
+   if (fstat(fd, &st) == -1 || st.st_size == 0) {
+      ::close(fd);
+      throw PluginError("unable to read file " + file);
+   }
+
+   void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   ::close(fd);
+   if (data == MAP_FAILED) {
+      throw PluginError("unable to map file " + file + ": " + strerror(errno));
+   }
+   madvise(data, st.st_size, MADV_SEQUENTIAL);
+   m_files.push_back({file, static_cast<uint8_t *>(data), static_cast<size_t>(st.st_size)});
+}
+
+size_t RssCore::attach_queue()
+{
+   std::lock_guard<std::mutex> guard(m_lock);
+   if (m_attached == m_queues.size()) {
+      throw PluginError("all " + std::to_string(m_queues.size()) + " rss queues are already used, increase number of queues");
+   }
+
+   size_t id = m_attached++;
+   if (m_attached == m_queues.size()) {
+      // Every queue has its reader, start reading files
+      m_dispatcher = std::thread(&RssCore::dispatch, this);
+   }
+   return id;
+}
+
+size_t RssCore::pending_queues() const
+{
+   std::lock_guard<std::mutex> guard(m_lock);
+   return m_queues.size() - m_attached;
+}
+
+SpscRing<RssSlice> *RssCore::get_queue(size_t id)
+{
+   return m_queues[id];
+}
+
+std::string RssCore::get_error() const
+{
+   return m_error;
+}
+
+RssSlice *RssCore::acquire_slice(size_t queue)
+{
+   RssSlice *slice;
+   while ((slice = m_queues[queue]->acquire()) == nullptr) {
+      if (m_stop) {
+         return nullptr;
+      }
+      usleep(1);
+   }
+   slice->cnt = 0;
+   slice->eof = false;
+   return slice;
+}
+
+bool RssCore::commit_batch(std::vector<RssSlice *> &slices, bool eof)
+{
+   for (size_t i = 0; i < slices.size(); i++) {
+      if (slices[i] == nullptr) {
+         slices[i] = acquire_slice(i);
+         if (slices[i] == nullptr) {
+            return false;
+         }
+      }
+      slices[i]->eof = eof;
+      m_queues[i]->commit();
+      slices[i] = nullptr;
+   }
+   return true;
+}
+
+void RssCore::dispatch()
+{
+   std::vector<RssSlice *> slices(m_queues.size(), nullptr);
+   size_t queues = m_queues.size();
+   uint32_t batch = 0;
+
+   try {
+      for (const auto &file : m_files) {
+         PcapFileParser parser(file.name, file.data, file.size);
+         PcapFilePacket pkt;
+
+         while (parser.next(pkt)) {
+            size_t queue = rss_hash(pkt) % queues;
+            if (slices[queue] == nullptr) {
+               slices[queue] = acquire_slice(queue);
+               if (slices[queue] == nullptr) {
+                  return;
+               }
+            }
+            slices[queue]->pkts[slices[queue]->cnt++] = pkt;
+
+            if (++batch == m_batch) {
+               if (!commit_batch(slices, false)) {
+                  return;
+               }
+               batch = 0;
+            }
+         }
+      }
+   } catch (PluginError &e) {
+      m_error = e.what();
+   }
+   commit_batch(slices, true);
+}
+
+RssReader::RssReader() : m_core(nullptr), m_queue(nullptr), m_idx(0), m_eof(false)
+{
+}
+
+RssReader::~RssReader()
+{
+   close();
+}
+
+void RssReader::init(const char *params)
+{
+   m_core = &RssCore::get_instance();
+   m_core->configure(params);
+   m_queue = m_core->get_queue(m_core->attach_queue());
+}
+
+size_t RssReader::pending_queues() const
+{
+   return m_core != nullptr ? m_core->pending_queues() : 0;
+}
+
+void RssReader::close()
+{
+   if (m_core != nullptr) {
+      RssCore::put_instance();
+      m_core = nullptr;
+      m_queue = nullptr;
+   }
+}
+
+InputPlugin::Result RssReader::get(PacketBlock &packets)
+{
+   parser_opt_t opt = {&packets, false, false, DLT_EN10MB};
+   size_t seen = 0;
+
+   packets.cnt = 0;
+   packets.bytes = 0;
+   if (m_eof) {
+      return Result::END_OF_FILE;
+   }
+
+   RssSlice *slice = m_queue->front();
+   if (slice == nullptr) {
+      return Result::TIMEOUT;
+   }
+
+   while (m_idx < slice->cnt && packets.cnt < packets.size) {
+      const PcapFilePacket &pkt = slice->pkts[m_idx++];
+      opt.datalink = pkt.datalink;
+      parse_packet(&opt, pkt.ts, pkt.data,
+         pkt.len > MAX_PACKET_LEN ? MAX_PACKET_LEN : pkt.len,
+         pkt.caplen > MAX_PACKET_LEN ? MAX_PACKET_LEN : pkt.caplen);
+      seen++;
+   }
+   if (m_idx == slice->cnt) {
+      m_eof = slice->eof;
+      m_idx = 0;
+      m_queue->release();
+   }
+
+   m_seen += seen;
+   m_parsed += packets.cnt;
+   if (m_eof) {
+      std::string err = m_core->get_error();
+      if (!err.empty()) {
+         throw PluginError(err);
+      }
+      if (packets.cnt == 0) {
+         return Result::END_OF_FILE;
+      }
+   }
+   return Result::PARSED;
+}
+
+}
@@ -0,0 +1,173 @@
+/**
+ * \file rss.hpp
+ * \brief Input plugin distributing packets of pcap files to multiple pipelines by flow hash
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef IPXP_INPUT_RSS_HPP
+#define IPXP_INPUT_RSS_HPP
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <cstdint>
+
+#include <ipfixprobe/input.hpp>
+#include <ipfixprobe/packet.hpp>
+#include <ipfixprobe/options.hpp>
+#include <ipfixprobe/utils.hpp>
+#include <ipfixprobe/spsc.hpp>
+
+#include "pcap-file.hpp"
+
+namespace ipxp {
+
+#define RSS_DEFAULT_QUEUES 1
+#define RSS_DEFAULT_BATCH  64
+#define RSS_DEFAULT_SLICES 1024
+
+class RssOptParser : public OptionsParser
+{
+public:
+   std::vector<std::string> m_files;
+   uint16_t m_queues;
+   uint32_t m_batch;
+   uint32_t m_slices;
+
+   RssOptParser() : OptionsParser("rss", "Input plugin distributing packets of pcap files to multiple pipelines by symmetric flow hash"),
+      m_files(), m_queues(RSS_DEFAULT_QUEUES), m_batch(RSS_DEFAULT_BATCH), m_slices(RSS_DEFAULT_SLICES)
+   {
+      register_option("f", "file", "PATH", "Path to a pcap or pcapng file, can be specified multiple times, files are read in the given order",
+         [this](const char *arg){m_files.push_back(arg); return true;}, OptionFlags::RequiredArgument);
+      register_option("q", "queues", "NUM", "Number of queues, every queue has to be read by one rss input plugin",
+         [this](const char *arg){try {m_queues = str2num<decltype(m_queues)>(arg);} catch(std::invalid_argument &e) {return false;} return m_queues != 0;},
+         OptionFlags::RequiredArgument);
+      register_option("b", "batch", "NUM", "Number of packets dispatched at once, must not exceed input queue size (default 64)",
+         [this](const char *arg){try {m_batch = str2num<decltype(m_batch)>(arg);} catch(std::invalid_argument &e) {return false;} return m_batch != 0;},
+         OptionFlags::RequiredArgument);
+      register_option("s", "size", "NUM", "Number of batches buffered by every queue (default 1024)",
+         [this](const char *arg){try {m_slices = str2num<decltype(m_slices)>(arg);} catch(std::invalid_argument &e) {return false;} return m_slices != 0;},
+         OptionFlags::RequiredArgument);
+   }
+};
+
+/**
+ * \brief Part of one dispatched batch belonging to one queue.
+ */
+struct RssSlice {
+   std::vector<PcapFilePacket> pkts;
+   size_t cnt;
+   bool eof;  /**< Last slice of the queue */
+};
+
+/**
+ * \brief Reader of pcap files shared by all rss input plugins.
+ *
+ * Dispatcher thread reads files one by one and sends every packet to queue selected by symmetric hash
+ * of its flow key, so both directions of a biflow are processed by the same pipeline. Packets are
+ * dispatched in batches of fixed size and every queue receives exactly one (possibly empty) slice of
+ * every batch. Pipelines therefore process the files in lockstep and export flows in deterministic order.
+ * Packet data are not copied, they point directly into memory mapped files.
+ */
+class RssCore
+{
+public:
+   static RssCore &get_instance();
+   static void put_instance();
+
+   void configure(const char *params);
+   size_t attach_queue();
+   size_t pending_queues() const;
+   SpscRing<RssSlice> *get_queue(size_t id);
+   std::string get_error() const;
+
+private:
+   static RssCore *m_instance;
+   static size_t m_refs;
+   static std::mutex m_lock;
+
+   struct MappedFile {
+      std::string name;
+      uint8_t *data;
+      size_t size;
+   };
+
+   bool m_configured;
+   std::vector<MappedFile> m_files;
+   std::vector<SpscRing<RssSlice> *> m_queues;
+   size_t m_attached;
+   uint32_t m_batch;
+   std::thread m_dispatcher;
+   std::atomic<bool> m_stop;
+   std::string m_error;
+
+   RssCore();
+   ~RssCore();
+   void map_file(const std::string &file);
+   void dispatch();
+   RssSlice *acquire_slice(size_t queue);
+   bool commit_batch(std::vector<RssSlice *> &slices, bool eof);
+};
+
+class RssReader : public InputPlugin
+{
+public:
+   RssReader();
+   ~RssReader();
+
+   void init(const char *params);
+   void close();
+   OptionsParser *get_parser() const { return new RssOptParser(); }
+   std::string get_name() const { return "rss"; }
+   bool ordered() const { return true; }
+   size_t pending_queues() const;
+   InputPlugin::Result get(PacketBlock &packets);
+
+private:
+   RssCore *m_core;
+   SpscRing<RssSlice> *m_queue;
+   size_t m_idx;   /**< Index of next packet of current slice */
+   bool m_eof;
+};
+
+}
+#endif /* IPXP_INPUT_RSS_HPP */
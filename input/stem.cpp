@@ -47,6 +47,7 @@
 #include <packet-reader.h>
 
 #include "stem.hpp"
+#include "parser.hpp"
 
 namespace ipxp {
 
@@ -163,11 +164,13 @@ bool StemPacketReader::convert(Stem::StatisticsPacket &stem_pkt, Packet &pkt)
    }
    pkt.payload_len_wire = raw_hwdata->size() - hwdata.size();
 
+   pkt.meta = PKT_META_FLOW | PKT_META_TCP | PKT_META_PAYLOAD;
    return true;
 }
 
 InputPlugin::Result StemPacketReader::get(PacketBlock &packets)
 {
+   parser_opt_t opt = {&packets, false, false, 0};
    packets.cnt = 0;
    packets.bytes = 0;
    while (packets.cnt < STEM_PACKET_BLOCK_SIZE) {
@@ -181,13 +184,11 @@ InputPlugin::Result StemPacketReader::get(PacketBlock &packets)
          } else {
             Stem::StatisticsPacket spkt = std::move(pkt.value());
             bool status = convert(spkt, packets.pkts[packets.cnt]);
-            packets.bytes += packets.pkts[packets.cnt].packet_len_wire;
 
             m_seen += 1;
-            if (!status) {
+            if (!status || !parse_packet_meta(&opt, nullptr, 0, 0)) {
                continue;
             }
-            packets.cnt++;
             m_parsed += 1;
          }
       } catch (Stem::Exceptions::Readers::ReadError &e) {
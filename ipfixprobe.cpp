@@ -70,6 +70,7 @@ volatile sig_atomic_t terminate_input = 0;
 const uint32_t DEFAULT_IQUEUE_SIZE = 64;
 const uint32_t DEFAULT_OQUEUE_SIZE = 16536;
 const uint32_t DEFAULT_FPS = 0; // unlimited
+const uint32_t DEFAULT_DQUEUE_SIZE = 4096;
 
 /**
  * \brief Signal handler function.
@@ -134,6 +135,9 @@ void print_help(ipxp_conf_t &conf, const std::string &arg)
       print_plugins_help<OutputPlugin>(*plugins);
    } else if (arg == "process") {
       print_plugins_help<ProcessPlugin>(*plugins);
+   } else if (arg == "overload") {
+      OverloadOptParser parser;
+      parser.usage(std::cout);
    } else {
       Plugin *p;
       try {
@@ -167,6 +171,21 @@ void process_plugin_argline(const std::string &args, std::string &plugin, std::s
    trim_str(params);
 }
 
+static bool is_ordered_input(ipxp_conf_t &conf, const std::string &name)
+{
+   Plugin *plugin = nullptr;
+   try {
+      plugin = conf.mgr.get(name);
+   } catch (PluginManagerError &e) {
+      // Reported when the input plugin is initialized
+      return false;
+   }
+   InputPlugin *input_plugin = dynamic_cast<InputPlugin *>(plugin);
+   bool ordered = input_plugin != nullptr && input_plugin->ordered();
+   delete plugin;
+   return ordered;
+}
+
 bool process_plugin_args(ipxp_conf_t &conf, IpfixprobeOptParser &parser)
 {
    auto deleter = [&](OutputPlugin::Plugins *p) {
@@ -236,6 +255,9 @@ bool process_plugin_args(ipxp_conf_t &conf, IpfixprobeOptParser &parser)
       }
 
       output_plugin->init(output_params.c_str(), *process_plugins);
+      if (!conf.overload.empty()) {
+         output_plugin->set_overload_control();
+      }
       conf.active.output.push_back(output_plugin);
       conf.active.all.push_back(output_plugin);
    } catch (PluginError &e) {
@@ -250,29 +272,76 @@ bool process_plugin_args(ipxp_conf_t &conf, IpfixprobeOptParser &parser)
       throw IPXPError(output_name + std::string(": ") + e.what());
    }
 
+   // Ordered pipelines export to separate queues, which have to be known before output worker starts
+   std::vector<ipx_ring_t *> ordered_queues;
+   for (auto &it : parser.m_input) {
+      std::string input_params;
+      std::string input_name;
+      process_plugin_argline(it, input_name, input_params);
+      if (!is_ordered_input(conf, input_name)) {
+         continue;
+      }
+      ipx_ring_t *ordered_queue = ipx_ring_init(conf.oqueue_size, 0);
+      if (ordered_queue == nullptr) {
+         for (auto &itq : ordered_queues) {
+            ipx_ring_destroy(itq);
+         }
+         ipx_ring_destroy(output_queue);
+         throw IPXPError("unable to initialize ring buffer");
+      }
+      ordered_queues.push_back(ordered_queue);
+   }
+   if (!ordered_queues.empty() && ordered_queues.size() != parser.m_input.size()) {
+      for (auto &itq : ordered_queues) {
+         ipx_ring_destroy(itq);
+      }
+      ipx_ring_destroy(output_queue);
+      throw IPXPError("ordered input plugins cannot be combined with other input plugins");
+   }
+
+   ExportFilter *export_filter = nullptr;
+   if (!conf.export_filter.empty()) {
+      try {
+         export_filter = new ExportFilter(conf.export_filter, *process_plugins);
+      } catch (PluginError &e) {
+         for (auto &itq : ordered_queues) {
+            ipx_ring_destroy(itq);
+         }
+         ipx_ring_destroy(output_queue);
+         throw IPXPError(std::string("export filter: ") + e.what());
+      }
+   }
+
    {
       std::promise<WorkerResult> *output_res = new std::promise<WorkerResult>();
       auto output_stats = new std::atomic<OutputStats>();
       conf.output_stats.push_back(output_stats);
       OutputWorker tmp = {
               output_plugin,
-              new std::thread(output_worker, output_plugin, output_queue, output_res, output_stats, conf.fps),
+              new std::thread(output_worker, output_plugin, output_queue, ordered_queues, output_res, output_stats, conf.fps,
+                 export_filter),
               output_res,
               output_stats,
-              output_queue
+              output_queue,
+              ordered_queues,
+              export_filter
       };
       conf.outputs.push_back(tmp);
       conf.output_fut.push_back(output_res->get_future());
    }
 
+   // Members of the plugin chain compiled in are called through the chain
+   std::unique_ptr<ProcessPlugin> plugin_chain(create_plugin_chain(*process_plugins));
+
    // Input
-   size_t pipeline_idx = 0;
-   for (auto &it : parser.m_input) {
+   std::vector<std::string> inputs = parser.m_input;
+   for (size_t pipeline_idx = 0; pipeline_idx < inputs.size(); pipeline_idx++) {
       InputPlugin *input_plugin = nullptr;
       StoragePlugin *storage_plugin = nullptr;
+      ipx_ring_t *ordered_queue = nullptr;
       std::string input_params;
       std::string input_name;
-      process_plugin_argline(it, input_name, input_params);
+      process_plugin_argline(inputs[pipeline_idx], input_name, input_params);
 
       try {
          input_plugin = dynamic_cast<InputPlugin *>(conf.mgr.get(input_name));
@@ -292,13 +361,37 @@ bool process_plugin_args(ipxp_conf_t &conf, IpfixprobeOptParser &parser)
          throw IPXPError(input_name + std::string(": ") + e.what());
       }
 
+      // Spawn pipelines for queues not claimed by following inputs of the same plugin
+      std::string next_name;
+      std::string next_params;
+      if (pipeline_idx + 1 < inputs.size()) {
+         process_plugin_argline(inputs[pipeline_idx + 1], next_name, next_params);
+      }
+      if (next_name != input_name) {
+         size_t pending = input_plugin->pending_queues();
+         if (pending && !ordered_queues.empty()) {
+            // Export queues of ordered pipelines were created for inputs given on command line
+            throw IPXPError(input_name + ": " + std::to_string(pending) + " queues have no input plugin, specify one input plugin per queue");
+         }
+         inputs.insert(inputs.begin() + pipeline_idx + 1, pending, input_name);
+      }
+
+      if (!ordered_queues.empty()) {
+         ordered_queue = ordered_queues[pipeline_idx];
+      }
+
       try {
          storage_plugin = dynamic_cast<StoragePlugin *>(conf.mgr.get(storage_name));
          if (storage_plugin == nullptr) {
             throw IPXPError("invalid storage plugin " + storage_name);
          }
-         storage_plugin->set_queue(output_queue);
+         storage_plugin->set_queue(ordered_queue != nullptr ? ordered_queue : output_queue);
          storage_plugin->init(storage_params.c_str());
+         uint32_t interval;
+         SamplingMode mode = storage_plugin->get_sampling(interval);
+         if (mode != SamplingMode::NONE) {
+            output_plugin->set_sampling(pipeline_idx, mode, interval);
+         }
          conf.active.storage.push_back(storage_plugin);
          conf.active.all.push_back(storage_plugin);
       } catch (PluginError &e) {
@@ -312,13 +405,33 @@ bool process_plugin_args(ipxp_conf_t &conf, IpfixprobeOptParser &parser)
       }
 
       std::vector<ProcessPlugin *> storage_process_plugins;
+      bool chain_added = false;
       for (auto &it : *process_plugins) {
-         ProcessPlugin *tmp = it.second->copy();
+         ProcessPlugin *tmp = nullptr;
+         if (plugin_chain != nullptr && plugin_chain_member(it.second)) {
+            if (chain_added) {
+               continue;
+            }
+            tmp = plugin_chain->copy();
+            chain_added = true;
+         } else {
+            tmp = it.second->copy();
+         }
          storage_plugin->add_plugin(tmp);
          conf.active.process.push_back(tmp);
          conf.active.all.push_back(tmp);
          storage_process_plugins.push_back(tmp);
       }
+      storage_plugin->set_dpi_workers(conf.dpi_workers, DEFAULT_DQUEUE_SIZE, conf.pkt_bufsize);
+
+      OverloadControl *overload = nullptr;
+      if (!conf.overload.empty()) {
+         try {
+            overload = new OverloadControl(conf.overload, storage_plugin, output_plugin, pipeline_idx);
+         } catch (PluginError &e) {
+            throw IPXPError(std::string("overload: ") + e.what());
+         }
+      }
 
       std::promise<WorkerResult> *input_res = new std::promise<WorkerResult>();
       conf.input_fut.push_back(input_res->get_future());
@@ -330,17 +443,17 @@ bool process_plugin_args(ipxp_conf_t &conf, IpfixprobeOptParser &parser)
          {
             input_plugin,
             new std::thread(input_storage_worker, input_plugin, storage_plugin, conf.iqueue_size, 
-               conf.max_pkts, input_res, input_stats),
+               conf.max_pkts, input_res, input_stats, ordered_queue, overload),
             input_res,
             input_stats
          },
          {
             storage_plugin,
-            storage_process_plugins
+            storage_process_plugins,
+            overload
          }
       };
       conf.pipelines.push_back(tmp);
-      pipeline_idx++;
    }
 
    return false;
@@ -368,6 +481,9 @@ void finish(ipxp_conf_t &conf)
    terminate_export = 1;
    for (auto &it : conf.outputs) {
       it.thread->join();
+      if (it.filter != nullptr) {
+         it.filter->print_stats();
+      }
    }
 
    for (auto &it : conf.pipelines) {
@@ -449,6 +565,20 @@ void serve_stat_clients(ipxp_conf_t &conf, struct pollfd pfds[2])
          close(pfds[1].fd);
          pfds[1].fd = -1;
       } else {
+         if (*((uint32_t *) buffer) == MSG_RESIZE) {
+            // Received flow cache resize request from client
+            uint32_t accepted = 0;
+            if (recv_data(pfds[1].fd, sizeof(uint32_t), buffer) == 0) {
+               uint32_t exponent = *((uint32_t *) buffer);
+               for (auto &it : conf.pipelines) {
+                  if (exponent < 32 && it.storage.plugin->resize(static_cast<uint32_t>(1) << exponent)) {
+                     accepted++;
+                  }
+               }
+               send_data(pfds[1].fd, sizeof(accepted), &accepted);
+            }
+            return;
+         }
          if (*((uint32_t *) buffer) != MSG_MAGIC) {
             return;
          }
@@ -613,6 +743,9 @@ int run(int argc, char *argv[])
    conf.fps = parser.m_fps;
    conf.pkt_bufsize = parser.m_pkt_bufsize;
    conf.max_pkts = parser.m_max_pkts;
+   conf.dpi_workers = parser.m_dpi_workers;
+   conf.overload = parser.m_overload;
+   conf.export_filter = parser.m_export_filter;
 
    try {
       if (process_plugin_args(conf, parser)) {
@@ -55,6 +55,7 @@
 #include <ipfixprobe/storage.hpp>
 #include <ipfixprobe/output.hpp>
 #include <ipfixprobe/process.hpp>
+#include <ipfixprobe/plugin-chain.hpp>
 #include <ipfixprobe/plugin.hpp>
 #include <ipfixprobe/packet.hpp>
 #include <ipfixprobe/options.hpp>
@@ -68,6 +69,7 @@ namespace ipxp {
 extern const uint32_t DEFAULT_IQUEUE_SIZE;
 extern const uint32_t DEFAULT_OQUEUE_SIZE;
 extern const uint32_t DEFAULT_FPS;
+extern const uint32_t DEFAULT_DQUEUE_SIZE;
 
 // global termination variable
 extern volatile sig_atomic_t terminate_export;
@@ -91,6 +93,7 @@ public:
    std::vector<std::string> m_storage;
    std::vector<std::string> m_output;
    std::vector<std::string> m_process;
+   std::vector<std::string> m_export_filter;
    std::string m_pid;
    bool m_daemon;
    uint32_t m_iqueue;
@@ -98,6 +101,8 @@ public:
    uint32_t m_fps;
    uint32_t m_pkt_bufsize;
    uint32_t m_max_pkts;
+   uint32_t m_dpi_workers;
+   std::string m_overload;
    bool m_help;
    std::string m_help_str;
    bool m_version;
@@ -105,7 +110,7 @@ public:
    IpfixprobeOptParser() : OptionsParser("ipfixprobe", "flow exporter supporting various custom IPFIX elements"),
                            m_pid(""), m_daemon(false),
                            m_iqueue(DEFAULT_IQUEUE_SIZE), m_oqueue(DEFAULT_OQUEUE_SIZE), m_fps(DEFAULT_FPS),
-                           m_pkt_bufsize(1600), m_max_pkts(0), m_help(false), m_help_str(""), m_version(false)
+                           m_pkt_bufsize(1600), m_max_pkts(0), m_dpi_workers(0), m_overload(""), m_help(false), m_help_str(""), m_version(false)
    {
       m_delim = ' ';
 
@@ -129,6 +134,11 @@ public:
                           m_process.push_back(arg);
                           return true;
                       }, OptionFlags::RequiredArgument);
+      register_option("-E", "--export-filter", "RULE", "Drop or strip extensions of flows before export, first matching rule applies",
+                      [this](const char *arg) {
+                          m_export_filter.push_back(arg);
+                          return true;
+                      }, OptionFlags::RequiredArgument);
       register_option("-q", "--iqueue", "SIZE", "Size of queue between input and storage plugins",
                       [this](const char *arg) {
                           try { m_iqueue = str2num<decltype(m_iqueue)>(arg); } catch (
@@ -159,6 +169,17 @@ public:
                                   std::invalid_argument &e) { return false; }
                           return true;
                       }, OptionFlags::RequiredArgument);
+      register_option("-D", "--dpi", "NUM", "Number of threads of each pipeline running process plugins which inspect payload",
+                      [this](const char *arg) {
+                          try { m_dpi_workers = str2num<decltype(m_dpi_workers)>(arg); } catch (
+                                  std::invalid_argument &e) { return false; }
+                          return true;
+                      }, OptionFlags::RequiredArgument);
+      register_option("-O", "--overload", "ARGS", "Degrade processing of new flows under overload (-h overload for help)",
+                      [this](const char *arg) {
+                          m_overload = arg;
+                          return true;
+                      }, OptionFlags::RequiredArgument);
       register_option("-P", "--pid", "FILE", "Create pid file", [this](const char *arg) {
           m_pid = arg;
           return m_pid != "";
@@ -167,7 +188,7 @@ public:
           m_daemon = true;
           return true;
       }, OptionFlags::NoArgument);
-      register_option("-h", "--help", "PLUGIN", "Print help text. Supported help for input, storage, output and process plugins", [this](const char *arg) {
+      register_option("-h", "--help", "PLUGIN", "Print help text. Supported help for input, storage, output and process plugins and overload control", [this](const char *arg) {
           m_help = true;
           m_help_str = arg ? arg : "";
           return true;
@@ -185,6 +206,9 @@ struct ipxp_conf_t {
    uint32_t worker_cnt;
    uint32_t fps;
    uint32_t max_pkts;
+   uint32_t dpi_workers;
+   std::string overload;
+   std::vector<std::string> export_filter;
 
    PluginManager mgr;
    struct Plugins {
@@ -215,7 +239,7 @@ struct ipxp_conf_t {
 
    ipxp_conf_t() : iqueue_size(DEFAULT_IQUEUE_SIZE),
                    oqueue_size(DEFAULT_OQUEUE_SIZE),
-                   worker_cnt(0), fps(0), max_pkts(0),
+                   worker_cnt(0), fps(0), max_pkts(0), dpi_workers(0),
                    pkt_bufsize(1600), blocks_cnt(0), pkts_cnt(0), pkt_data_cnt(0), blocks(nullptr), pkts(nullptr), pkt_data(nullptr)
    {
    }
@@ -233,6 +257,7 @@ struct ipxp_conf_t {
       }
 
       for (auto &it : pipelines) {
+         delete it.storage.overload;
          delete it.storage.plugin;
       }
 
@@ -250,7 +275,11 @@ struct ipxp_conf_t {
          delete it.thread;
          delete it.promise;
          delete it.plugin;
+         delete it.filter;
          ipx_ring_destroy(it.queue);
+         for (auto &itq : it.ordered_queues) {
+            ipx_ring_destroy(itq);
+         }
       }
 
       for (auto &it : input_stats) {
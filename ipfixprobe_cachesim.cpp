@@ -0,0 +1,404 @@
+/**
+ * \file ipfixprobe_cachesim.cpp
+ * \brief Offline simulation of flow cache configurations on a packet capture.
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <config.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <ipfixprobe/options.hpp>
+#include <ipfixprobe/packet.hpp>
+#include <ipfixprobe/plugin.hpp>
+#include <ipfixprobe/ring.h>
+#include <ipfixprobe/utils.hpp>
+
+#include "input/parser.hpp"
+#include "input/pcap-file.hpp"
+#include "storage/cache.hpp"
+
+using namespace ipxp;
+
+#define SIM_QUEUE_SIZE 1024
+#define SIM_PROBE_COLUMNS 8
+
+static std::vector<uint32_t> parse_list(const char *arg)
+{
+   std::vector<uint32_t> list;
+   std::string str(arg);
+   size_t begin = 0;
+   while (begin <= str.size()) {
+      size_t end = str.find(',', begin);
+      if (end == std::string::npos) {
+         end = str.size();
+      }
+      list.push_back(str2num<uint32_t>(str.substr(begin, end - begin)));
+      begin = end + 1;
+   }
+   return list;
+}
+
+class CacheSimParser : public OptionsParser {
+public:
+   std::vector<std::string> m_files;
+   std::vector<uint32_t> m_size;
+   std::vector<uint32_t> m_line;
+   std::vector<uint32_t> m_active;
+   std::vector<uint32_t> m_inactive;
+   std::string m_cache;
+   uint32_t m_jobs;
+   bool m_help;
+
+   CacheSimParser() : OptionsParser("ipfixprobe_cachesim", "Replay packet capture through flow cache configurations without plugins and export"),
+                      m_files(), m_size({17}), m_line({4}), m_active({300}), m_inactive({30}), m_cache(""),
+                      m_jobs(std::thread::hardware_concurrency()), m_help(false)
+   {
+      m_delim = ' ';
+
+      register_option("-r", "--read", "FILE", "Read packets from pcap or pcapng file, files are replayed in given order", [this](const char *arg) {
+            m_files.push_back(arg);
+            return true;
+      }, OptionFlags::RequiredArgument);
+      register_option("-s", "--size", "LIST", "Comma separated cache size exponents", [this](const char *arg) {
+            try { m_size = parse_list(arg); } catch (std::invalid_argument &e) { return false; }
+            return true;
+      }, OptionFlags::RequiredArgument);
+      register_option("-l", "--line", "LIST", "Comma separated cache line size exponents", [this](const char *arg) {
+            try { m_line = parse_list(arg); } catch (std::invalid_argument &e) { return false; }
+            return true;
+      }, OptionFlags::RequiredArgument);
+      register_option("-a", "--active", "LIST", "Comma separated active timeouts in seconds", [this](const char *arg) {
+            try { m_active = parse_list(arg); } catch (std::invalid_argument &e) { return false; }
+            return true;
+      }, OptionFlags::RequiredArgument);
+      register_option("-i", "--inactive", "LIST", "Comma separated inactive timeouts in seconds", [this](const char *arg) {
+            try { m_inactive = parse_list(arg); } catch (std::invalid_argument &e) { return false; }
+            return true;
+      }, OptionFlags::RequiredArgument);
+      register_option("-c", "--cache", "ARGS", "Additional parameters of every simulated cache, e.g. evict=clock", [this](const char *arg) {
+            m_cache = arg;
+            return true;
+      }, OptionFlags::RequiredArgument);
+      register_option("-j", "--jobs", "NUM", "Number of configurations simulated at once, number of CPUs by default", [this](const char *arg) {
+            try { m_jobs = str2num<decltype(m_jobs)>(arg); } catch (std::invalid_argument &e) { return false; }
+            return m_jobs > 0;
+      }, OptionFlags::RequiredArgument);
+      register_option("-h", "--help", "", "Print help", [this](const char *arg) {
+            m_help = true;
+            return true;
+      }, OptionFlags::NoArgument);
+   }
+};
+
+/**
+ * \brief Packets parsed from capture files, packet data point into the loaded files.
+ */
+struct Trace {
+   std::vector<std::vector<uint8_t>> files;
+   std::unique_ptr<PacketBlock> block;
+};
+
+struct SimConfig {
+   uint32_t size;
+   uint32_t line;
+   uint32_t active;
+   uint32_t inactive;
+   std::string params;
+};
+
+struct SimResult {
+   bool error;
+   std::string msg;
+   FlowCacheStats stats;
+   double ns_per_pkt;
+};
+
+static void error(const std::string &msg)
+{
+   std::cerr << "Error: " << msg << std::endl;
+}
+
+static void load_file(const std::string &file, std::vector<uint8_t> &data)
+{
+   int fd = open(file.c_str(), O_RDONLY);
+   if (fd == -1) {
+      throw PluginError("unable to open file " + file + ": " + strerror(errno));
+   }
+   uint8_t buffer[65536];
+   while (1) {
+      ssize_t ret = read(fd, buffer, sizeof(buffer));
+      if (ret < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         ::close(fd);
+         throw PluginError("unable to read file " + file + ": " + strerror(errno));
+      } else if (ret == 0) {
+         break;
+      }
+      data.insert(data.end(), buffer, buffer + ret);
+   }
+   ::close(fd);
+}
+
+static void load_trace(const std::vector<std::string> &files, Trace &trace)
+{
+   size_t cnt = 0;
+   trace.files.resize(files.size());
+   for (size_t i = 0; i < files.size(); i++) {
+      load_file(files[i], trace.files[i]);
+      PcapFileParser parser(files[i], trace.files[i].data(), trace.files[i].size());
+      PcapFilePacket pkt;
+      while (parser.next(pkt)) {
+         cnt++;
+      }
+   }
+
+   trace.block.reset(new PacketBlock(cnt));
+   parser_opt_t opt = {trace.block.get(), false, false, DLT_EN10MB};
+   for (size_t i = 0; i < files.size(); i++) {
+      PcapFileParser parser(files[i], trace.files[i].data(), trace.files[i].size());
+      PcapFilePacket pkt;
+      while (parser.next(pkt)) {
+         opt.datalink = pkt.datalink;
+         parse_packet(&opt, pkt.ts, pkt.data, pkt.len, pkt.caplen);
+      }
+   }
+}
+
+/**
+ * \brief Replay all packets through one cache configuration.
+ *
+ * Exported flows are dropped, flows evicted with FLOW_END_NO_RES are counted by cache statistics.
+ * Ring is drained only when half full, reader would wait for the writer when emptying it.
+ */
+static void simulate(const PacketBlock &pkts, const SimConfig &conf, SimResult &res)
+{
+   ipx_ring_t *queue = ipx_ring_init(SIM_QUEUE_SIZE, 0);
+   if (queue == nullptr) {
+      res.error = true;
+      res.msg = "unable to initialize ring buffer";
+      return;
+   }
+
+   try {
+      NHTFlowCache cache;
+      cache.set_queue(queue);
+      cache.init(conf.params.c_str());
+
+      auto begin = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < pkts.cnt; i++) {
+         Packet pkt = pkts.pkts[i];
+         cache.put_pkt(pkt);
+         if (ipx_ring_cnt(queue) >= SIM_QUEUE_SIZE / 2) {
+            for (uint32_t cnt = ipx_ring_cnt(queue) - SIM_QUEUE_SIZE / 4; cnt; cnt--) {
+               ipx_ring_pop(queue);
+            }
+         }
+      }
+      auto end = std::chrono::steady_clock::now();
+
+      res.ns_per_pkt = pkts.cnt ? std::chrono::duration<double, std::nano>(end - begin).count() / pkts.cnt : 0;
+      cache.get_stats(res.stats);
+      cache.close();
+   } catch (PluginError &e) {
+      res.error = true;
+      res.msg = e.what();
+   } catch (ParserError &e) {
+      res.error = true;
+      res.msg = e.what();
+   }
+   ipx_ring_destroy(queue);
+}
+
+static double percent(uint64_t part, uint64_t total)
+{
+   return total ? 100.0 * part / total : 0;
+}
+
+static void print_results(const std::vector<SimConfig> &confs, const std::vector<SimResult> &results)
+{
+   std::cout << std::fixed << std::setprecision(2) <<
+      std::setw(5) << "size" <<
+      std::setw(5) << "line" <<
+      std::setw(7) << "active" <<
+      std::setw(9) << "inactive" <<
+      std::setw(12) << "packets" <<
+      std::setw(8) << "hit%" <<
+      std::setw(11) << "flows" <<
+      std::setw(8) << "nores%" <<
+      std::setw(7) << "probe" <<
+      std::setw(11) << "peak" <<
+      std::setw(8) << "peak%" <<
+      std::setw(10) << "ns/pkt" << std::endl;
+
+   for (size_t i = 0; i < confs.size(); i++) {
+      const SimConfig &conf = confs[i];
+      const SimResult &res = results[i];
+      std::cout <<
+         std::setw(5) << conf.size <<
+         std::setw(5) << conf.line <<
+         std::setw(7) << conf.active <<
+         std::setw(9) << conf.inactive;
+      if (res.error) {
+         std::cout << "  error: " << res.msg << std::endl;
+         continue;
+      }
+      const FlowCacheStats &stats = res.stats;
+      uint64_t flows = stats.empty + stats.not_empty;
+      uint64_t probes = 0;
+      for (size_t j = 0; j < stats.probes.size(); j++) {
+         probes += (j + 1) * stats.probes[j];
+      }
+      std::cout <<
+         std::setw(12) << stats.packets <<
+         std::setw(8) << percent(stats.hits, stats.packets) <<
+         std::setw(11) << flows <<
+         std::setw(8) << percent(stats.not_empty, flows) <<
+         std::setw(7) << (stats.hits ? static_cast<double>(probes) / stats.hits : 0) <<
+         std::setw(11) << stats.peak_occupied <<
+         std::setw(8) << percent(stats.peak_occupied, static_cast<uint64_t>(1) << conf.size) <<
+         std::setw(10) << res.ns_per_pkt << std::endl;
+   }
+
+   std::cout << std::endl << "Probe length distribution (% of hits):" << std::endl <<
+      std::setw(5) << "size" <<
+      std::setw(5) << "line" <<
+      std::setw(7) << "active" <<
+      std::setw(9) << "inactive";
+   for (int j = 1; j <= SIM_PROBE_COLUMNS; j++) {
+      std::cout << std::setw(8) << j;
+   }
+   std::cout << std::setw(8) << ">" + std::to_string(SIM_PROBE_COLUMNS) << std::endl;
+
+   for (size_t i = 0; i < confs.size(); i++) {
+      if (results[i].error) {
+         continue;
+      }
+      const SimConfig &conf = confs[i];
+      const FlowCacheStats &stats = results[i].stats;
+      std::cout <<
+         std::setw(5) << conf.size <<
+         std::setw(5) << conf.line <<
+         std::setw(7) << conf.active <<
+         std::setw(9) << conf.inactive;
+      uint64_t rest = 0;
+      for (size_t j = 0; j < stats.probes.size(); j++) {
+         if (j < SIM_PROBE_COLUMNS) {
+            std::cout << std::setw(8) << percent(stats.probes[j], stats.hits);
+         } else {
+            rest += stats.probes[j];
+         }
+      }
+      for (size_t j = stats.probes.size(); j < SIM_PROBE_COLUMNS; j++) {
+         std::cout << std::setw(8) << "-";
+      }
+      std::cout << std::setw(8) << percent(rest, stats.hits) << std::endl;
+   }
+}
+
+int main(int argc, char *argv[])
+{
+   CacheSimParser parser;
+   Trace trace;
+
+   try {
+      parser.parse(argc - 1, const_cast<const char **>(argv) + 1);
+      if (parser.m_help) {
+         parser.usage(std::cout, 0);
+         return EXIT_SUCCESS;
+      }
+      if (parser.m_files.empty()) {
+         error("specify capture file to replay");
+         return EXIT_FAILURE;
+      }
+      load_trace(parser.m_files, trace);
+   } catch (std::runtime_error &e) {
+      error(e.what());
+      return EXIT_FAILURE;
+   }
+
+   std::vector<SimConfig> confs;
+   for (auto size : parser.m_size) {
+      for (auto line : parser.m_line) {
+         for (auto active : parser.m_active) {
+            for (auto inactive : parser.m_inactive) {
+               std::string params = "size=" + std::to_string(size) + ";line=" + std::to_string(line) +
+                  ";active=" + std::to_string(active) + ";inactive=" + std::to_string(inactive);
+               if (!parser.m_cache.empty()) {
+                  params += ";" + parser.m_cache;
+               }
+               confs.push_back({size, line, active, inactive, params});
+            }
+         }
+      }
+   }
+
+   /* One thread per configuration, at most jobs of them run at once. */
+   std::vector<SimResult> results(confs.size(), SimResult{false, "", FlowCacheStats(), 0});
+   std::atomic<size_t> next(0);
+   std::vector<std::thread> threads;
+   for (uint32_t i = 0; i < parser.m_jobs && i < confs.size(); i++) {
+      threads.emplace_back([&]() {
+         size_t idx;
+         while ((idx = next++) < confs.size()) {
+            simulate(*trace.block, confs[idx], results[idx]);
+         }
+      });
+   }
+   for (auto &it : threads) {
+      it.join();
+   }
+
+   std::cerr << "Replayed " << trace.block->cnt << " parsed packets of " << parser.m_files.size() << " file(s)" << std::endl;
+   print_results(confs, results);
+   return EXIT_SUCCESS;
+}
@@ -66,10 +66,11 @@ class IpfixStatsParser : public OptionsParser {
 public:
    pid_t m_pid;
    bool m_one;
+   int m_resize;
    bool m_help;
 
    IpfixStatsParser() : OptionsParser("ipfixprobe_stats", "Read statistics from running ipfixprobe exporter"),
-                        m_pid(0), m_one(false), m_help(false)
+                        m_pid(0), m_one(false), m_resize(-1), m_help(false)
    {
       m_delim = ' ';
 
@@ -82,6 +83,11 @@ public:
             m_one = true;
             return true;
       }, OptionFlags::NoArgument);
+      register_option("-r", "--resize", "EXPONENT", "Resize flow caches of exporter to 2^EXPONENT records and exit", [this](const char *arg) {
+            try { m_resize = str2num<uint32_t>(arg); } catch (
+                  std::invalid_argument &e) { return false; }
+            return m_resize >= 4 && m_resize <= 30;
+      }, OptionFlags::RequiredArgument);
       register_option("-h", "--help", "", "Print help", [this](const char *arg) {
             m_help = true;
             return true;
@@ -127,6 +133,20 @@ int main(int argc, char *argv[])
       goto EXIT;
    }
 
+   if (parser.m_resize >= 0) {
+      *(uint32_t *) buffer = MSG_RESIZE;
+      *(uint32_t *) (buffer + sizeof(uint32_t)) = parser.m_resize;
+      if (send_data(fd, 2 * sizeof(uint32_t), buffer) || recv_data(fd, sizeof(uint32_t), buffer)) {
+         status = EXIT_FAILURE;
+      } else if (*(uint32_t *) buffer == 0) {
+         error("exporter does not support resizing flow cache");
+         status = EXIT_FAILURE;
+      } else {
+         std::cout << "Resize requested for " << *(uint32_t *) buffer << " flow cache(s)" << std::endl;
+      }
+      goto EXIT;
+   }
+
    while (!stop) {
       *(uint32_t *) buffer = MSG_MAGIC;
       // Send stats data request
@@ -131,6 +131,12 @@ const char *basic_tmplt_v6[] = {
    nullptr
 };
 
+/* Fields following basic template when overload control is enabled. */
+const char *overload_tmplt[] = {
+   OVERLOAD_TMPLT(IPFIX_FIELD_NAMES)
+   nullptr
+};
+
 IPFIXExporter::IPFIXExporter() :
    extensions(nullptr), extension_cnt(0),
    templates(nullptr), templatesDataSize(0),
@@ -142,7 +148,8 @@ IPFIXExporter::IPFIXExporter() :
    reconnectTimeout(RECONNECT_TIMEOUT), lastReconnect(0), odid(0),
    templateRefreshTime(TEMPLATE_REFRESH_TIME),
    templateRefreshPackets(TEMPLATE_REFRESH_PACKETS),
-   dir_bit_field(0),
+   dir_bit_field(0), sampling(), samplingChanged(false), samplingExported(false), samplingExportTime(0), samplingExportPacket(0),
+   degradedExported(false),
    mtu(DEFAULT_MTU), packetDataBuffer(nullptr),
    tmpltMaxBufferSize(mtu - IPFIX_HEADER_SIZE)
 {
@@ -275,6 +282,11 @@ template_t *IPFIXExporter::get_template(const Flow &flow)
    if (tmpltMap[ipTmpltIdx].find(tmpltIdx) == tmpltMap[ipTmpltIdx].end()) {
       std::vector<const char *> all_fields;
 
+      if (degradedExported) {
+         for (const char **field = overload_tmplt; *field != nullptr; field++) {
+            all_fields.push_back(*field);
+         }
+      }
       RecordExt *ext = flow.m_exts;
       while (ext != nullptr) {
          if (ext->m_ext_id < 0 || ext->m_ext_id >= extension_cnt) {
@@ -376,6 +388,35 @@ int IPFIXExporter::export_flow(const Flow &flow)
    return 0;
 }
 
+void IPFIXExporter::set_sampling(uint32_t pipeline, SamplingMode mode, uint32_t interval)
+{
+   std::lock_guard<std::mutex> lock(samplingLock);
+   if (pipeline >= sampling.size()) {
+      if (mode == SamplingMode::NONE) {
+         return;
+      }
+      sampling.resize(pipeline + 1, 0);
+   }
+   if (mode == SamplingMode::NONE) {
+      if (sampling[pipeline] == 0) {
+         return;
+      }
+      /* Pipeline sampled before, announce that every packet is selected again. */
+      mode = SamplingMode::COUNT;
+      interval = 1;
+   }
+   uint64_t value = (static_cast<uint64_t>(mode) << 32) | interval;
+   if (sampling[pipeline] != value) {
+      sampling[pipeline] = value;
+      samplingChanged.store(true, std::memory_order_release);
+   }
+}
+
+void IPFIXExporter::set_overload_control()
+{
+   degradedExported = true;
+}
+
 /**
  * \brief Initialise buffer for record with Data Set Header
  *
@@ -496,6 +537,7 @@ void IPFIXExporter::expire_templates()
          tmp->exportPacket = exportedPackets;
       }
    }
+   samplingExported = false;
 }
 
 /**
@@ -693,6 +735,132 @@ uint16_t IPFIXExporter::create_template_packet(ipfix_packet_t *packet)
    return totalSize;
 }
 
+/**
+ * \brief Creates packet with sampling options
+ *
+ * Options Template Set scoped by observationDomainId and selectorId is followed by Data Sets
+ * with one record per sampled pipeline, selectorId is index of the pipeline. Count-based and random
+ * sampling records carry samplingInterval, samplingAlgorithm and selectorAlgorithm. Flow sampling
+ * hashes flow key by XXH64, which has no PSAMP selectorAlgorithm nor samplingAlgorithm value,
+ * so its records carry samplingInterval only.
+ * Options are sent again when sampling of any pipeline changes, UDP refreshes them like templates.
+ *
+ * @param packet Pointer to packet to fill
+ * @return length of the IPFIX packet, 0 when there is nothing to send
+ */
+uint16_t IPFIXExporter::create_sampling_packet(ipfix_packet_t *packet)
+{
+   static const uint16_t fields[][2] = {
+      {149, 4}, /* observationDomainId (scope) */
+      {302, 8}, /* selectorId (scope) */
+      {34, 4},  /* samplingInterval */
+      {35, 1},  /* samplingAlgorithm */
+      {304, 2}  /* selectorAlgorithm */
+   };
+   const uint16_t fieldCount = sizeof(fields) / sizeof(fields[0]);
+   const uint16_t flowFieldCount = 3;
+   const uint16_t templateSetSize = IPFIX_SET_HEADER_SIZE + 2 * 6 + (fieldCount + flowFieldCount) * 4;
+   const uint16_t recordSize = 4 + 8 + 4 + 1 + 2;
+   const uint16_t flowRecordSize = 4 + 8 + 4;
+   std::vector<uint64_t> values;
+   uint16_t records = 0;
+   uint16_t flowRecords = 0;
+   uint16_t totalSize;
+   uint8_t *ptr;
+
+   if (samplingChanged.exchange(false, std::memory_order_acquire)) {
+      samplingExported = false;
+   }
+   if (protocol == IPPROTO_UDP && samplingExported &&
+         ((templateRefreshTime != 0 && (time_t) (templateRefreshTime + samplingExportTime) <= time(nullptr)) ||
+         (templateRefreshPackets != 0 && templateRefreshPackets + samplingExportPacket <= exportedPackets))) {
+      samplingExported = false;
+   }
+   if (samplingExported) {
+      return 0;
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(samplingLock);
+      values = sampling;
+   }
+   for (auto value : values) {
+      if (value >> 32 == static_cast<uint16_t>(SamplingMode::FLOW)) {
+         flowRecords++;
+      } else if (value != 0) {
+         records++;
+      }
+   }
+   if (records == 0 && flowRecords == 0) {
+      return 0;
+   }
+   totalSize = IPFIX_HEADER_SIZE + templateSetSize +
+      (records ? IPFIX_SET_HEADER_SIZE + records * recordSize : 0) +
+      (flowRecords ? IPFIX_SET_HEADER_SIZE + flowRecords * flowRecordSize : 0);
+
+   packet->data = (uint8_t *) malloc(sizeof(uint8_t) * totalSize);
+   if (!packet->data) {
+      return 0;
+   }
+   ptr = packet->data;
+   ptr += fill_ipfix_header(ptr, totalSize);
+
+   /* Options Template Set, flow sampling template is a prefix of the other one */
+   *((uint16_t *) ptr) = htons(OPTIONS_TEMPLATE_SET_ID);
+   *((uint16_t *) (ptr + 2)) = htons(templateSetSize);
+   ptr += IPFIX_SET_HEADER_SIZE;
+   for (uint16_t id : {SAMPLING_TEMPLATE_ID, FLOW_SAMPLING_TEMPLATE_ID}) {
+      uint16_t count = id == SAMPLING_TEMPLATE_ID ? fieldCount : flowFieldCount;
+      *((uint16_t *) ptr) = htons(id);
+      *((uint16_t *) (ptr + 2)) = htons(count);
+      *((uint16_t *) (ptr + 4)) = htons(2); /* Scope field count */
+      ptr += 6;
+      for (uint16_t i = 0; i < count; i++) {
+         *((uint16_t *) ptr) = htons(fields[i][0]);
+         *((uint16_t *) (ptr + 2)) = htons(fields[i][1]);
+         ptr += 4;
+      }
+   }
+
+   /* Data Sets */
+   for (uint16_t id : {SAMPLING_TEMPLATE_ID, FLOW_SAMPLING_TEMPLATE_ID}) {
+      bool flow = id == FLOW_SAMPLING_TEMPLATE_ID;
+      uint16_t cnt = flow ? flowRecords : records;
+      if (cnt == 0) {
+         continue;
+      }
+      *((uint16_t *) ptr) = htons(id);
+      *((uint16_t *) (ptr + 2)) = htons(IPFIX_SET_HEADER_SIZE + cnt * (flow ? flowRecordSize : recordSize));
+      ptr += IPFIX_SET_HEADER_SIZE;
+      for (size_t pipeline = 0; pipeline < values.size(); pipeline++) {
+         uint16_t mode = values[pipeline] >> 32;
+         if (values[pipeline] == 0 || flow != (mode == static_cast<uint16_t>(SamplingMode::FLOW))) {
+            continue;
+         }
+         *((uint32_t *) ptr) = htonl(odid);
+         *((uint64_t *) (ptr + 4)) = swap_uint64(pipeline);
+         *((uint32_t *) (ptr + 12)) = htonl(static_cast<uint32_t>(values[pipeline]));
+         if (flow) {
+            ptr += flowRecordSize;
+            continue;
+         }
+         /* samplingAlgorithm: 1 deterministic, 2 random */
+         *(ptr + 16) = mode == static_cast<uint16_t>(SamplingMode::COUNT) ? 1 : 2;
+         *((uint16_t *) (ptr + 17)) = htons(mode);
+         ptr += recordSize;
+      }
+   }
+
+   samplingExported = true;
+   samplingExportTime = time(nullptr);
+   samplingExportPacket = exportedPackets;
+
+   packet->length = totalSize;
+   packet->flows = records + flowRecords;
+
+   return totalSize;
+}
+
 /**
  * \brief Creates data packet from template buffers
  *
@@ -766,6 +934,12 @@ void IPFIXExporter::send_templates()
        * so we need not concern about it here */
       send_packet(&pkt);
 
+      free(pkt.data);
+   }
+   /* Sampling options follow templates, so they are resent together */
+   if (create_sampling_packet(&pkt)) {
+      send_packet(&pkt);
+
       free(pkt.data);
    }
 }
@@ -1079,6 +1253,13 @@ int IPFIXExporter::fill_basic_flow(const Flow &flow, template_t *tmplt)
 #endif
    }
 
+   if (degradedExported) {
+      if (tmplt->bufferSize + (p - buffer) + GENERATE_FIELDS_SUMLEN(OVERLOAD_TMPLT) > tmpltMaxBufferSize) {
+         return -1;
+      }
+      OVERLOAD_TMPLT(GEN_FILLFIELDS_INT)
+   }
+
    length = p - buffer;
 
    return length;
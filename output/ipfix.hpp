@@ -38,8 +38,10 @@
 #ifndef IPXP_OUTPUT_IPFIX_H
 #define IPXP_OUTPUT_IPFIX_H
 
+#include <atomic>
 #include <vector>
 #include <map>
+#include <mutex>
 
 #include <ipfixprobe/output.hpp>
 #include <ipfixprobe/process.hpp>
@@ -51,6 +53,9 @@
 #define COUNT_IPFIX_TEMPLATES(T) + 1
 
 #define TEMPLATE_SET_ID 2
+#define OPTIONS_TEMPLATE_SET_ID 3
+#define SAMPLING_TEMPLATE_ID 256
+#define FLOW_SAMPLING_TEMPLATE_ID 257
 #define FIRST_TEMPLATE_ID 258
 #define IPFIX_VERISON 10
 #define DEFAULT_MTU 1458 /* 1500 - (ethernet 14 + ip 20 + udp 8) */
@@ -235,6 +240,8 @@ public:
    OptionsParser *get_parser() const { return new IpfixOptParser(); }
    std::string get_name() const { return "ipfix"; }
    int export_flow(const Flow &flow);
+   void set_sampling(uint32_t pipeline, SamplingMode mode, uint32_t interval);
+   void set_overload_control();
 
 private:
    /* Templates */
@@ -269,6 +276,13 @@ private:
    uint32_t templateRefreshTime; /**< UDP template refresh time interval */
    uint32_t templateRefreshPackets; /**< UDP template refresh packet interval */
    uint8_t dir_bit_field;     /**< Direction bit field value. */
+   std::mutex samplingLock; /**< Protects sampling set from storage threads. */
+   std::vector<uint64_t> sampling; /**< Sampling of pipelines, mode in upper half and interval in lower half, 0 when pipeline was never sampled. */
+   std::atomic<bool> samplingChanged; /**< Sampling of some pipeline changed since options were sent. */
+   bool samplingExported; /**< Sampling options were sent to collector. */
+   time_t samplingExportTime; /**< Time when sampling options were last sent. */
+   uint64_t samplingExportPacket; /**< Number of packet when sampling options were last sent. */
+   bool degradedExported; /**< Basic templates contain flags of degraded processing. */
 
    uint16_t mtu; /**< Max size of packet payload sent */
    uint8_t *packetDataBuffer; /**< Data buffer to store packet */
@@ -282,6 +296,7 @@ private:
    void expire_templates();
    template_t *create_template(const char **tmplt, const char **ext);
    uint16_t create_template_packet(ipfix_packet_t *packet);
+   uint16_t create_sampling_packet(ipfix_packet_t *packet);
    uint16_t create_data_packet(ipfix_packet_t *packet);
    void send_templates();
    void send_data();
@@ -173,6 +173,12 @@ void TextExporter::print_basic_flow(const Flow &flow)
       " " <<
       time_begin << "->" << time_end;
 
+   if (flow.degraded) {
+      *m_out << " degraded=" <<
+         ((flow.degraded & FLOW_DEGRADED_DPI) ? "dpi" : "") <<
+         ((flow.degraded & FLOW_DEGRADED_DPI) && (flow.degraded & FLOW_DEGRADED_SAMPLED) ? "," : "") <<
+         ((flow.degraded & FLOW_DEGRADED_SAMPLED) ? "sampled" : "");
+   }
 }
 
 }
@@ -0,0 +1,154 @@
+/**
+ * \file overload.cpp
+ * \brief Overload control degrading processing of a pipeline which cannot keep up with input.
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <iostream>
+
+#include "overload.hpp"
+
+namespace ipxp {
+
+OverloadControl::OverloadControl(const std::string &params, StoragePlugin *cache, OutputPlugin *output, uint32_t pipeline) :
+   m_cache(cache), m_output(output), m_pipeline(pipeline), m_names(), m_masks(1, 0), m_drops(0), m_fill(0), m_sampling(1), m_hold(0),
+   m_level(0), m_max_level(0), m_calm(0), m_last(0), m_seen(0), m_dropped(0), m_read(0), m_capacity(0)
+{
+   OverloadOptParser parser;
+   std::string args = params;
+   std::string name = args.substr(0, args.find(OptionsParser::DELIM));
+   trim_str(name);
+   /* Accept arguments also in the form printed by usage. */
+   if (name == "overload") {
+      args.erase(0, args.find(OptionsParser::DELIM));
+      if (!args.empty()) {
+         args.erase(0, 1);
+      }
+   }
+   try {
+      parser.parse(args.c_str());
+   } catch (ParserError &e) {
+      throw PluginError(e.what());
+   }
+
+   for (const auto &name : parser.m_shed) {
+      int idx = cache->find_plugin(name);
+      if (idx < 0) {
+         throw PluginError("unknown process plugin " + name + " in shed list");
+      }
+      m_names.push_back(name);
+      m_masks.push_back(m_masks.back() | (static_cast<uint64_t>(1) << idx));
+   }
+   m_drops = parser.m_drops;
+   m_fill = parser.m_fill;
+   m_sampling = parser.m_sampling;
+   m_hold = parser.m_hold;
+   m_max_level = m_names.size() + (m_sampling > 1);
+}
+
+/**
+ * \brief Evaluate load of last second and change level of degradation.
+ * \param [in] now Monotonic time in seconds.
+ * \param [in] seen Packets seen by input.
+ * \param [in] dropped Packets dropped by input.
+ */
+void OverloadControl::check(time_t now, uint64_t seen, uint64_t dropped)
+{
+   if (m_last == 0) {
+      m_last = now;
+      m_seen = seen;
+      m_dropped = dropped;
+      return;
+   }
+   if (now == m_last) {
+      return;
+   }
+
+   uint64_t seen_diff = seen - m_seen;
+   uint64_t dropped_diff = dropped - m_dropped;
+   bool overload = dropped_diff && dropped_diff * 100 > m_drops * seen_diff;
+   if (m_fill && m_capacity && m_read * 100 > m_fill * m_capacity) {
+      overload = true;
+   }
+
+   if (overload) {
+      m_calm = 0;
+      if (m_level < m_max_level) {
+         m_level++;
+         apply();
+      }
+   } else if (m_level && ++m_calm >= m_hold) {
+      m_calm = 0;
+      m_level--;
+      apply();
+   }
+
+   m_last = now;
+   m_seen = seen;
+   m_dropped = dropped;
+   m_read = 0;
+   m_capacity = 0;
+}
+
+void OverloadControl::apply()
+{
+   uint32_t shed = m_level < m_names.size() ? m_level : m_names.size();
+   uint32_t sampling = m_level > m_names.size() ? m_sampling : 1;
+
+   m_cache->set_degradation(m_masks[shed], sampling);
+
+   uint32_t interval;
+   SamplingMode mode = m_cache->get_sampling(interval);
+   m_output->set_sampling(m_pipeline, mode, interval);
+
+   std::cerr << "overload: level " << m_level << "/" << m_max_level;
+   if (shed) {
+      std::cerr << ", disabled";
+      for (uint32_t i = 0; i < shed; i++) {
+         std::cerr << (i ? "," : " ") << m_names[i];
+      }
+   }
+   if (sampling > 1) {
+      std::cerr << ", sampling 1 of " << sampling << " packets";
+   }
+   std::cerr << std::endl;
+}
+
+}
@@ -0,0 +1,166 @@
+/**
+ * \file overload.hpp
+ * \brief Overload control degrading processing of a pipeline which cannot keep up with input.
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef IPXP_OVERLOAD_HPP
+#define IPXP_OVERLOAD_HPP
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <ipfixprobe/options.hpp>
+#include <ipfixprobe/output.hpp>
+#include <ipfixprobe/storage.hpp>
+#include <ipfixprobe/utils.hpp>
+
+namespace ipxp {
+
+class OverloadOptParser : public OptionsParser
+{
+public:
+   std::vector<std::string> m_shed;
+   uint32_t m_drops;
+   uint32_t m_fill;
+   uint32_t m_sampling;
+   uint32_t m_hold;
+
+   OverloadOptParser() : OptionsParser("overload", "Degrade processing of new flows when pipeline cannot keep up with input"),
+      m_shed(), m_drops(1), m_fill(0), m_sampling(1), m_hold(10)
+   {
+      register_option("s", "shed", "LIST", "Comma separated process plugins disabled for new flows, in order of disabling",
+         [this](const char *arg){std::string list(arg);
+            size_t begin = 0;
+            while (begin <= list.size()) {
+               size_t end = list.find(',', begin);
+               if (end == std::string::npos) {
+                  end = list.size();
+               }
+               std::string name = list.substr(begin, end - begin);
+               trim_str(name);
+               if (name.empty()) {
+                  return false;
+               }
+               m_shed.push_back(name);
+               begin = end + 1;
+            } return true;},
+         OptionFlags::RequiredArgument);
+      register_option("d", "drops", "PERCENT", "Pipeline is overloaded when input drops more than PERCENT of packets in a second",
+         [this](const char *arg){try {m_drops = str2num<decltype(m_drops)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("f", "fill", "PERCENT", "Pipeline is overloaded when reads from input return on average more than PERCENT of packet block, 0 disables the check",
+         [this](const char *arg){try {m_fill = str2num<decltype(m_fill)>(arg);
+               if (m_fill > 100) {
+                  throw PluginError("Fill threshold must be between 0 and 100 percent");
+               }
+            } catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("S", "sampling", "N", "Process one of N packets when all plugins of shed list are disabled, 1 disables sampling",
+         [this](const char *arg){try {m_sampling = str2num<decltype(m_sampling)>(arg);
+               if (m_sampling == 0) {
+                  throw PluginError("Sampling interval must be at least 1");
+               }
+            } catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("H", "hold", "SECONDS", "Restore one degraded feature after SECONDS without overload",
+         [this](const char *arg){try {m_hold = str2num<decltype(m_hold)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+   }
+};
+
+/**
+ * \brief Overload controller of one pipeline, driven by storage worker.
+ *
+ * Load is evaluated every second. Every overloaded second raises level by one: level N disables
+ * first N plugins of shed list for new flows, the level after the last plugin enables packet sampling.
+ * Level is lowered by one after hold seconds without overload.
+ */
+class OverloadControl
+{
+public:
+   /**
+    * \brief Constructor.
+    * \param [in] params Options of overload control.
+    * \param [in] cache Storage plugin of pipeline with all process plugins added.
+    * \param [in] output Output plugin notified about sampling applied by storage plugin.
+    * \param [in] pipeline Index of pipeline.
+    */
+   OverloadControl(const std::string &params, StoragePlugin *cache, OutputPlugin *output, uint32_t pipeline);
+
+   /**
+    * \brief Account block read from input.
+    * \param [in] cnt Packets in block.
+    * \param [in] size Capacity of block.
+    */
+   void add_block(size_t cnt, size_t size)
+   {
+      m_read += cnt;
+      m_capacity += size;
+   }
+
+   void check(time_t now, uint64_t seen, uint64_t dropped);
+
+private:
+   StoragePlugin *m_cache;
+   OutputPlugin *m_output;
+   uint32_t m_pipeline;
+   std::vector<std::string> m_names; /**< Plugins of shed list. */
+   std::vector<uint64_t> m_masks; /**< Plugins disabled at every level up to the last plugin of shed list. */
+   uint32_t m_drops;
+   uint32_t m_fill;
+   uint32_t m_sampling;
+   uint32_t m_hold;
+   uint32_t m_level;
+   uint32_t m_max_level;
+   uint32_t m_calm; /**< Seconds without overload. */
+   time_t m_last; /**< Time of last evaluation. */
+   uint64_t m_seen; /**< Packets seen by input at last evaluation. */
+   uint64_t m_dropped; /**< Packets dropped by input at last evaluation. */
+   uint64_t m_read; /**< Packets read since last evaluation. */
+   uint64_t m_capacity; /**< Capacity of blocks read since last evaluation. */
+
+   void apply();
+};
+
+}
+#endif /* IPXP_OVERLOAD_HPP */
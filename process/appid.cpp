@@ -0,0 +1,482 @@
+/**
+ * \file appid.cpp
+ * \brief Plugin identifying application protocol by signatures matched in first payload bytes
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <iostream>
+#include <fstream>
+#include <queue>
+#include <limits>
+#include <cstring>
+#include <cerrno>
+
+#include "appid.hpp"
+
+namespace ipxp {
+
+int RecordExtAPPID::REGISTERED_ID = -1;
+
+__attribute__((constructor)) static void register_this_plugin()
+{
+   static PluginRecord rec = PluginRecord("appid", [](){return new APPIDPlugin();});
+   register_plugin(&rec);
+   RecordExtAPPID::REGISTERED_ID = register_extension();
+}
+
+#define APPID_ANY_OFFSET -1
+#define APPID_STATES 256 /**< Transitions of one automaton state */
+
+/**
+ * \brief Built-in signature written in the same notation as signature file.
+ */
+struct AppSignatureDef {
+   uint16_t id;
+   const char *name;
+   const char *offset;
+   const char *pattern;
+   const char *ports;
+};
+
+static const AppSignatureDef default_signatures[] = {
+   {APP_HTTP,       "http",       "0",              "GET ",                     "80 8080"},
+   {APP_HTTP,       "http",       "0",              "POST ",                    "80 8080"},
+   {APP_HTTP,       "http",       "0",              "HEAD ",                    "80 8080"},
+   {APP_HTTP,       "http",       "0",              "PUT ",                     "80 8080"},
+   {APP_HTTP,       "http",       "0",              "DELETE ",                  "80 8080"},
+   {APP_HTTP,       "http",       "0",              "OPTIONS ",                 "80 8080"},
+   {APP_HTTP,       "http",       "0",              "HTTP/1.",                  "80 8080"},
+   {APP_RTSP,       "rtsp",       "0",              "RTSP/1.0 ",                "554"},
+   {APP_RTSP,       "rtsp",       "0",              "DESCRIBE ",                "554"},
+   {APP_RTSP,       "rtsp",       "0",              "SETUP ",                   "554"},
+   {APP_RTSP,       "rtsp",       "0",              "PLAY ",                    "554"},
+   {APP_RTSP,       "rtsp",       "0",              "OPTIONS rtsp:",            "554"},
+   {APP_TLS,        "tls",        "0",              "0x160301",                 "443"},
+   {APP_TLS,        "tls",        "0",              "0x160302",                 "443"},
+   {APP_TLS,        "tls",        "0",              "0x160303",                 "443"},
+   {APP_SSH,        "ssh",        "0",              "SSH-",                     "22"},
+   {APP_SMTP,       "smtp",       "0",              "220 ",                     "25 587"},
+   {APP_SMTP,       "smtp",       "0",              "EHLO ",                    "25 587"},
+   {APP_SMTP,       "smtp",       "0",              "HELO ",                    "25 587"},
+   {APP_SIP,        "sip",        "0",              "INVITE sip:",              "5060"},
+   {APP_SIP,        "sip",        "0",              "REGISTER sip:",            "5060"},
+   {APP_SIP,        "sip",        "0",              "OPTIONS sip:",             "5060"},
+   {APP_SIP,        "sip",        "0",              "SIP/2.0 ",                 "5060"},
+   {APP_SSDP,       "ssdp",       "0",              "M-SEARCH * HTTP/1.1",      "1900"},
+   {APP_SSDP,       "ssdp",       "0",              "NOTIFY * HTTP/1.1",        "1900"},
+   {APP_DNS,        "dns",        "*",              "",                         "53"},
+   {APP_NTP,        "ntp",        "*",              "",                         "123"},
+   {APP_NETBIOS,    "netbios",    "*",              "",                         "137"},
+   {APP_MDNS,       "mdns",       "*",              "",                         "5353"},
+   {APP_WIREGUARD,  "wireguard",  "0",              "0x01000000",               "51820"},
+   {APP_OPENVPN,    "openvpn",    "0",              "0x38",                     "1194"},
+   {APP_OPENVPN,    "openvpn",    "2",              "0x38",                     "1194"},
+   {APP_QUIC,       "quic",       "1",              "0x00000001",               "443"},
+   {APP_QUIC,       "quic",       "1",              "0x6b3343cf",               "443"},
+   {APP_QUIC,       "quic",       "1",              "0xff0000",                 "443"},
+   {APP_BITTORRENT, "bittorrent", "0",              "\\x13BitTorrent protocol", ""},
+   {APP_SMB,        "smb",        "4",              "0xff534d42",               "445"},
+   {APP_SMB,        "smb",        "4",              "0xfe534d42",               "445"}
+};
+
+/**
+ * \brief Convert hexadecimal digit to its value.
+ * \return Value of digit or -1 when character is not a hexadecimal digit.
+ */
+static int hex_value(char c)
+{
+   if (c >= '0' && c <= '9') {
+      return c - '0';
+   } else if (c >= 'a' && c <= 'f') {
+      return c - 'a' + 10;
+   } else if (c >= 'A' && c <= 'F') {
+      return c - 'A' + 10;
+   }
+   return -1;
+}
+
+/**
+ * \brief Decode signature pattern.
+ * \param [in] str Text with \xHH escapes or 0x prefixed hexadecimal string.
+ * \return Pattern bytes.
+ */
+static std::string decode_pattern(const std::string &str)
+{
+   std::string pattern;
+
+   if (str.size() > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
+      if (str.size() % 2) {
+         throw PluginError("odd length of hexadecimal pattern " + str);
+      }
+      for (size_t i = 2; i < str.size(); i += 2) {
+         int hi = hex_value(str[i]);
+         int lo = hex_value(str[i + 1]);
+         if (hi < 0 || lo < 0) {
+            throw PluginError("invalid hexadecimal pattern " + str);
+         }
+         pattern.push_back(static_cast<char>(hi << 4 | lo));
+      }
+      return pattern;
+   }
+
+   for (size_t i = 0; i < str.size(); i++) {
+      if (str[i] == '\\' && i + 3 < str.size() && str[i + 1] == 'x') {
+         int hi = hex_value(str[i + 2]);
+         int lo = hex_value(str[i + 3]);
+         if (hi < 0 || lo < 0) {
+            throw PluginError("invalid escape sequence in pattern " + str);
+         }
+         pattern.push_back(static_cast<char>(hi << 4 | lo));
+         i += 3;
+      } else {
+         pattern.push_back(str[i]);
+      }
+   }
+   return pattern;
+}
+
+/**
+ * \brief Create signature from its text notation.
+ */
+static AppSignature make_signature(uint16_t id, const std::string &name, const std::string &offset,
+   const std::string &pattern, const std::string &ports)
+{
+   AppSignature sig;
+   std::istringstream port_list(ports);
+   std::string port;
+
+   sig.id = id;
+   sig.name = name.substr(0, APPID_NAME_LEN - 1);
+   if (offset.find('*') != std::string::npos) {
+      sig.offset = APPID_ANY_OFFSET;
+   } else {
+      try {
+         sig.offset = str2num<uint16_t>(offset);
+      } catch (std::invalid_argument &e) {
+         throw PluginError("invalid offset " + offset + " of signature " + name);
+      }
+   }
+   sig.pattern = decode_pattern(pattern);
+   while (port_list >> port) {
+      try {
+         sig.ports.push_back(str2num<uint16_t>(port));
+      } catch (std::invalid_argument &e) {
+         throw PluginError("invalid port " + port + " of signature " + name);
+      }
+   }
+   if (sig.pattern.empty() && sig.ports.empty()) {
+      throw PluginError("signature " + name + " has neither pattern nor port");
+   }
+   return sig;
+}
+
+AppIdAutomaton::AppIdAutomaton(const std::vector<AppSignature> &sigs) : m_sigs(sigs), m_limit(0)
+{
+   std::vector<std::vector<uint32_t>> outputs(1);
+   std::vector<uint32_t> fail(1, 0);
+   std::queue<uint32_t> queue;
+
+   // Build trie of patterns, missing transitions are marked by 0
+   m_delta.assign(APPID_STATES, 0);
+   for (uint32_t i = 0; i < m_sigs.size(); i++) {
+      const std::string &pattern = m_sigs[i].pattern;
+      uint32_t state = 0;
+
+      if (pattern.empty()) {
+         continue;
+      }
+      if (m_sigs[i].offset == APPID_ANY_OFFSET) {
+         m_limit = std::numeric_limits<uint32_t>::max();
+      } else if (m_limit != std::numeric_limits<uint32_t>::max()) {
+         m_limit = std::max<uint32_t>(m_limit, m_sigs[i].offset + pattern.size());
+      }
+      for (size_t j = 0; j < pattern.size(); j++) {
+         uint32_t &next = m_delta[state * APPID_STATES + static_cast<uint8_t>(pattern[j])];
+         if (next == 0) {
+            next = outputs.size();
+            outputs.emplace_back();
+            fail.push_back(0);
+            m_delta.resize(m_delta.size() + APPID_STATES, 0);
+         }
+         state = m_delta[state * APPID_STATES + static_cast<uint8_t>(pattern[j])];
+      }
+      outputs[state].push_back(i);
+   }
+
+   // Compute failure links in breadth-first order and complete transition table
+   for (uint32_t c = 0; c < APPID_STATES; c++) {
+      if (m_delta[c] != 0) {
+         queue.push(m_delta[c]);
+      }
+   }
+   while (!queue.empty()) {
+      uint32_t state = queue.front();
+      queue.pop();
+
+      outputs[state].insert(outputs[state].end(), outputs[fail[state]].begin(), outputs[fail[state]].end());
+      for (uint32_t c = 0; c < APPID_STATES; c++) {
+         uint32_t &next = m_delta[state * APPID_STATES + c];
+         if (next != 0) {
+            fail[next] = m_delta[fail[state] * APPID_STATES + c];
+            queue.push(next);
+         } else {
+            next = m_delta[fail[state] * APPID_STATES + c];
+         }
+      }
+   }
+
+   m_out.reserve(outputs.size() + 1);
+   for (const auto &it : outputs) {
+      m_out.push_back(m_out_sigs.size());
+      m_out_sigs.insert(m_out_sigs.end(), it.begin(), it.end());
+   }
+   m_out.push_back(m_out_sigs.size());
+}
+
+bool AppIdAutomaton::hinted(const AppSignature &sig, uint16_t src_port, uint16_t dst_port) const
+{
+   if (sig.ports.empty()) {
+      return !sig.pattern.empty();
+   }
+   for (auto port : sig.ports) {
+      if (port == src_port || port == dst_port) {
+         return true;
+      }
+   }
+   return false;
+}
+
+void AppIdAutomaton::scan(uint32_t &state, uint32_t pos, const uint8_t *data, uint32_t len,
+   uint16_t src_port, uint16_t dst_port, uint32_t &sig, uint32_t &prio) const
+{
+   uint32_t s = state;
+
+   for (uint32_t i = 0; i < len; i++) {
+      s = m_delta[s * APPID_STATES + data[i]];
+      if (m_out[s] == m_out[s + 1]) {
+         continue;
+      }
+      for (uint32_t j = m_out[s]; j < m_out[s + 1]; j++) {
+         const AppSignature &cur = m_sigs[m_out_sigs[j]];
+         uint32_t start = pos + i + 1 - cur.pattern.size();
+
+         if (cur.offset != APPID_ANY_OFFSET && static_cast<uint32_t>(cur.offset) != start) {
+            continue;
+         }
+         uint32_t cur_prio = hinted(cur, src_port, dst_port) ? PRIO_BEST : PRIO_PATTERN;
+         if (cur_prio > prio) {
+            sig = m_out_sigs[j];
+            prio = cur_prio;
+         }
+      }
+   }
+   state = s;
+}
+
+void AppIdAutomaton::match_ports(uint16_t src_port, uint16_t dst_port, uint32_t &sig, uint32_t &prio) const
+{
+   if (prio >= PRIO_PORT) {
+      return;
+   }
+   for (uint32_t i = 0; i < m_sigs.size(); i++) {
+      if (m_sigs[i].pattern.empty() && hinted(m_sigs[i], src_port, dst_port)) {
+         sig = i;
+         prio = PRIO_PORT;
+         return;
+      }
+   }
+}
+
+APPIDPlugin::APPIDPlugin() : m_automaton(nullptr), m_bytes(APPID_DEFAULT_BYTES)
+{
+}
+
+APPIDPlugin::~APPIDPlugin()
+{
+   close();
+}
+
+void APPIDPlugin::init(const char *params)
+{
+   APPIDOptParser parser;
+   std::vector<AppSignature> sigs;
+
+   try {
+      parser.parse(params);
+   } catch (ParserError &e) {
+      throw PluginError(e.what());
+   }
+
+   m_bytes = parser.m_bytes;
+   if (parser.m_file.empty()) {
+      for (const auto &it : default_signatures) {
+         sigs.push_back(make_signature(it.id, it.name, it.offset, it.pattern, it.ports));
+      }
+   } else {
+      sigs = load_signatures(parser.m_file);
+   }
+   m_automaton = std::make_shared<const AppIdAutomaton>(sigs);
+}
+
+void APPIDPlugin::close()
+{
+   m_automaton.reset();
+}
+
+ProcessPlugin *APPIDPlugin::copy()
+{
+   return new APPIDPlugin(*this);
+}
+
+/**
+ * \brief Load signatures from file.
+ *
+ * Each line contains `id,name,offset,pattern[,ports]`, lines starting with `#` are ignored.
+ */
+std::vector<AppSignature> APPIDPlugin::load_signatures(const std::string &file)
+{
+   std::vector<AppSignature> sigs;
+   std::ifstream in_file;
+   std::string line;
+   size_t line_num = 0;
+
+   in_file.open(file);
+   if (!in_file) {
+      std::ostringstream oss;
+      oss << strerror(errno) << " '" << file << "'";
+      throw PluginError(oss.str());
+   }
+
+   while (getline(in_file, line)) {
+      std::vector<std::string> parts;
+      size_t begin = 0;
+      size_t end = 0;
+      uint16_t id;
+
+      line_num++;
+      if (line.empty() || line[0] == '#') {
+         continue;
+      }
+      while (end != std::string::npos) {
+         end = line.find(",", begin);
+         parts.push_back(line.substr(begin, (end == std::string::npos ? (line.length() - begin) : (end - begin))));
+         begin = end + 1;
+      }
+      if (parts.size() < 4 || parts.size() > 5) {
+         throw PluginError("invalid signature on line " + std::to_string(line_num) + " of '" + file + "'");
+      }
+      try {
+         id = str2num<uint16_t>(parts[0]);
+      } catch (std::invalid_argument &e) {
+         throw PluginError("invalid application id on line " + std::to_string(line_num) + " of '" + file + "'");
+      }
+      trim_str(parts[1]);
+      sigs.push_back(make_signature(id, parts[1], parts[2], parts[3], parts.size() == 5 ? parts[4] : ""));
+   }
+   in_file.close();
+
+   if (sigs.empty()) {
+      throw PluginError("no signatures loaded from '" + file + "'");
+   }
+   return sigs;
+}
+
+int APPIDPlugin::post_create(Flow &rec, const Packet &pkt)
+{
+   RecordExtAPPID *ext = new RecordExtAPPID();
+
+   rec.add_extension(ext);
+   m_automaton->match_ports(rec.src_port, rec.dst_port, ext->sig, ext->prio);
+   return scan(rec, ext, pkt);
+}
+
+int APPIDPlugin::post_update(Flow &rec, const Packet &pkt)
+{
+   RecordExtAPPID *ext = static_cast<RecordExtAPPID *>(rec.get_extension(RecordExtAPPID::REGISTERED_ID));
+
+   if (ext == nullptr) {
+      return FLOW_PLUGIN_DETACH;
+   }
+   return scan(rec, ext, pkt);
+}
+
+void APPIDPlugin::pre_export(Flow &rec)
+{
+   RecordExtAPPID *ext = static_cast<RecordExtAPPID *>(rec.get_extension(RecordExtAPPID::REGISTERED_ID));
+
+   if (ext != nullptr && ext->prio == AppIdAutomaton::PRIO_NONE) {
+      rec.remove_extension(RecordExtAPPID::REGISTERED_ID);
+   }
+}
+
+/**
+ * \brief Continue scanning packet direction and stop when application is known or nothing can match anymore.
+ */
+int APPIDPlugin::scan(Flow &rec, RecordExtAPPID *ext, const Packet &pkt)
+{
+   uint32_t limit = std::min(m_bytes, m_automaton->scan_limit());
+   uint32_t dir = pkt.source_pkt ? 0 : 1;
+   uint32_t prio = ext->prio;
+
+   if (ext->scanned[dir] < limit && pkt.payload_len > 0) {
+      uint32_t len = std::min<uint32_t>(pkt.payload_len, limit - ext->scanned[dir]);
+
+      m_automaton->scan(ext->state[dir], ext->scanned[dir], pkt.payload, len,
+         rec.src_port, rec.dst_port, ext->sig, ext->prio);
+      ext->scanned[dir] += len;
+   }
+
+   if (ext->prio != prio || (prio != AppIdAutomaton::PRIO_NONE && ext->app_name[0] == 0)) {
+      const AppSignature &sig = m_automaton->signature(ext->sig);
+      ext->app_id = sig.id;
+      strncpy(ext->app_name, sig.name.c_str(), APPID_NAME_LEN - 1);
+      ext->app_name[APPID_NAME_LEN - 1] = 0;
+   }
+
+   if (ext->prio == AppIdAutomaton::PRIO_BEST || (ext->scanned[0] >= limit && ext->scanned[1] >= limit)) {
+      if (ext->prio == AppIdAutomaton::PRIO_NONE) {
+         rec.remove_extension(RecordExtAPPID::REGISTERED_ID);
+      }
+      return FLOW_PLUGIN_DETACH;
+   }
+   return 0;
+}
+
+}
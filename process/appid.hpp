@@ -0,0 +1,302 @@
+/**
+ * \file appid.hpp
+ * \brief Plugin identifying application protocol by signatures matched in first payload bytes
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef IPXP_PROCESS_APPID_HPP
+#define IPXP_PROCESS_APPID_HPP
+
+#include <string>
+#include <cstring>
+#include <sstream>
+#include <memory>
+#include <vector>
+
+#ifdef WITH_NEMEA
+#include "fields.h"
+#endif
+
+#include <ipfixprobe/process.hpp>
+#include <ipfixprobe/flowifc.hpp>
+#include <ipfixprobe/packet.hpp>
+#include <ipfixprobe/options.hpp>
+#include <ipfixprobe/utils.hpp>
+#include <ipfixprobe/ipfix-elements.hpp>
+
+namespace ipxp {
+
+#define APPID_UNIREC_TEMPLATE "APP_ID,APP_NAME"
+
+UR_FIELDS (
+   uint16 APP_ID,
+   string APP_NAME
+)
+
+#define APPID_DEFAULT_BYTES 64
+#define APPID_NAME_LEN 32
+
+/**
+ * \brief Classification engine ID of applicationId IPFIX element (RFC 6759), user defined selectors.
+ */
+#define APPID_ENGINE_USER 6
+
+/**
+ * \brief Applications identified by built-in signatures.
+ */
+enum AppId : uint16_t {
+   APP_UNKNOWN = 0,
+   APP_HTTP = 1,
+   APP_RTSP = 2,
+   APP_TLS = 3,
+   APP_SSH = 4,
+   APP_SMTP = 5,
+   APP_SIP = 6,
+   APP_SSDP = 7,
+   APP_DNS = 8,
+   APP_NTP = 9,
+   APP_WIREGUARD = 10,
+   APP_OPENVPN = 11,
+   APP_QUIC = 12,
+   APP_BITTORRENT = 13,
+   APP_NETBIOS = 14,
+   APP_MDNS = 15,
+   APP_SMB = 16
+};
+
+class APPIDOptParser : public OptionsParser
+{
+public:
+   uint32_t m_bytes;
+   std::string m_file;
+
+   APPIDOptParser() : OptionsParser("appid", "Identify application protocol by signatures matched in first payload bytes of each direction"),
+      m_bytes(APPID_DEFAULT_BYTES), m_file("")
+   {
+      register_option("b", "bytes", "SIZE", "Number of payload bytes scanned in each direction",
+         [this](const char *arg){try {m_bytes = str2num<decltype(m_bytes)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("f", "file", "PATH", "Signature file replacing built-in signatures (line format: id,name,offset|*,pattern[,port port ...]), "
+         "pattern is text with \\xHH escapes or 0x prefixed hex string, empty pattern matches by port only",
+         [this](const char *arg){m_file = arg; return true;}, OptionFlags::RequiredArgument);
+   }
+};
+
+/**
+ * \brief Application signature.
+ */
+struct AppSignature {
+   uint16_t id;
+   std::string name;
+   int32_t offset;              /**< Offset of pattern in direction payload, -1 for any offset */
+   std::string pattern;         /**< Bytes to match, empty to match by ports only */
+   std::vector<uint16_t> ports; /**< Ports increasing priority of match */
+};
+
+/**
+ * \brief Patterns of all signatures compiled into a single Aho-Corasick automaton with complete transition table.
+ */
+class AppIdAutomaton
+{
+public:
+   static constexpr uint32_t PRIO_NONE = 0;
+   static constexpr uint32_t PRIO_PORT = 1;    /**< Signature without pattern matched by port */
+   static constexpr uint32_t PRIO_PATTERN = 2; /**< Pattern matched */
+   static constexpr uint32_t PRIO_BEST = 3;    /**< Pattern matched on hinted port */
+
+   /**
+    * \brief Compile signatures.
+    * \param [in] sigs Signatures, first matched one wins over later matches with equal priority.
+    */
+   AppIdAutomaton(const std::vector<AppSignature> &sigs);
+
+   /**
+    * \brief Scan next part of direction payload.
+    * \param [in,out] state Automaton state of direction, 0 at start.
+    * \param [in] pos Number of bytes of direction payload scanned before.
+    * \param [in] data Payload.
+    * \param [in] len Length of payload.
+    * \param [in] src_port Source port of flow.
+    * \param [in] dst_port Destination port of flow.
+    * \param [in,out] sig Index of best signature matched so far.
+    * \param [in,out] prio Priority of best signature matched so far.
+    */
+   void scan(uint32_t &state, uint32_t pos, const uint8_t *data, uint32_t len, uint16_t src_port, uint16_t dst_port,
+      uint32_t &sig, uint32_t &prio) const;
+
+   /**
+    * \brief Match signatures without pattern against flow ports.
+    */
+   void match_ports(uint16_t src_port, uint16_t dst_port, uint32_t &sig, uint32_t &prio) const;
+
+   /**
+    * \brief Get number of direction payload bytes after which no signature can match.
+    */
+   uint32_t scan_limit() const { return m_limit; }
+
+   const AppSignature &signature(uint32_t idx) const { return m_sigs[idx]; }
+
+private:
+   std::vector<AppSignature> m_sigs;
+   std::vector<uint32_t> m_delta;    /**< Transitions, 256 per state */
+   std::vector<uint32_t> m_out;      /**< First index to m_out_sigs for each state, one extra item at the end */
+   std::vector<uint32_t> m_out_sigs; /**< Signatures with pattern ending in state */
+   uint32_t m_limit;
+
+   bool hinted(const AppSignature &sig, uint16_t src_port, uint16_t dst_port) const;
+};
+
+/**
+ * \brief Flow record extension header for storing identified application.
+ */
+struct RecordExtAPPID : public RecordExt {
+   static int REGISTERED_ID;
+
+   uint16_t app_id;
+   char app_name[APPID_NAME_LEN];
+
+   uint32_t sig;         /**< Index of best matching signature */
+   uint32_t prio;        /**< Priority of best match */
+   uint32_t state[2];    /**< Automaton state of each direction */
+   uint32_t scanned[2];  /**< Bytes scanned in each direction */
+
+   /**
+    * \brief Constructor.
+    */
+   RecordExtAPPID() : RecordExt(REGISTERED_ID)
+   {
+      app_id = APP_UNKNOWN;
+      app_name[0] = 0;
+      sig = 0;
+      prio = AppIdAutomaton::PRIO_NONE;
+      state[0] = state[1] = 0;
+      scanned[0] = scanned[1] = 0;
+   }
+
+#ifdef WITH_NEMEA
+   virtual void fill_unirec(ur_template_t *tmplt, void *record)
+   {
+      ur_set(tmplt, record, F_APP_ID, app_id);
+      ur_set_string(tmplt, record, F_APP_NAME, app_name);
+   }
+
+   const char *get_unirec_tmplt() const
+   {
+      return APPID_UNIREC_TEMPLATE;
+   }
+#endif
+
+   virtual int fill_ipfix(uint8_t *buffer, int size)
+   {
+      int name_len = strlen(app_name);
+
+      if (name_len + 4 > size) {
+         return -1;
+      }
+
+      buffer[0] = APPID_ENGINE_USER;
+      *(uint16_t *) (buffer + 1) = htons(app_id);
+      buffer[3] = name_len;
+      memcpy(buffer + 4, app_name, name_len);
+
+      return name_len + 4;
+   }
+
+   const char **get_ipfix_tmplt() const
+   {
+      static const char *ipfix_tmplt[] = {
+         IPFIX_APPID_TEMPLATE(IPFIX_FIELD_NAMES)
+         nullptr
+      };
+      return ipfix_tmplt;
+   }
+
+   std::string get_text() const
+   {
+      std::ostringstream out;
+      out << "appid=" << app_id
+         << ",app=\"" << app_name << "\"";
+      return out.str();
+   }
+};
+
+/**
+ * \brief Get application of flow identified by appid plugin.
+ *
+ * Plugins called after appid plugin can use it to skip flows of other applications.
+ * \param [in] rec Flow record.
+ * \return Application ID or APP_UNKNOWN when not identified (yet).
+ */
+static inline uint16_t flow_app_id(const Flow &rec)
+{
+   const RecordExtAPPID *ext = static_cast<const RecordExtAPPID *>(rec.get_extension(RecordExtAPPID::REGISTERED_ID));
+   return ext != nullptr ? ext->app_id : APP_UNKNOWN;
+}
+
+/**
+ * \brief Flow cache plugin identifying application protocol.
+ */
+class APPIDPlugin : public ProcessPlugin
+{
+public:
+   APPIDPlugin();
+   ~APPIDPlugin();
+   void init(const char *params);
+   void close();
+   OptionsParser *get_parser() const { return new APPIDOptParser(); }
+   std::string get_name() const { return "appid"; }
+   PluginInterest get_interest() const { return PluginInterest({}, {}, true); }
+   RecordExt *get_ext() const { return new RecordExtAPPID(); }
+   ProcessPlugin *copy();
+
+   int post_create(Flow &rec, const Packet &pkt);
+   int post_update(Flow &rec, const Packet &pkt);
+   void pre_export(Flow &rec);
+
+private:
+   std::shared_ptr<const AppIdAutomaton> m_automaton; /**< Shared by plugin copies */
+   uint32_t m_bytes;
+
+   int scan(Flow &rec, RecordExtAPPID *ext, const Packet &pkt);
+   static std::vector<AppSignature> load_signatures(const std::string &file);
+};
+
+}
+#endif /* IPXP_PROCESS_APPID_HPP */
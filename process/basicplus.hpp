@@ -171,6 +171,8 @@ struct RecordExtBASICPLUS : public RecordExt {
          << ",tcpsynsize=" << tcp_syn_size;
       return out.str();
    }
+
+   RECORD_EXT_PLAIN_SNAPSHOT(RecordExtBASICPLUS, 1)
 };
 
 /**
@@ -240,6 +240,8 @@ struct RecordExtBSTATS : public RecordExt {
 
       return out.str();
    }
+
+   RECORD_EXT_PLAIN_SNAPSHOT(RecordExtBSTATS, 1)
 };
 
 /**
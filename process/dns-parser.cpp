@@ -0,0 +1,234 @@
+/**
+ * \file dns-parser.cpp
+ * \brief Single pass DNS message decoder shared by DNS plugins
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <cstring>
+#include <arpa/inet.h>
+
+#include "dns-parser.hpp"
+
+namespace ipxp {
+
+/**
+ * \brief Check for label pointer in DNS name.
+ */
+#define IS_POINTER(ch) ((ch & 0xC0) == 0xC0)
+
+#define MAX_LABEL_CNT 127
+
+/**
+ * \brief Get offset from 2 byte pointer.
+ */
+#define GET_OFFSET(half1, half2) ((((uint8_t)(half1) & 0x3F) << 8) | (uint8_t)(half2))
+
+int DnsMessage::decode_name(uint32_t offset, char *out, size_t size, uint32_t *next) const
+{
+   uint32_t pos = offset;
+   uint32_t end = 0;
+   size_t len = 0;
+   int label_cnt = 0;
+
+   if (pos > length) {
+      return -1;
+   }
+
+   while (1) {
+      if (pos >= length) {
+         return -1;
+      }
+      uint8_t label = data[pos];
+      if (!label) {
+         if (!end) {
+            end = pos + 1;
+         }
+         break;
+      }
+      if (IS_POINTER(label)) { /* Check for label pointer (11xxxxxx byte) */
+         if (pos + 1 >= length) {
+            return -1;
+         }
+         if (!end) {
+            end = pos + 2;
+         }
+         pos = GET_OFFSET(label, data[pos + 1]);
+         if (label_cnt++ > MAX_LABEL_CNT || pos > length) {
+            return -1;
+         }
+         continue;
+      }
+      if (label_cnt++ > MAX_LABEL_CNT || label > 63 || pos + label + 2 > length) {
+         return -1;
+      }
+
+      if (out != nullptr) {
+         if (len != 0 && len + 1 < size) {
+            out[len++] = '.';
+         }
+         size_t copy = len + label < size ? label : (size - 1 - len);
+         memcpy(out + len, data + pos + 1, copy);
+         len += copy;
+      }
+      pos += label + 1;
+   }
+
+   if (out != nullptr && size != 0) {
+      out[len] = 0;
+   }
+   if (next != nullptr) {
+      *next = end;
+   }
+   return len;
+}
+
+DnsStatus DnsMessage::store_name(uint32_t &offset, DnsName &name)
+{
+   if (DNS_NAMES_SIZE - names_len < DNS_MAX_NAME_LEN + 1) {
+      return DNS_MSG_TRUNCATED;
+   }
+   int len = decode_name(offset, names + names_len, DNS_MAX_NAME_LEN + 1, &offset);
+   if (len < 0) {
+      return DNS_MSG_MALFORMED;
+   }
+   name.offset = names_len;
+   name.length = len;
+   names_len += len + 1;
+   return DNS_MSG_OK;
+}
+
+DnsStatus DnsMessage::parse(const uint8_t *payload, uint32_t payload_len, bool tcp)
+{
+   questions_parsed = 0;
+   rrs_parsed = 0;
+   names_len = 0;
+   status = DNS_MSG_INVALID;
+
+   if (tcp) {
+      if (payload_len < 2 || ntohs(*(uint16_t *) payload) != payload_len - 2) {
+         return status; // fragmented tcp pkt
+      }
+      payload += 2;
+      payload_len -= 2;
+   }
+   if (payload_len < sizeof(struct dns_hdr)) {
+      return status;
+   }
+
+   const struct dns_hdr *dns = (const struct dns_hdr *) payload;
+   data = payload;
+   length = payload_len;
+   id = ntohs(dns->id);
+   flags = ntohs(dns->flags);
+   question_cnt = ntohs(dns->question_rec_cnt);
+   answer_cnt = ntohs(dns->answer_rec_cnt);
+   authority_cnt = ntohs(dns->name_server_rec_cnt);
+   additional_cnt = ntohs(dns->additional_rec_cnt);
+
+   uint32_t pos = sizeof(struct dns_hdr);
+   for (int i = 0; i < question_cnt; i++) {
+      if (questions_parsed < DNS_MAX_QUESTIONS) {
+         DnsQuestion &question = questions[questions_parsed];
+         status = store_name(pos, question.name);
+         if (status != DNS_MSG_OK) {
+            return status;
+         }
+         if (pos + sizeof(struct dns_question) > length) {
+            return status = DNS_MSG_TRUNCATED;
+         }
+         const struct dns_question *q = (const struct dns_question *) (data + pos);
+         question.qtype = ntohs(q->qtype);
+         question.qclass = ntohs(q->qclass);
+         questions_parsed++;
+      } else {
+         if (decode_name(pos, nullptr, 0, &pos) < 0) {
+            return status = DNS_MSG_MALFORMED;
+         }
+         if (pos + sizeof(struct dns_question) > length) {
+            return status = DNS_MSG_TRUNCATED;
+         }
+      }
+      pos += sizeof(struct dns_question);
+   }
+
+   const uint16_t section_cnt[] = {answer_cnt, authority_cnt, additional_cnt};
+   for (int section = DNS_SECTION_ANSWER; section <= DNS_SECTION_ADDITIONAL; section++) {
+      for (int i = 0; i < section_cnt[section]; i++) {
+         if (rrs_parsed >= DNS_MAX_RRS) {
+            return status = DNS_MSG_TRUNCATED;
+         }
+         DnsRr &rr = rrs[rrs_parsed];
+         status = store_name(pos, rr.name);
+         if (status != DNS_MSG_OK) {
+            return status;
+         }
+
+         const struct dns_answer *answer = (const struct dns_answer *) (data + pos);
+         pos += sizeof(struct dns_answer);
+         if (pos > length || pos + ntohs(answer->rdlength) > length) {
+            return status = DNS_MSG_TRUNCATED;
+         }
+         rr.section = static_cast<DnsSection>(section);
+         rr.type = ntohs(answer->atype);
+         rr.rclass = ntohs(answer->aclass);
+         rr.ttl = ntohl(answer->ttl);
+         rr.rdata = pos;
+         rr.rdlength = ntohs(answer->rdlength);
+         rrs_parsed++;
+         pos += rr.rdlength;
+      }
+   }
+
+   return status = DNS_MSG_OK;
+}
+
+const DnsMessage &dns_message(const Packet &pkt)
+{
+   // Plugins of one pipeline (or DPI worker) process a packet at a time in one thread
+   static thread_local DnsMessage msg;
+
+   if (pkt.dns == nullptr) {
+      msg.parse(pkt.payload, pkt.payload_len, pkt.ip_proto == IPPROTO_TCP);
+      pkt.dns = &msg;
+   }
+   return *pkt.dns;
+}
+
+}
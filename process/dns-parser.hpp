@@ -0,0 +1,180 @@
+/**
+ * \file dns-parser.hpp
+ * \brief Single pass DNS message decoder shared by DNS plugins
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef IPXP_PROCESS_DNS_PARSER_HPP
+#define IPXP_PROCESS_DNS_PARSER_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <ipfixprobe/packet.hpp>
+#include "dns-utils.hpp"
+
+namespace ipxp {
+
+#define DNS_MAX_QUESTIONS 32
+#define DNS_MAX_RRS       128
+#define DNS_MAX_NAME_LEN  255   /**< Longest stored name, longer names are truncated */
+#define DNS_NAMES_SIZE    16384 /**< Size of scratch buffer for decompressed names */
+
+/**
+ * \brief Result of DNS message decoding.
+ */
+enum DnsStatus : uint8_t {
+   DNS_MSG_INVALID,   /**< Payload is not a DNS message, nothing decoded */
+   DNS_MSG_MALFORMED, /**< Invalid name encountered, records before it are decoded */
+   DNS_MSG_TRUNCATED, /**< Record exceeds payload, records before it are decoded */
+   DNS_MSG_OK         /**< All records decoded */
+};
+
+enum DnsSection : uint8_t {
+   DNS_SECTION_ANSWER,
+   DNS_SECTION_AUTHORITY,
+   DNS_SECTION_ADDITIONAL
+};
+
+/**
+ * \brief Decompressed name stored in DnsMessage scratch buffer.
+ */
+struct DnsName {
+   uint16_t offset; /**< Offset of null terminated name in scratch buffer */
+   uint16_t length;
+};
+
+struct DnsQuestion {
+   DnsName name;
+   uint16_t qtype;
+   uint16_t qclass;
+};
+
+/**
+ * \brief Resource record, RDATA is referenced by offset to message.
+ */
+struct DnsRr {
+   DnsName name;
+   DnsSection section;
+   uint16_t type;
+   uint16_t rclass;
+   uint32_t ttl;
+   uint16_t rdata;
+   uint16_t rdlength;
+};
+
+/**
+ * \brief View of DNS message decoded in a single pass without memory allocation.
+ *
+ * Names of questions and records are decompressed into fixed scratch buffer,
+ * names inside RDATA are decompressed on demand by decode_name.
+ */
+struct DnsMessage {
+   DnsStatus status;
+   const uint8_t *data; /**< Begin of DNS message (after TCP length prefix) */
+   uint16_t length;
+
+   uint16_t id;
+   uint16_t flags;
+   uint16_t question_cnt;   /**< Counts from header */
+   uint16_t answer_cnt;
+   uint16_t authority_cnt;
+   uint16_t additional_cnt;
+
+   uint16_t questions_parsed;
+   uint16_t rrs_parsed;
+   DnsQuestion questions[DNS_MAX_QUESTIONS];
+   DnsRr rrs[DNS_MAX_RRS];
+
+   uint16_t names_len;
+   char names[DNS_NAMES_SIZE];
+
+   /**
+    * \brief Decode DNS message.
+    * \param [in] payload Packet payload.
+    * \param [in] payload_len Payload length.
+    * \param [in] tcp DNS over TCP, message is prefixed by its length.
+    * \return Decoding status.
+    */
+   DnsStatus parse(const uint8_t *payload, uint32_t payload_len, bool tcp);
+
+   /**
+    * \brief Get decompressed name of question or record.
+    */
+   const char *name(const DnsName &name) const
+   {
+      return names + name.offset;
+   }
+
+   /**
+    * \brief Decompress name at given message offset.
+    * \param [in] offset Offset of name in message.
+    * \param [out] out Output buffer, name is truncated and null terminated, nullptr to only validate name.
+    * \param [in] size Size of output buffer.
+    * \param [out] next Offset of first byte following the name, can be nullptr.
+    * \return Length of name stored in output buffer or -1 for invalid name.
+    */
+   int decode_name(uint32_t offset, char *out, size_t size, uint32_t *next = nullptr) const;
+
+   /**
+    * \brief Check whether RDATA contains `len` bytes at `offset` (relative to RDATA).
+    */
+   bool rdata_has(const DnsRr &rr, uint32_t offset, uint32_t len) const
+   {
+      return offset + len <= rr.rdlength;
+   }
+
+private:
+   DnsStatus store_name(uint32_t &offset, DnsName &name);
+};
+
+/**
+ * \brief Get DNS message carried in packet payload.
+ *
+ * Payload is decoded by the first plugin asking for it and the view is cached on the packet
+ * until next packet enters the flow cache, so other DNS plugins do not decode it again.
+ * View is valid only during processing of the packet.
+ * \param [in] pkt Packet with DNS payload.
+ * \return Decoded message, check its status.
+ */
+const DnsMessage &dns_message(const Packet &pkt);
+
+}
+#endif /* IPXP_PROCESS_DNS_PARSER_HPP */
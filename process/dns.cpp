@@ -46,6 +46,8 @@
 #include <stdio.h>
 #include <iostream>
 #include <sstream>
+#include <cstring>
+#include <algorithm>
 #include <arpa/inet.h>
 
 #ifdef WITH_NEMEA
@@ -81,19 +83,7 @@ __attribute__((constructor)) static void register_this_plugin()
 #define DEBUG_CODE(code)
 #endif
 
-/**
- * \brief Check for label pointer in DNS name.
- */
-#define IS_POINTER(ch) ((ch & 0xC0) == 0xC0)
-
-#define MAX_LABEL_CNT 127
-
-/**
- * \brief Get offset from 2 byte pointer.
- */
-#define GET_OFFSET(half1, half2) ((((uint8_t)(half1) & 0x3F) << 8) | (uint8_t)(half2))
-
-DNSPlugin::DNSPlugin() : queries(0), responses(0), total(0), data_begin(nullptr), data_len(0)
+DNSPlugin::DNSPlugin() : queries(0), responses(0), total(0)
 {
 }
 
@@ -118,7 +108,7 @@ ProcessPlugin *DNSPlugin::copy()
 int DNSPlugin::post_create(Flow &rec, const Packet &pkt)
 {
    if (pkt.dst_port == 53 || pkt.src_port == 53) {
-      return add_ext_dns(reinterpret_cast<const char *>(pkt.payload), pkt.payload_len, pkt.ip_proto == IPPROTO_TCP, rec);
+      return add_ext_dns(dns_message(pkt), rec);
    }
 
    return 0;
@@ -129,9 +119,9 @@ int DNSPlugin::post_update(Flow &rec, const Packet &pkt)
    if (pkt.dst_port == 53 || pkt.src_port == 53) {
       RecordExt *ext = rec.get_extension(RecordExtDNS::REGISTERED_ID);
       if (ext == nullptr) {
-         return add_ext_dns(reinterpret_cast<const char *>(pkt.payload), pkt.payload_len, pkt.ip_proto == IPPROTO_TCP, rec);
+         return add_ext_dns(dns_message(pkt), rec);
       } else {
-         parse_dns(reinterpret_cast<const char *>(pkt.payload), pkt.payload_len, pkt.ip_proto == IPPROTO_TCP, static_cast<RecordExtDNS *>(ext));
+         parse_dns(dns_message(pkt), static_cast<RecordExtDNS *>(ext));
       }
       return FLOW_FLUSH;
    }
@@ -150,538 +140,322 @@ void DNSPlugin::finish(bool print_stats)
 }
 
 /**
- * \brief Get name length.
- * \param [in] data Pointer to string.
- * \return Number of characters in string.
+ * \brief Bounded writer of text into fixed size buffer.
  */
-size_t DNSPlugin::get_name_length(const char *data) const
-{
-   size_t len = 0;
-
-   while (1) {
-      if ((uint32_t) (data - data_begin) + 1 > data_len) {
-         throw "Error: overflow";
-      }
-      if (!data[0]) {
-         break;
-      }
-      if (IS_POINTER(data[0])) {
-         return len + 2;
-      }
-
-      len += (uint8_t) data[0] + 1;
-      data += (uint8_t) data[0] + 1;
+struct RdataWriter {
+   char *out;
+   size_t size;
+   size_t len;
+
+   RdataWriter(char *buffer, size_t buffer_size) : out(buffer), size(buffer_size), len(0)
+   {
+      out[0] = 0;
    }
 
-   return len + 1;
-}
-
-/**
- * \brief Decompress dns name.
- * \param [in] data Pointer to compressed data.
- * \return String with decompressed dns name.
- */
-std::string DNSPlugin::get_name(const char *data) const
-{
-   std::string name = "";
-   int label_cnt = 0;
-
-   if ((uint32_t) (data - data_begin) > data_len) {
-      throw "Error: overflow";
+   void append(const char *str, size_t str_len)
+   {
+      str_len = std::min(str_len, size - 1 - len);
+      memcpy(out + len, str, str_len);
+      len += str_len;
+      out[len] = 0;
    }
 
-   while (data[0]) { /* Check for terminating character. */
-      if (IS_POINTER(data[0])) { /* Check for label pointer (11xxxxxx byte) */
-         data = data_begin + GET_OFFSET(data[0], data[1]);
-
-         /* Check for possible errors.*/
-         if (label_cnt++ > MAX_LABEL_CNT || (uint32_t) (data - data_begin) > data_len) {
-            throw "Error: label count exceed or overflow";
-         }
-
-         continue;
-      }
-
-      /* Check for possible errors.*/
-      if (label_cnt++ > MAX_LABEL_CNT || (uint8_t) data[0] > 63 ||
-         (uint32_t) ((data - data_begin) + (uint8_t) data[0] + 2) > data_len) {
-         throw "Error: label count exceed or overflow";
-      }
-
-      name += '.' + std::string(data + 1, (uint8_t) data[0]);
-      data += ((uint8_t) data[0] + 1);
+   void append(const char *str)
+   {
+      append(str, strlen(str));
    }
 
-   if (name[0] == '.') {
-      name.erase(0, 1);
+   void append(uint32_t num)
+   {
+      char tmp[11];
+      append(tmp, snprintf(tmp, sizeof(tmp), "%u", num));
    }
 
-   return name;
-}
+   /**
+    * \brief Append name decompressed from message.
+    * \return False for invalid name.
+    */
+   bool append(const DnsMessage &msg, uint32_t offset, uint32_t *next = nullptr)
+   {
+      int name_len = msg.decode_name(offset, out + len, size - len, next);
+      if (name_len < 0) {
+         out[len] = 0;
+         return false;
+      }
+      len += name_len;
+      return true;
+   }
+};
 
 /**
  * \brief Process SRV strings.
  * \param [in,out] str Raw SRV string.
  */
-void DNSPlugin::process_srv(std::string &str) const
+void DNSPlugin::process_srv(char *str) const
 {
-   bool underline_found = false;
-   for (int i = 0; str[i]; i++) {
-      if (str[i] == '_') {
-         str.erase(i--, 1);
-         if (underline_found) {
-            break;
-         }
-         underline_found = true;
+   int underlines = 0;
+   size_t len = 0;
+   for (size_t i = 0; str[i]; i++) {
+      if (str[i] == '_' && underlines < 2) {
+         underlines++;
+         continue;
       }
+      str[len++] = str[i];
    }
-   size_t pos = str.find('.');
-   if (pos != std::string::npos) {
-      str[pos] = ' ';
+   str[len] = 0;
+
+   char *pos = strchr(str, '.');
+   if (pos != nullptr) {
+      *pos = ' ';
 
-      pos = str.find('.', pos);
-      if (pos != std::string::npos) {
-         str[pos] = ' ';
+      pos = strchr(pos, '.');
+      if (pos != nullptr) {
+         *pos = ' ';
       }
    }
 }
 
 /**
  * \brief Process RDATA section.
- * \param [in] record_begin Pointer to start of current resource record.
- * \param [in] data Pointer to RDATA section.
- * \param [out] rdata String which stores processed data.
- * \param [in] type Type of RDATA section.
- * \param [in] length Length of RDATA section.
+ * \param [in] msg Decoded DNS message.
+ * \param [in] rr Resource record.
+ * \param [out] out Buffer which stores processed data.
+ * \param [in] size Size of buffer.
+ * \return Length of processed data or -1 when RDATA contains invalid name.
  */
-void DNSPlugin::process_rdata(const char *record_begin, const char *data, std::ostringstream &rdata, uint16_t type, size_t length) const
+int DNSPlugin::process_rdata(const DnsMessage &msg, const DnsRr &rr, char *out, size_t size) const
 {
-   rdata.str("");
-   rdata.clear();
+   RdataWriter rdata(out, size);
+   const uint8_t *data = msg.data + rr.rdata;
+   size_t length = rr.rdlength;
+   bool valid = true;
 
-   switch (type){
+   switch (rr.type) {
    case DNS_TYPE_A:
-      rdata << inet_ntoa(*(struct in_addr *) (data));
-      DEBUG_MSG("\tData A:\t\t\t%s\n",       rdata.str().c_str());
+      if (msg.rdata_has(rr, 0, 4)) {
+         char addr[INET_ADDRSTRLEN];
+         inet_ntop(AF_INET, (const void *) data, addr, INET_ADDRSTRLEN);
+         rdata.append(addr);
+      }
+      DEBUG_MSG("\tData A:\t\t\t%s\n",       out);
       break;
    case DNS_TYPE_AAAA:
-      {
+      if (msg.rdata_has(rr, 0, 16)) {
          char addr[INET6_ADDRSTRLEN];
          inet_ntop(AF_INET6, (const void *) data, addr, INET6_ADDRSTRLEN);
-         rdata << addr;
-         DEBUG_MSG("\tData AAAA:\t\t%s\n",   rdata.str().c_str());
+         rdata.append(addr);
       }
+      DEBUG_MSG("\tData AAAA:\t\t%s\n",      out);
       break;
    case DNS_TYPE_NS:
-      rdata << get_name(data);
-      DEBUG_MSG("\tData NS:\t\t\t%s\n",      rdata.str().c_str());
-      break;
    case DNS_TYPE_CNAME:
-      rdata << get_name(data);
-      DEBUG_MSG("\tData CNAME:\t\t%s\n",     rdata.str().c_str());
-      break;
    case DNS_TYPE_PTR:
-      rdata << get_name(data);
-      DEBUG_MSG("\tData PTR:\t\t%s\n",       rdata.str().c_str());
-      break;
    case DNS_TYPE_DNAME:
-      rdata << get_name(data);
-      DEBUG_MSG("\tData DNAME:\t\t%s\n",     rdata.str().c_str());
+      valid = rdata.append(msg, rr.rdata);
+      DEBUG_MSG("\tData %u:\t\t\t%s\n",      rr.type, out);
       break;
    case DNS_TYPE_SOA:
       {
-         rdata << get_name(data);
-         data += get_name_length(data);
-         std::string tmp = get_name(data);
-         data += get_name_length(data);
-
-         DEBUG_MSG("\t\tMName:\t\t%s\n",     rdata.str().c_str());
-         DEBUG_MSG("\t\tRName:\t\t%s\n",     tmp.c_str());
-
-         rdata << " " << tmp;
-
-         struct dns_soa *soa = (struct dns_soa *) data;
-         DEBUG_MSG("\t\tSerial:\t\t%u\n",    ntohl(soa->serial));
-         DEBUG_MSG("\t\tRefresh:\t%u\n",     ntohl(soa->refresh));
-         DEBUG_MSG("\t\tRetry:\t\t%u\n",     ntohl(soa->retry));
-         DEBUG_MSG("\t\tExpiration:\t%u\n",  ntohl(soa->expiration));
-         DEBUG_MSG("\t\tMin TTL:\t%u\n",     ntohl(soa->ttl));
-         rdata << " " << ntohl(soa->serial) << " " << ntohl(soa->refresh) << " "
-               << ntohl(soa->retry) << " " << ntohl(soa->expiration) << " " << ntohl(soa->ttl);
+         uint32_t next;
+         valid = rdata.append(msg, rr.rdata, &next);
+         if (valid) {
+            rdata.append(" ");
+            valid = rdata.append(msg, next, &next);
+         }
+         if (valid && next + sizeof(struct dns_soa) <= (uint32_t) rr.rdata + length) {
+            const struct dns_soa *soa = (const struct dns_soa *) (msg.data + next);
+            rdata.append(" "); rdata.append(ntohl(soa->serial));
+            rdata.append(" "); rdata.append(ntohl(soa->refresh));
+            rdata.append(" "); rdata.append(ntohl(soa->retry));
+            rdata.append(" "); rdata.append(ntohl(soa->expiration));
+            rdata.append(" "); rdata.append(ntohl(soa->ttl));
+         }
+         DEBUG_MSG("\tData SOA:\t\t%s\n",    out);
       }
       break;
    case DNS_TYPE_SRV:
-      {
-         DEBUG_MSG("\tData SRV:\n");
-         std::string tmp = get_name(record_begin);
-         process_srv(tmp);
-         struct dns_srv *srv = (struct dns_srv *) data;
-
-         DEBUG_MSG("\t\tPriority:\t%u\n",    ntohs(srv->priority));
-         DEBUG_MSG("\t\tWeight:\t\t%u\n",    ntohs(srv->weight));
-         DEBUG_MSG("\t\tPort:\t\t%u\n",      ntohs(srv->port));
+      if (msg.rdata_has(rr, 0, sizeof(struct dns_srv))) {
+         const struct dns_srv *srv = (const struct dns_srv *) data;
+         char tmp[DNS_MAX_NAME_LEN + 1];
 
-         rdata << tmp << " ";
-         tmp = get_name(data + 6);
-
-         DEBUG_MSG("\t\tTarget:\t\t%s\n", tmp.c_str());
-         rdata << tmp << " " << ntohs(srv->priority) << " " <<  ntohs(srv->weight) << " " << ntohs(srv->port);
+         memcpy(tmp, msg.name(rr.name), rr.name.length + 1);
+         process_srv(tmp);
+         rdata.append(tmp);
+         rdata.append(" ");
+         valid = rdata.append(msg, rr.rdata + sizeof(struct dns_srv));
+         if (valid) {
+            rdata.append(" "); rdata.append(ntohs(srv->priority));
+            rdata.append(" "); rdata.append(ntohs(srv->weight));
+            rdata.append(" "); rdata.append(ntohs(srv->port));
+         }
+         DEBUG_MSG("\tData SRV:\t\t%s\n",    out);
       }
       break;
    case DNS_TYPE_MX:
-      {
-         uint16_t preference = ntohs(*(uint16_t *) data);
-         rdata << preference << " " << get_name(data + 2);
-         DEBUG_MSG("\tData MX:\n");
-         DEBUG_MSG("\t\tPreference:\t%u\n",     preference);
-         DEBUG_MSG("\t\tMail exchanger:\t%s\n", get_name(data + 2).c_str());
+      if (msg.rdata_has(rr, 0, 2)) {
+         rdata.append(ntohs(*(const uint16_t *) data));
+         rdata.append(" ");
+         valid = rdata.append(msg, rr.rdata + 2);
+         DEBUG_MSG("\tData MX:\t\t%s\n",     out);
       }
       break;
    case DNS_TYPE_TXT:
       {
-         DEBUG_MSG("\tData TXT:\n");
-
-         size_t len = (uint8_t) *(data++);
+         size_t pos = 0;
+         size_t len = length != 0 ? data[pos] : 0;
          size_t total_len = len + 1;
 
+         pos++;
          while (length != 0 && total_len <= length) {
-            DEBUG_MSG("\t\tTXT data:\t%s\n",    std::string(data, len).c_str());
-            rdata << std::string(data, len);
+            rdata.append((const char *) data + pos, len);
 
-            data += len;
-            len = (uint8_t) *(data++);
+            pos += len;
+            len = pos < length ? data[pos] : 0;
+            pos++;
             total_len += len + 1;
 
             if (total_len <= length) {
-               rdata << " ";
+               rdata.append(" ");
             }
          }
+         DEBUG_MSG("\tData TXT:\t\t%s\n",    out);
       }
       break;
    case DNS_TYPE_MINFO:
-      DEBUG_MSG("\tData MINFO:\n");
-      rdata << get_name(data);
-      DEBUG_MSG("\t\tRMAILBX:\t%s\n",  rdata.str().c_str());
-      data += get_name_length(data);
-
-      rdata << get_name(data);
-      DEBUG_MSG("\t\tEMAILBX:\t%s\n",  get_name(data).c_str());
+      {
+         uint32_t next;
+         valid = rdata.append(msg, rr.rdata, &next) && rdata.append(msg, next);
+         DEBUG_MSG("\tData MINFO:\t\t%s\n",  out);
+      }
       break;
    case DNS_TYPE_HINFO:
-      DEBUG_MSG("\tData HINFO:\n");
-      rdata << std::string(data, length);
-      DEBUG_MSG("\t\tData:\t%s\n", rdata.str().c_str());
-      break;
    case DNS_TYPE_ISDN:
-      DEBUG_MSG("\tData ISDN:\n");
-      rdata << std::string(data, length);
-      DEBUG_MSG("\t\tData:\t%s\n", rdata.str().c_str());
+      rdata.append((const char *) data, length);
+      DEBUG_MSG("\tData %u:\t\t%s\n",        rr.type, out);
       break;
    case DNS_TYPE_DS:
-      {
-         struct dns_ds *ds = (struct dns_ds *) data;
-         DEBUG_MSG("\tData DS:\n");
-         DEBUG_MSG("\t\tKey tag:\t%u\n",        ntohs(ds->keytag));
-         DEBUG_MSG("\t\tAlgorithm:\t%u\n",      ds->algorithm);
-         DEBUG_MSG("\t\tDigest type:\t%u\n",    ds->digest_type);
-         DEBUG_MSG("\t\tDigest:\t\t(binary)\n");
-         rdata << ntohs(ds->keytag) << " " << (uint16_t) ds->keytag << " "
-               << (uint16_t) ds->digest_type << " <key>";
+      if (msg.rdata_has(rr, 0, sizeof(struct dns_ds))) {
+         const struct dns_ds *ds = (const struct dns_ds *) data;
+         rdata.append(ntohs(ds->keytag));
+         rdata.append(" "); rdata.append((uint16_t) ds->keytag);
+         rdata.append(" "); rdata.append(ds->digest_type);
+         rdata.append(" <key>");
+         DEBUG_MSG("\tData DS:\t\t%s\n",     out);
       }
       break;
    case DNS_TYPE_RRSIG:
-      {
-         struct dns_rrsig *rrsig = (struct dns_rrsig *) data;
-         std::string tmp = "";
-         DEBUG_MSG("\tData RRSIG:\n");
-         DEBUG_MSG("\t\tType:\t\t%u\n",         ntohs(rrsig->type));
-         DEBUG_MSG("\t\tAlgorithm:\t%u\n",      rrsig->algorithm);
-         DEBUG_MSG("\t\tLabels:\t\t%u\n",       rrsig->labels);
-         DEBUG_MSG("\t\tTTL:\t\t%u\n",          ntohl(rrsig->ttl));
-         DEBUG_MSG("\t\tSig expiration:\t%u\n", ntohl(rrsig->sig_expiration));
-         DEBUG_MSG("\t\tSig inception:\t%u\n",  ntohl(rrsig->sig_inception));
-         DEBUG_MSG("\t\tKey tag:\t%u\n",        ntohs(rrsig->keytag));
-         rdata << ntohs(rrsig->type) << " " << (uint16_t) rrsig->algorithm << " " // Conversion needed, otherwise uint8_t will be threated as a char.
-               << (uint16_t) rrsig->labels << " " << ntohl(rrsig->ttl) << " "
-               << ntohl(rrsig->sig_expiration) << " " << ntohl(rrsig->sig_inception)
-               << " " << ntohs(rrsig->keytag) << " <key>";
-
-         tmp = get_name(data + 18);
-         DEBUG_MSG("\t\tSigner's name:\t%s\n",  tmp.c_str());
-         DEBUG_MSG("\t\tSignature:\t(binary)\n");
+      if (msg.rdata_has(rr, 0, sizeof(struct dns_rrsig))) {
+         const struct dns_rrsig *rrsig = (const struct dns_rrsig *) data;
+         rdata.append(ntohs(rrsig->type));
+         rdata.append(" "); rdata.append(rrsig->algorithm);
+         rdata.append(" "); rdata.append(rrsig->labels);
+         rdata.append(" "); rdata.append(ntohl(rrsig->ttl));
+         rdata.append(" "); rdata.append(ntohl(rrsig->sig_expiration));
+         rdata.append(" "); rdata.append(ntohl(rrsig->sig_inception));
+         rdata.append(" "); rdata.append(ntohs(rrsig->keytag));
+         rdata.append(" <key>");
+         DEBUG_MSG("\tData RRSIG:\t\t%s\n",  out);
       }
       break;
    case DNS_TYPE_DNSKEY:
-      {
-         struct dns_dnskey *dnskey = (struct dns_dnskey *) data;
-         DEBUG_MSG("\tData DNSKEY:\n");
-         DEBUG_MSG("\t\tFlags:\t\t%u\n",        ntohs(dnskey->flags));
-         DEBUG_MSG("\t\tProtocol:\t%u\n",       dnskey->protocol);
-         DEBUG_MSG("\t\tAlgorithm:\t%u\n",      dnskey->algorithm);
-
-         rdata << ntohs(dnskey->flags) << " " << (uint16_t) dnskey->protocol << " " << (uint16_t) dnskey->algorithm << " <key>";
-         DEBUG_MSG("\t\tPublic key:\t(binary data)\n");
+      if (msg.rdata_has(rr, 0, sizeof(struct dns_dnskey))) {
+         const struct dns_dnskey *dnskey = (const struct dns_dnskey *) data;
+         rdata.append(ntohs(dnskey->flags));
+         rdata.append(" "); rdata.append(dnskey->protocol);
+         rdata.append(" "); rdata.append(dnskey->algorithm);
+         rdata.append(" <key>");
+         DEBUG_MSG("\tData DNSKEY:\t\t%s\n", out);
       }
       break;
    default:
       DEBUG_MSG("\tData:\t\t\t(format not supported yet)\n");
-      rdata << "(not_impl)";
+      rdata.append("(not_impl)");
       break;
    }
-}
 
-#ifdef DEBUG_DNS
-uint32_t s_queries = 0;
-uint32_t s_responses = 0;
-#endif /* DEBUG_DNS */
+   return valid ? rdata.len : -1;
+}
 
 /**
- * \brief Parse and store DNS packet.
- * \param [in] data Pointer to packet payload section.
- * \param [in] payload_len Payload length.
- * \param [in] tcp DNS over tcp.
+ * \brief Store DNS packet.
+ * \param [in] msg Decoded DNS message.
  * \param [out] rec Output Flow extension header.
  * \return True if DNS was parsed.
  */
-bool DNSPlugin::parse_dns(const char *data, unsigned int payload_len, bool tcp, RecordExtDNS *rec)
+bool DNSPlugin::parse_dns(const DnsMessage &msg, RecordExtDNS *rec)
 {
-   try {
-      total++;
-
-      DEBUG_MSG("---------- dns parser #%u ----------\n", total);
-      DEBUG_MSG("Payload length: %u\n", payload_len);
-
-      if (tcp) {
-         payload_len -= 2;
-         if (ntohs(*(uint16_t *) data) != payload_len) {
-            DEBUG_MSG("parser quits: fragmented tcp pkt");
-            return false;
-         }
-         data += 2;
-      }
-
-      if (payload_len < sizeof(struct dns_hdr)) {
-         DEBUG_MSG("parser quits: payload length < %ld\n", sizeof(struct dns_hdr));
-         return false;
-      }
-
-      data_begin = data;
-      data_len = payload_len;
-
-      struct dns_hdr *dns = (struct dns_hdr *) data;
-      uint16_t flags = ntohs(dns->flags);
-      uint16_t question_cnt = ntohs(dns->question_rec_cnt);
-      uint16_t answer_rr_cnt = ntohs(dns->answer_rec_cnt);
-      uint16_t authority_rr_cnt = ntohs(dns->name_server_rec_cnt);
-      uint16_t additional_rr_cnt = ntohs(dns->additional_rec_cnt);
-
-      rec->answers = answer_rr_cnt;
-      rec->id = ntohs(dns->id);
-      rec->rcode = DNS_HDR_GET_RESPCODE(flags);
-
-      DEBUG_MSG("%s number: %u\n",                    DNS_HDR_GET_QR(flags) ? "Response" : "Query",
-                                                      DNS_HDR_GET_QR(flags) ? s_queries++ : s_responses++);
-      DEBUG_MSG("DNS message header\n");
-      DEBUG_MSG("\tTransaction ID:\t\t%#06x\n",       ntohs(dns->id));
-      DEBUG_MSG("\tFlags:\t\t\t%#06x\n",              ntohs(dns->flags));
-
-      DEBUG_MSG("\t\tQuestion/reply:\t\t%u\n",        DNS_HDR_GET_QR(flags));
-      DEBUG_MSG("\t\tOP code:\t\t%u\n",               DNS_HDR_GET_OPCODE(flags));
-      DEBUG_MSG("\t\tAuthoritative answer:\t%u\n",    DNS_HDR_GET_AA(flags));
-      DEBUG_MSG("\t\tTruncation:\t\t%u\n",            DNS_HDR_GET_TC(flags));
-      DEBUG_MSG("\t\tRecursion desired:\t%u\n",       DNS_HDR_GET_RD(flags));
-      DEBUG_MSG("\t\tRecursion available:\t%u\n",     DNS_HDR_GET_RA(flags));
-      DEBUG_MSG("\t\tReserved:\t\t%u\n",              DNS_HDR_GET_Z(flags));
-      DEBUG_MSG("\t\tAuth data:\t\t%u\n",             DNS_HDR_GET_AD(flags));
-      DEBUG_MSG("\t\tChecking disabled:\t%u\n",       DNS_HDR_GET_CD(flags));
-      DEBUG_MSG("\t\tResponse code:\t\t%u\n",         DNS_HDR_GET_RESPCODE(flags));
-
-      DEBUG_MSG("\tQuestions:\t\t%u\n",               question_cnt);
-      DEBUG_MSG("\tAnswer RRs:\t\t%u\n",              answer_rr_cnt);
-      DEBUG_MSG("\tAuthority RRs:\t\t%u\n",           authority_rr_cnt);
-      DEBUG_MSG("\tAdditional RRs:\t\t%u\n",          additional_rr_cnt);
-
-      /********************************************************************
-      *****                   DNS Question section                    *****
-      ********************************************************************/
-      data += sizeof(struct dns_hdr);
-      for (int i = 0; i < question_cnt; i++) {
-         DEBUG_MSG("\nDNS question #%d\n",            i + 1);
-         std::string name = get_name(data);
-         DEBUG_MSG("\tName:\t\t\t%s\n",               name.c_str());
-
-         data += get_name_length(data);
-         struct dns_question *question = (struct dns_question *) data;
-
-         if ((data - data_begin) + sizeof(struct dns_question) > payload_len) {
-            DEBUG_MSG("DNS parser quits: overflow\n\n");
-            return 1;
-         }
-
-         if (i == 0) { // Copy only first question.
-            rec->qtype = ntohs(question->qtype);
-            rec->qclass = ntohs(question->qclass);
-
-            size_t length = name.length();
-            if (length >= sizeof(rec->qname)) {
-               DEBUG_MSG("Truncating qname (length = %lu) to %lu.\n", length, sizeof(rec->qname) - 1);
-               length = sizeof(rec->qname) - 1;
-            }
-            memcpy(rec->qname, name.c_str(), length);
-            rec->qname[length] = 0;
-         }
-         DEBUG_MSG("\tType:\t\t\t%u\n",               ntohs(question->qtype));
-         DEBUG_MSG("\tClass:\t\t\t%u\n",              ntohs(question->qclass));
-         data += sizeof(struct dns_question);
-      }
-
-      /********************************************************************
-      *****                    DNS Answers section                    *****
-      ********************************************************************/
-      const char *record_begin;
-      size_t rdlength;
-      std::ostringstream rdata;
-      for (int i = 0; i < answer_rr_cnt; i++) { // Process answers section.
-         record_begin = data;
-
-         DEBUG_MSG("DNS answer #%d\n", i + 1);
-         DEBUG_MSG("\tAnswer name:\t\t%s\n",          get_name(data).c_str());
-         data += get_name_length(data);
-
-         struct dns_answer *answer = (struct dns_answer *) data;
-
-         uint32_t tmp = (data - data_begin) + sizeof(dns_answer);
-         if (tmp > payload_len || tmp + ntohs(answer->rdlength) > payload_len) {
-            DEBUG_MSG("DNS parser quits: overflow\n\n");
-            return 1;
-         }
+   total++;
 
-         DEBUG_MSG("\tType:\t\t\t%u\n",               ntohs(answer->atype));
-         DEBUG_MSG("\tClass:\t\t\t%u\n",              ntohs(answer->aclass));
-         DEBUG_MSG("\tTTL:\t\t\t%u\n",                ntohl(answer->ttl));
-         DEBUG_MSG("\tRD length:\t\t%u\n",            ntohs(answer->rdlength));
-
-         data += sizeof(struct dns_answer);
-         rdlength = ntohs(answer->rdlength);
-
-         if (i == 0) { // Copy only first answer.
-            process_rdata(record_begin, data, rdata, ntohs(answer->atype), rdlength);
-            rec->rr_ttl = ntohl(answer->ttl);
-
-            size_t length = rdata.str().length();
-            if (length >= sizeof(rec->data)) {
-               DEBUG_MSG("Truncating rdata (length = %lu) to %lu.\n", length, sizeof(rec->data) - 1);
-               length = sizeof(rec->data) - 1;
-            }
-            memcpy(rec->data, rdata.str().c_str(), length); // Copy processed rdata.
-            rec->data[length] = 0; // Add terminating '\0' char.
-            rec->rlength = length; // Report length.
-         }
-         data += rdlength;
-      }
-
-      /********************************************************************
-      *****                 DNS Authority RRs section                 *****
-      ********************************************************************/
-
-      for (int i = 0; i < authority_rr_cnt; i++) { // Unused yet.
-         record_begin = data;
-
-         DEBUG_MSG("DNS authority RR #%d\n", i + 1);
-         DEBUG_MSG("\tAnswer name:\t\t%s\n",          get_name(data).c_str());
-         data += get_name_length(data);
-
-         struct dns_answer *answer = (struct dns_answer *) data;
+   DEBUG_MSG("---------- dns parser #%u ----------\n", total);
+   if (msg.status == DNS_MSG_INVALID || msg.status == DNS_MSG_MALFORMED) {
+      DEBUG_MSG("DNS parser quits: not a valid DNS message\n\n");
+      return false;
+   }
 
-         uint32_t tmp = (data - data_begin) + sizeof(dns_answer);
-         if (tmp > payload_len || tmp + ntohs(answer->rdlength) > payload_len) {
-            DEBUG_MSG("DNS parser quits: overflow\n\n");
-            return 1;
-         }
+   DEBUG_MSG("%s, transaction ID %#06x, flags %#06x\n", DNS_HDR_GET_QR(msg.flags) ? "Response" : "Query", msg.id, msg.flags);
+   DEBUG_MSG("\tQuestions: %u, answer RRs: %u, authority RRs: %u, additional RRs: %u\n",
+             msg.question_cnt, msg.answer_cnt, msg.authority_cnt, msg.additional_cnt);
 
-         DEBUG_MSG("\tType:\t\t\t%u\n",               ntohs(answer->atype));
-         DEBUG_MSG("\tClass:\t\t\t%u\n",              ntohs(answer->aclass));
-         DEBUG_MSG("\tTTL:\t\t\t%u\n",                ntohl(answer->ttl));
-         DEBUG_MSG("\tRD length:\t\t%u\n",            ntohs(answer->rdlength));
+   rec->answers = msg.answer_cnt;
+   rec->id = msg.id;
+   rec->rcode = DNS_HDR_GET_RESPCODE(msg.flags);
 
-         data += sizeof(struct dns_answer);
-         rdlength = ntohs(answer->rdlength);
-         DEBUG_CODE(process_rdata(record_begin, data, rdata, ntohs(answer->atype), rdlength));
+   if (msg.questions_parsed) { // Copy only first question.
+      const DnsQuestion &question = msg.questions[0];
+      size_t length = question.name.length;
 
-         data += rdlength;
+      rec->qtype = question.qtype;
+      rec->qclass = question.qclass;
+      if (length >= sizeof(rec->qname)) {
+         DEBUG_MSG("Truncating qname (length = %lu) to %lu.\n", length, sizeof(rec->qname) - 1);
+         length = sizeof(rec->qname) - 1;
       }
+      memcpy(rec->qname, msg.name(question.name), length);
+      rec->qname[length] = 0;
+      DEBUG_MSG("\tQuestion:\t\t%s, type %u, class %u\n", rec->qname, rec->qtype, rec->qclass);
+   }
 
-      /********************************************************************
-      *****                 DNS Additional RRs section                *****
-      ********************************************************************/
-      for (int i = 0; i < additional_rr_cnt; i++) { // Unused yet.
-         record_begin = data;
-
-         DEBUG_MSG("DNS additional RR #%d\n", i + 1);
-         DEBUG_MSG("\tAnswer name:\t\t%s\n",          get_name(data).c_str());
-         data += get_name_length(data);
-
-         struct dns_answer *answer = (struct dns_answer *) data;
+   bool first_answer = true;
+   for (int i = 0; i < msg.rrs_parsed; i++) {
+      const DnsRr &rr = msg.rrs[i];
 
-         uint32_t tmp = (data - data_begin) + sizeof(dns_answer);
-         if (tmp > payload_len || tmp + ntohs(answer->rdlength) > payload_len) {
-            DEBUG_MSG("DNS parser quits: overflow\n\n");
-            return 1;
-         }
-
-         DEBUG_MSG("\tType:\t\t\t%u\n",               ntohs(answer->atype));
-         if (ntohs(answer->atype) != DNS_TYPE_OPT) {
-            DEBUG_MSG("\tClass:\t\t\t%u\n",           ntohs(answer->aclass));
-            DEBUG_MSG("\tTTL:\t\t\t%u\n",             ntohl(answer->ttl));
-            DEBUG_MSG("\tRD length:\t\t%u\n",         ntohs(answer->rdlength));
-
-            data += sizeof(struct dns_answer);
-            rdlength = ntohs(answer->rdlength);
-            DEBUG_CODE(process_rdata(record_begin, data, rdata, ntohs(answer->atype), rdlength));
-         } else { // Process OPT record.
-            DEBUG_MSG("\tReq UDP payload:\t%u\n",     ntohs(answer->aclass));
-            DEBUG_CODE(uint32_t ttl = ntohl(answer->ttl));
-            DEBUG_MSG("\tExtended RCODE:\t\t%#x\n",   (ttl & 0xFF000000) >> 24);
-            DEBUG_MSG("\tVersion:\t\t%#x\n",          (ttl & 0x00FF0000) >> 16);
-            DEBUG_MSG("\tDO bit:\t\t\t%u\n",          ((ttl & 0x8000) >> 15));
-            DEBUG_MSG("\tReserved:\t\t%u\n",          (ttl & 0x7FFF));
-            DEBUG_MSG("\tRD length:\t\t%u\n",         ntohs(answer->rdlength));
-
-            data += sizeof(struct dns_answer);
-            rdlength = ntohs(answer->rdlength);
-            rec->psize = ntohs(answer->aclass); // Copy requested UDP payload size. RFC 6891
-            rec->dns_do = ((ntohl(answer->ttl) & 0x8000) >> 15); // Copy DO bit.
+      DEBUG_MSG("DNS RR #%d (section %u):\t%s, type %u, class %u, ttl %u, rdlength %u\n", i + 1,
+                rr.section, msg.name(rr.name), rr.type, rr.rclass, rr.ttl, rr.rdlength);
+      if (rr.section == DNS_SECTION_ANSWER && first_answer) { // Copy only first answer.
+         int length = process_rdata(msg, rr, rec->data, sizeof(rec->data));
+         if (length < 0) {
+            DEBUG_MSG("DNS parser quits: invalid name in rdata\n\n");
+            return false;
          }
-
-         data += rdlength;
-      }
-
-      if (DNS_HDR_GET_QR(flags)) {
-         responses++;
-      } else {
-         queries++;
+         rec->rr_ttl = rr.ttl;
+         rec->rlength = length; // Report length.
+         first_answer = false;
+      } else if (rr.section == DNS_SECTION_ADDITIONAL && rr.type == DNS_TYPE_OPT) {
+         rec->psize = rr.rclass; // Copy requested UDP payload size. RFC 6891
+         rec->dns_do = ((rr.ttl & 0x8000) >> 15); // Copy DO bit.
+         DEBUG_MSG("\tReq UDP payload:\t%u, DO bit:\t%u\n", rec->psize, rec->dns_do);
       }
+   }
 
-      DEBUG_MSG("DNS parser quits: parsing done\n\n");
-   } catch (const char *err) {
-      DEBUG_MSG("%s\n", err);
-      return false;
+   if (DNS_HDR_GET_QR(msg.flags)) {
+      responses++;
+   } else {
+      queries++;
    }
 
+   DEBUG_MSG("DNS parser quits: parsing done\n\n");
    return true;
 }
 
 /**
  * \brief Add new extension DNS header into Flow.
- * \param [in] data Pointer to packet payload section.
- * \param [in] payload_len Payload length.
- * \param [in] tcp DNS over tcp.
+ * \param [in] msg Decoded DNS message.
  * \param [out] rec Destination Flow.
  */
-int DNSPlugin::add_ext_dns(const char *data, unsigned int payload_len, bool tcp, Flow &rec)
+int DNSPlugin::add_ext_dns(const DnsMessage &msg, Flow &rec)
 {
    RecordExtDNS *ext = new RecordExtDNS();
-   if (!parse_dns(data, payload_len, tcp, ext)) {
+   if (!parse_dns(msg, ext)) {
       delete ext;
       return 0;
    } else {
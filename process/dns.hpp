@@ -58,6 +58,7 @@
 #include <ipfixprobe/packet.hpp>
 #include <ipfixprobe/ipfix-elements.hpp>
 #include "dns-utils.hpp"
+#include "dns-parser.hpp"
 
 namespace ipxp {
 
@@ -186,6 +187,8 @@ struct RecordExtDNS : public RecordExt {
          << ",dnsdo=" << dns_do;
       return out.str();
    }
+
+   RECORD_EXT_PLAIN_SNAPSHOT(RecordExtDNS, 1)
 };
 
 /**
@@ -200,6 +203,7 @@ public:
    void close();
    OptionsParser *get_parser() const { return new OptionsParser("dns", "Parse DNS packets"); }
    std::string get_name() const { return "dns"; }
+   PluginInterest get_interest() const { return PluginInterest({}, {53}, true); }
    RecordExt *get_ext() const { return new RecordExtDNS(); }
    ProcessPlugin *copy();
 
@@ -212,16 +216,10 @@ private:
    uint32_t responses;     /**< Total number of parsed DNS responses. */
    uint32_t total;         /**< Total number of parsed DNS packets. */
 
-   const char *data_begin; /**< Pointer to begin of payload. */
-   uint32_t data_len;      /**< Length of packet payload. */
-
-   bool parse_dns(const char *data, unsigned int payload_len, bool tcp, RecordExtDNS *rec);
-   int  add_ext_dns(const char *data, unsigned int payload_len, bool tcp, Flow &rec);
-   void process_srv(std::string &str) const;
-   void process_rdata(const char *record_begin, const char *data, std::ostringstream &rdata, uint16_t type, size_t length) const;
-
-   std::string get_name(const char *data) const;
-   size_t get_name_length(const char *data) const;
+   bool parse_dns(const DnsMessage &msg, RecordExtDNS *rec);
+   int  add_ext_dns(const DnsMessage &msg, Flow &rec);
+   void process_srv(char *str) const;
+   int  process_rdata(const DnsMessage &msg, const DnsRr &rr, char *out, size_t size) const;
 };
 
 }
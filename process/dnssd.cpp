@@ -83,19 +83,7 @@ __attribute__((constructor)) static void register_this_plugin()
 #define DEBUG_CODE(code)
 #endif
 
-/**
- * \brief Check for label pointer in DNS name.
- */
-#define IS_POINTER(ch) ((ch & 0xC0) == 0xC0)
-
-#define MAX_LABEL_CNT 127
-
-/**
- * \brief Get offset from 2 byte pointer.
- */
-#define GET_OFFSET(half1, half2) ((((uint8_t)(half1) & 0x3F) << 8) | (uint8_t)(half2))
-
-DNSSDPlugin::DNSSDPlugin() : txt_all_records(false), queries(0), responses(0), total(0), data_begin(nullptr), data_len(0)
+DNSSDPlugin::DNSSDPlugin() : txt_all_records(false), queries(0), responses(0), total(0)
 {
 }
 
@@ -131,7 +119,7 @@ ProcessPlugin *DNSSDPlugin::copy()
 int DNSSDPlugin::post_create(Flow &rec, const Packet &pkt)
 {
    if (pkt.dst_port == 5353 || pkt.src_port == 5353) {
-      return add_ext_dnssd(reinterpret_cast<const char *>(pkt.payload), pkt.payload_len, pkt.ip_proto == IPPROTO_TCP, rec);
+      return add_ext_dnssd(dns_message(pkt), rec);
    }
 
    return 0;
@@ -143,10 +131,9 @@ int DNSSDPlugin::post_update(Flow &rec, const Packet &pkt)
       RecordExt *ext = rec.get_extension(RecordExtDNSSD::REGISTERED_ID);
 
       if (ext == nullptr) {
-         return add_ext_dnssd(reinterpret_cast<const char *>(pkt.payload), pkt.payload_len, pkt.ip_proto == IPPROTO_TCP, rec);
+         return add_ext_dnssd(dns_message(pkt), rec);
       } else {
-         parse_dns(reinterpret_cast<const char *>(pkt.payload), pkt.payload_len, pkt.ip_proto == IPPROTO_TCP,
-                   static_cast<RecordExtDNSSD *>(ext));
+         parse_dns(dns_message(pkt), static_cast<RecordExtDNSSD *>(ext));
       }
       return 0;
    }
@@ -209,76 +196,6 @@ void DNSSDPlugin::load_txtconfig(const char *config_file)
    in_file.close();
 }
 
-/**
- * \brief Get name length.
- * \param [in] data Pointer to string.
- * \return Number of characters in string.
- */
-size_t DNSSDPlugin::get_name_length(const char *data) const
-{
-   size_t len = 0;
-
-   while (1) {
-      if ((uint32_t) (data - data_begin) + 1 > data_len) {
-         throw "Error: overflow";
-      }
-      if (!data[0]) {
-         break;
-      }
-      if (IS_POINTER(data[0])) {
-         return len + 2;
-      }
-
-      len += (uint8_t) data[0] + 1;
-      data += (uint8_t) data[0] + 1;
-   }
-
-   return len + 1;
-}
-
-/**
- * \brief Decompress dns name.
- * \param [in] data Pointer to compressed data.
- * \return String with decompressed dns name.
- */
-std::string DNSSDPlugin::get_name(const char *data) const
-{
-   std::string name = "";
-   int label_cnt = 0;
-
-   if ((uint32_t) (data - data_begin) > data_len) {
-      throw "Error: overflow";
-   }
-
-   while (data[0]) {            /* Check for terminating character. */
-      if (IS_POINTER(data[0])) {        /* Check for label pointer (11xxxxxx byte) */
-         data = data_begin + GET_OFFSET(data[0], data[1]);
-
-         /* Check for possible errors. */
-         if (label_cnt++ > MAX_LABEL_CNT || (uint32_t) (data - data_begin) > data_len) {
-            throw "Error: label count exceed or overflow";
-         }
-
-         continue;
-      }
-
-      /* Check for possible errors. */
-      if (label_cnt++ > MAX_LABEL_CNT || (uint8_t) data[0] > 63 ||
-          (uint32_t) ((data - data_begin) + (uint8_t) data[0] + 2) > data_len) {
-         throw "Error: label count exceed or overflow";
-      }
-
-      name += '.' + std::string(data + 1, (uint8_t) data[0]);
-      data += ((uint8_t) data[0] + 1);
-   }
-
-   if (name[0] == '.') {
-      name.erase(0, 1);
-   }
-
-   return name;
-}
-
 /**
  * \brief Returns a DNS Service Instance Name without the <Instance> part.
  * \param [in] name DNS Service Instance Name.
@@ -287,27 +204,27 @@ std::string DNSSDPlugin::get_name(const char *data) const
  * As an example, given input "My MacBook Air._device-info._tcp.local"
  * returns "_device-info._tcp.local".
  */
-const std::string DNSSDPlugin::get_service_str(std::string &name) const
+const char *DNSSDPlugin::get_service_str(const char *name) const
 {
-   size_t begin = name.length();
+   const char *begin = name + strlen(name);
    int8_t underscore_counter = 0;
 
-   while (underscore_counter < 2 && begin != std::string::npos) {
-      begin = name.rfind("_", begin - 1);
-      if (begin != std::string::npos) {
+   while (underscore_counter < 2 && begin > name) {
+      begin--;
+      if (*begin == '_') {
          underscore_counter++;
       }
    }
-   return name.substr((begin == std::string::npos ? 0 : begin), name.length());
+   return underscore_counter == 2 ? begin : name;
 }
 
 /**
  * \brief Checks if Service Instance Name is allowed for TXT processing by checking txt_config.
  * \return True if allowed, otherwise false.
  */
-bool DNSSDPlugin::matches_service(std::list<std::pair<std::string, std::list<std::string> > >::const_iterator &it, std::string &name) const
+bool DNSSDPlugin::matches_service(std::list<std::pair<std::string, std::list<std::string> > >::const_iterator &it, const char *name) const
 {
-   std::string service = get_service_str(name);
+   const char *service = get_service_str(name);
 
    for (it = txt_config.begin(); it != txt_config.end(); it++) {
       if (it->first == service) {
@@ -319,71 +236,80 @@ bool DNSSDPlugin::matches_service(std::list<std::pair<std::string, std::list<std
 
 /**
  * \brief Process RDATA section.
- * \param [in] record_begin Pointer to start of current resource record.
- * \param [in] data Pointer to RDATA section.
- * \param [out] rdata String which stores processed data.
- * \param [in] type Type of RDATA section.
- * \param [in] length Length of RDATA section.
+ * \param [in] msg Decoded DNS message.
+ * \param [in] rr Resource record.
+ * \param [out] rdata Structure which stores processed data.
+ * \return False when RDATA contains invalid name.
  */
-void DNSSDPlugin::process_rdata(const char *record_begin, const char *data, DnsSdRr &rdata, uint16_t type, size_t length) const
+bool DNSSDPlugin::process_rdata(const DnsMessage &msg, const DnsRr &rr, DnsSdRr &rdata) const
 {
-   std::string name = rdata.name;
-   rdata = DnsSdRr();
+   const char *data = reinterpret_cast<const char *>(msg.data) + rr.rdata;
+   size_t length = rr.rdlength;
 
-   switch (type) {
-   case DNS_TYPE_PTR:
-      DEBUG_MSG("%16s\t\t    %s\n", "PTR", get_name(data).c_str());
-      break;
-   case DNS_TYPE_SRV:
-      {
-         struct dns_srv *srv = (struct dns_srv *) data;
+   rdata.srv_port = -1;
+   rdata.srv_target.clear();
+   rdata.hinfo[0].clear();
+   rdata.hinfo[1].clear();
+   rdata.txt.clear();
 
-         std::string tmp = get_name(data + 6);
+   switch (rr.type) {
+   case DNS_TYPE_SRV:
+      if (msg.rdata_has(rr, 0, sizeof(struct dns_srv))) {
+         const struct dns_srv *srv = (const struct dns_srv *) data;
+         char target[DNS_MAX_NAME_LEN + 1];
 
-         DEBUG_MSG("%16s\t%8u    %s\n", "SRV", ntohs(srv->port), tmp.c_str());
+         if (msg.decode_name(rr.rdata + sizeof(struct dns_srv), target, sizeof(target)) < 0) {
+            return false;
+         }
+         DEBUG_MSG("%16s\t%8u    %s\n", "SRV", ntohs(srv->port), target);
 
          rdata.srv_port = ntohs(srv->port);
-         rdata.srv_target = tmp;
+         rdata.srv_target = target;
       }
       break;
    case DNS_TYPE_HINFO:
       {
-         rdata.hinfo[0] = std::string(data + 1, (uint8_t) data[0]);
-         data += ((uint8_t) data[0] + 1);
-         rdata.hinfo[1] = std::string(data + 1, (uint8_t) data[0]);
-         data += ((uint8_t) data[0] + 1);
+         size_t pos = 0;
+         for (int i = 0; i < 2 && pos < length && pos + (uint8_t) data[pos] < length; i++) {
+            rdata.hinfo[i].assign(data + pos + 1, (uint8_t) data[pos]);
+            pos += (uint8_t) data[pos] + 1;
+         }
          DEBUG_MSG("%16s\t\t    %s, %s\n", "HINFO", rdata.hinfo[0].c_str(), rdata.hinfo[1].c_str());
       }
       break;
    case DNS_TYPE_TXT:
       {
          std::list<std::pair<std::string, std::list<std::string> > >::const_iterator it;
-         if (!(txt_all_records || matches_service(it, name))) {  // all_records overrides filter
+         if (!(txt_all_records || matches_service(it, msg.name(rr.name)))) {  // all_records overrides filter
             break;
          }
-         size_t len = (uint8_t) *(data++);
+         size_t pos = 0;
+         size_t len = length != 0 ? (uint8_t) data[pos] : 0;
          size_t total_len = len + 1;
          std::list<std::string>::const_iterator sit;
-         std::string txt;
 
+         pos++;
          while (length != 0 && total_len <= length) {
-            txt = std::string(data, len);
+            const char *txt = data + pos;
 
             if (txt_all_records) {
-               DEBUG_MSG("%16s\t\t    %s\n", "TXT", txt.c_str());
-               rdata.txt += txt + ":";
+               DEBUG_MSG("%16s\t\t    %.*s\n", "TXT", (int) len, txt);
+               rdata.txt.append(txt, len).append(":");
             } else {
-                  for (sit = it->second.begin(); sit != it->second.end(); sit++) {
-                  if (*sit == txt.substr(0, txt.find("="))) {
-                     DEBUG_MSG("%16s\t\t    %s\n", "TXT", txt.c_str());
-                     rdata.txt += txt + ":";
+               const char *eq = static_cast<const char *>(memchr(txt, '=', len));
+               size_t key_len = eq != nullptr ? eq - txt : len;
+               for (sit = it->second.begin(); sit != it->second.end(); sit++) {
+                  if (sit->length() == key_len && !memcmp(sit->c_str(), txt, key_len)) {
+                     DEBUG_MSG("%16s\t\t    %.*s\n", "TXT", (int) len, txt);
+                     rdata.txt.append(txt, len).append(":");
                      break;
                   }
                }
             }
 
-            data += len;
-            len = (uint8_t) *(data++);
+            pos += len;
+            len = pos < length ? (uint8_t) data[pos] : 0;
+            pos++;
             total_len += len + 1;
          }
       }
@@ -391,6 +317,7 @@ void DNSSDPlugin::process_rdata(const char *record_begin, const char *data, DnsS
    default:
       break;
    }
+   return true;
 }
 
 #ifdef DEBUG_DNSSD
@@ -399,218 +326,62 @@ uint32_t s_responses = 0;
 #endif /* DEBUG_DNSSD */
 
 /**
- * \brief Parse and store DNS packet.
- * \param [in] data Pointer to packet payload section.
- * \param [in] payload_len Payload length.
- * \param [in] tcp DNS over tcp.
+ * \brief Store DNS packet.
+ * \param [in] msg Decoded DNS message.
  * \param [out] rec Output Flow extension header.
  * \return True if DNS was parsed.
  */
-bool DNSSDPlugin::parse_dns(const char *data, unsigned int payload_len, bool tcp, RecordExtDNSSD *rec)
+bool DNSSDPlugin::parse_dns(const DnsMessage &msg, RecordExtDNSSD *rec)
 {
-   try {
-      total++;
-
-      DEBUG_MSG("---------- dns parser #%u ----------\n", total);
-      DEBUG_MSG("Payload length: %u\n", payload_len);
-
-      if (tcp) {
-         payload_len -= 2;
-         if (ntohs(*(uint16_t *) data) != payload_len) {
-            DEBUG_MSG("parser quits: fragmented tcp pkt");
-            return false;
-         }
-         data += 2;
-      }
-
-      if (payload_len < sizeof(struct dns_hdr)) {
-         DEBUG_MSG("parser quits: payload length < %ld\n", sizeof(struct dns_hdr));
-         return false;
-      }
-
-      data_begin = data;
-      data_len = payload_len;
-
-      struct dns_hdr *dns = (struct dns_hdr *) data;
-      uint16_t flags = ntohs(dns->flags);
-      uint16_t question_cnt = ntohs(dns->question_rec_cnt);
-      uint16_t answer_rr_cnt = ntohs(dns->answer_rec_cnt);
-      uint16_t authority_rr_cnt = ntohs(dns->name_server_rec_cnt);
-      uint16_t additional_rr_cnt = ntohs(dns->additional_rec_cnt);
-
-      DEBUG_MSG("%s number: %u\n",                    DNS_HDR_GET_QR(flags) ? "Response" : "Query",
-                                                      DNS_HDR_GET_QR(flags) ? s_queries++ : s_responses++);
-      DEBUG_MSG("DNS message header\n");
-      DEBUG_MSG("\tFlags:\t\t\t%#06x\n",              ntohs(dns->flags));
-
-      DEBUG_MSG("\t\tQuestion/reply:\t\t%u (%s)\n",   DNS_HDR_GET_QR(flags),
-                                                      DNS_HDR_GET_QR(flags) ? "Response" : "Query");
-      DEBUG_MSG("\t\tAuthoritative answer:\t%u\n",    DNS_HDR_GET_AA(flags));
-
-      DEBUG_MSG("\tQuestions:\t\t%u\n",               question_cnt);
-      DEBUG_MSG("\tAnswer RRs:\t\t%u\n",              answer_rr_cnt);
-      DEBUG_MSG("\tAuthority RRs:\t\t%u\n",           authority_rr_cnt);
-      DEBUG_MSG("\tAdditional RRs:\t\t%u\n",          additional_rr_cnt);
-
-      /********************************************************************
-      *****                   DNS Question section                    *****
-      ********************************************************************/
-      data += sizeof(struct dns_hdr);
-      for (int i = 0; i < question_cnt; i++) {
-         DEBUG_CODE(if (i == 0) {
-            DEBUG_MSG("\nDNS questions section\n");
-            DEBUG_MSG("%8s%8s%8s%8s%8s\n", "num", "type", "ttl", "port", "name");
-         });
-         std::string name = get_name(data);
-
-         data += get_name_length(data);
-         DEBUG_CODE(struct dns_question *question = (struct dns_question *) data);
-
-         if ((data - data_begin) + sizeof(struct dns_question) > payload_len) {
-            DEBUG_MSG("DNS parser quits: overflow\n\n");
-            return 1;
-         }
-
-         filtered_append(rec, name);
-
-         DEBUG_MSG("#%7d%8u%20s%s\n", i + 1, ntohs(question->qtype), "", name.c_str());
-         data += sizeof(struct dns_question);
-      }
-
-      /********************************************************************
-      *****                    DNS Answers section                    *****
-      ********************************************************************/
-      const char *record_begin;
-      size_t rdlength;
-      DnsSdRr rdata;
-
-      for (int i = 0; i < answer_rr_cnt; i++) { // Process answers section.
-         if (i == 0) {
-            DEBUG_MSG("DNS answers section\n");
-            DEBUG_MSG("%8s%8s%8s%8s%8s\n", "num", "type", "ttl", "port", "name");
-         }
-
-         record_begin = data;
-         std::string name = get_name(data);
-
-         data += get_name_length(data);
-
-         struct dns_answer *answer = (struct dns_answer *) data;
-
-         uint32_t tmp = (data - data_begin) + sizeof(dns_answer);
-
-         if (tmp > payload_len || tmp + ntohs(answer->rdlength) > payload_len) {
-            DEBUG_MSG("DNS parser quits: overflow\n\n");
-            return 1;
-         }
-         DEBUG_MSG("#%7d%8u%8u%12s%s\n", i + 1, ntohs(answer->atype), ntohl(answer->ttl), "",
-                   name.c_str());
-
-         data += sizeof(struct dns_answer);
-         rdlength = ntohs(answer->rdlength);
-         rdata.name = name;
-
-         process_rdata(record_begin, data, rdata, ntohs(answer->atype), rdlength);
-         if (DNS_HDR_GET_QR(flags)) {   // Ignore the known answers in a query.
-            filtered_append(rec, name, ntohs(answer->atype), rdata);
-         }
-         data += rdlength;
-      }
-
-      /********************************************************************
-      *****                 DNS Authority RRs section                 *****
-      ********************************************************************/
-
-      for (int i = 0; i < authority_rr_cnt; i++) {
-         DEBUG_CODE(if (i == 0) {
-            DEBUG_MSG("DNS authority RRs section\n");
-            DEBUG_MSG("%8s%8s%8s%8s%8s\n", "num", "type", "ttl", "port", "name");
-         });
+   total++;
 
-         record_begin = data;
-         std::string name = get_name(data);
-
-         data += get_name_length(data);
-
-         struct dns_answer *answer = (struct dns_answer *) data;
-
-         uint32_t tmp = (data - data_begin) + sizeof(dns_answer);
-
-         if (tmp > payload_len || tmp + ntohs(answer->rdlength) > payload_len) {
-            DEBUG_MSG("DNS parser quits: overflow\n\n");
-            return 1;
-         }
-
-         DEBUG_MSG("#%7d%8u%8u%12s%s\n", i + 1, ntohs(answer->atype), ntohl(answer->ttl), "",
-                   name.c_str());
+   DEBUG_MSG("---------- dns parser #%u ----------\n", total);
+   if (msg.status == DNS_MSG_INVALID) {
+      DEBUG_MSG("DNS parser quits: not a valid DNS message\n\n");
+      return false;
+   }
 
+   DEBUG_MSG("%s number: %u\n",                    DNS_HDR_GET_QR(msg.flags) ? "Response" : "Query",
+                                                   DNS_HDR_GET_QR(msg.flags) ? s_queries++ : s_responses++);
+   DEBUG_MSG("\tQuestions: %u, answer RRs: %u, authority RRs: %u, additional RRs: %u\n",
+             msg.question_cnt, msg.answer_cnt, msg.authority_cnt, msg.additional_cnt);
 
-         data += sizeof(struct dns_answer);
-         rdlength = ntohs(answer->rdlength);
-         rdata.name = name;
+   for (int i = 0; i < msg.questions_parsed; i++) {
+      DEBUG_MSG("#%7d%8u%20s%s\n", i + 1, msg.questions[i].qtype, "", msg.name(msg.questions[i].name));
+      filtered_append(rec, msg.name(msg.questions[i].name));
+   }
 
-         process_rdata(record_begin, data, rdata, ntohs(answer->atype), rdlength);
-         filtered_append(rec, name, ntohs(answer->atype), rdata);
+   DnsSdRr rdata;
+   for (int i = 0; i < msg.rrs_parsed; i++) {
+      const DnsRr &rr = msg.rrs[i];
+      const char *name = msg.name(rr.name);
 
-         data += rdlength;
+      DEBUG_MSG("#%7d%8u%8u%12s%s\n", i + 1, rr.type, rr.ttl, "", name);
+      if (rr.section == DNS_SECTION_ADDITIONAL && rr.type == DNS_TYPE_OPT) {
+         continue;
       }
-
-      /********************************************************************
-      *****                 DNS Additional RRs section                *****
-      ********************************************************************/
-      for (int i = 0; i < additional_rr_cnt; i++) {
-         DEBUG_CODE(if (i == 0) {
-            DEBUG_MSG("DNS additional RRs section\n");
-            DEBUG_MSG("%8s%8s%8s%8s%8s\n", "num", "type", "ttl", "port", "name");
-         });
-
-         record_begin = data;
-
-         std::string name = get_name(data);
-
-         data += get_name_length(data);
-
-         struct dns_answer *answer = (struct dns_answer *) data;
-
-         uint32_t tmp = (data - data_begin) + sizeof(dns_answer);
-
-         if (tmp > payload_len || tmp + ntohs(answer->rdlength) > payload_len) {
-            DEBUG_MSG("DNS parser quits: overflow\n\n");
-            return 1;
-         }
-
-         DEBUG_MSG("#%7d%8u%8u%12s%s\n", i + 1, ntohs(answer->atype), ntohl(answer->ttl), "",
-                   name.c_str());
-
-         rdlength = ntohs(answer->rdlength);
-
-         if (ntohs(answer->atype) != DNS_TYPE_OPT) {
-
-            data += sizeof(struct dns_answer);
-            rdata.name = name;
-
-            process_rdata(record_begin, data, rdata, ntohs(answer->atype), rdlength);
-            if (DNS_HDR_GET_QR(flags)) {
-               filtered_append(rec, name, ntohs(answer->atype), rdata);
-            }
-         }
-
-         data += rdlength;
+      if (!process_rdata(msg, rr, rdata)) {
+         DEBUG_MSG("DNS parser quits: invalid name in rdata\n\n");
+         return false;
       }
-
-      if (DNS_HDR_GET_QR(flags)) {
-         responses++;
-      } else {
-         queries++;
+      // Ignore the known answers in a query.
+      if (rr.section == DNS_SECTION_AUTHORITY || DNS_HDR_GET_QR(msg.flags)) {
+         filtered_append(rec, name, rr.type, rdata);
       }
-
-      DEBUG_MSG("DNS parser quits: parsing done\n\n");
    }
-   catch(const char *err) {
-      DEBUG_MSG("%s\n", err);
+
+   if (msg.status == DNS_MSG_MALFORMED) {
+      DEBUG_MSG("DNS parser quits: invalid name\n\n");
       return false;
    }
 
+   if (DNS_HDR_GET_QR(msg.flags)) {
+      responses++;
+   } else {
+      queries++;
+   }
+
+   DEBUG_MSG("DNS parser quits: parsing done\n\n");
    return true;
 }
 
@@ -619,9 +390,9 @@ bool DNSSDPlugin::parse_dns(const char *data, unsigned int payload_len, bool tcp
  * \param [in,out] rec Pointer to DNSSD extension record
  * \param [in] name Domain name of the DNS record.
  */
-void DNSSDPlugin::filtered_append(RecordExtDNSSD *rec, std::string name)
+void DNSSDPlugin::filtered_append(RecordExtDNSSD *rec, const char *name)
 {
-   if (name.rfind("arpa") == std::string::npos
+   if (strstr(name, "arpa") == nullptr
        && std::find(rec->queries.begin(), rec->queries.end(), name) == rec->queries.end()) {
       rec->queries.push_back(name);
    }
@@ -634,10 +405,10 @@ void DNSSDPlugin::filtered_append(RecordExtDNSSD *rec, std::string name)
  * \param [in] type DNS type id of the DNS record.
  * \param [in] rdata RDATA of the DNS record.
  */
-void DNSSDPlugin::filtered_append(RecordExtDNSSD *rec, std::string name, uint16_t type, DnsSdRr &rdata)
+void DNSSDPlugin::filtered_append(RecordExtDNSSD *rec, const char *name, uint16_t type, DnsSdRr &rdata)
 {
    if ((type != DNS_TYPE_SRV && type != DNS_TYPE_HINFO && type != DNS_TYPE_TXT)
-       || name.rfind("arpa") != std::string::npos) {
+       || strstr(name, "arpa") != nullptr) {
       return;
    }
    std::list<DnsSdRr>::iterator it;
@@ -687,16 +458,14 @@ void DNSSDPlugin::filtered_append(RecordExtDNSSD *rec, std::string name, uint16_
 
 /**
  * \brief Add new extension DNSSD header into Flow.
- * \param [in] data Pointer to packet payload section.
- * \param [in] payload_len Payload length.
- * \param [in] tcp DNS over tcp.
+ * \param [in] msg Decoded DNS message.
  * \param [out] rec Destination Flow.
  */
-int DNSSDPlugin::add_ext_dnssd(const char *data, unsigned int payload_len, bool tcp, Flow &rec)
+int DNSSDPlugin::add_ext_dnssd(const DnsMessage &msg, Flow &rec)
 {
    RecordExtDNSSD *ext = new RecordExtDNSSD();
 
-   if (!parse_dns(data, payload_len, tcp, ext)) {
+   if (!parse_dns(msg, ext)) {
       delete ext;
 
       return 0;
@@ -61,6 +61,7 @@
 #include <ipfixprobe/options.hpp>
 #include <ipfixprobe/ipfix-elements.hpp>
 #include "dns-utils.hpp"
+#include "dns-parser.hpp"
 
 namespace ipxp {
 
@@ -271,6 +272,7 @@ public:
    void close();
    OptionsParser *get_parser() const { return new DNSSDOptParser(); }
    std::string get_name() const { return "dnssd"; }
+   PluginInterest get_interest() const { return PluginInterest({}, {5353}, true); }
    RecordExt *get_ext() const { return new RecordExtDNSSD(); }
    ProcessPlugin *copy();
 
@@ -284,22 +286,17 @@ private:
    uint32_t responses;     /**< Total number of parsed DNS responses. */
    uint32_t total;         /**< Total number of parsed DNS packets. */
 
-   const char *data_begin; /**< Pointer to begin of payload. */
-   uint32_t data_len;      /**< Length of packet payload. */
+   bool parse_dns(const DnsMessage &msg, RecordExtDNSSD *rec);
+   int  add_ext_dnssd(const DnsMessage &msg, Flow &rec);
+   bool process_rdata(const DnsMessage &msg, const DnsRr &rr, DnsSdRr &rdata) const;
+   void filtered_append(RecordExtDNSSD *rec, const char *name);
+   void filtered_append(RecordExtDNSSD *rec, const char *name, uint16_t type, DnsSdRr &rdata);
 
-   bool parse_dns(const char *data, unsigned int payload_len, bool tcp, RecordExtDNSSD *rec);
-   int  add_ext_dnssd(const char *data, unsigned int payload_len, bool tcp, Flow &rec);
-   void process_rdata(const char *record_begin, const char *data, DnsSdRr &rdata, uint16_t type, size_t length) const;
-   void filtered_append(RecordExtDNSSD *rec, std::string name);
-   void filtered_append(RecordExtDNSSD *rec, std::string name, uint16_t type, DnsSdRr &rdata);
-
-   std::string get_name(const char *data) const;
-   size_t get_name_length(const char *data) const;
-   const std::string get_service_str(std::string &name) const;
+   const char *get_service_str(const char *name) const;
 
    bool parse_params(const std::string &params, std::string &config_file);
    void load_txtconfig(const char *config_file);
-   bool matches_service(std::list<std::pair<std::string, std::list<std::string> > >::const_iterator &it, std::string &name) const;
+   bool matches_service(std::list<std::pair<std::string, std::list<std::string> > >::const_iterator &it, const char *name) const;
 
    std::list<std::pair<std::string, std::list<std::string> > > txt_config;   /**< Configuration for TXT record filter. */
 };
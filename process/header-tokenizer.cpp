@@ -0,0 +1,243 @@
+/**
+ * \file header-tokenizer.cpp
+ * \brief Shared tokenizer for text protocol headers (HTTP, RTSP, SIP).
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "header-tokenizer.hpp"
+
+namespace ipxp {
+
+#define HEADER_HASH_SIZE 32
+
+struct HeaderName {
+   const char *name;
+   uint8_t len;
+   HeaderField field;
+};
+
+static const HeaderName header_names[] = {
+   { "Host",         4,  HeaderField::HOST },
+   { "User-Agent",   10, HeaderField::USER_AGENT },
+   { "Referer",      7,  HeaderField::REFERER },
+   { "Content-Type", 12, HeaderField::CONTENT_TYPE },
+   { "Server",       6,  HeaderField::SERVER },
+   { "From",         4,  HeaderField::FROM },
+   { "f",            1,  HeaderField::FROM },
+   { "To",           2,  HeaderField::TO },
+   { "t",            1,  HeaderField::TO },
+   { "Via",          3,  HeaderField::VIA },
+   { "v",            1,  HeaderField::VIA },
+   { "Call-ID",      7,  HeaderField::CALL_ID },
+   { "i",            1,  HeaderField::CALL_ID },
+   { "CSeq",         4,  HeaderField::CSEQ },
+};
+
+/**
+ * \brief Hash of header name, collision free for the names above.
+ *
+ * Only length and case folded first and last characters are used, so
+ * computing it costs the same for every name length.
+ */
+static inline uint32_t header_hash(const char *name, size_t len)
+{
+   return (len * 24 + (static_cast<uint8_t>(name[0]) | 0x20) * 2 +
+      (static_cast<uint8_t>(name[len - 1]) | 0x20)) & (HEADER_HASH_SIZE - 1);
+}
+
+struct HeaderHashTable {
+   const HeaderName *slots[HEADER_HASH_SIZE];
+
+   HeaderHashTable()
+   {
+      memset(slots, 0, sizeof(slots));
+      for (const auto &it : header_names) {
+         slots[header_hash(it.name, it.len)] = &it;
+      }
+   }
+};
+
+static const HeaderHashTable &header_hash_table()
+{
+   static const HeaderHashTable table;
+   return table;
+}
+
+static inline char header_lower(char c)
+{
+   return (c >= 'A' && c <= 'Z') ? c | 0x20 : c;
+}
+
+static inline bool header_name_eq_nocase(const char *a, const char *b, size_t len)
+{
+   for (size_t i = 0; i < len; i++) {
+      if (header_lower(a[i]) != header_lower(b[i])) {
+         return false;
+      }
+   }
+   return true;
+}
+
+HeaderField header_field_lookup(const char *name, size_t len, bool nocase)
+{
+   if (len == 0) {
+      return HeaderField::UNKNOWN;
+   }
+
+   const HeaderName *entry = header_hash_table().slots[header_hash(name, len)];
+   if (entry == nullptr || entry->len != len) {
+      return HeaderField::UNKNOWN;
+   }
+   if (nocase ? !header_name_eq_nocase(name, entry->name, len) : memcmp(name, entry->name, len)) {
+      return HeaderField::UNKNOWN;
+   }
+   return entry->field;
+}
+
+const char *header_find_line(const char *begin, const char *end, const char **colon)
+{
+   const char *p = begin;
+   const char *found_colon = nullptr;
+
+#if defined(__AVX2__)
+   const __m256i nl_32 = _mm256_set1_epi8('\n');
+   const __m256i colon_32 = _mm256_set1_epi8(':');
+   while (end - p >= 32) {
+      __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+      uint32_t nl_mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, nl_32));
+      if (found_colon == nullptr) {
+         uint32_t colon_mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, colon_32));
+         if (nl_mask) {
+            /* Keep only colons preceding the first line delimiter. */
+            colon_mask &= (nl_mask & -nl_mask) - 1;
+         }
+         if (colon_mask) {
+            found_colon = p + __builtin_ctz(colon_mask);
+         }
+      }
+      if (nl_mask) {
+         *colon = found_colon;
+         return p + __builtin_ctz(nl_mask);
+      }
+      p += 32;
+   }
+#endif
+#if defined(__SSE2__)
+   const __m128i nl_16 = _mm_set1_epi8('\n');
+   const __m128i colon_16 = _mm_set1_epi8(':');
+   while (end - p >= 16) {
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      uint32_t nl_mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, nl_16));
+      if (found_colon == nullptr) {
+         uint32_t colon_mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, colon_16));
+         if (nl_mask) {
+            colon_mask &= (nl_mask & -nl_mask) - 1;
+         }
+         if (colon_mask) {
+            found_colon = p + __builtin_ctz(colon_mask);
+         }
+      }
+      if (nl_mask) {
+         *colon = found_colon;
+         return p + __builtin_ctz(nl_mask);
+      }
+      p += 16;
+   }
+#endif
+
+   for (; p < end; p++) {
+      if (*p == '\n') {
+         *colon = found_colon;
+         return p;
+      }
+      if (*p == ':' && found_colon == nullptr) {
+         found_colon = p;
+      }
+   }
+
+   *colon = found_colon;
+   return nullptr;
+}
+
+bool HeaderTokenizer::next(HeaderLine &line)
+{
+   const char *colon;
+   const char *nl;
+   const char *p = m_pos;
+
+   if (m_pos >= m_end) {
+      return false;
+   }
+
+   line.begin = m_pos;
+   line.colon = nullptr;
+   while (1) {
+      nl = header_find_line(p, m_end, &colon);
+      if (line.colon == nullptr) {
+         line.colon = colon;
+      }
+      if (nl == nullptr || !m_crlf || (nl > line.begin && nl[-1] == '\r')) {
+         break;
+      }
+      /* Bare LF does not end the line in CRLF mode. */
+      p = nl + 1;
+   }
+
+   if (nl == nullptr) {
+      line.end = m_end;
+      line.terminated = false;
+      m_pos = m_end;
+   } else {
+      line.end = nl;
+      line.terminated = true;
+      m_pos = nl + 1;
+   }
+   return true;
+}
+
+}
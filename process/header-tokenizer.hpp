@@ -0,0 +1,159 @@
+/**
+ * \file header-tokenizer.hpp
+ * \brief Shared tokenizer for text protocol headers (HTTP, RTSP, SIP).
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef IPXP_PROCESS_HEADER_TOKENIZER_HPP
+#define IPXP_PROCESS_HEADER_TOKENIZER_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+namespace ipxp {
+
+/**
+ * \brief Header fields recognized by header_field_lookup().
+ *
+ * Compact SIP forms (f, t, v, i) map to the same value as their full names.
+ */
+enum class HeaderField : uint8_t {
+   UNKNOWN = 0,
+   HOST,
+   USER_AGENT,
+   REFERER,
+   CONTENT_TYPE,
+   SERVER,
+   FROM,
+   TO,
+   VIA,
+   CALL_ID,
+   CSEQ
+};
+
+/**
+ * \brief One header line returned by HeaderTokenizer.
+ */
+struct HeaderLine {
+   const char *begin;   /**< First byte of the line. */
+   const char *end;     /**< Terminating '\n' or end of data when the line is not terminated. */
+   const char *colon;   /**< First ':' of the line, nullptr when there is none. */
+   bool terminated;     /**< Line ends with a line delimiter. */
+
+   /**
+    * \brief Check for the blank line separating header from body ("\n" or "\r\n").
+    */
+   bool blank() const
+   {
+      return terminated && (begin == end || (end - begin == 1 && *begin == '\r'));
+   }
+
+   /**
+    * \brief Get first byte of field value, leading spaces and tabs are skipped.
+    * \return Pointer into range (colon, end], call only when colon is set.
+    */
+   const char *value() const
+   {
+      const char *p = colon + 1;
+      while (p < end && (*p == ' ' || *p == '\t')) {
+         p++;
+      }
+      return p;
+   }
+};
+
+/**
+ * \brief Split header section into lines and locate the name/value delimiter.
+ *
+ * Line and field delimiters are searched at once, 32 (AVX2) or 16 (SSE2)
+ * bytes per step with a scalar fallback on other targets.
+ */
+class HeaderTokenizer
+{
+public:
+   /**
+    * \brief Constructor.
+    * \param [in] data First byte of the header section.
+    * \param [in] len Number of bytes available.
+    * \param [in] crlf Lines end only with "\r\n" (HTTP), otherwise any '\n' does.
+    */
+   HeaderTokenizer(const char *data, size_t len, bool crlf = false) :
+      m_pos(data), m_end(data + len), m_crlf(crlf)
+   {
+   }
+
+   /**
+    * \brief Get next line.
+    * \param [out] line Parsed line.
+    * \return False when there is no more data.
+    */
+   bool next(HeaderLine &line);
+
+   /**
+    * \brief Get position of the first unprocessed byte.
+    */
+   const char *position() const { return m_pos; }
+
+private:
+   const char *m_pos;
+   const char *m_end;
+   bool m_crlf;
+};
+
+/**
+ * \brief Find first '\n' in range and first ':' preceding it.
+ * \param [in] begin First byte of range.
+ * \param [in] end Byte after the range.
+ * \param [out] colon First ':' before returned line delimiter (or before end), nullptr if not found.
+ * \return Pointer to '\n' or nullptr if not found.
+ */
+const char *header_find_line(const char *begin, const char *end, const char **colon);
+
+/**
+ * \brief Match header name through perfect hash table of known names.
+ * \param [in] name Header name (without ':').
+ * \param [in] len Length of the name.
+ * \param [in] nocase Compare ASCII case insensitively (SIP), otherwise exact match is required.
+ * \return Recognized field or HeaderField::UNKNOWN.
+ */
+HeaderField header_field_lookup(const char *name, size_t len, bool nocase);
+
+}
+#endif /* IPXP_PROCESS_HEADER_TOKENIZER_HPP */
@@ -52,6 +52,7 @@
 
 #include "common.hpp"
 #include "http.hpp"
+#include "header-tokenizer.hpp"
 
 namespace ipxp {
 
@@ -81,7 +82,6 @@ __attribute__((constructor)) static void register_this_plugin()
 #endif
 
 #define HTTP_LINE_DELIMITER   "\r\n"
-#define HTTP_KEYVAL_DELIMITER ':'
 
 HTTPPlugin::HTTPPlugin() : recPrealloc(nullptr), flow_flush(false), requests(0), responses(0), total(0)
 {
@@ -231,7 +231,7 @@ bool HTTPPlugin::parse_http_request(const char *data, int payload_len, RecordExt
 {
    char buffer[64];
    size_t remaining;
-   const char *begin, *end, *keyval_delimiter;
+   const char *begin, *end;
 
    total++;
 
@@ -311,53 +311,47 @@ bool HTTPPlugin::parse_http_request(const char *data, int payload_len, RecordExt
     *
     * REQ-FIELD: VALUE
     * |        |      |
-    * |        |      ----- end
-    * |        ------------ keyval_delimiter
-    * --------------------- begin
+    * |        |      ----- line.end
+    * |        ------------ line.colon
+    * --------------------- line.begin
     */
 
    rec->host[0] = 0;
    rec->user_agent[0] = 0;
    rec->referer[0] = 0;
    /* Process headers. */
-   while (begin - data < payload_len) {
-
-      remaining = payload_len - (begin - data);
-      end = ipxp::strnstr(begin, HTTP_LINE_DELIMITER, remaining);
-      keyval_delimiter = static_cast<const char *>(memchr(begin, HTTP_KEYVAL_DELIMITER, remaining));
-
-      if (end == nullptr) {
+   HeaderTokenizer tokenizer(begin, payload_len - (begin - data), true);
+   HeaderLine line;
+   while (tokenizer.next(line)) {
+      if (!line.terminated) {
          DEBUG_MSG("Parser quits:\theader is fragmented\n");
          return  false;
       }
-
-      end += 1;
-      int tmp = end - begin;
-      if (tmp == 0 || tmp == 1) { /* Check for blank line with \r\n or \n ending. */
+      if (line.blank()) { /* Check for blank line with \r\n or \n ending. */
          break; /* Double LF found - end of header section. */
-      } else if (keyval_delimiter == nullptr) {
-         DEBUG_MSG("Parser quits:\theader is fragmented\n");
-         return  false;
+      } else if (line.colon == nullptr) {
+         continue;
       }
 
-      /* Copy field name. */
-      copy_str(buffer, sizeof(buffer), begin, keyval_delimiter);
-
+      DEBUG_CODE(copy_str(buffer, sizeof(buffer), line.begin, line.colon));
       DEBUG_CODE(char debug_buffer[4096]);
-      DEBUG_CODE(copy_str(debug_buffer, sizeof(debug_buffer), keyval_delimiter + 2, end));
+      DEBUG_CODE(copy_str(debug_buffer, sizeof(debug_buffer), line.value(), line.end));
       DEBUG_MSG("\t%s: %s\n", buffer, debug_buffer);
 
       /* Copy interesting field values. */
-      if (!strcmp(buffer, "Host")) {
-         copy_str(rec->host, sizeof(rec->host), keyval_delimiter + 2, end);
-      } else if (!strcmp(buffer, "User-Agent")) {
-         copy_str(rec->user_agent, sizeof(rec->user_agent), keyval_delimiter + 2, end);
-      } else if (!strcmp(buffer, "Referer")) {
-         copy_str(rec->referer, sizeof(rec->referer), keyval_delimiter + 2, end);
+      switch (header_field_lookup(line.begin, line.colon - line.begin, false)) {
+      case HeaderField::HOST:
+         copy_str(rec->host, sizeof(rec->host), line.value(), line.end);
+         break;
+      case HeaderField::USER_AGENT:
+         copy_str(rec->user_agent, sizeof(rec->user_agent), line.value(), line.end);
+         break;
+      case HeaderField::REFERER:
+         copy_str(rec->referer, sizeof(rec->referer), line.value(), line.end);
+         break;
+      default:
+         break;
       }
-
-      /* Go to next line. */
-      begin = end + 1 ;
    }
 
    DEBUG_MSG("Parser quits:\tend of header section\n");
@@ -376,7 +370,7 @@ bool HTTPPlugin::parse_http_request(const char *data, int payload_len, RecordExt
 bool HTTPPlugin::parse_http_response(const char *data, int payload_len, RecordExtHTTP *rec)
 {
    char buffer[64];
-   const char *begin, *end, *keyval_delimiter;
+   const char *begin, *end;
    size_t remaining;
    int code;
 
@@ -459,46 +453,35 @@ bool HTTPPlugin::parse_http_response(const char *data, int payload_len, RecordEx
     *
     * REQ-FIELD: VALUE
     * |        |      |
-    * |        |      ----- end
-    * |        ------------ keyval_delimiter
-    * --------------------- begin
+    * |        |      ----- line.end
+    * |        ------------ line.colon
+    * --------------------- line.begin
     */
 
    rec->content_type[0] = 0;
    /* Process headers. */
-   while (begin - data < payload_len) {
-      remaining = payload_len - (begin - data);
-      end = ipxp::strnstr(begin, HTTP_LINE_DELIMITER, remaining);
-      keyval_delimiter = static_cast<const char *>(memchr(begin, HTTP_KEYVAL_DELIMITER, remaining));
-
-      if (end == nullptr) {
+   HeaderTokenizer tokenizer(begin, payload_len - (begin - data), true);
+   HeaderLine line;
+   while (tokenizer.next(line)) {
+      if (!line.terminated) {
          DEBUG_MSG("Parser quits:\theader is fragmented\n");
          return  false;
       }
-
-      end += 1;
-      int tmp = end - begin;
-      if (tmp == 0 || tmp == 1) { /* Check for blank line with \r\n or \n ending. */
+      if (line.blank()) { /* Check for blank line with \r\n or \n ending. */
          break; /* Double LF found - end of header section. */
-      } else if (keyval_delimiter == nullptr) {
-         DEBUG_MSG("Parser quits:\theader is fragmented\n");
-         return  false;
+      } else if (line.colon == nullptr) {
+         continue;
       }
 
-      /* Copy field name. */
-      copy_str(buffer, sizeof(buffer), begin, keyval_delimiter);
-
+      DEBUG_CODE(copy_str(buffer, sizeof(buffer), line.begin, line.colon));
       DEBUG_CODE(char debug_buffer[4096]);
-      DEBUG_CODE(copy_str(debug_buffer, sizeof(debug_buffer), keyval_delimiter + 2, end));
+      DEBUG_CODE(copy_str(debug_buffer, sizeof(debug_buffer), line.value(), line.end));
       DEBUG_MSG("\t%s: %s\n", buffer, debug_buffer);
 
       /* Copy interesting field values. */
-      if (!strcmp(buffer, "Content-Type")) {
-         copy_str(rec->content_type, sizeof(rec->content_type), keyval_delimiter + 2, end);
+      if (header_field_lookup(line.begin, line.colon - line.begin, false) == HeaderField::CONTENT_TYPE) {
+         copy_str(rec->content_type, sizeof(rec->content_type), line.value(), line.end);
       }
-
-      /* Go to next line. */
-      begin = end + 1;
    }
 
    DEBUG_MSG("Parser quits:\tend of header section\n");
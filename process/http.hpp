@@ -199,6 +199,8 @@ struct RecordExtHTTP : public RecordExt {
          << ",status=" << code;
       return out.str();
    }
+
+   RECORD_EXT_PLAIN_SNAPSHOT(RecordExtHTTP, 1)
 };
 
 /**
@@ -214,6 +216,7 @@ public:
    RecordExt *get_ext() const { return new RecordExtHTTP(); }
    OptionsParser *get_parser() const { return new OptionsParser("http", "Parse HTTP traffic"); }
    std::string get_name() const { return "http"; }
+   PluginInterest get_interest() const { return PluginInterest({}, {}, true); }
    ProcessPlugin *copy();
 
    int post_create(Flow &rec, const Packet &pkt);
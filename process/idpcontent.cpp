@@ -80,6 +80,11 @@ ProcessPlugin *IDPCONTENTPlugin::copy()
    return new IDPCONTENTPlugin(*this);
 }
 
+bool IDPCONTENTPlugin::content_complete(const RecordExtIDPCONTENT *idpcontent_data) const
+{
+   return idpcontent_data->pkt_export_flg[0] && idpcontent_data->pkt_export_flg[1];
+}
+
 void IDPCONTENTPlugin::update_record(RecordExtIDPCONTENT *idpcontent_data, const Packet &pkt)
 {
    // create ptr into buffers from packet directions
@@ -101,14 +106,14 @@ int IDPCONTENTPlugin::post_create(Flow &rec, const Packet &pkt)
    rec.add_extension(idpcontent_data);
 
    update_record(idpcontent_data, pkt);
-   return 0;
+   return content_complete(idpcontent_data) ? FLOW_PLUGIN_DETACH : 0;
 }
 
 int IDPCONTENTPlugin::post_update(Flow &rec, const Packet &pkt)
 {
    RecordExtIDPCONTENT *idpcontent_data = static_cast<RecordExtIDPCONTENT *>(rec.get_extension(RecordExtIDPCONTENT::REGISTERED_ID));
    update_record(idpcontent_data, pkt);
-   return 0;
+   return content_complete(idpcontent_data) ? FLOW_PLUGIN_DETACH : 0;
 }
 
 }
@@ -145,6 +145,8 @@ struct RecordExtIDPCONTENT : public RecordExt {
       }
       return out.str();
    }
+
+   RECORD_EXT_PLAIN_SNAPSHOT(RecordExtIDPCONTENT, 1)
 };
 
 /**
@@ -165,6 +167,7 @@ public:
    int post_create(Flow &rec, const Packet &pkt);
    int post_update(Flow &rec, const Packet &pkt);
    void update_record(RecordExtIDPCONTENT *pstats_data, const Packet &pkt);
+   bool content_complete(const RecordExtIDPCONTENT *idpcontent_data) const;
 };
 
 }
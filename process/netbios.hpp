@@ -137,6 +137,7 @@ public:
     void close();
     OptionsParser *get_parser() const { return new OptionsParser("netbios", "Parse netbios traffic"); }
     std::string get_name() const { return "netbios"; }
+    PluginInterest get_interest() const { return PluginInterest({}, {137}, true); }
     RecordExt *get_ext() const { return new RecordExtNETBIOS(); }
     ProcessPlugin *copy();
 
@@ -243,6 +243,8 @@ struct RecordExtNTP : public RecordExt {
          << ",sent=\"" << sent << "\"";
       return out.str();
    }
+
+   RECORD_EXT_PLAIN_SNAPSHOT(RecordExtNTP, 1)
 };
 
 /**
@@ -257,6 +259,7 @@ public:
    void close();
    OptionsParser *get_parser() const { return new OptionsParser("ntp", "Parse NTP traffic"); }
    std::string get_name() const { return "ntp"; }
+   PluginInterest get_interest() const { return PluginInterest({}, {123}, true); }
    RecordExt *get_ext() const { return new RecordExtNTP(); }
    ProcessPlugin *copy();
 
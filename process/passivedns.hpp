@@ -57,10 +57,11 @@
 #include <ipfixprobe/packet.hpp>
 #include <ipfixprobe/ipfix-elements.hpp>
 #include "dns-utils.hpp"
+#include "dns-parser.hpp"
 
 namespace ipxp {
 
-#define DNS_UNIREC_TEMPLATE "DNS_ID,DNS_ATYPE,DNS_NAME,DNS_RR_TTL,DNS_IP"
+#define PASSIVEDNS_UNIREC_TEMPLATE "DNS_ID,DNS_ATYPE,DNS_NAME,DNS_RR_TTL,DNS_IP"
 
 UR_FIELDS (
    uint16 DNS_ID,
@@ -110,7 +111,7 @@ struct RecordExtPassiveDNS : public RecordExt {
 
    const char *get_unirec_tmplt() const
    {
-      return DNS_UNIREC_TEMPLATE;
+      return PASSIVEDNS_UNIREC_TEMPLATE;
    }
 #endif
 
@@ -167,6 +168,8 @@ struct RecordExtPassiveDNS : public RecordExt {
          << ",ip=" << ip_str;
       return out.str();
    }
+
+   RECORD_EXT_PLAIN_SNAPSHOT(RecordExtPassiveDNS, 1)
 };
 
 /**
@@ -181,6 +184,7 @@ public:
    void close();
    OptionsParser *get_parser() const { return new OptionsParser("passivedns", "Parse A, AAAA and PTR records from DNS traffic"); }
    std::string get_name() const { return "passivedns"; }
+   PluginInterest get_interest() const { return PluginInterest({}, {53}, true); }
    RecordExt *get_ext() const { return new RecordExtPassiveDNS(); }
    ProcessPlugin *copy();
    int post_create(Flow &rec, const Packet &pkt);
@@ -193,16 +197,9 @@ private:
    uint32_t parsed_aaaa;   /**< Number of parsed AAAA records. */
    uint32_t parsed_ptr;    /**< Number of parsed PTR records. */
 
-   const char *data_begin; /**< Pointer to begin of payload. */
-   uint32_t data_len;      /**< Length of packet payload. */
-
-   RecordExtPassiveDNS *parse_dns(const char *data, unsigned int payload_len, bool tcp);
-   int add_ext_dns(const char *data, unsigned int payload_len, bool tcp, Flow &rec);
-
-   std::string get_name(const char *data) const;
-   size_t get_name_length(const char *data) const;
-   bool process_ptr_record(std::string name, RecordExtPassiveDNS *rec);
-   bool str_to_uint4(std::string str, uint8_t &dst);
+   RecordExtPassiveDNS *parse_dns(const DnsMessage &msg);
+   int add_ext_dns(const DnsMessage &msg, Flow &rec);
+   bool process_ptr_record(const char *name, size_t name_len, RecordExtPassiveDNS *rec);
 };
 
 }
@@ -191,6 +191,8 @@ struct RecordExtPHISTS : public RecordExt {
       }
       return out.str();
    }
+
+   RECORD_EXT_PLAIN_SNAPSHOT(RecordExtPHISTS, 1)
 };
 
 /**
@@ -0,0 +1,98 @@
+/**
+ * \file plugin-chain.cpp
+ * \brief Process plugin chain selected at configure time
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <config.h>
+
+#include <ipfixprobe/plugin-chain.hpp>
+
+#ifdef WITH_PLUGIN_CHAIN
+#include "appid.hpp"
+#include "basicplus.hpp"
+#include "bstats.hpp"
+#include "dns.hpp"
+#include "dnssd.hpp"
+#include "http.hpp"
+#include "idpcontent.hpp"
+#include "netbios.hpp"
+#include "ntp.hpp"
+#include "ovpn.hpp"
+#include "passivedns.hpp"
+#include "phists.hpp"
+#include "pstats.hpp"
+#include "rtsp.hpp"
+#include "sip.hpp"
+#include "smtp.hpp"
+#include "ssdp.hpp"
+#include "tls.hpp"
+#include "wg.hpp"
+#ifdef WITH_QUIC
+#include "quic.hpp"
+#endif
+#endif
+
+namespace ipxp {
+
+#ifdef WITH_PLUGIN_CHAIN
+typedef PluginChain<IPXP_PLUGIN_CHAIN> ConfiguredPluginChain;
+#endif
+
+ProcessPlugin *create_plugin_chain(const OutputPlugin::Plugins &plugins)
+{
+#ifdef WITH_PLUGIN_CHAIN
+   if (ConfiguredPluginChain::available(plugins)) {
+      return new ConfiguredPluginChain(plugins);
+   }
+#endif
+   return nullptr;
+}
+
+bool plugin_chain_member(const ProcessPlugin *plugin)
+{
+#ifdef WITH_PLUGIN_CHAIN
+   return ConfiguredPluginChain::member(plugin);
+#else
+   return false;
+#endif
+}
+
+}
@@ -217,6 +217,8 @@ struct RecordExtPSTATS : public RecordExt {
       out << ")";
       return out.str();
    }
+
+   RECORD_EXT_PLAIN_SNAPSHOT(RecordExtPSTATS, 1)
 };
 
 /**
@@ -101,6 +101,8 @@ struct RecordExtQUIC : public RecordExt {
            quic_version << "\"";
       return out.str();
    }
+
+   RECORD_EXT_PLAIN_SNAPSHOT(RecordExtQUIC, 1)
 };
 
 /**
@@ -119,6 +121,8 @@ public:
 
    std::string get_name() const { return "quic"; }
 
+   PluginInterest get_interest() const { return PluginInterest({IPPROTO_UDP}, {}, true); }
+
    ProcessPlugin *copy();
 
    int pre_create(Packet &pkt);
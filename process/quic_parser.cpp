@@ -29,6 +29,106 @@
 #endif
 
 namespace ipxp {
+QUICCryptoCtx::QUICCryptoCtx() : hkdf(nullptr), hp(nullptr), aead(nullptr), valid(false)
+{
+   hkdf = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, NULL);
+   hp   = EVP_CIPHER_CTX_new();
+   aead = EVP_CIPHER_CTX_new();
+   if (hkdf == nullptr || hp == nullptr || aead == nullptr) {
+      DEBUG_MSG("Error, allocation of crypto contexts failed\n");
+      return;
+   }
+   if (!EVP_EncryptInit_ex(hp, EVP_aes_128_ecb(), NULL, NULL, NULL)) {
+      DEBUG_MSG("Error, header protection context initialization failed\n");
+      return;
+   }
+   // we need to disable padding so we can use EncryptFinal
+   EVP_CIPHER_CTX_set_padding(hp, 0);
+   if (!EVP_DecryptInit_ex(aead, EVP_aes_128_gcm(), NULL, NULL, NULL)) {
+      DEBUG_MSG("Error, payload decryption context initialization failed\n");
+      return;
+   }
+   if (!EVP_CIPHER_CTX_ctrl(aead, EVP_CTRL_AEAD_SET_IVLEN, TLS13_AEAD_NONCE_LENGTH, NULL)) {
+      DEBUG_MSG("Error, setting NONCE length failed\n");
+      return;
+   }
+   valid = true;
+}
+
+QUICCryptoCtx::~QUICCryptoCtx()
+{
+   EVP_PKEY_CTX_free(hkdf);
+   EVP_CIPHER_CTX_free(hp);
+   EVP_CIPHER_CTX_free(aead);
+}
+
+QUICKeyCache::QUICKeyCache() : m_clock(0)
+{
+   memset(m_entries, 0, sizeof(m_entries));
+}
+
+bool QUICKeyCache::lookup(uint32_t version, const uint8_t *dcid, uint8_t dcid_len, Initial_Secrets &out)
+{
+   if (dcid_len > QUIC_MAX_CID_LEN) {
+      return false;
+   }
+   for (unsigned i = 0; i < QUIC_KEY_CACHE_SIZE; i++) {
+      Entry &entry = m_entries[i];
+      if (entry.last_used != 0 && entry.version == version && entry.dcid_len == dcid_len &&
+        (dcid_len == 0 || !memcmp(entry.dcid, dcid, dcid_len))) {
+         entry.last_used = ++m_clock;
+         out = entry.secrets;
+         return true;
+      }
+   }
+   return false;
+}
+
+void QUICKeyCache::insert(uint32_t version, const uint8_t *dcid, uint8_t dcid_len, const Initial_Secrets &secrets)
+{
+   if (dcid_len > QUIC_MAX_CID_LEN) {
+      return;
+   }
+   if (m_clock == UINT32_MAX) {
+      // restart aging instead of letting the counter wrap
+      memset(m_entries, 0, sizeof(m_entries));
+      m_clock = 0;
+   }
+
+   Entry *victim = &m_entries[0];
+   for (unsigned i = 1; i < QUIC_KEY_CACHE_SIZE && victim->last_used != 0; i++) {
+      if (m_entries[i].last_used < victim->last_used) {
+         victim = &m_entries[i];
+      }
+   }
+
+   victim->version   = version;
+   victim->last_used = ++m_clock;
+   victim->dcid_len  = dcid_len;
+   if (dcid_len != 0) {
+      memcpy(victim->dcid, dcid, dcid_len);
+   }
+   victim->secrets = secrets;
+}
+
+/**
+ * \brief Get OpenSSL contexts of the calling thread.
+ */
+static QUICCryptoCtx &quic_crypto_ctx()
+{
+   static thread_local QUICCryptoCtx ctx;
+   return ctx;
+}
+
+/**
+ * \brief Get Initial secrets cache of the calling thread.
+ */
+static QUICKeyCache &quic_key_cache()
+{
+   static thread_local QUICKeyCache cache;
+   return cache;
+}
+
 QUICParser::QUICParser()
 {
    quic_h1 = nullptr;
@@ -319,48 +419,40 @@ bool expand_label(const char *label_prefix, const char *label, const uint8_t *co
    return true;
 }
 
-bool quic_derive_n_set(uint8_t *secret, uint8_t *expanded_label, uint8_t size, size_t output_len,
-  uint8_t *store_data)
+bool quic_derive_n_set(EVP_PKEY_CTX *pctx, uint8_t *secret, uint8_t *expanded_label, uint8_t size,
+  size_t output_len, uint8_t *store_data)
 {
-   EVP_PKEY_CTX *pctx;
-
-   pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, NULL);
+   // derive_init resets salt, key and info stored in the reused context
    if (1 != EVP_PKEY_derive_init(pctx)) {
       DEBUG_MSG("Error, context initialization failed %s\n", (char *) expanded_label);
-      EVP_PKEY_CTX_free(pctx);
       return false;
    }
    if (1 != EVP_PKEY_CTX_hkdf_mode(pctx, EVP_PKEY_HKDEF_MODE_EXPAND_ONLY)) {
       DEBUG_MSG("Error, mode initialization failed %s\n", (char *) expanded_label);
-      EVP_PKEY_CTX_free(pctx);
       return false;
    }
    if (1 != EVP_PKEY_CTX_set_hkdf_md(pctx, EVP_sha256())) {
       DEBUG_MSG("Error, message digest initialization failed %s\n", (char *) expanded_label);
-      EVP_PKEY_CTX_free(pctx);
       return false;
    }
    if (1 != EVP_PKEY_CTX_add1_hkdf_info(pctx, expanded_label, size)) {
       DEBUG_MSG("Error, info initialization failed %s\n", (char *) expanded_label);
-      EVP_PKEY_CTX_free(pctx);
       return false;
    }
    if (1 != EVP_PKEY_CTX_set1_hkdf_key(pctx, secret, HASH_SHA2_256_LENGTH)) {
       DEBUG_MSG("Error, key initialization failed %s\n", (char *) expanded_label);
-      EVP_PKEY_CTX_free(pctx);
       return false;
    }
    if (1 != EVP_PKEY_derive(pctx, store_data, &output_len)) {
       DEBUG_MSG("Error, HKDF-Expand derivation failed %s\n", (char *) expanded_label);
-      EVP_PKEY_CTX_free(pctx);
       return false;
    }
-   EVP_PKEY_CTX_free(pctx);
    return true;
 } // QUICPlugin::quic_derive_n_set
 
 bool QUICParser::quic_derive_secrets(uint8_t *secret)
 {
+   EVP_PKEY_CTX *pctx = quic_crypto_ctx().hkdf;
    uint8_t len_quic_key;
    uint8_t len_quic_iv;
    uint8_t len_quic_hp;
@@ -374,9 +466,9 @@ bool QUICParser::quic_derive_secrets(uint8_t *secret)
       expand_label("tls13 ", "quic iv", NULL, 0, TLS13_AEAD_NONCE_LENGTH, quic_iv, len_quic_iv);
       expand_label("tls13 ", "quic hp", NULL, 0, AES_128_KEY_LENGTH, quic_hp, len_quic_hp);
       // use HKDF-Expand to derive other secrets
-      if (!quic_derive_n_set(secret, quic_key, len_quic_key, AES_128_KEY_LENGTH, initial_secrets.key) ||
-        !quic_derive_n_set(secret, quic_iv, len_quic_iv, TLS13_AEAD_NONCE_LENGTH, initial_secrets.iv) ||
-        !quic_derive_n_set(secret, quic_hp, len_quic_hp, AES_128_KEY_LENGTH, initial_secrets.hp)) {
+      if (!quic_derive_n_set(pctx, secret, quic_key, len_quic_key, AES_128_KEY_LENGTH, initial_secrets.key) ||
+        !quic_derive_n_set(pctx, secret, quic_iv, len_quic_iv, TLS13_AEAD_NONCE_LENGTH, initial_secrets.iv) ||
+        !quic_derive_n_set(pctx, secret, quic_hp, len_quic_hp, AES_128_KEY_LENGTH, initial_secrets.hp)) {
          DEBUG_MSG("Error, derivation of initial secrets failed\n");
          return false;
       }
@@ -389,9 +481,9 @@ bool QUICParser::quic_derive_secrets(uint8_t *secret)
       expand_label("tls13 ", "quicv2 hp", NULL, 0, AES_128_KEY_LENGTH, quic_hp, len_quic_hp);
 
       // use HKDF-Expand to derive other secrets
-      if (!quic_derive_n_set(secret, quic_key, len_quic_key, AES_128_KEY_LENGTH, initial_secrets.key) ||
-        !quic_derive_n_set(secret, quic_iv, len_quic_iv, TLS13_AEAD_NONCE_LENGTH, initial_secrets.iv) ||
-        !quic_derive_n_set(secret, quic_hp, len_quic_hp, AES_128_KEY_LENGTH, initial_secrets.hp)) {
+      if (!quic_derive_n_set(pctx, secret, quic_key, len_quic_key, AES_128_KEY_LENGTH, initial_secrets.key) ||
+        !quic_derive_n_set(pctx, secret, quic_iv, len_quic_iv, TLS13_AEAD_NONCE_LENGTH, initial_secrets.iv) ||
+        !quic_derive_n_set(pctx, secret, quic_hp, len_quic_hp, AES_128_KEY_LENGTH, initial_secrets.hp)) {
          DEBUG_MSG("Error, derivation of initial secrets failed\n");
          return false;
       }
@@ -402,6 +494,12 @@ bool QUICParser::quic_derive_secrets(uint8_t *secret)
 
 bool QUICParser::quic_create_initial_secrets()
 {
+   QUICKeyCache &cache = quic_key_cache();
+
+   if (cache.lookup(version, dcid, quic_h1->dcid_len, initial_secrets)) {
+      return true;
+   }
+
    uint8_t extracted_secret[HASH_SHA2_256_LENGTH] = { 0 };
    size_t extr_len = HASH_SHA2_256_LENGTH;
 
@@ -415,37 +513,30 @@ bool QUICParser::quic_create_initial_secrets()
 
 
    // HKDF-Extract
-   EVP_PKEY_CTX *pctx;
+   EVP_PKEY_CTX *pctx = quic_crypto_ctx().hkdf;
 
-   pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, NULL);
    if (1 != EVP_PKEY_derive_init(pctx)) {
       DEBUG_MSG("Error, context initialization failed(Extract)\n");
-      EVP_PKEY_CTX_free(pctx);
       return false;
    }
    if (1 != EVP_PKEY_CTX_hkdf_mode(pctx, EVP_PKEY_HKDEF_MODE_EXTRACT_ONLY)) {
       DEBUG_MSG("Error, mode initialization failed(Extract)\n");
-      EVP_PKEY_CTX_free(pctx);
       return false;
    }
    if (1 != EVP_PKEY_CTX_set_hkdf_md(pctx, EVP_sha256())) {
       DEBUG_MSG("Error, message digest initialization failed(Extract)\n");
-      EVP_PKEY_CTX_free(pctx);
       return false;
    }
    if (1 != EVP_PKEY_CTX_set1_hkdf_salt(pctx, salt, SALT_LENGTH)) {
       DEBUG_MSG("Error, salt initialization failed(Extract)\n");
-      EVP_PKEY_CTX_free(pctx);
       return false;
    }
    if (1 != EVP_PKEY_CTX_set1_hkdf_key(pctx, dcid, quic_h1->dcid_len)) {
       DEBUG_MSG("Error, key initialization failed(Extract)\n");
-      EVP_PKEY_CTX_free(pctx);
       return false;
    }
    if (1 != EVP_PKEY_derive(pctx, extracted_secret, &extr_len)) {
       DEBUG_MSG("Error, HKDF-Extract derivation failed\n");
-      EVP_PKEY_CTX_free(pctx);
       return false;
    }
    // Expand-Label
@@ -453,69 +544,54 @@ bool QUICParser::quic_create_initial_secrets()
    // HKDF-Expand
    if (!EVP_PKEY_derive_init(pctx)) {
       DEBUG_MSG("Error, context initialization failed(Expand)\n");
-      EVP_PKEY_CTX_free(pctx);
       return false;
    }
    if (1 != EVP_PKEY_CTX_hkdf_mode(pctx, EVP_PKEY_HKDEF_MODE_EXPAND_ONLY)) {
       DEBUG_MSG("Error, mode initialization failed(Expand)\n");
-      EVP_PKEY_CTX_free(pctx);
       return false;
    }
    if (1 != EVP_PKEY_CTX_set_hkdf_md(pctx, EVP_sha256())) {
       DEBUG_MSG("Error, message digest initialization failed(Expand)\n");
-      EVP_PKEY_CTX_free(pctx);
       return false;
    }
    if (1 != EVP_PKEY_CTX_add1_hkdf_info(pctx, expand_label_buffer, expand_label_len)) {
       DEBUG_MSG("Error, info initialization failed(Expand)\n");
-      EVP_PKEY_CTX_free(pctx);
       return false;
    }
    if (1 != EVP_PKEY_CTX_set1_hkdf_key(pctx, extracted_secret, HASH_SHA2_256_LENGTH)) {
       DEBUG_MSG("Error, key initialization failed(Expand)\n");
-      EVP_PKEY_CTX_free(pctx);
       return false;
    }
    if (1 != EVP_PKEY_derive(pctx, expanded_secret, &expd_len)) {
       DEBUG_MSG("Error, HKDF-Expand derivation failed\n");
-      EVP_PKEY_CTX_free(pctx);
       return false;
    }
-   EVP_PKEY_CTX_free(pctx);
    if (!quic_derive_secrets(expanded_secret)) {
       DEBUG_MSG("Error, Derivation of initial secrets failed\n");
       return false;
    }
+   cache.insert(version, dcid, quic_h1->dcid_len, initial_secrets);
    return true;
 } // QUICPlugin::quic_create_initial_secrets
 
 bool QUICParser::quic_encrypt_sample(uint8_t *plaintext)
 {
    int len = 0;
-   EVP_CIPHER_CTX *ctx;
+   EVP_CIPHER_CTX *ctx = quic_crypto_ctx().hp;
 
-   if (!(ctx = EVP_CIPHER_CTX_new())) {
-      DEBUG_MSG("Sample encryption, creating context failed\n");
-      return false;
-   }
-   if (!(EVP_EncryptInit_ex(ctx, EVP_aes_128_ecb(), NULL, initial_secrets.hp, NULL))) {
+   // cipher and disabled padding are kept from context construction, only the key changes
+   if (!(EVP_EncryptInit_ex(ctx, NULL, NULL, initial_secrets.hp, NULL))) {
       DEBUG_MSG("Sample encryption, context initialization failed\n");
-      EVP_CIPHER_CTX_free(ctx);
       return false;
    }
-   // we need to disable padding so we can use EncryptFinal
-   EVP_CIPHER_CTX_set_padding(ctx, 0);
    if (!(EVP_EncryptUpdate(ctx, plaintext, &len, sample, SAMPLE_LENGTH))) {
       DEBUG_MSG("Sample encryption, decrypting header failed\n");
-      EVP_CIPHER_CTX_free(ctx);
       return false;
    }
    if (!(EVP_EncryptFinal_ex(ctx, plaintext + len, &len))) {
       DEBUG_MSG("Sample encryption, final header decryption failed\n");
-      EVP_CIPHER_CTX_free(ctx);
       return false;
    }
-   EVP_CIPHER_CTX_free(ctx);
    return true;
 }
 
@@ -597,50 +673,30 @@ bool QUICParser::quic_decrypt_payload()
    // adjust length because last 16 bytes are authentication tag
    payload_len -= 16;
    memcpy(&atag, &payload[payload_len], 16);
-   EVP_CIPHER_CTX *ctx;
+   EVP_CIPHER_CTX *ctx = quic_crypto_ctx().aead;
 
-   if (!(ctx = EVP_CIPHER_CTX_new())) {
-      DEBUG_MSG("Payload decryption error, creating context failed\n");
-      return false;
-   }
-   if (!EVP_DecryptInit_ex(ctx, EVP_aes_128_gcm(), NULL, NULL, NULL)) {
-      DEBUG_MSG("Payload decryption error, context initialization failed\n");
-      EVP_CIPHER_CTX_free(ctx);
-      return false;
-   }
-   if (!EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN, TLS13_AEAD_NONCE_LENGTH, NULL)) {
-      DEBUG_MSG("Payload decryption error, setting NONCE length failed\n");
-      EVP_CIPHER_CTX_free(ctx);
-      return false;
-   }
-   // SET NONCE and KEY
+   // SET NONCE and KEY, AES-128-GCM and nonce length are kept from context construction
    if (!EVP_DecryptInit_ex(ctx, NULL, NULL, initial_secrets.key, initial_secrets.iv)) {
       DEBUG_MSG("Payload decryption error, setting KEY and NONCE failed\n");
-      EVP_CIPHER_CTX_free(ctx);
       return false;
    }
    // SET ASSOCIATED DATA (HEADER with unprotected PKN)
    if (!EVP_DecryptUpdate(ctx, NULL, &len, header, header_len)) {
       DEBUG_MSG("Payload decryption error, initializing authenticated data failed\n");
-      EVP_CIPHER_CTX_free(ctx);
       return false;
    }
    if (!EVP_DecryptUpdate(ctx, decrypted_payload, &len, payload, payload_len)) {
       DEBUG_MSG("Payload decryption error, decrypting payload failed\n");
-      EVP_CIPHER_CTX_free(ctx);
       return false;
    }
    if (!EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, 16, atag)) {
       DEBUG_MSG("Payload decryption error, TAG check failed\n");
-      EVP_CIPHER_CTX_free(ctx);
       return false;
    }
    if (!EVP_DecryptFinal_ex(ctx, decrypted_payload + len, &len)) {
       DEBUG_MSG("Payload decryption error, final payload decryption failed\n");
-      EVP_CIPHER_CTX_free(ctx);
       return false;
    }
-   EVP_CIPHER_CTX_free(ctx);
    final_payload = decrypted_payload;
    return true;
 } // QUICPlugin::quic_decrypt_payload
@@ -792,8 +848,9 @@ bool QUICParser::quic_check_initial(uint8_t packet0)
 
 bool QUICParser::quic_initial_checks(const Packet&pkt)
 {
-   // Port check, Initial packet check and UDP check
-   if (pkt.ip_proto != 17 || !quic_check_initial(pkt.payload[0]) || pkt.dst_port != 443) {
+   // Port check, Initial packet check and UDP check, all done before any crypto is touched
+   if (pkt.ip_proto != 17 || pkt.dst_port != 443 || pkt.payload_len < sizeof(quic_first_ver_dcidlen) ||
+     !quic_check_initial(pkt.payload[0])) {
       DEBUG_MSG("Packet is not Initial or does not contains LONG HEADER or is not on port 443\n");
       return false;
    }
@@ -889,11 +946,14 @@ bool QUICParser::quic_start(const Packet& pkt)
       return false;
    }
 
-   quic_initialze_arrays();
    if (!quic_parse_header(pkt)) {
       DEBUG_MSG("Error, parsing header failed\n");
       return false;
    }
+   if (!quic_crypto_ctx().valid) {
+      return false;
+   }
+   quic_initialze_arrays();
    if (!quic_create_initial_secrets()) {
       DEBUG_MSG("Error, creation of initial secrets failed (client side)\n");
       return false;
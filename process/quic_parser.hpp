@@ -44,6 +44,11 @@
 #define BUFF_SIZE           255
 #define CURRENT_BUFFER_SIZE 1500
 
+// connection IDs longer than this (allowed only by pre-RFC versions) are never cached
+#define QUIC_MAX_CID_LEN    20
+// number of derived Initial secrets remembered by each thread
+#define QUIC_KEY_CACHE_SIZE 16
+
 namespace ipxp {
 typedef struct __attribute__((packed)) quic_first_ver_dcidlen {
    uint8_t  first_byte;
@@ -62,6 +67,50 @@ typedef struct Initial_Secrets {
    uint8_t hp[AES_128_KEY_LENGTH];
 } Initial_Secrets;
 
+/**
+ * \brief OpenSSL contexts reused by all QUIC parsers running in one thread.
+ *
+ * Contexts are allocated once and only rekeyed per packet, cipher selection and
+ * padding are configured in the constructor.
+ */
+struct QUICCryptoCtx {
+   EVP_PKEY_CTX *hkdf;   /**< HKDF context for extract/expand. */
+   EVP_CIPHER_CTX *hp;   /**< AES-128-ECB context for header protection. */
+   EVP_CIPHER_CTX *aead; /**< AES-128-GCM context for payload decryption. */
+   bool valid;           /**< All contexts were successfully initialized. */
+
+   QUICCryptoCtx();
+   ~QUICCryptoCtx();
+   QUICCryptoCtx(const QUICCryptoCtx &) = delete;
+   QUICCryptoCtx &operator=(const QUICCryptoCtx &) = delete;
+};
+
+/**
+ * \brief Small LRU cache of Initial secrets keyed by version and destination connection ID.
+ *
+ * Client Initial secrets depend only on the version salt and the DCID chosen by the client,
+ * so retransmitted and coalesced Initials of one connection can skip HKDF derivation.
+ */
+class QUICKeyCache
+{
+public:
+   QUICKeyCache();
+   bool lookup(uint32_t version, const uint8_t *dcid, uint8_t dcid_len, Initial_Secrets &out);
+   void insert(uint32_t version, const uint8_t *dcid, uint8_t dcid_len, const Initial_Secrets &secrets);
+
+private:
+   struct Entry {
+      uint32_t version;
+      uint32_t last_used; /**< Value of the access counter at the last hit, 0 marks empty slot. */
+      uint8_t dcid_len;
+      uint8_t dcid[QUIC_MAX_CID_LEN];
+      Initial_Secrets secrets;
+   };
+
+   Entry m_entries[QUIC_KEY_CACHE_SIZE];
+   uint32_t m_clock;
+};
+
 class QUICParser
 {
 private:
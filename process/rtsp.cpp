@@ -51,6 +51,7 @@
 
 #include "common.hpp"
 #include "rtsp.hpp"
+#include "header-tokenizer.hpp"
 
 namespace ipxp {
 
@@ -80,7 +81,6 @@ __attribute__((constructor)) static void register_this_plugin()
 #endif
 
 #define RTSP_LINE_DELIMITER   '\n'
-#define RTSP_KEYVAL_DELIMITER ':'
 
 RTSPPlugin::RTSPPlugin() : recPrealloc(nullptr), flow_flush(false),
    requests(0), responses(0), total(0)
@@ -204,7 +204,6 @@ bool RTSPPlugin::parse_rtsp_request(const char *data, int payload_len, RecordExt
    char buffer[64];
    const char *begin;
    const char *end;
-   const char *keyval_delimiter;
    size_t remaining;
 
    total++;
@@ -284,40 +283,34 @@ bool RTSPPlugin::parse_rtsp_request(const char *data, int payload_len, RecordExt
     *
     * REQ-FIELD: VALUE
     * |        |      |
-    * |        |      ----- end
-    * |        ------------ keyval_delimiter
-    * --------------------- begin
+    * |        |      ----- line.end
+    * |        ------------ line.colon
+    * --------------------- line.begin
     */
 
    rec->user_agent[0] = 0;
    /* Process headers. */
-   while (begin - data < payload_len) {
-      remaining = payload_len - (begin - data);
-      end = static_cast<const char *>(memchr(begin, RTSP_LINE_DELIMITER, remaining));
-      keyval_delimiter = static_cast<const char *>(memchr(begin, RTSP_KEYVAL_DELIMITER, remaining));
-
-      int tmp = end - begin;
-      if (tmp == 0 || tmp == 1) { /* Check for blank line with \r\n or \n ending. */
+   HeaderTokenizer tokenizer(begin, payload_len - (begin - data));
+   HeaderLine line;
+   while (tokenizer.next(line)) {
+      if (line.blank()) { /* Check for blank line with \r\n or \n ending. */
          break; /* Double LF found - end of header section. */
-      } else if (end == nullptr || keyval_delimiter == NULL) {
+      } else if (!line.terminated) {
          DEBUG_MSG("Parser quits:\theader is fragmented\n");
          return  false;
+      } else if (line.colon == nullptr) {
+         continue;
       }
 
-      /* Copy field name. */
-      copy_str(buffer, sizeof(buffer), begin, keyval_delimiter);
-
+      DEBUG_CODE(copy_str(buffer, sizeof(buffer), line.begin, line.colon));
       DEBUG_CODE(char debug_buffer[4096]);
-      DEBUG_CODE(copy_str(debug_buffer, sizeof(debug_buffer), keyval_delimiter + 2, end));
+      DEBUG_CODE(copy_str(debug_buffer, sizeof(debug_buffer), line.value(), line.end));
       DEBUG_MSG("\t%s: %s\n", buffer, debug_buffer);
 
       /* Copy interesting field values. */
-      if (!strcmp(buffer, "User-Agent")) {
-         copy_str(rec->user_agent, sizeof(rec->user_agent), keyval_delimiter + 2, end);
+      if (header_field_lookup(line.begin, line.colon - line.begin, false) == HeaderField::USER_AGENT) {
+         copy_str(rec->user_agent, sizeof(rec->user_agent), line.value(), line.end);
       }
-
-      /* Go to next line. */
-      begin = end + 1 ;
    }
 
    DEBUG_MSG("Parser quits:\tend of header section\n");
@@ -338,7 +331,6 @@ bool RTSPPlugin::parse_rtsp_response(const char *data, int payload_len, RecordEx
    char buffer[64];
    const char *begin;
    const char *end;
-   const char *keyval_delimiter;
    size_t remaining;
    int code;
 
@@ -421,42 +413,41 @@ bool RTSPPlugin::parse_rtsp_response(const char *data, int payload_len, RecordEx
     *
     * REQ-FIELD: VALUE
     * |        |      |
-    * |        |      ----- end
-    * |        ------------ keyval_delimiter
-    * --------------------- begin
+    * |        |      ----- line.end
+    * |        ------------ line.colon
+    * --------------------- line.begin
     */
 
    rec->content_type[0] = 0;
    /* Process headers. */
-   while (begin - data < payload_len) {
-      remaining = payload_len - (begin - data);
-      end = static_cast<const char *>(memchr(begin, RTSP_LINE_DELIMITER, remaining));
-      keyval_delimiter = static_cast<const char *>(memchr(begin, RTSP_KEYVAL_DELIMITER, remaining));
-
-      int tmp = end - begin;
-      if (tmp == 0 || tmp == 1) { /* Check for blank line with \r\n or \n ending. */
+   HeaderTokenizer tokenizer(begin, payload_len - (begin - data));
+   HeaderLine line;
+   while (tokenizer.next(line)) {
+      if (line.blank()) { /* Check for blank line with \r\n or \n ending. */
          break; /* Double LF found - end of header section. */
-      } else if (end == nullptr || keyval_delimiter == NULL) {
+      } else if (!line.terminated) {
          DEBUG_MSG("Parser quits:\theader is fragmented\n");
          return  false;
+      } else if (line.colon == nullptr) {
+         continue;
       }
 
-      /* Copy field name. */
-      copy_str(buffer, sizeof(buffer), begin, keyval_delimiter);
-
+      DEBUG_CODE(copy_str(buffer, sizeof(buffer), line.begin, line.colon));
       DEBUG_CODE(char debug_buffer[4096]);
-      DEBUG_CODE(copy_str(debug_buffer, sizeof(debug_buffer), keyval_delimiter + 2, end));
+      DEBUG_CODE(copy_str(debug_buffer, sizeof(debug_buffer), line.value(), line.end));
       DEBUG_MSG("\t%s: %s\n", buffer, debug_buffer);
 
       /* Copy interesting field values. */
-      if (!strcmp(buffer, "Content-Type")) {
-         copy_str(rec->content_type, sizeof(rec->content_type), keyval_delimiter + 2, end);
-      } else if (!strcmp(buffer, "Server")) {
-         copy_str(rec->server, sizeof(rec->server), keyval_delimiter + 2, end);
+      switch (header_field_lookup(line.begin, line.colon - line.begin, false)) {
+      case HeaderField::CONTENT_TYPE:
+         copy_str(rec->content_type, sizeof(rec->content_type), line.value(), line.end);
+         break;
+      case HeaderField::SERVER:
+         copy_str(rec->server, sizeof(rec->server), line.value(), line.end);
+         break;
+      default:
+         break;
       }
-
-      /* Go to next line. */
-      begin = end + 1 ;
    }
 
    DEBUG_MSG("Parser quits:\tend of header section\n");
@@ -200,6 +200,8 @@ struct RecordExtRTSP : public RecordExt {
          << ",status=" << code;
       return out.str();
    }
+
+   RECORD_EXT_PLAIN_SNAPSHOT(RecordExtRTSP, 1)
 };
 
 /**
@@ -214,6 +216,7 @@ public:
    void close();
    OptionsParser *get_parser() const { return new OptionsParser("rtsp", "Parse RTSP traffic"); }
    std::string get_name() const { return "rtsp"; }
+   PluginInterest get_interest() const { return PluginInterest({}, {}, true); }
    RecordExt *get_ext() const { return new RecordExtRTSP(); }
    ProcessPlugin *copy();
 
@@ -0,0 +1,83 @@
+/**
+ * \file sha256.hpp
+ * \brief Incremental SHA-256 (FIPS 180-4) used for fingerprint hashing.
+ * \author agent <agent@local>
+ * \date 2026
+ */
+/*
+ * Copyright (C) 2026 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef IPXP_PROCESS_SHA256_HPP
+#define IPXP_PROCESS_SHA256_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+namespace ipxp {
+
+#define SHA256_DIGEST_LENGTH_BYTES 32
+
+/**
+ * \brief Allocation free SHA-256 context.
+ *
+ * Usage mirrors the MD5 class: feed data with update(), call finalize()
+ * and read the result with binary_digest().
+ */
+class SHA256
+{
+public:
+   SHA256();
+   void update(const uint8_t *data, size_t length);
+   void update(const char *data, size_t length);
+   SHA256 &finalize();
+   const uint8_t *binary_digest() const;
+
+private:
+   enum { blocksize = 64 };
+
+   void transform(const uint8_t *block);
+
+   uint32_t m_state[8];
+   uint64_t m_length;            /**< Total number of hashed bytes. */
+   uint8_t m_buffer[blocksize];  /**< Bytes that did not fill the last block. */
+   uint8_t m_used;
+   bool m_finalized;
+   uint8_t m_digest[SHA256_DIGEST_LENGTH_BYTES];
+};
+
+}
+#endif /* IPXP_PROCESS_SHA256_HPP */
@@ -50,6 +50,7 @@
 #endif
 
 #include "sip.hpp"
+#include "header-tokenizer.hpp"
 
 namespace ipxp {
 
@@ -450,23 +451,22 @@ void SIPPlugin::parser_field_uri(const unsigned char *line, int linelen, int ski
 
 int SIPPlugin::parser_process_sip(const Packet &pkt, RecordExtSIP *sip_data)
 {
-   const unsigned char *payload;
    const unsigned char *line;
-   int caplen;
-   unsigned int line_len = 0;
+   unsigned int line_len;
+   unsigned int skip;
+   const char *name_end;
    int field_len;
-   parser_strtok_t line_parser;
-   uint32_t first_bytes4;
-   uint32_t first_bytes3;
-   uint32_t first_bytes2;
+   HeaderLine header;
 
-   /* Skip the packet headers: */
-   payload = (unsigned char *)pkt.payload;
-   caplen = pkt.payload_len;
+   /* Divide the packet payload by line breaks and process them one by one: */
+   HeaderTokenizer tokenizer(reinterpret_cast<const char *>(pkt.payload), pkt.payload_len);
 
    /* Grab the first line of the payload: */
-   line = parser_strtok(payload, caplen, '\n', &line_len, &line_parser);
-
+   if (!tokenizer.next(header)) {
+      header.begin = header.end = reinterpret_cast<const char *>(pkt.payload);
+   }
+   line = reinterpret_cast<const unsigned char *>(header.begin);
+   line_len = header.end - header.begin;
 
    /* Get Request-URI for SIP requests from first line of the payload: */
    if (sip_data->msg_type <= 10) {
@@ -504,73 +504,55 @@ int SIPPlugin::parser_process_sip(const Packet &pkt, RecordExtSIP *sip_data)
    }
 
    total++;
-   /* Go to the next line. Divide the packet payload by line breaks and process them one by one: */
-   line = parser_strtok(nullptr, 0, ' ', &line_len, &line_parser);
 
    /*
     * Process all the remaining attributes:
     */
-   while (line != nullptr && line_len > 1) {
-      /* Get first 4, 3 and 2 bytes and compare them with searched SIP fields: */
-      first_bytes4 = SIP_UCFOUR(*((uint32_t *) line));
-      first_bytes3 = SIP_UCTHREE(*((uint32_t *) line));
-      first_bytes2 = SIP_UCTWO(*((uint32_t *) line));
-
-      /* From: */
-      if (first_bytes4 == SIP_FROM4) {
-         parser_field_uri(line, line_len, 5, sip_data->calling_party, sizeof(sip_data->calling_party));
-      } else if (first_bytes2 == SIP_FROM2) {
-         parser_field_uri(line, line_len, 2, sip_data->calling_party, sizeof(sip_data->calling_party));
+   while (tokenizer.next(header) && !header.blank()) {
+      if (header.colon == nullptr) {
+         continue;
       }
 
-      /* To: */
-      else if (first_bytes3 == SIP_TO3) {
-         parser_field_uri(line, line_len, 3, sip_data->called_party, sizeof(sip_data->called_party));
-      } else if (first_bytes2 == SIP_TO2) {
-         parser_field_uri(line, line_len, 2, sip_data->called_party, sizeof(sip_data->called_party));
+      /* Header name may be followed by whitespaces before the colon: */
+      name_end = header.colon;
+      while (name_end > header.begin && (name_end[-1] == ' ' || name_end[-1] == '\t')) {
+         name_end--;
       }
 
-      /* Via: */
-      else if (first_bytes4 == SIP_VIA4) {
+      line = reinterpret_cast<const unsigned char *>(header.begin);
+      line_len = header.end - header.begin;
+      skip = header.colon + 1 - header.begin;
+
+      /* Long and compact forms of the names are matched case insensitively: */
+      switch (header_field_lookup(header.begin, name_end - header.begin, true)) {
+      case HeaderField::FROM:
+         parser_field_uri(line, line_len, skip, sip_data->calling_party, sizeof(sip_data->calling_party));
+         break;
+      case HeaderField::TO:
+         parser_field_uri(line, line_len, skip, sip_data->called_party, sizeof(sip_data->called_party));
+         break;
+      case HeaderField::VIA:
          /* Via fields can be present more times. Include all and separate them by semicolons: */
          if (sip_data->via[0] == 0) {
-            parser_field_value(line, line_len, 4, sip_data->via, sizeof(sip_data->via));
-         } else {
-            field_len = strlen(sip_data->via);
-            sip_data->via[field_len++] = ';';
-            parser_field_value(line, line_len, 4, sip_data->via + field_len, sizeof(sip_data->via) - field_len);
-         }
-      } else if (first_bytes2 == SIP_VIA2) {
-         if (sip_data->via[0] == 0) {
-            parser_field_value(line, line_len, 2, sip_data->via, sizeof(sip_data->via));
+            parser_field_value(line, line_len, skip, sip_data->via, sizeof(sip_data->via));
          } else {
             field_len = strlen(sip_data->via);
             sip_data->via[field_len++] = ';';
-            parser_field_value(line, line_len, 2, sip_data->via + field_len, sizeof(sip_data->via) - field_len);
+            parser_field_value(line, line_len, skip, sip_data->via + field_len, sizeof(sip_data->via) - field_len);
          }
+         break;
+      case HeaderField::CALL_ID:
+         parser_field_value(line, line_len, skip, sip_data->call_id, sizeof(sip_data->call_id));
+         break;
+      case HeaderField::USER_AGENT:
+         parser_field_value(line, line_len, skip, sip_data->user_agent, sizeof(sip_data->user_agent));
+         break;
+      case HeaderField::CSEQ:
+         parser_field_value(line, line_len, skip, sip_data->cseq, sizeof(sip_data->cseq));
+         break;
+      default:
+         break;
       }
-
-      /* Call-ID: */
-      else if (first_bytes4 == SIP_CALLID4) {
-         parser_field_value(line, line_len, 8, sip_data->call_id, sizeof(sip_data->call_id));
-      } else if (first_bytes2 == SIP_CALLID2) {
-         parser_field_value(line, line_len, 2, sip_data->call_id, sizeof(sip_data->call_id));
-      }
-
-      /* User-Agent: */
-      else if (first_bytes4 == SIP_USERAGENT4) {
-         parser_field_value(line, line_len, 11, sip_data->user_agent, sizeof(sip_data->user_agent));
-      }
-
-      /* CSeq: */
-      else if (first_bytes4 == SIP_CSEQ4) {
-
-         /* Save CSeq: */
-         parser_field_value(line, line_len, 5, sip_data->cseq, sizeof(sip_data->cseq));
-      }
-
-      /* Go to the next line: */
-      line = parser_strtok(nullptr, 0, ' ', &line_len, &line_parser);
    }
 
    return 0;
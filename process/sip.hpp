@@ -221,76 +221,7 @@ namespace ipxp {
  * detect necessary SIP fields.
  */
 /* This macro converts low ASCII characters to upper case. Colon changes to 0x1a character: */
-#if BYTEORDER == 1234
-#  define SIP_UCFOUR(A)   ((A) & 0xdfdfdfdf)
-#  define SIP_UCTWO(A)    ((A) & 0x0000dfdf)
-#  define SIP_UCTHREE(A)  ((A) & 0x00dfdfdf)
-#else
-#  define SIP_UCFOUR(A)   ((A) & 0xdfdfdfdf)
-#  define SIP_UCTWO(A)    ((A) & 0xdfdf0000)
-#  define SIP_UCTHREE(A)  ((A) & 0xdfdfdf00)
-#endif
-
-/* Encoded SIP field names - long and short alternatives. The trailing number means the number of bytes to compare: */
-#if BYTEORDER == 1234
-#  define SIP_VIA4        0x1a414956	/* :AIV */
-#else
-#  define SIP_VIA4        0x5649411a	/* VIA: */
-#endif
-
-#if BYTEORDER == 1234
-#  define SIP_VIA2        0x00001a56	/*   :V */
-#else
-#  define SIP_VIA2        0x561a0000	/* V:   */
-#endif
-
-#if BYTEORDER == 1234
-#  define SIP_FROM4       0x4d4f5246	/* MORF */
-#else
-#  define SIP_FROM4       0x46524f4d	/* FROM */
-#endif
-
-#if BYTEORDER == 1234
-#  define SIP_FROM2       0x00001a46	/*   :F */
-#else
-#  define SIP_FROM2       0x461a0000	/* F:   */
-#endif
-
-#if BYTEORDER == 1234
-#  define SIP_TO3         0x001a4f54	/*  :OT */
-#else
-#  define SIP_TO3         0x544f1a00	/* TO:  */
-#endif
-
-#if BYTEORDER == 1234
-#  define SIP_TO2         0x00001a54	/*   :T */
-#else
-#  define SIP_TO2         0x541a0000	/* T:   */
-#endif
-
-#if BYTEORDER == 1234
-#  define SIP_CALLID4     0x4c4c4143	/* LLAC */
-#else
-#  define SIP_CALLID4     0x43414c4c	/* CALL */
-#endif
-
-#if BYTEORDER == 1234
-#  define SIP_CALLID2     0x00001a49	/*   :I */
-#else
-#  define SIP_CALLID2     0x491a0000	/* I:   */
-#endif
-
-#if BYTEORDER == 1234
-#  define SIP_CSEQ4       0x51455343	/* QESC */
-#else
-#  define SIP_CSEQ4       0x43534551	/* CSEQ */
-#endif
-
-#if BYTEORDER == 1234
-#  define SIP_USERAGENT4  0x52455355	/* RESU */
-#else
-#  define SIP_USERAGENT4  0x55534552	/* USER */
-#endif
+#define SIP_UCFOUR(A)   ((A) & 0xdfdfdfdf)
 
 /* Encoded SIP URI start: */
 #if BYTEORDER == 1234
@@ -499,6 +430,8 @@ struct RecordExtSIP : public RecordExt {
          << ",via=\"" << via << "\"";
       return out.str();
    }
+
+   RECORD_EXT_PLAIN_SNAPSHOT(RecordExtSIP, 1)
 };
 
 class SIPPlugin : public ProcessPlugin {
@@ -509,6 +442,7 @@ public:
    void close();
    OptionsParser *get_parser() const { return new OptionsParser("sip", "Parse SIP traffic"); }
    std::string get_name() const { return "sip"; }
+   PluginInterest get_interest() const { return PluginInterest({}, {}, true); }
    RecordExt *get_ext() const { return new RecordExtSIP(); }
    ProcessPlugin *copy();
    int post_create(Flow &rec, const Packet &pkt);
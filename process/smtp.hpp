@@ -239,6 +239,8 @@ struct RecordExtSMTP : public RecordExt {
          << ",firstrecipient=\"" << first_recipient << "\"";
       return out.str();
    }
+
+   RECORD_EXT_PLAIN_SNAPSHOT(RecordExtSMTP, 1)
 };
 
 /**
@@ -253,6 +255,7 @@ public:
    void close();
    OptionsParser *get_parser() const { return new OptionsParser("smtp", "Parse SMTP traffic"); }
    std::string get_name() const { return "smtp"; }
+   PluginInterest get_interest() const { return PluginInterest({}, {25}, true); }
    RecordExt *get_ext() const { return new RecordExtSMTP(); }
    ProcessPlugin *copy();
 
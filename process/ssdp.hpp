@@ -179,6 +179,8 @@ struct RecordExtSSDP : public RecordExt {
          << ",useragent=\"" << user_agent << "\"";
       return out.str();
    }
+
+   RECORD_EXT_PLAIN_SNAPSHOT(RecordExtSSDP, 1)
 };
 
 /**
@@ -193,6 +195,7 @@ public:
    void close();
    OptionsParser *get_parser() const { return new OptionsParser("ssdp", "Parse SSDP traffic"); }
    std::string get_name() const { return "ssdp"; }
+   PluginInterest get_interest() const { return PluginInterest({}, {1900}, true); }
    RecordExt *get_ext() const { return new RecordExtSSDP(); }
    ProcessPlugin *copy();
 
@@ -48,7 +48,86 @@ __attribute__((constructor)) static void register_this_plugin()
 # define DEBUG_CODE(code)
 #endif
 
-TLSPlugin::TLSPlugin() : ext_ptr(nullptr), parsed_sni(0), flow_flush(false)
+TLSReassemblyPool::TLSReassemblyPool() : m_size(TLS_REASM_BUFFERS), m_used(0)
+{ }
+
+TLSReassemblyPool::TLSReassemblyPool(const TLSReassemblyPool &other) : m_size(other.m_size), m_used(0)
+{ }
+
+void TLSReassemblyPool::set_size(size_t count)
+{
+   m_size = count;
+}
+
+TLSReassembly *TLSReassemblyPool::find(const Flow &rec)
+{
+   if (m_used == 0) {
+      return nullptr;
+   }
+   for (auto &slot : m_slots) {
+      if (slot.flow != &rec) {
+         continue;
+      }
+      if (timercmp(&slot.flow_start, &rec.time_first, !=)) {
+         // Flow record was exported without pre_export and reused
+         release(&slot);
+         return nullptr;
+      }
+      return &slot;
+   }
+   return nullptr;
+}
+
+TLSReassembly *TLSReassemblyPool::acquire(const Flow &rec, const Packet &pkt, bool &stolen)
+{
+   TLSReassembly *buf;
+
+   stolen = false;
+   if (m_size == 0) {
+      return nullptr;
+   }
+   if (m_slots.empty()) {
+      m_slots.resize(m_size);
+      m_memory.resize(m_size * TLS_REASM_BUFFER_SIZE);
+      for (size_t i = 0; i < m_size; i++) {
+         m_slots[i].flow = nullptr;
+         m_slots[i].data = m_memory.data() + i * TLS_REASM_BUFFER_SIZE;
+         m_free.push_back(m_size - 1 - i);
+      }
+   }
+
+   if (m_free.empty()) {
+      buf = &m_slots[0];
+      for (auto &slot : m_slots) {
+         if (timercmp(&slot.last, &buf->last, <)) {
+            buf = &slot;
+         }
+      }
+      stolen = true;
+   } else {
+      buf = &m_slots[m_free.back()];
+      m_free.pop_back();
+      m_used++;
+   }
+
+   buf->flow       = &rec;
+   buf->flow_start = rec.time_first;
+   buf->last       = pkt.ts;
+   buf->src_port   = pkt.src_port;
+   buf->next_seq   = pkt.tcp_seq;
+   buf->length     = 0;
+   return buf;
+}
+
+void TLSReassemblyPool::release(TLSReassembly *buf)
+{
+   buf->flow = nullptr;
+   m_free.push_back(buf - m_slots.data());
+   m_used--;
+}
+
+TLSPlugin::TLSPlugin() : ext_ptr(nullptr), parsed_sni(0), flow_flush(false), ja4(false), reassembled(0),
+   reasm_failed(0)
 { }
 
 TLSPlugin::~TLSPlugin()
@@ -57,7 +136,17 @@ TLSPlugin::~TLSPlugin()
 }
 
 void TLSPlugin::init(const char *params)
-{ }
+{
+   TLSOptParser parser;
+   try {
+      parser.parse(params);
+   } catch (ParserError &e) {
+      throw PluginError(e.what());
+   }
+
+   ja4 = parser.m_ja4;
+   reasm_pool.set_size(parser.m_buffers);
+}
 
 void TLSPlugin::close()
 {
@@ -72,10 +161,22 @@ ProcessPlugin *TLSPlugin::copy()
    return new TLSPlugin(*this);
 }
 
+/**
+ * \brief Check whether payload starts with TLS record other than handshake.
+ *
+ * Such record means the handshake is already over and no hello will follow in the flow.
+ */
+static bool tls_is_non_handshake_record(const uint8_t *data, uint32_t len)
+{
+   const tls_rec *rec = (const tls_rec *) data;
+
+   return len >= sizeof(tls_rec) && rec->type >= 20 && rec->type <= 23 && rec->type != TLS_HANDSHAKE &&
+          rec->version.major == 3 && rec->version.minor <= 3;
+}
+
 int TLSPlugin::post_create(Flow &rec, const Packet &pkt)
 {
-   add_tls_record(rec, pkt);
-   return 0;
+   return add_tls_record(rec, pkt);
 }
 
 int TLSPlugin::pre_update(Flow &rec, Packet &pkt)
@@ -83,21 +184,102 @@ int TLSPlugin::pre_update(Flow &rec, Packet &pkt)
    RecordExtTLS *ext = static_cast<RecordExtTLS *>(rec.get_extension(RecordExtTLS::REGISTERED_ID));
 
    if (ext != nullptr) {
+      if (pkt.payload_len == 0) {
+         return 0;
+      }
       if (ext->alpn[0] == 0) {
          // Add ALPN from server packet
          parse_tls(pkt.payload, pkt.payload_len, ext);
       }
+      // Hellos are over with the first server packet carrying payload or with any non-handshake record,
+      // server hello without ALPN is common
+      if (ext->alpn[0] != 0 || !pkt.source_pkt || tls_is_non_handshake_record(pkt.payload, pkt.payload_len)) {
+         return FLOW_PLUGIN_DETACH;
+      }
+      return 0;
+   }
+
+   return add_tls_record(rec, pkt);
+}
+
+void TLSPlugin::pre_export(Flow &rec)
+{
+   TLSReassembly *buf = reasm_pool.find(rec);
+
+   if (buf != nullptr) {
+      reasm_pool.release(buf);
+   }
+}
+
+/**
+ * \brief Get length of hello message starting at the beginning of TLS payload.
+ * \param [in] data Start of TLS record.
+ * \param [in] len Number of available bytes.
+ * \return Length of record header, handshake header and hello body, 0 when payload does not start
+ * with a hello or the hello is fragmented into several records.
+ */
+static uint32_t tls_hello_length(const uint8_t *data, uint32_t len)
+{
+   const tls_rec *rec = (const tls_rec *) data;
+   const uint8_t *hs  = data + sizeof(tls_rec);
+
+   if (len < sizeof(tls_rec) + 4 || rec->type != TLS_HANDSHAKE ||
+     rec->version.major != 3 || rec->version.minor > 3) {
+      return 0;
+   }
+   if (hs[0] != TLS_HANDSHAKE_CLIENT_HELLO && hs[0] != TLS_HANDSHAKE_SERVER_HELLO) {
+      return 0;
+   }
+
+   uint32_t hs_len = ((uint32_t) hs[1] << 16) | ((uint32_t) hs[2] << 8) | hs[3];
+
+   if (hs_len + 4 > ntohs(rec->length)) {
       return 0;
    }
-   add_tls_record(rec, pkt);
+   return sizeof(tls_rec) + 4 + hs_len;
+}
+
+TLSPlugin::ReasmResult TLSPlugin::reassemble(TLSReassembly *buf, const Packet &pkt)
+{
+   if (pkt.src_port != buf->src_port || pkt.payload_len == 0) {
+      // segment of opposite direction or bare ACK
+      return ReasmResult::INCOMPLETE;
+   }
 
-   return 0;
+   int32_t diff = (int32_t) (pkt.tcp_seq - buf->next_seq);
+   if (diff > 0) {
+      // missing segment, out of order segments are not buffered
+      return ReasmResult::FAILED;
+   }
+
+   uint32_t skip = -diff;
+   if (skip >= pkt.payload_len) {
+      // retransmission of already collected data
+      return ReasmResult::INCOMPLETE;
+   }
+
+   uint32_t copy = pkt.payload_len - skip;
+   if (buf->length + copy > TLS_REASM_BUFFER_SIZE) {
+      copy = TLS_REASM_BUFFER_SIZE - buf->length;
+   }
+   memcpy(buf->data + buf->length, pkt.payload + skip, copy);
+   buf->length  += copy;
+   buf->next_seq = pkt.tcp_seq + skip + copy;
+   buf->last     = pkt.ts;
+
+   uint32_t needed = tls_hello_length(buf->data, buf->length);
+   if (needed == 0 || needed > TLS_REASM_BUFFER_SIZE) {
+      return ReasmResult::FAILED;
+   }
+   return buf->length >= needed ? ReasmResult::COMPLETE : ReasmResult::INCOMPLETE;
 }
 
-bool TLSPlugin::obtain_tls_data(TLSData &payload, RecordExtTLS *rec, std::string &ja3, uint8_t hs_type)
+bool TLSPlugin::obtain_tls_data(TLSData &payload, RecordExtTLS *rec, TLSJA3Hasher &ja3, TLSJA4Data *ja4_data,
+  uint8_t hs_type)
 {
-   std::string ecliptic_curves;
-   std::string ec_point_formats;
+   // curves and point formats close the JA3 string, only remember where they are
+   TLSData ecliptic_curves  = { nullptr, nullptr, 0 };
+   TLSData ec_point_formats = { nullptr, nullptr, 0 };
 
 
    while (payload.start + sizeof(tls_ext) <= payload.end) {
@@ -114,9 +296,21 @@ bool TLSPlugin::obtain_tls_data(TLSData &payload, RecordExtTLS *rec, std::string
          if (type == TLS_EXT_SERVER_NAME) {
             tls_parser.tls_get_server_name(payload, rec->sni, sizeof(rec->sni));
          } else if (type == TLS_EXT_ECLIPTIC_CURVES) {
-            ecliptic_curves = tls_parser.tls_get_ja3_ecpliptic_curves(payload);
+            ecliptic_curves = payload;
          } else if (type == TLS_EXT_EC_POINT_FORMATS) {
-            ec_point_formats = tls_parser.tls_get_ja3_ec_point_formats(payload);
+            ec_point_formats = payload;
+         }
+         if (ja4_data != nullptr) {
+            TLSData ext_data = { payload.start, payload.start + length, 0 };
+            if (type == TLS_EXT_SERVER_NAME) {
+               ja4_data->has_sni = true;
+            } else if (type == TLS_EXT_ALPN) {
+               tls_parser.tls_get_ja4_alpn(ext_data, *ja4_data);
+            } else if (type == TLS_EXT_SIGNATURE_ALGORITHMS) {
+               tls_parser.tls_get_ja4_signature_algorithms(ext_data, *ja4_data);
+            } else if (type == TLS_EXT_SUPPORTED_VERSIONS) {
+               tls_parser.tls_get_ja4_supported_versions(ext_data, *ja4_data);
+            }
          }
       } else if (hs_type == TLS_HANDSHAKE_SERVER_HELLO) {
          if (type == TLS_EXT_ALPN) {
@@ -126,18 +320,31 @@ bool TLSPlugin::obtain_tls_data(TLSData &payload, RecordExtTLS *rec, std::string
       }
       payload.start += length;
       if (!tls_parser.tls_is_grease_value(type)) {
-         ja3 += std::to_string(type);
+         ja3.put_number(type);
 
          if (payload.start + sizeof(tls_ext) <= payload.end) {
-            ja3 += '-';
+            ja3.put('-');
+         }
+         if (ja4_data != nullptr) {
+            ja4_data->add_extension(type);
          }
       }
    }
    if (hs_type == TLS_HANDSHAKE_SERVER_HELLO) {
       return false;
    }
-   ja3 += ',' + ecliptic_curves + ',' + ec_point_formats;
-   md5_get_bin(ja3, rec->ja3_hash_bin);
+   ja3.put(',');
+   if (ecliptic_curves.start != nullptr) {
+      tls_parser.tls_get_ja3_ecpliptic_curves(ja3, ecliptic_curves);
+   }
+   ja3.put(',');
+   if (ec_point_formats.start != nullptr) {
+      tls_parser.tls_get_ja3_ec_point_formats(ja3, ec_point_formats);
+   }
+   ja3.finalize(rec->ja3_hash_bin);
+   if (ja4_data != nullptr) {
+      ja4_data->compute(rec->ja4, false);
+   }
    return true;
 } // TLSPlugin::obtain_tls_data
 
@@ -148,7 +355,9 @@ bool TLSPlugin::parse_tls(const uint8_t *data, uint16_t payload_len, RecordExtTL
       payload.end   = data + payload_len,
       payload.obejcts_parsed = 0,
    };
-   std::string ja3;
+   TLSJA3Hasher ja3;
+   TLSJA4Data ja4_data;
+   TLSJA4Data *ja4_ptr = nullptr;
 
 
    if (!tls_parser.tls_check_rec(payload)) {
@@ -160,7 +369,8 @@ bool TLSPlugin::parse_tls(const uint8_t *data, uint16_t payload_len, RecordExtTL
    tls_handshake tls_hs = tls_parser.tls_get_handshake();
 
    rec->version = ((uint16_t) tls_hs.version.major << 8) | tls_hs.version.minor;
-   ja3 += std::to_string((uint16_t) tls_hs.version.version) + ',';
+   ja3.put_number((uint16_t) tls_hs.version.version);
+   ja3.put(',');
 
    if (!tls_parser.tls_skip_random(payload)) {
       return false;
@@ -170,7 +380,11 @@ bool TLSPlugin::parse_tls(const uint8_t *data, uint16_t payload_len, RecordExtTL
    }
 
    if (tls_hs.type == TLS_HANDSHAKE_CLIENT_HELLO) {
-      if (!tls_parser.tls_get_ja3_cipher_suites(ja3, payload)) {
+      if (ja4) {
+         ja4_data.version = rec->version;
+         ja4_ptr = &ja4_data;
+      }
+      if (!tls_parser.tls_get_ja3_cipher_suites(ja3, payload, ja4_ptr)) {
          return false;
       }
       if (!tls_parser.tls_skip_compression_met(payload)) {
@@ -185,20 +399,67 @@ bool TLSPlugin::parse_tls(const uint8_t *data, uint16_t payload_len, RecordExtTL
    if (!tls_parser.tls_check_ext_len(payload)) {
       return false;
    }
-   if (!obtain_tls_data(payload, rec, ja3, tls_hs.type)) {
+   if (!obtain_tls_data(payload, rec, ja3, ja4_ptr, tls_hs.type)) {
       return false;
    }
    parsed_sni = payload.obejcts_parsed;
-   return payload.obejcts_parsed != 0 || !ja3.empty();
+   return payload.obejcts_parsed != 0 || ja3.length() != 0;
 } // TLSPlugin::parse_sni
 
-void TLSPlugin::add_tls_record(Flow &rec, const Packet &pkt)
+int TLSPlugin::add_tls_record(Flow &rec, const Packet &pkt)
+{
+   TLSReassembly *buf = reasm_pool.find(rec);
+
+   if (buf != nullptr) {
+      ReasmResult res = reassemble(buf, pkt);
+      if (res == ReasmResult::INCOMPLETE) {
+         return 0;
+      }
+
+      bool parsed = res == ReasmResult::COMPLETE && add_tls_ext(rec, buf->data, buf->length);
+      reasm_pool.release(buf);
+      if (parsed) {
+         reassembled++;
+         return 0;
+      }
+      reasm_failed++;
+      return FLOW_PLUGIN_DETACH;
+   }
+   if (pkt.payload_len == 0) {
+      return 0;
+   }
+
+   uint32_t hello_len = tls_hello_length(pkt.payload, pkt.payload_len);
+   if (hello_len > pkt.payload_len && pkt.ip_proto == IPPROTO_TCP) {
+      if (hello_len > TLS_REASM_BUFFER_SIZE) {
+         reasm_failed++;
+         return FLOW_PLUGIN_DETACH;
+      }
+
+      bool stolen;
+      buf = reasm_pool.acquire(rec, pkt, stolen);
+      if (stolen) {
+         reasm_failed++;
+      }
+      if (buf != nullptr) {
+         reassemble(buf, pkt);
+         return 0;
+      }
+   }
+
+   if (add_tls_ext(rec, pkt.payload, pkt.payload_len)) {
+      return 0;
+   }
+   return tls_is_non_handshake_record(pkt.payload, pkt.payload_len) ? FLOW_PLUGIN_DETACH : 0;
+} // TLSPlugin::add_tls_record
+
+bool TLSPlugin::add_tls_ext(Flow &rec, const uint8_t *data, uint16_t len)
 {
    if (ext_ptr == nullptr) {
-      ext_ptr = new RecordExtTLS();
+      ext_ptr = new RecordExtTLS(ja4);
    }
 
-   if (parse_tls(pkt.payload, pkt.payload_len, ext_ptr)) {
+   if (parse_tls(data, len, ext_ptr)) {
       DEBUG_CODE(for (int i = 0; i < 16; i++) {
             DEBUG_MSG("%02x", ext_ptr->ja3_hash_bin[i]);
          }
@@ -208,7 +469,9 @@ void TLSPlugin::add_tls_record(Flow &rec, const Packet &pkt)
       DEBUG_MSG("%s\n", ext_ptr->alpn);
       rec.add_extension(ext_ptr);
       ext_ptr = nullptr;
+      return true;
    }
+   return false;
 }
 
 void TLSPlugin::finish(bool print_stats)
@@ -216,6 +479,8 @@ void TLSPlugin::finish(bool print_stats)
    if (print_stats) {
       std::cout << "TLS plugin stats:" << std::endl;
       std::cout << "   Parsed SNI: " << parsed_sni << std::endl;
+      std::cout << "   Reassembled hellos: " << reassembled << std::endl;
+      std::cout << "   Failed reassemblies: " << reasm_failed << std::endl;
    }
 }
 }
@@ -21,11 +21,14 @@
 
 #include <sstream>
 #include <iomanip>
+#include <vector>
+#include <sys/time.h>
 
 #ifdef WITH_NEMEA
 # include "fields.h"
 #endif
 
+#include <ipfixprobe/options.hpp>
 #include <ipfixprobe/process.hpp>
 #include <ipfixprobe/flowifc.hpp>
 #include <ipfixprobe/packet.hpp>
@@ -38,31 +41,55 @@
 
 namespace ipxp {
 #define TLS_UNIREC_TEMPLATE "TLS_SNI,TLS_JA3,TLS_ALPN,TLS_VERSION"
+#define TLS_JA4_UNIREC_TEMPLATE TLS_UNIREC_TEMPLATE ",TLS_JA4"
 
 UR_FIELDS(
    string TLS_SNI,
    string TLS_ALPN,
    uint16 TLS_VERSION,
-   bytes TLS_JA3
+   bytes TLS_JA3,
+   string TLS_JA4
 )
 
+// default number of buffers for hellos spanning several TCP segments
+#define TLS_REASM_BUFFERS     64
+// largest handshake message (with record and handshake header) collected from segments
+#define TLS_REASM_BUFFER_SIZE 8192
+
+class TLSOptParser : public OptionsParser
+{
+public:
+   bool m_ja4;
+   uint32_t m_buffers;
+
+   TLSOptParser() : OptionsParser("tls", "Parse SNI from TLS traffic"), m_ja4(false), m_buffers(TLS_REASM_BUFFERS)
+   {
+      register_option("j", "ja4", "", "Compute JA4 fingerprint of ClientHello", [this](const char *arg){m_ja4 = true; return true;}, OptionFlags::NoArgument);
+      register_option("b", "buffers", "NUM", "Number of buffers for hellos spanning several TCP segments, 0 disables reassembly",
+         [this](const char *arg){try {m_buffers = str2num<decltype(m_buffers)>(arg);} catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+   }
+};
+
 /**
  * \brief Flow record extension header for storing parsed HTTPS packets.
  */
 struct RecordExtTLS : public RecordExt {
    static int  REGISTERED_ID;
 
+   bool        export_ja4; /**< JA4 is part of exported templates, set by plugin which created the record. */
    uint16_t    version;
    char        alpn[BUFF_SIZE]  = { 0 };
    char        sni[BUFF_SIZE]   = { 0 };
    char        ja3_hash[33]     = { 0 };
    uint8_t     ja3_hash_bin[16] = { 0 };
-   std::string ja3;
+   char        ja4[TLS_JA4_LENGTH + 1] = { 0 };
 
    /**
     * \brief Constructor.
+    * \param [in] ja4 Export JA4 fingerprint.
     */
-   RecordExtTLS() : RecordExt(REGISTERED_ID), version(0)
+   RecordExtTLS(bool ja4 = false) : RecordExt(REGISTERED_ID), export_ja4(ja4), version(0)
    {
       alpn[0]     = 0;
       sni[0]      = 0;
@@ -76,11 +103,14 @@ struct RecordExtTLS : public RecordExt {
       ur_set_string(tmplt, record, F_TLS_SNI, sni);
       ur_set_string(tmplt, record, F_TLS_ALPN, alpn);
       ur_set_var(tmplt, record, F_TLS_JA3, ja3_hash_bin, 16);
+      if (export_ja4) {
+         ur_set_string(tmplt, record, F_TLS_JA4, ja4);
+      }
    }
 
    const char *get_unirec_tmplt() const
    {
-      return TLS_UNIREC_TEMPLATE;
+      return export_ja4 ? TLS_JA4_UNIREC_TEMPLATE : TLS_UNIREC_TEMPLATE;
    }
 
    #endif // ifdef WITH_NEMEA
@@ -89,9 +119,10 @@ struct RecordExtTLS : public RecordExt {
    {
       uint16_t sni_len  = strlen(sni);
       uint16_t alpn_len = strlen(alpn);
+      uint16_t ja4_len  = export_ja4 ? strlen(ja4) + 3 : 0;
 
       uint32_t pos = 0;
-      uint32_t req_buff_len = (sni_len + 3) + (alpn_len + 3) + (2) + (16 + 3); // (SNI) + (ALPN) + (VERSION) + (JA3)
+      uint32_t req_buff_len = (sni_len + 3) + (alpn_len + 3) + (2) + (16 + 3) + ja4_len; // (SNI) + (ALPN) + (VERSION) + (JA3) + (JA4)
 
       if (req_buff_len > (uint32_t) size) {
          return -1;
@@ -107,6 +138,10 @@ struct RecordExtTLS : public RecordExt {
       memcpy(buffer + pos, ja3_hash_bin, 16);
       pos += 16;
 
+      if (export_ja4) {
+         pos += variable2ipfix_buffer(buffer + pos, (uint8_t *) ja4, ja4_len - 3);
+      }
+
       return pos;
    }
 
@@ -116,8 +151,13 @@ struct RecordExtTLS : public RecordExt {
          IPFIX_TLS_TEMPLATE(IPFIX_FIELD_NAMES)
          nullptr
       };
+      static const char *ipfix_ja4_template[] = {
+         IPFIX_TLS_TEMPLATE(IPFIX_FIELD_NAMES)
+         IPFIX_TLS_JA4_TEMPLATE(IPFIX_FIELD_NAMES)
+         nullptr
+      };
 
-      return ipfix_template;
+      return export_ja4 ? ipfix_ja4_template : ipfix_template;
    }
 
    std::string get_text() const
@@ -131,8 +171,13 @@ struct RecordExtTLS : public RecordExt {
       for (int i = 0; i < 16; i++) {
          out << std::hex << std::setw(2) << std::setfill('0') << (unsigned) ja3_hash_bin[i];
       }
+      if (export_ja4) {
+         out << ",tlsja4=\"" << ja4 << "\"";
+      }
       return out.str();
    }
+
+   RECORD_EXT_PLAIN_SNAPSHOT(RecordExtTLS, 1)
 };
 
 
@@ -145,6 +190,46 @@ struct RecordExtTLS : public RecordExt {
 #define TLS_EXT_EC_POINT_FORMATS 11
 #define TLS_EXT_ALPN             16
 
+/**
+ * \brief Hello message of one flow direction collected from consecutive TCP segments.
+ */
+struct TLSReassembly {
+   const Flow *flow;              /**< Owner flow, nullptr for free buffer. */
+   struct timeval flow_start;     /**< Start of owner flow, detects reused flow records. */
+   struct timeval last;           /**< Arrival of last collected segment. */
+   uint16_t src_port;             /**< Source port of collected direction. */
+   uint32_t next_seq;             /**< Sequence number of next expected segment. */
+   uint16_t length;               /**< Number of collected bytes. */
+   uint8_t *data;                 /**< Buffer of TLS_REASM_BUFFER_SIZE bytes. */
+};
+
+/**
+ * \brief Fixed pool of reassembly buffers shared by all flows of one plugin instance.
+ *
+ * Memory is allocated on first use, so plugin instances which are only copied
+ * from do not hold any buffers. When the pool runs out, the least recently
+ * updated reassembly is dropped.
+ */
+class TLSReassemblyPool
+{
+public:
+   TLSReassemblyPool();
+   void set_size(size_t count);
+   TLSReassemblyPool &operator=(const TLSReassemblyPool &other) = delete;
+   TLSReassemblyPool(const TLSReassemblyPool &other);
+
+   TLSReassembly *find(const Flow &rec);
+   TLSReassembly *acquire(const Flow &rec, const Packet &pkt, bool &stolen);
+   void release(TLSReassembly *buf);
+
+private:
+   std::vector<TLSReassembly> m_slots;
+   std::vector<uint8_t> m_memory;
+   std::vector<uint32_t> m_free;
+   size_t m_size;
+   size_t m_used;
+};
+
 
 /**
  * \brief Flow cache plugin for parsing HTTPS packets.
@@ -156,27 +241,37 @@ public:
    ~TLSPlugin();
    void init(const char *params);
    void close();
-   OptionsParser *get_parser() const { return new OptionsParser("tls", "Parse SNI from TLS traffic"); }
+   OptionsParser *get_parser() const { return new TLSOptParser(); }
 
    std::string get_name() const { return "tls"; }
+   PluginInterest get_interest() const { return PluginInterest({}, {}, true); }
 
-   RecordExtTLS *get_ext() const { return new RecordExtTLS(); }
+   RecordExtTLS *get_ext() const { return new RecordExtTLS(ja4); }
 
    ProcessPlugin *copy();
 
    int post_create(Flow &rec, const Packet &pkt);
    int pre_update(Flow &rec, Packet &pkt);
+   void pre_export(Flow &rec);
    void finish(bool print_stats);
 
 private:
-   void add_tls_record(Flow&, const Packet&);
+   enum class ReasmResult { INCOMPLETE, COMPLETE, FAILED };
+
+   int add_tls_record(Flow&, const Packet&);
+   bool add_tls_ext(Flow&, const uint8_t *, uint16_t);
+   ReasmResult reassemble(TLSReassembly *, const Packet&);
    bool parse_tls(const uint8_t *, uint16_t, RecordExtTLS *);
-   bool obtain_tls_data(TLSData&, RecordExtTLS *, std::string&, uint8_t);
+   bool obtain_tls_data(TLSData&, RecordExtTLS *, TLSJA3Hasher&, TLSJA4Data *, uint8_t);
 
    RecordExtTLS *ext_ptr;
    TLSParser tls_parser;
    uint32_t parsed_sni;
    bool flow_flush;
+   bool ja4;              /**< Compute JA4 fingerprint of ClientHello. */
+   TLSReassemblyPool reasm_pool;
+   uint32_t reassembled;  /**< Hellos parsed from several segments. */
+   uint32_t reasm_failed; /**< Reassemblies dropped because of a gap, size limit or full pool. */
 };
 }
 #endif /* IPXP_PROCESS_TLS_HPP */
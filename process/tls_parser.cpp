@@ -11,9 +11,168 @@
  */
 
 #include "tls_parser.hpp"
+#include "sha256.hpp"
+#include <algorithm>
 #include <endian.h>
 
 namespace ipxp {
+TLSJA3Hasher::TLSJA3Hasher() : m_used(0), m_total(0)
+{ }
+
+void TLSJA3Hasher::put(char c)
+{
+   if (m_used == sizeof(m_buffer)) {
+      m_md5.update(m_buffer, m_used);
+      m_used = 0;
+   }
+   m_buffer[m_used++] = c;
+   m_total++;
+}
+
+void TLSJA3Hasher::put_number(uint16_t value)
+{
+   char digits[5];
+   int cnt = 0;
+
+   do {
+      digits[cnt++] = '0' + value % 10;
+      value /= 10;
+   } while (value);
+   while (cnt) {
+      put(digits[--cnt]);
+   }
+}
+
+void TLSJA3Hasher::finalize(uint8_t *digest)
+{
+   m_md5.update(m_buffer, m_used);
+   m_used = 0;
+   memcpy(digest, m_md5.finalize().binary_digest(), 16);
+}
+
+TLSJA4Data::TLSJA4Data() : cipher_cnt(0), extension_cnt(0), sig_alg_cnt(0), version(0), has_alpn(false), has_sni(false)
+{
+   alpn[0] = 0;
+   alpn[1] = 0;
+}
+
+void TLSJA4Data::add_cipher(uint16_t cipher)
+{
+   if (cipher_cnt < TLS_JA4_MAX_VALUES) {
+      ciphers[cipher_cnt] = cipher;
+   }
+   cipher_cnt++;
+}
+
+void TLSJA4Data::add_extension(uint16_t type)
+{
+   if (extension_cnt < TLS_JA4_MAX_VALUES) {
+      extensions[extension_cnt] = type;
+   }
+   extension_cnt++;
+}
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static void ja4_hash_list(SHA256 &sha, const uint16_t *values, uint16_t cnt, bool separate)
+{
+   char buffer[TLS_JA4_MAX_VALUES * 5];
+   size_t used = 0;
+
+   for (uint16_t i = 0; i < cnt; i++) {
+      if (i || separate) {
+         buffer[used++] = i ? ',' : '_';
+      }
+      buffer[used++] = hex_digits[values[i] >> 12];
+      buffer[used++] = hex_digits[(values[i] >> 8) & 0x0F];
+      buffer[used++] = hex_digits[(values[i] >> 4) & 0x0F];
+      buffer[used++] = hex_digits[values[i] & 0x0F];
+   }
+   sha.update(buffer, used);
+}
+
+static char *ja4_truncated_hash(char *out, const SHA256 &sha)
+{
+   const uint8_t *digest = sha.binary_digest();
+
+   for (int i = 0; i < 6; i++) {
+      *out++ = hex_digits[digest[i] >> 4];
+      *out++ = hex_digits[digest[i] & 0x0F];
+   }
+   return out;
+}
+
+static bool ja4_is_alnum(uint8_t c)
+{
+   return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+}
+
+void TLSJA4Data::compute(char *out, bool quic) const
+{
+   uint16_t sorted[TLS_JA4_MAX_VALUES];
+   uint16_t stored;
+   uint16_t used;
+
+   *out++ = quic ? 'q' : 't';
+   switch (version) {
+   case 0x0304: *out++ = '1'; *out++ = '3'; break;
+   case 0x0303: *out++ = '1'; *out++ = '2'; break;
+   case 0x0302: *out++ = '1'; *out++ = '1'; break;
+   case 0x0301: *out++ = '1'; *out++ = '0'; break;
+   case 0x0300: *out++ = 's'; *out++ = '3'; break;
+   default:     *out++ = '0'; *out++ = '0'; break;
+   }
+   *out++ = has_sni ? 'd' : 'i';
+   *out++ = '0' + std::min<uint16_t>(cipher_cnt, 99) / 10;
+   *out++ = '0' + std::min<uint16_t>(cipher_cnt, 99) % 10;
+   *out++ = '0' + std::min<uint16_t>(extension_cnt, 99) / 10;
+   *out++ = '0' + std::min<uint16_t>(extension_cnt, 99) % 10;
+   if (!has_alpn) {
+      *out++ = '0';
+      *out++ = '0';
+   } else if (ja4_is_alnum(alpn[0]) && ja4_is_alnum(alpn[1])) {
+      *out++ = alpn[0];
+      *out++ = alpn[1];
+   } else {
+      *out++ = hex_digits[alpn[0] >> 4];
+      *out++ = hex_digits[alpn[1] & 0x0F];
+   }
+
+   // JA4_b: sorted cipher suites
+   *out++ = '_';
+   stored = std::min<uint16_t>(cipher_cnt, TLS_JA4_MAX_VALUES);
+   if (stored) {
+      SHA256 sha;
+      std::copy(ciphers, ciphers + stored, sorted);
+      std::sort(sorted, sorted + stored);
+      ja4_hash_list(sha, sorted, stored, false);
+      out = ja4_truncated_hash(out, sha.finalize());
+   } else {
+      out = std::fill_n(out, 12, '0');
+   }
+
+   // JA4_c: sorted extensions without SNI and ALPN followed by signature algorithms in original order,
+   // zeros when no extension is left after SNI and ALPN are removed
+   *out++ = '_';
+   stored = std::min<uint16_t>(extension_cnt, TLS_JA4_MAX_VALUES);
+   used = 0;
+   for (uint16_t i = 0; i < stored; i++) {
+      if (extensions[i] != TLS_EXT_SERVER_NAME && extensions[i] != TLS_EXT_ALPN) {
+         sorted[used++] = extensions[i];
+      }
+   }
+   if (used) {
+      SHA256 sha;
+      std::sort(sorted, sorted + used);
+      ja4_hash_list(sha, sorted, used, false);
+      ja4_hash_list(sha, sig_algs, std::min<uint16_t>(sig_alg_cnt, TLS_JA4_MAX_VALUES), true);
+      out = ja4_truncated_hash(out, sha.finalize());
+   } else {
+      out = std::fill_n(out, 12, '0');
+   }
+   *out = 0;
+} // TLSJA4Data::compute
+
 TLSParser::TLSParser()
 {
    tls_hs = NULL;
@@ -259,7 +418,7 @@ bool TLSParser::tls_check_ext_len(TLSData& payload)
    return true;
 }
 
-bool TLSParser::tls_get_ja3_cipher_suites(std::string &ja3, TLSData &data)
+bool TLSParser::tls_get_ja3_cipher_suites(TLSJA3Hasher &ja3, TLSData &data, TLSJA4Data *ja4)
 {
    uint16_t cipher_suites_length = ntohs(*(uint16_t *) data.start);
    uint16_t type_id = 0;
@@ -274,19 +433,21 @@ bool TLSParser::tls_get_ja3_cipher_suites(std::string &ja3, TLSData &data)
    for (; data.start <= section_end; data.start += sizeof(uint16_t)) {
       type_id = ntohs(*(uint16_t *) (data.start));
       if (!tls_is_grease_value(type_id)) {
-         ja3 += std::to_string(type_id);
+         ja3.put_number(type_id);
          if (data.start < section_end) {
-            ja3 += '-';
+            ja3.put('-');
+         }
+         if (ja4 != nullptr) {
+            ja4->add_cipher(type_id);
          }
       }
    }
-   ja3 += ',';
+   ja3.put(',');
    return true;
 }
 
-std::string TLSParser::tls_get_ja3_ecpliptic_curves(TLSData &data)
+void TLSParser::tls_get_ja3_ecpliptic_curves(TLSJA3Hasher &ja3, const TLSData &data)
 {
-   std::string collected_types;
    uint16_t type_id        = 0;
    uint16_t list_len       = ntohs(*(uint16_t *) data.start);
    const uint8_t *list_end = data.start + list_len + sizeof(list_len);
@@ -294,26 +455,24 @@ std::string TLSParser::tls_get_ja3_ecpliptic_curves(TLSData &data)
 
    if (list_end > data.end) {
       // data.valid = false;
-      return "";
+      return;
    }
 
    while (data.start + sizeof(uint16_t) + offset <= list_end) {
       type_id = ntohs(*(uint16_t *) (data.start + offset));
       offset += sizeof(uint16_t);
       if (!tls_is_grease_value(type_id)) {
-         collected_types += std::to_string(type_id);
+         ja3.put_number(type_id);
 
          if (data.start + sizeof(uint16_t) + offset <= list_end) {
-            collected_types += '-';
+            ja3.put('-');
          }
       }
    }
-   return collected_types;
 }
 
-std::string TLSParser::tls_get_ja3_ec_point_formats(TLSData &data)
+void TLSParser::tls_get_ja3_ec_point_formats(TLSJA3Hasher &ja3, const TLSData &data)
 {
-   std::string collected_formats;
    uint8_t list_len        = *data.start;
    uint16_t offset         = sizeof(list_len);
    const uint8_t *list_end = data.start + list_len + offset;
@@ -321,17 +480,69 @@ std::string TLSParser::tls_get_ja3_ec_point_formats(TLSData &data)
 
    if (list_end > data.end) {
       // data.valid = false;
-      return "";
+      return;
    }
 
    while (data.start + sizeof(uint8_t) + offset <= list_end) {
       format = *(data.start + offset);
-      collected_formats += std::to_string((int) format);
+      ja3.put_number(format);
       offset += sizeof(uint8_t);
       if (data.start + sizeof(uint8_t) + offset <= list_end) {
-         collected_formats += '-';
+         ja3.put('-');
+      }
+   }
+}
+
+void TLSParser::tls_get_ja4_signature_algorithms(const TLSData &data, TLSJA4Data &ja4)
+{
+   if (data.start + sizeof(uint16_t) > data.end) {
+      return;
+   }
+   const uint8_t *list_end = data.start + sizeof(uint16_t) + ntohs(*(uint16_t *) data.start);
+
+   if (list_end > data.end) {
+      return;
+   }
+   ja4.sig_alg_cnt = 0;
+   for (const uint8_t *it = data.start + sizeof(uint16_t); it + sizeof(uint16_t) <= list_end; it += sizeof(uint16_t)) {
+      if (ja4.sig_alg_cnt < TLS_JA4_MAX_VALUES) {
+         ja4.sig_algs[ja4.sig_alg_cnt++] = ntohs(*(uint16_t *) it);
+      }
+   }
+}
+
+void TLSParser::tls_get_ja4_supported_versions(const TLSData &data, TLSJA4Data &ja4)
+{
+   if (data.start + sizeof(uint8_t) > data.end) {
+      return;
+   }
+   const uint8_t *list_end = data.start + sizeof(uint8_t) + *data.start;
+
+   if (list_end > data.end) {
+      return;
+   }
+   for (const uint8_t *it = data.start + sizeof(uint8_t); it + sizeof(uint16_t) <= list_end; it += sizeof(uint16_t)) {
+      uint16_t version = ntohs(*(uint16_t *) it);
+      if (!tls_is_grease_value(version) && version > ja4.version) {
+         ja4.version = version;
       }
    }
-   return collected_formats;
+}
+
+void TLSParser::tls_get_ja4_alpn(const TLSData &data, TLSJA4Data &ja4)
+{
+   // ALPN list length (2) + first protocol length (1)
+   if (data.start + sizeof(uint16_t) + sizeof(uint8_t) > data.end) {
+      return;
+   }
+   uint8_t alpn_len = data.start[sizeof(uint16_t)];
+   const uint8_t *alpn_str = data.start + sizeof(uint16_t) + sizeof(uint8_t);
+
+   if (alpn_len == 0 || alpn_str + alpn_len > data.end) {
+      return;
+   }
+   ja4.alpn[0]  = alpn_str[0];
+   ja4.alpn[1]  = alpn_str[alpn_len - 1];
+   ja4.has_alpn = true;
 }
 }
@@ -10,11 +10,15 @@
  * \date 2022
  */
 
+#ifndef IPXP_PROCESS_TLS_PARSER_HPP
+#define IPXP_PROCESS_TLS_PARSER_HPP
 
 #include <cstdint>
 #include <cstring>
 #include <ipfixprobe/process.hpp>
 
+#include "md5.hpp"
+
 #define TLS_HANDSHAKE_CLIENT_HELLO           1
 #define TLS_HANDSHAKE_SERVER_HELLO           2
 #define TLS_EXT_SERVER_NAME                  0
@@ -26,6 +30,13 @@
 // draf-02 az draft-12 have this value defined as 0x26 == 38
 #define TLS_EXT_QUIC_TRANSPORT_PARAMETERS_V2 0x26
 #define TLS_EXT_GOOGLE_USER_AGENT            0x3129
+#define TLS_EXT_SIGNATURE_ALGORITHMS         13
+#define TLS_EXT_SUPPORTED_VERSIONS           43
+
+// values of one ClientHello list kept for JA4, longer lists are counted but truncated
+#define TLS_JA4_MAX_VALUES                   128
+// e.g. t13d1516h2_8daaf6152771_e5627efa2ab1
+#define TLS_JA4_LENGTH                       36
 
 
 namespace ipxp {
@@ -72,6 +83,48 @@ struct __attribute__((packed)) tls_rec {
    /* Record data... */
 };
 
+/**
+ * \brief Feeds JA3 fields straight into MD5 without building the JA3 string.
+ *
+ * Characters are collected in a block sized stack buffer and handed to MD5 once it fills.
+ */
+class TLSJA3Hasher
+{
+public:
+   TLSJA3Hasher();
+   void put(char c);
+   void put_number(uint16_t value);
+   void finalize(uint8_t *digest);
+   size_t length() const { return m_total; }
+
+private:
+   MD5 m_md5;
+   char m_buffer[64];
+   size_t m_used;
+   size_t m_total;
+};
+
+/**
+ * \brief ClientHello values collected for JA4 fingerprint.
+ */
+struct TLSJA4Data {
+   uint16_t ciphers[TLS_JA4_MAX_VALUES];
+   uint16_t extensions[TLS_JA4_MAX_VALUES];
+   uint16_t sig_algs[TLS_JA4_MAX_VALUES];
+   uint16_t cipher_cnt;    /**< Number of non-GREASE ciphers, may exceed stored values. */
+   uint16_t extension_cnt; /**< Number of non-GREASE extensions, may exceed stored values. */
+   uint16_t sig_alg_cnt;
+   uint16_t version;       /**< Handshake version or highest supported_versions value. */
+   uint8_t alpn[2];        /**< First and last byte of the first ALPN value. */
+   bool has_alpn;
+   bool has_sni;
+
+   TLSJA4Data();
+   void add_cipher(uint16_t cipher);
+   void add_extension(uint16_t type);
+   void compute(char *out, bool quic) const;
+};
+
 class TLSParser
 {
 private:
@@ -89,14 +142,18 @@ public:
 
    void tls_get_quic_user_agent(TLSData &, char *, size_t);
    bool tls_check_handshake(TLSData&);
-   bool tls_get_ja3_cipher_suites(std::string&, TLSData&);
+   bool tls_get_ja3_cipher_suites(TLSJA3Hasher&, TLSData&, TLSJA4Data *);
 
    bool tls_is_grease_value(uint16_t);
 
    tls_handshake tls_get_handshake();
    uint8_t tls_get_hstype();
    std::string tls_get_version_ja3();
-   std::string tls_get_ja3_ecpliptic_curves(TLSData &data);
-   std::string tls_get_ja3_ec_point_formats(TLSData &data);
+   void tls_get_ja3_ecpliptic_curves(TLSJA3Hasher &ja3, const TLSData &data);
+   void tls_get_ja3_ec_point_formats(TLSJA3Hasher &ja3, const TLSData &data);
+   void tls_get_ja4_signature_algorithms(const TLSData &data, TLSJA4Data &ja4);
+   void tls_get_ja4_supported_versions(const TLSData &data, TLSJA4Data &ja4);
+   void tls_get_ja4_alpn(const TLSData &data, TLSJA4Data &ja4);
 };
 }
+#endif /* IPXP_PROCESS_TLS_PARSER_HPP */
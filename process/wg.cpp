@@ -89,6 +89,10 @@ int WGPlugin::post_create(Flow &rec, const Packet &pkt)
       add_ext_wg(reinterpret_cast<const char *>(pkt.payload), pkt.payload_len, pkt.source_pkt, rec);
    }
 
+   RecordExtWG *vpn_data = (RecordExtWG *) rec.get_extension(RecordExtWG::REGISTERED_ID);
+   if (vpn_data == nullptr || !vpn_data->possible_wg) {
+      return FLOW_PLUGIN_DETACH;
+   }
    return 0;
 }
 
@@ -108,6 +112,9 @@ int WGPlugin::pre_update(Flow &rec, Packet &pkt)
       }
    }
 
+   if (vpn_data == nullptr || !vpn_data->possible_wg) {
+      return FLOW_PLUGIN_DETACH;
+   }
    return 0;
 }
 
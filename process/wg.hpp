@@ -153,6 +153,8 @@ struct RecordExtWG : public RecordExt {
          << ",wgdstpeer=" << dst_peer;
       return out.str();
    }
+
+   RECORD_EXT_PLAIN_SNAPSHOT(RecordExtWG, 1)
 };
 
 /**
@@ -167,6 +169,7 @@ public:
    void close();
    OptionsParser *get_parser() const { return new OptionsParser("wg", "Parse WireGuard traffic"); }
    std::string get_name() const { return "wg"; }
+   PluginInterest get_interest() const { return PluginInterest({IPPROTO_UDP}); }
    RecordExt *get_ext() const { return new RecordExtWG(); }
    ProcessPlugin *copy();
 
@@ -48,6 +48,7 @@
 #define SERVICE_WAIT_MAX_TRY 8  ///< A maximal count of repeated timeouts per each service recv() and send() function call.
 
 #define MSG_MAGIC 0xBEEFFEEB
+#define MSG_RESIZE 0xBEEFFEEC ///< Flow cache resize request followed by uint32_t size exponent, answered by uint32_t number of accepting caches.
 
 namespace ipxp
 {
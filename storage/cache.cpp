@@ -45,9 +45,17 @@
  *
  */
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <cstring>
+#include <cerrno>
+#include <atomic>
+#include <random>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 
 #include <ipfixprobe/ring.h>
@@ -56,26 +64,26 @@
 
 namespace ipxp {
 
+#ifdef FLOW_CACHE_STATS
+/**
+ * \brief Count cache lines spanned by memory range accessed by flow cache.
+ */
+#define FLOW_CACHE_TOUCH(ptr, len) \
+   m_lines += (reinterpret_cast<uintptr_t>(ptr) + (len) - 1) / FLOW_CACHE_LINE - \
+      reinterpret_cast<uintptr_t>(ptr) / FLOW_CACHE_LINE + 1
+#else
+#define FLOW_CACHE_TOUCH(ptr, len)
+#endif /* FLOW_CACHE_STATS */
+
 __attribute__((constructor)) static void register_this_plugin()
 {
    static PluginRecord rec = PluginRecord("cache", [](){return new NHTFlowCache();});
    register_plugin(&rec);
 }
 
-FlowRecord::FlowRecord()
-{
-   erase();
-};
-
-FlowRecord::~FlowRecord()
-{
-   erase();
-};
-
 void FlowRecord::erase()
 {
    m_flow.remove_extensions();
-   m_hash = 0;
 
    memset(&m_flow.time_first, 0, sizeof(m_flow.time_first));
    memset(&m_flow.time_last, 0, sizeof(m_flow.time_last));
@@ -91,6 +99,7 @@ void FlowRecord::erase()
    m_flow.dst_bytes = 0;
    m_flow.src_tcp_flags = 0;
    m_flow.dst_tcp_flags = 0;
+   m_flow.degraded = 0;
 }
 void FlowRecord::reuse()
 {
@@ -102,24 +111,13 @@ void FlowRecord::reuse()
    m_flow.dst_bytes = 0;
    m_flow.src_tcp_flags = 0;
    m_flow.dst_tcp_flags = 0;
+   m_flow.degraded &= FLOW_DEGRADED_DPI;
 }
 
-inline __attribute__((always_inline)) bool FlowRecord::is_empty() const
-{
-   return m_hash == 0;
-}
-
-inline __attribute__((always_inline)) bool FlowRecord::belongs(uint64_t hash) const
-{
-   return hash == m_hash;
-}
-
-void FlowRecord::create(const Packet &pkt, uint64_t hash)
+void FlowRecord::create(const Packet &pkt)
 {
    m_flow.src_packets = 1;
 
-   m_hash = hash;
-
    m_flow.time_first = pkt.ts;
    m_flow.time_last = pkt.ts;
 
@@ -178,7 +176,13 @@ void FlowRecord::update(const Packet &pkt, bool src)
 NHTFlowCache::NHTFlowCache() :
    m_cache_size(0), m_line_size(0), m_line_mask(0), m_line_new_idx(0),
    m_qsize(0), m_qidx(0), m_timeout_idx(0), m_active(0), m_inactive(0),
-   m_split_biflow(false), m_keylen(0), m_key(), m_key_inv(), m_flow_table(nullptr), m_flow_records(nullptr)
+   m_split_biflow(false), m_keylen(0), m_key(), m_key_inv(), m_mem(nullptr), m_mem_size(0),
+   m_flow_table(nullptr), m_flow_records(nullptr), m_flow_hash(nullptr), m_flow_last(nullptr),
+   m_flow_meta(nullptr), m_line_hand(nullptr), m_hugepages(false), m_evict(EvictPolicy::LRU), m_evict_cnt(0),
+   m_evict_single(0), m_evict_packets(0), m_sampling(SamplingMode::NONE), m_sampling_interval(1), m_sampling_cnt(0),
+   m_sampling_threshold(0), m_sampling_state(0), m_sampling_seen(0), m_sampling_selected(0),
+   m_overload_sampling(false), m_old(), m_old_line(0), m_retired(), m_pushed(0), m_resize_request(0),
+   m_grow(0), m_max_size(0), m_created(0), m_evicted(0)
 {
 }
 
@@ -216,18 +220,38 @@ void NHTFlowCache::init(const char *params)
       throw PluginError("flow cache won't properly work with 0 records");
    }
 
-   try {
-      m_flow_table = new FlowRecord*[m_cache_size + m_qsize];
-      m_flow_records = new FlowRecord[m_cache_size + m_qsize];
-      for (decltype(m_cache_size + m_qsize) i = 0; i < m_cache_size + m_qsize; i++) {
-         m_flow_table[i] = m_flow_records + i;
-      }
-   } catch (std::bad_alloc &e) {
-      throw PluginError("not enough memory for flow cache allocation");
+   m_hugepages = parser.m_hugepages;
+   m_evict = parser.m_evict;
+   FlowTable tab;
+   alloc_table(tab, m_cache_size);
+   set_table(tab);
+
+   m_grow = parser.m_grow;
+   m_max_size = parser.m_max_size;
+   if (m_max_size == 0) {
+      m_max_size = m_cache_size < (1U << 26) ? m_cache_size << 4 : 1U << 30;
    }
 
    m_split_biflow = parser.m_split_biflow;
 
+   m_sampling = parser.m_sampling;
+   m_sampling_interval = parser.m_sampling_interval;
+   if (m_sampling == SamplingMode::NONE && m_sampling_interval > 1) {
+      m_sampling = SamplingMode::COUNT;
+   } else if (m_sampling_interval == 1) {
+      m_sampling = SamplingMode::NONE;
+   }
+   m_sampling_threshold = (static_cast<uint64_t>(1) << 32) / m_sampling_interval;
+   std::random_device rd;
+   m_sampling_state = (static_cast<uint64_t>(rd()) << 32) | rd() | 1;
+
+   /* Every pipeline has its own cache, instances after the first one use numbered snapshots. */
+   static std::atomic<uint32_t> snapshot_instances(0);
+   if (!parser.m_snapshot.empty()) {
+      uint32_t instance = snapshot_instances++;
+      m_snapshot = instance ? parser.m_snapshot + "." + std::to_string(instance) : parser.m_snapshot;
+   }
+
 #ifdef FLOW_CACHE_STATS
    m_empty = 0;
    m_not_empty = 0;
@@ -236,19 +260,347 @@ void NHTFlowCache::init(const char *params)
    m_flushed = 0;
    m_lookups = 0;
    m_lookups2 = 0;
+   m_packets = 0;
+   m_lines = 0;
+   m_occupied = 0;
+   m_peak_occupied = 0;
+   m_probes.assign(m_line_size, 0);
 #endif /* FLOW_CACHE_STATS */
 }
 
 void NHTFlowCache::close()
 {
-   if (m_flow_records != nullptr) {
-      delete [] m_flow_records;
-      m_flow_records = nullptr;
+   FlowTable tab = get_table();
+   free_table(tab);
+   set_table(tab);
+   free_table(m_old);
+   for (auto &it : m_retired) {
+      free_table(it.first);
+   }
+   m_retired.clear();
+}
+
+/**
+ * \brief Allocate flow table of given size.
+ *
+ * Records and hot arrays start at cache line boundary, so flow line probe touches minimum of lines.
+ * Sizes of records and hot arrays are multiples of cache line size.
+ * \param [out] tab Allocated table.
+ * \param [in] size Number of records.
+ */
+void NHTFlowCache::alloc_table(FlowTable &tab, uint32_t size)
+{
+   size_t records_size = sizeof(FlowRecord) * (size + m_qsize);
+   size_t hash_size = sizeof(uint64_t) * size;
+   size_t last_size = sizeof(uint32_t) * size;
+   size_t meta_size = (size + FLOW_CACHE_LINE - 1) & ~static_cast<size_t>(FLOW_CACHE_LINE - 1);
+   size_t hand_size = (sizeof(uint32_t) * (size / m_line_size) + FLOW_CACHE_LINE - 1) & ~static_cast<size_t>(FLOW_CACHE_LINE - 1);
+   size_t table_size = sizeof(uint32_t) * (size + m_qsize);
+
+   tab.mem_size = records_size + hash_size + last_size + meta_size + hand_size + table_size;
+   tab.mem = alloc_mem(tab.mem_size, m_hugepages);
+   tab.size = size;
+   tab.line_mask = (size - 1) & ~(m_line_size - 1);
+
+   uint8_t *mem = static_cast<uint8_t *>(tab.mem);
+   tab.records = reinterpret_cast<FlowRecord *>(mem);
+   tab.hash = reinterpret_cast<uint64_t *>(mem + records_size);
+   tab.last = reinterpret_cast<uint32_t *>(mem + records_size + hash_size);
+   tab.meta = mem + records_size + hash_size + last_size;
+   tab.hand = reinterpret_cast<uint32_t *>(tab.meta + meta_size);
+   tab.table = reinterpret_cast<uint32_t *>(tab.meta + meta_size + hand_size);
+}
+
+/**
+ * \brief Release extensions held by flow table and free its memory.
+ * \param [in,out] tab Table, cleared on return.
+ */
+void NHTFlowCache::free_table(FlowTable &tab)
+{
+   if (tab.mem == nullptr) {
+      return;
+   }
+   /* Only occupied records and records waiting in export queue can hold extensions. */
+   for (uint32_t i = 0; i < tab.size + m_qsize; i++) {
+      if (i >= tab.size || tab.hash[i] != 0) {
+         tab.get_record(i)->m_flow.remove_extensions();
+      }
+   }
+   munmap(tab.mem, tab.mem_size);
+   tab = FlowTable();
+}
+
+/**
+ * \brief Get current flow table.
+ */
+FlowTable NHTFlowCache::get_table() const
+{
+   FlowTable tab;
+   tab.mem = m_mem;
+   tab.mem_size = m_mem_size;
+   tab.size = m_cache_size;
+   tab.line_mask = m_line_mask;
+   tab.table = m_flow_table;
+   tab.records = m_flow_records;
+   tab.hash = m_flow_hash;
+   tab.last = m_flow_last;
+   tab.meta = m_flow_meta;
+   tab.hand = m_line_hand;
+   return tab;
+}
+
+/**
+ * \brief Make flow table current one, lookups and timeout scans use it from now on.
+ */
+void NHTFlowCache::set_table(const FlowTable &tab)
+{
+   m_mem = tab.mem;
+   m_mem_size = tab.mem_size;
+   m_cache_size = tab.size;
+   m_line_mask = tab.line_mask;
+   m_flow_table = tab.table;
+   m_flow_records = tab.records;
+   m_flow_hash = tab.hash;
+   m_flow_last = tab.last;
+   m_flow_meta = tab.meta;
+   m_line_hand = tab.hand;
+   m_timeout_idx = 0;
+}
+
+/**
+ * \brief Request change of cache size, resize is done by storage thread.
+ * Safe to call from any thread.
+ * \param [in] size Requested number of records, power of two.
+ * \return False when size is invalid.
+ */
+bool NHTFlowCache::resize(uint32_t size)
+{
+   if (size < m_line_size || size < 16 || size > (1U << 30) || (size & (size - 1))) {
+      return false;
+   }
+   m_resize_request.store(size);
+   return true;
+}
+
+/**
+ * \brief Start migration of flows to a new table of given size.
+ *
+ * Old table is kept and its lines are moved to the new table when a packet maps to them
+ * and in background by resize_step(), so packet processing and export continue meanwhile.
+ */
+void NHTFlowCache::start_resize(uint32_t size)
+{
+   if (size == m_cache_size) {
+      return;
+   }
+   FlowTable tab;
+   try {
+      alloc_table(tab, size);
+   } catch (PluginError &e) {
+      std::cerr << "cache: unable to resize to " << size << " records: " << e.what() << std::endl;
+      return;
+   }
+   std::cerr << "cache: resizing from " << m_cache_size << " to " << size << " records" << std::endl;
+   m_old = get_table();
+   m_old_line = 0;
+   set_table(tab);
+   m_created = 0;
+   m_evicted = 0;
+}
+
+/**
+ * \brief Advance resize in progress, or start requested one.
+ * Called for every packet and on timeouts, does nothing when no resize was requested.
+ */
+void NHTFlowCache::resize_step()
+{
+   if (m_old.mem != nullptr) {
+      for (uint32_t i = 0; i < FLOW_CACHE_RESIZE_LINES && m_old_line < m_old.size; i++) {
+         migrate_line(m_old_line);
+         m_old_line += m_line_size;
+      }
+      if (m_old_line >= m_old.size) {
+         /* Output may still read spare records of old table, like spare records of current table
+          * they are released after export queue wraps around. */
+         m_retired.push_back(std::make_pair(m_old, m_pushed + m_qsize));
+         m_old = FlowTable();
+      }
+      return;
+   }
+   if (!m_retired.empty() && m_pushed >= m_retired.front().second) {
+      free_table(m_retired.front().first);
+      m_retired.erase(m_retired.begin());
+   }
+   uint32_t size = m_resize_request.exchange(0);
+   if (size != 0) {
+      start_resize(size);
+   }
+}
+
+/**
+ * \brief Move records of one line of old table to current table.
+ *
+ * Records are moved in line order, so order of recent use is kept. When shrinking
+ * cache merges lines, records which do not fit are exported as for lack of space.
+ * \param [in] line Index of first slot of line in old table.
+ */
+void NHTFlowCache::migrate_line(uint32_t line)
+{
+   for (uint32_t i = line; i < line + m_line_size; i++) {
+      uint64_t hashval = m_old.hash[i];
+      if (hashval == 0) {
+         continue;
+      }
+      uint32_t line_index = hashval & m_line_mask;
+      uint32_t next_line = line_index + m_line_size;
+      uint32_t flow_index;
+      for (flow_index = line_index; flow_index < next_line; flow_index++) {
+         if (m_flow_hash[flow_index] == 0) {
+            break;
+         }
+      }
+      if (flow_index == next_line) {
+         flow_index = select_victim(line_index);
+         evict_flow(flow_index);
+      }
+
+      FlowRecord *from = m_old.get_record(i);
+      FlowRecord *to = get_record(flow_index);
+      *to = *from;
+      if (to->m_flow.dpi != nullptr) {
+         to->m_flow.dpi->owner = &to->m_flow;
+      }
+      from->m_flow.m_exts = nullptr;
+      from->m_flow.dpi = nullptr;
+      m_flow_hash[flow_index] = hashval;
+      m_flow_last[flow_index] = m_old.last[i];
+      m_flow_meta[flow_index] = m_old.meta[i];
+      m_old.hash[i] = 0;
+   }
+}
+
+/**
+ * \brief Request growth of cache when too many new flows evicted another flow.
+ * Evaluated after every m_cache_size new flows.
+ */
+void NHTFlowCache::check_growth()
+{
+   if (static_cast<uint64_t>(m_evicted) * 100 > static_cast<uint64_t>(m_created) * m_grow && m_cache_size < m_max_size) {
+      uint32_t none = 0;
+      /* Size requested over stats socket takes precedence. */
+      m_resize_request.compare_exchange_strong(none, m_cache_size * 2);
+   }
+   m_created = 0;
+   m_evicted = 0;
+}
+
+/**
+ * \brief Choose flow evicted from full flow line by configured policy.
+ *
+ * Records closer to the end of line were used less recently, except with CLOCK which
+ * does not reorder line.
+ * \param [in] line_index Index of first slot of line.
+ * \return Slot of victim.
+ */
+uint32_t NHTFlowCache::select_victim(uint32_t line_index)
+{
+   uint32_t next_line = line_index + m_line_size;
+   uint32_t victim = next_line - 1;
+
+   switch (m_evict) {
+   case EvictPolicy::PACKETS:
+      for (uint32_t i = next_line - 1; i > line_index && m_flow_meta[victim] > 1; i--) {
+         if (m_flow_meta[i - 1] < m_flow_meta[victim]) {
+            victim = i - 1;
+         }
+      }
+      FLOW_CACHE_TOUCH(m_flow_meta + line_index, m_line_size);
+      break;
+   case EvictPolicy::PROBATION:
+      for (uint32_t i = next_line; i > line_index; i--) {
+         if (m_flow_meta[i - 1] <= 1) {
+            victim = i - 1;
+            break;
+         }
+      }
+      FLOW_CACHE_TOUCH(m_flow_meta + line_index, m_line_size);
+      break;
+   case EvictPolicy::CLOCK: {
+      /* Hand clears reference bits until it finds a flow not used since its last pass. */
+      uint32_t &hand = m_line_hand[line_index / m_line_size];
+      while (m_flow_meta[line_index + hand]) {
+         m_flow_meta[line_index + hand] = 0;
+         hand = (hand + 1) & (m_line_size - 1);
+      }
+      victim = line_index + hand;
+      hand = (hand + 1) & (m_line_size - 1);
+      FLOW_CACHE_TOUCH(m_flow_meta + line_index, m_line_size);
+      break;
+   }
+   default:
+      break;
+   }
+   return victim;
+}
+
+/**
+ * \brief Export flow to make room for a new one and account it in eviction statistics.
+ * \param [in] index Slot of flow table.
+ */
+void NHTFlowCache::evict_flow(uint32_t index)
+{
+   Flow &flow = get_record(index)->m_flow;
+   uint64_t packets = static_cast<uint64_t>(flow.src_packets) + flow.dst_packets;
+
+   m_evict_cnt++;
+   m_evict_packets += packets;
+   if (packets <= 1) {
+      m_evict_single++;
+   }
+   plugins_pre_export(flow);
+   flow.end_reason = FLOW_END_NO_RES;
+   export_flow(index);
+}
+
+/**
+ * \brief Allocate zero filled memory for flow table.
+ *
+ * Pages are not touched here, kernel maps them on first access, so startup does not
+ * depend on cache size. Regular pages are aligned to hugepage size to let transparent
+ * hugepages back the table.
+ * \param [in] size Size of memory.
+ * \param [in] hugepages Use hugetlbfs pages when available.
+ */
+void *NHTFlowCache::alloc_mem(size_t &size, bool hugepages)
+{
+   void *mem = MAP_FAILED;
+
+   size = (size + FLOW_CACHE_HUGEPAGE_SIZE - 1) & ~(static_cast<size_t>(FLOW_CACHE_HUGEPAGE_SIZE) - 1);
+   if (hugepages) {
+      mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (mem == MAP_FAILED) {
+         std::cerr << "cache: unable to allocate hugepages (" << strerror(errno) << "), using regular pages" << std::endl;
+      }
    }
-   if (m_flow_table != nullptr) {
-      delete [] m_flow_table;
-      m_flow_table = nullptr;
+   if (mem == MAP_FAILED) {
+      mem = mmap(nullptr, size + FLOW_CACHE_HUGEPAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (mem == MAP_FAILED) {
+         throw PluginError(std::string("not enough memory for flow cache allocation: ") + strerror(errno));
+      }
+      uintptr_t begin = reinterpret_cast<uintptr_t>(mem);
+      uintptr_t aligned = (begin + FLOW_CACHE_HUGEPAGE_SIZE - 1) & ~(static_cast<uintptr_t>(FLOW_CACHE_HUGEPAGE_SIZE) - 1);
+      if (aligned != begin) {
+         munmap(mem, aligned - begin);
+      }
+      munmap(reinterpret_cast<void *>(aligned + size), begin + FLOW_CACHE_HUGEPAGE_SIZE - aligned);
+      mem = reinterpret_cast<void *>(aligned);
+#ifdef MADV_HUGEPAGE
+      if (hugepages) {
+         madvise(mem, size, MADV_HUGEPAGE);
+      }
+#endif
    }
+   return mem;
 }
 
 void NHTFlowCache::set_queue(ipx_ring_t *queue)
@@ -257,26 +609,485 @@ void NHTFlowCache::set_queue(ipx_ring_t *queue)
    m_qsize = ipx_ring_size(queue);
 }
 
+/**
+ * \brief Exchange record in slot with the next record of export queue.
+ * \param [in] slot Slot of flow table.
+ */
+void NHTFlowCache::swap_spare(uint32_t slot)
+{
+   FlowRecord *flow = get_record(slot);
+   set_record(slot, get_record(m_cache_size + m_qidx));
+   set_record(m_cache_size + m_qidx, flow);
+}
+
 void NHTFlowCache::export_flow(size_t index)
 {
-   ipx_ring_push(m_export_queue, &m_flow_table[index]->m_flow);
-   std::swap(m_flow_table[index], m_flow_table[m_cache_size + m_qidx]);
-   m_flow_table[index]->erase();
+   FlowRecord *flow = get_record(index);
+   plugins_merge(flow->m_flow);
+   ipx_ring_push(m_export_queue, &flow->m_flow);
+   m_pushed++;
+   swap_spare(index);
+   flow = get_record(index);
+   flow->erase();
+   m_flow_hash[index] = 0;
+   m_flow_last[index] = 0;
    m_qidx = (m_qidx + 1) % m_qsize;
+#ifdef FLOW_CACHE_STATS
+   m_occupied--;
+#endif /* FLOW_CACHE_STATS */
+   FLOW_CACHE_TOUCH(flow, sizeof(FlowRecord));
+}
+
+/**
+ * \brief Move record to lower index of flow line, records in between are shifted by one.
+ * \param [in] from Current index of record.
+ * \param [in] to New index of record.
+ */
+void NHTFlowCache::move_record(uint32_t from, uint32_t to)
+{
+   FlowRecord *flow = get_record(from);
+   uint64_t hash = m_flow_hash[from];
+   uint32_t last = m_flow_last[from];
+   if (m_evict != EvictPolicy::LRU) {
+      uint8_t meta = m_flow_meta[from];
+      memmove(m_flow_meta + to + 1, m_flow_meta + to, from - to);
+      m_flow_meta[to] = meta;
+   }
+
+   /* Slots may refer to their records implicitly, so the table is shifted through accessors: */
+   for (uint32_t i = from; i > to; i--) {
+      set_record(i, get_record(i - 1));
+   }
+   memmove(m_flow_hash + to + 1, m_flow_hash + to, (from - to) * sizeof(*m_flow_hash));
+   memmove(m_flow_last + to + 1, m_flow_last + to, (from - to) * sizeof(*m_flow_last));
+   set_record(to, flow);
+   m_flow_hash[to] = hash;
+   m_flow_last[to] = last;
+
+   FLOW_CACHE_TOUCH(m_flow_table + to, (from - to + 1) * sizeof(*m_flow_table));
+   FLOW_CACHE_TOUCH(m_flow_last + to, (from - to + 1) * sizeof(*m_flow_last));
+}
+
+void NHTFlowCache::start()
+{
+   if (!m_snapshot.empty()) {
+      load_snapshot();
+   }
 }
 
 void NHTFlowCache::finish()
 {
-   for (decltype(m_cache_size) i = 0; i < m_cache_size; i++) {
-      if (!m_flow_table[i]->is_empty()) {
-         plugins_pre_export(m_flow_table[i]->m_flow);
-         m_flow_table[i]->m_flow.end_reason = FLOW_END_FORCED;
-         export_flow(i);
+   /* Complete pending migration, so all flows are in the current table. */
+   while (m_old.mem != nullptr) {
+      resize_step();
+   }
+   /* Flows kept in snapshot continue after restart, they are force exported only when saving fails. */
+   if (m_snapshot.empty() || !save_snapshot()) {
+      for (decltype(m_cache_size) i = 0; i < m_cache_size; i++) {
+         if (m_flow_hash[i] != 0) {
+            plugins_pre_export(get_record(i)->m_flow);
+            get_record(i)->m_flow.end_reason = FLOW_END_FORCED;
+            export_flow(i);
 #ifdef FLOW_CACHE_STATS
-         m_expired++;
+            m_expired++;
 #endif /* FLOW_CACHE_STATS */
+         }
       }
    }
+   if (m_sampling != SamplingMode::NONE) {
+      std::cerr << "cache: sampling selected " << m_sampling_selected << " of " << m_sampling_seen << " packets" << std::endl;
+   }
+   if (m_evict_cnt != 0) {
+      std::cerr << "cache: " << EVICT_POLICY_NAMES[static_cast<int>(m_evict)] << " policy evicted " << m_evict_cnt <<
+         " flows for lack of space, " << m_evict_single << " of them single packet, " <<
+         static_cast<double>(m_evict_packets) / m_evict_cnt << " packets per evicted flow" << std::endl;
+   }
+#ifdef FLOW_CACHE_STATS
+   print_report();
+#endif /* FLOW_CACHE_STATS */
+}
+
+/**
+ * \brief Snapshot file written through shared mapping, which grows as data are appended.
+ */
+struct SnapshotWriter {
+   int fd;
+   uint8_t *data;
+   size_t size; /**< Bytes written. */
+   size_t capacity; /**< Size of file and mapping. */
+
+   SnapshotWriter(int fd) : fd(fd), data(nullptr), size(0), capacity(0)
+   {
+   }
+
+   ~SnapshotWriter()
+   {
+      unmap();
+   }
+
+   void unmap()
+   {
+      if (data != nullptr) {
+         munmap(data, capacity);
+         data = nullptr;
+         capacity = 0;
+      }
+   }
+
+   /**
+    * \brief Make room for data at the end of snapshot.
+    * \param [in] len Number of bytes to be appended.
+    * \return False when file cannot be resized or mapped.
+    */
+   bool reserve(size_t len)
+   {
+      if (size + len <= capacity) {
+         return true;
+      }
+      size_t new_capacity = std::max(capacity * 2, size + len);
+      new_capacity = (new_capacity + FLOW_CACHE_HUGEPAGE_SIZE - 1) & ~(static_cast<size_t>(FLOW_CACHE_HUGEPAGE_SIZE) - 1);
+      unmap();
+      if (ftruncate(fd, new_capacity) != 0) {
+         return false;
+      }
+      void *mem = mmap(nullptr, new_capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (mem == MAP_FAILED) {
+         return false;
+      }
+      data = static_cast<uint8_t *>(mem);
+      capacity = new_capacity;
+      return true;
+   }
+};
+
+/**
+ * \brief Save flows to snapshot file.
+ *
+ * Snapshot is written to temporary file, which replaces previous snapshot when complete.
+ * Extensions are stored only when they implement snapshot hooks.
+ * \return True when all flows were saved.
+ */
+bool NHTFlowCache::save_snapshot()
+{
+   std::string tmp = m_snapshot + ".tmp";
+   int fd = open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+   if (fd < 0) {
+      std::cerr << "cache: unable to create snapshot " << tmp << " (" << strerror(errno) << "), exporting flows" << std::endl;
+      return false;
+   }
+
+   /* Map extensions to plugins creating them. */
+   uint32_t plugin_cnt = get_plugin_cnt();
+   std::vector<int> ext_plugin(get_extension_cnt(), -1);
+   for (uint32_t i = 0; i < plugin_cnt; i++) {
+      RecordExt *ext = get_plugin(i)->get_ext();
+      if (ext != nullptr) {
+         if (ext->m_ext_id >= 0 && static_cast<size_t>(ext->m_ext_id) < ext_plugin.size()) {
+            ext_plugin[ext->m_ext_id] = i;
+         }
+         delete ext;
+      }
+   }
+
+   SnapshotWriter out(fd);
+   size_t table_size = sizeof(FlowCacheSnapshotHeader) + plugin_cnt * sizeof(FlowCacheSnapshotPlugin);
+   uint64_t flow_cnt = 0;
+   bool ok = out.reserve(table_size);
+   if (ok) {
+      for (uint32_t i = 0; i < plugin_cnt; i++) {
+         FlowCacheSnapshotPlugin *plugin = reinterpret_cast<FlowCacheSnapshotPlugin *>(
+            out.data + sizeof(FlowCacheSnapshotHeader)) + i;
+         strncpy(plugin->name, get_plugin(i)->get_name().c_str(), sizeof(plugin->name) - 1);
+      }
+      out.size = table_size;
+   }
+
+   for (decltype(m_cache_size) i = 0; ok && i < m_cache_size; i++) {
+      if (m_flow_hash[i] == 0) {
+         continue;
+      }
+      Flow &flow = get_record(i)->m_flow;
+      plugins_merge(flow);
+
+      size_t flow_pos = out.size;
+      ok = out.reserve(sizeof(FlowCacheSnapshotFlow));
+      if (!ok) {
+         break;
+      }
+      FlowCacheSnapshotFlow *snap = reinterpret_cast<FlowCacheSnapshotFlow *>(out.data + flow_pos);
+      memset(snap, 0, sizeof(*snap));
+      snap->time_first = flow.time_first;
+      snap->time_last = flow.time_last;
+      snap->src_bytes = flow.src_bytes;
+      snap->dst_bytes = flow.dst_bytes;
+      snap->plugins_active = flow.plugins_active;
+      snap->src_ip = flow.src_ip;
+      snap->dst_ip = flow.dst_ip;
+      snap->src_packets = flow.src_packets;
+      snap->dst_packets = flow.dst_packets;
+      snap->src_port = flow.src_port;
+      snap->dst_port = flow.dst_port;
+      snap->ip_version = flow.ip_version;
+      snap->ip_proto = flow.ip_proto;
+      snap->src_tcp_flags = flow.src_tcp_flags;
+      snap->dst_tcp_flags = flow.dst_tcp_flags;
+      memcpy(snap->src_mac, flow.src_mac, sizeof(snap->src_mac));
+      memcpy(snap->dst_mac, flow.dst_mac, sizeof(snap->dst_mac));
+      out.size += sizeof(*snap);
+
+      uint16_t ext_cnt = 0;
+      for (RecordExt *ext = flow.m_exts; ext != nullptr; ext = ext->m_next) {
+         if (ext->m_ext_id < 0 || static_cast<size_t>(ext->m_ext_id) >= ext_plugin.size() ||
+            ext_plugin[ext->m_ext_id] < 0 || ext->snapshot_version() == 0) {
+            continue;
+         }
+         ok = out.reserve(sizeof(FlowCacheSnapshotExt) + FLOW_CACHE_SNAPSHOT_EXT_MAX);
+         if (!ok) {
+            break;
+         }
+         int len = ext->save_snapshot(out.data + out.size + sizeof(FlowCacheSnapshotExt), FLOW_CACHE_SNAPSHOT_EXT_MAX);
+         if (len < 0) {
+            continue;
+         }
+         FlowCacheSnapshotExt *snap_ext = reinterpret_cast<FlowCacheSnapshotExt *>(out.data + out.size);
+         snap_ext->plugin = ext_plugin[ext->m_ext_id];
+         snap_ext->version = ext->snapshot_version();
+         snap_ext->size = len;
+         out.size += sizeof(*snap_ext) + ((len + 7) & ~7);
+         ext_cnt++;
+      }
+      /* Mapping might have moved while extensions were appended. */
+      reinterpret_cast<FlowCacheSnapshotFlow *>(out.data + flow_pos)->ext_cnt = ext_cnt;
+      flow_cnt++;
+   }
+
+   if (ok) {
+      FlowCacheSnapshotHeader *hdr = reinterpret_cast<FlowCacheSnapshotHeader *>(out.data);
+      memcpy(hdr->magic, FLOW_CACHE_SNAPSHOT_MAGIC, sizeof(hdr->magic));
+      hdr->version = FLOW_CACHE_SNAPSHOT_VERSION;
+      hdr->flow_size = sizeof(FlowCacheSnapshotFlow);
+      hdr->plugin_cnt = plugin_cnt;
+      hdr->reserved = 0;
+      hdr->flow_cnt = flow_cnt;
+      hdr->size = out.size;
+      out.unmap();
+      ok = ftruncate(fd, out.size) == 0 && fsync(fd) == 0;
+   }
+   out.unmap();
+   ::close(fd);
+   if (ok && rename(tmp.c_str(), m_snapshot.c_str()) != 0) {
+      ok = false;
+   }
+   if (!ok) {
+      std::cerr << "cache: unable to write snapshot " << m_snapshot << " (" << strerror(errno) << "), exporting flows" << std::endl;
+      unlink(tmp.c_str());
+   }
+   return ok;
+}
+
+/**
+ * \brief Restore flows from snapshot file saved on previous exit.
+ *
+ * Snapshot is removed once restored, so flows are never restored twice.
+ */
+void NHTFlowCache::load_snapshot()
+{
+   int fd = open(m_snapshot.c_str(), O_RDONLY);
+   if (fd < 0) {
+      if (errno != ENOENT) {
+         std::cerr << "cache: unable to open snapshot " << m_snapshot << " (" << strerror(errno) << ")" << std::endl;
+      }
+      return;
+   }
+   struct stat st;
+   void *mem = MAP_FAILED;
+   if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(FlowCacheSnapshotHeader)) {
+      mem = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   }
+   ::close(fd);
+   if (mem == MAP_FAILED) {
+      std::cerr << "cache: unable to read snapshot " << m_snapshot << std::endl;
+      return;
+   }
+
+   const uint8_t *data = static_cast<const uint8_t *>(mem);
+   const uint8_t *end = data + st.st_size;
+   const FlowCacheSnapshotHeader *hdr = reinterpret_cast<const FlowCacheSnapshotHeader *>(data);
+   if (memcmp(hdr->magic, FLOW_CACHE_SNAPSHOT_MAGIC, sizeof(hdr->magic)) ||
+      hdr->version != FLOW_CACHE_SNAPSHOT_VERSION || hdr->flow_size != sizeof(FlowCacheSnapshotFlow) ||
+      hdr->size != static_cast<uint64_t>(st.st_size) || hdr->plugin_cnt > MAX_PLUGINS ||
+      sizeof(*hdr) + hdr->plugin_cnt * sizeof(FlowCacheSnapshotPlugin) > hdr->size) {
+      std::cerr << "cache: ignoring incompatible snapshot " << m_snapshot << std::endl;
+      munmap(mem, st.st_size);
+      return;
+   }
+
+   /* Plugins are matched by name, plugins missing in current configuration are ignored. */
+   std::vector<int> plugin_map(hdr->plugin_cnt, -1);
+   uint64_t used = 0;
+   const FlowCacheSnapshotPlugin *plugins = reinterpret_cast<const FlowCacheSnapshotPlugin *>(hdr + 1);
+   for (uint32_t i = 0; i < hdr->plugin_cnt; i++) {
+      std::string name(plugins[i].name, strnlen(plugins[i].name, sizeof(plugins[i].name)));
+      for (uint32_t j = 0; j < get_plugin_cnt(); j++) {
+         if (!(used & (1ULL << j)) && get_plugin(j)->get_name() == name) {
+            plugin_map[i] = j;
+            used |= 1ULL << j;
+            break;
+         }
+      }
+   }
+
+   time_t now = time(nullptr);
+   uint64_t dropped = 0;
+   uint64_t flow_idx;
+   const uint8_t *pos = reinterpret_cast<const uint8_t *>(plugins + hdr->plugin_cnt);
+   for (flow_idx = 0; flow_idx < hdr->flow_cnt; flow_idx++) {
+      if (static_cast<size_t>(end - pos) < sizeof(FlowCacheSnapshotFlow)) {
+         break;
+      }
+      const FlowCacheSnapshotFlow *snap = reinterpret_cast<const FlowCacheSnapshotFlow *>(pos);
+      const uint8_t *ext = pos + sizeof(*snap);
+      pos = ext;
+      uint16_t i;
+      for (i = 0; i < snap->ext_cnt; i++) {
+         if (static_cast<size_t>(end - pos) < sizeof(FlowCacheSnapshotExt)) {
+            break;
+         }
+         size_t len = sizeof(FlowCacheSnapshotExt) + ((reinterpret_cast<const FlowCacheSnapshotExt *>(pos)->size + 7) & ~7ULL);
+         if (static_cast<size_t>(end - pos) < len) {
+            break;
+         }
+         pos += len;
+      }
+      if (i != snap->ext_cnt) {
+         break;
+      }
+      if (!restore_flow(*snap, ext, pos, plugin_map, now)) {
+         dropped++;
+      }
+   }
+   if (flow_idx != hdr->flow_cnt) {
+      std::cerr << "cache: snapshot " << m_snapshot << " is truncated, restored " << flow_idx << " of " << hdr->flow_cnt << " flows" << std::endl;
+   }
+   if (dropped) {
+      std::cerr << "cache: dropped " << dropped << " flows with invalid timestamps from snapshot " << m_snapshot << std::endl;
+   }
+
+   munmap(mem, st.st_size);
+   unlink(m_snapshot.c_str());
+}
+
+/**
+ * \brief Insert flow from snapshot into the cache.
+ *
+ * Timestamps are revalidated against current time: flows from the future are dropped,
+ * flows whose timeout elapsed while the exporter was down are exported right away.
+ * \param [in] snap Basic flow state.
+ * \param [in] ext First extension of flow.
+ * \param [in] end End of extensions of flow.
+ * \param [in] plugin_map Index of current plugin for every plugin of snapshot, -1 when missing.
+ * \param [in] now Current time.
+ * \return False when flow was dropped.
+ */
+bool NHTFlowCache::restore_flow(const FlowCacheSnapshotFlow &snap, const uint8_t *ext, const uint8_t *end,
+   const std::vector<int> &plugin_map, time_t now)
+{
+   if (timercmp(&snap.time_first, &snap.time_last, >) || snap.time_last.tv_sec > now) {
+      return false;
+   }
+
+   Packet pkt;
+   pkt.ip_version = snap.ip_version;
+   pkt.ip_proto = snap.ip_proto;
+   pkt.src_ip = snap.src_ip;
+   pkt.dst_ip = snap.dst_ip;
+   pkt.src_port = snap.src_port;
+   pkt.dst_port = snap.dst_port;
+   if (!create_hash_key(pkt)) {
+      return false;
+   }
+   uint64_t hashval = XXH64(m_key, m_keylen, 0);
+   uint32_t line_index = hashval & m_line_mask;
+   uint32_t next_line = line_index + m_line_size;
+   uint32_t flow_index;
+   for (flow_index = line_index; flow_index < next_line; flow_index++) {
+      if (m_flow_hash[flow_index] == 0) {
+         break;
+      }
+   }
+   if (flow_index == next_line) {
+      /* Cache is smaller than the one which saved the snapshot. */
+      flow_index = select_victim(line_index);
+      evict_flow(flow_index);
+   }
+
+   Flow &flow = get_record(flow_index)->m_flow;
+   flow.time_first = snap.time_first;
+   flow.time_last = snap.time_last;
+   flow.src_bytes = snap.src_bytes;
+   flow.dst_bytes = snap.dst_bytes;
+   flow.src_ip = snap.src_ip;
+   flow.dst_ip = snap.dst_ip;
+   flow.src_packets = snap.src_packets;
+   flow.dst_packets = snap.dst_packets;
+   flow.src_port = snap.src_port;
+   flow.dst_port = snap.dst_port;
+   flow.ip_version = snap.ip_version;
+   flow.ip_proto = snap.ip_proto;
+   flow.src_tcp_flags = snap.src_tcp_flags;
+   flow.dst_tcp_flags = snap.dst_tcp_flags;
+   flow.degraded = 0;
+   memcpy(flow.src_mac, snap.src_mac, sizeof(flow.src_mac));
+   memcpy(flow.dst_mac, snap.dst_mac, sizeof(flow.dst_mac));
+
+   /* Plugins running in DPI workers are not reactivated, their worker state is not part of snapshot. */
+   flow.plugins_active = 0;
+   for (uint64_t active = snap.plugins_active; active; active &= active - 1) {
+      unsigned int idx = __builtin_ctzll(active);
+      if (idx < plugin_map.size() && plugin_map[idx] >= 0 && !plugin_offloaded(plugin_map[idx])) {
+         flow.plugins_active |= 1ULL << plugin_map[idx];
+      }
+   }
+   /* Only plugins with restored extension continue on flow, the others would miss their flow state. */
+   flow.plugins_created = 0;
+   while (ext < end) {
+      const FlowCacheSnapshotExt *snap_ext = reinterpret_cast<const FlowCacheSnapshotExt *>(ext);
+      const uint8_t *ext_data = ext + sizeof(*snap_ext);
+      ext = ext_data + ((snap_ext->size + 7) & ~7ULL);
+      if (snap_ext->plugin >= plugin_map.size() || plugin_map[snap_ext->plugin] < 0) {
+         continue;
+      }
+      RecordExt *rec_ext = get_plugin(plugin_map[snap_ext->plugin])->get_ext();
+      if (rec_ext == nullptr) {
+         continue;
+      }
+      if (rec_ext->snapshot_version() == snap_ext->version && rec_ext->load_snapshot(ext_data, snap_ext->size)) {
+         flow.add_extension(rec_ext);
+         if (!plugin_offloaded(plugin_map[snap_ext->plugin])) {
+            flow.plugins_created |= 1ULL << plugin_map[snap_ext->plugin];
+         }
+      } else {
+         delete rec_ext;
+      }
+   }
+   flow.plugins_active &= flow.plugins_created;
+   m_flow_hash[flow_index] = hashval;
+   m_flow_last[flow_index] = snap.time_last.tv_sec;
+#ifdef FLOW_CACHE_STATS
+   m_occupied++;
+#endif /* FLOW_CACHE_STATS */
+   init_meta(flow_index, static_cast<uint64_t>(snap.src_packets) + snap.dst_packets);
+
+   if (now - snap.time_last.tv_sec >= m_inactive) {
+      flow.end_reason = get_export_reason(flow);
+      plugins_pre_export(flow);
+      export_flow(flow_index);
+   } else if (now - snap.time_first.tv_sec >= m_active) {
+      flow.end_reason = FLOW_END_ACTIVE;
+      plugins_pre_export(flow);
+      export_flow(flow_index);
+   }
+   return true;
 }
 
 void NHTFlowCache::flush(Packet &pkt, size_t flow_index, int ret, bool source_flow)
@@ -286,32 +1097,113 @@ void NHTFlowCache::flush(Packet &pkt, size_t flow_index, int ret, bool source_fl
 #endif /* FLOW_CACHE_STATS */
 
    if (ret == FLOW_FLUSH_WITH_REINSERT) {
-      FlowRecord *flow = m_flow_table[flow_index];
+      FlowRecord *flow = get_record(flow_index);
       flow->m_flow.end_reason = FLOW_END_FORCED;
+      plugins_merge(flow->m_flow);
       ipx_ring_push(m_export_queue, &flow->m_flow);
+      m_pushed++;
 
-      std::swap(m_flow_table[flow_index], m_flow_table[m_cache_size + m_qidx]);
+      swap_spare(flow_index);
 
-      flow = m_flow_table[flow_index];
+      flow = get_record(flow_index);
       flow->m_flow.remove_extensions();
-      *flow = *m_flow_table[m_cache_size + m_qidx];
+      *flow = *get_record(m_cache_size + m_qidx);
       m_qidx = (m_qidx + 1) % m_qsize;
 
       flow->m_flow.m_exts = nullptr;
       flow->reuse(); // Clean counters, set time first to last
       flow->update(pkt, source_flow); // Set new counters from packet
+      m_flow_last[flow_index] = pkt.ts.tv_sec;
 
       ret = plugins_post_create(flow->m_flow, pkt);
       if (ret & FLOW_FLUSH) {
          flush(pkt, flow_index, ret, source_flow);
       }
    } else {
-      m_flow_table[flow_index]->m_flow.end_reason = FLOW_END_FORCED;
+      get_record(flow_index)->m_flow.end_reason = FLOW_END_FORCED;
       export_flow(flow_index);
    }
 }
 
+SamplingMode NHTFlowCache::get_sampling(uint32_t &interval) const
+{
+   interval = m_sampling_interval;
+   return m_sampling;
+}
+
+/**
+ * \brief Sample every interval-th packet while overload control requests it.
+ * Sampling configured by options takes precedence.
+ */
+bool NHTFlowCache::set_overload_sampling(uint32_t interval)
+{
+   if (m_sampling != SamplingMode::NONE && !m_overload_sampling) {
+      return false;
+   }
+   m_overload_sampling = interval > 1;
+   m_sampling = m_overload_sampling ? SamplingMode::COUNT : SamplingMode::NONE;
+   m_sampling_interval = interval;
+   m_sampling_threshold = (static_cast<uint64_t>(1) << 32) / interval;
+   m_sampling_cnt = 0;
+   return true;
+}
+
+/**
+ * \brief Decide whether packet is selected by sampling.
+ *
+ * Flow sampling hashes flow key of both directions, so the decision is the same
+ * for both directions and for all caches.
+ */
+bool NHTFlowCache::select_pkt(Packet &pkt)
+{
+   uint64_t value;
+
+   m_sampling_seen++;
+   switch (m_sampling) {
+   case SamplingMode::COUNT:
+      if (++m_sampling_cnt < m_sampling_interval) {
+         return false;
+      }
+      m_sampling_cnt = 0;
+      break;
+   case SamplingMode::RANDOM:
+      /* xorshift64* generator, upper half of output is used. */
+      m_sampling_state ^= m_sampling_state >> 12;
+      m_sampling_state ^= m_sampling_state << 25;
+      m_sampling_state ^= m_sampling_state >> 27;
+      value = (m_sampling_state * 0x2545F4914F6CDD1DULL) >> 32;
+      if (value >= m_sampling_threshold) {
+         return false;
+      }
+      break;
+   case SamplingMode::FLOW:
+      /* Packets without flow key are left to the cache, which ignores them. */
+      if (create_hash_key(pkt)) {
+         value = (XXH64(m_key, m_keylen, 0) + XXH64(m_key_inv, m_keylen, 0)) >> 32;
+         if (value >= m_sampling_threshold) {
+            return false;
+         }
+      }
+      break;
+   default:
+      break;
+   }
+   m_sampling_selected++;
+   return true;
+}
+
 int NHTFlowCache::put_pkt(Packet &pkt)
+{
+   if (m_sampling != SamplingMode::NONE && !select_pkt(pkt)) {
+      return 0;
+   }
+   return insert_pkt(pkt);
+}
+
+/**
+ * \brief Put packet selected by sampling into flow cache.
+ */
+int NHTFlowCache::insert_pkt(Packet &pkt)
 {
    int ret = plugins_pre_create(pkt);
 
@@ -320,6 +1212,13 @@ int NHTFlowCache::put_pkt(Packet &pkt)
    }
 
    uint64_t hashval = XXH64(m_key, m_keylen, 0); /* Calculates hash value from key created before. */
+   if (m_old.mem != nullptr) {
+      /* Lines of both directions are migrated first, so flows are searched only in the current table. */
+      migrate_line(hashval & m_old.line_mask);
+      if (!m_split_biflow) {
+         migrate_line(XXH64(m_key_inv, m_keylen, 0) & m_old.line_mask);
+      }
+   }
 
    FlowRecord *flow; /* Pointer to flow we will be working with. */
    bool found = false;
@@ -328,13 +1227,18 @@ int NHTFlowCache::put_pkt(Packet &pkt)
    uint32_t flow_index = 0;
    uint32_t next_line = line_index + m_line_size;
 
+#ifdef FLOW_CACHE_STATS
+   m_packets++;
+#endif /* FLOW_CACHE_STATS */
+
    /* Find existing flow record in flow cache. */
    for (flow_index = line_index; flow_index < next_line; flow_index++) {
-      if (m_flow_table[flow_index]->belongs(hashval)) {
+      if (m_flow_hash[flow_index] == hashval) {
          found = true;
          break;
       }
    }
+   FLOW_CACHE_TOUCH(m_flow_hash + line_index, (std::min(flow_index + 1, next_line) - line_index) * sizeof(*m_flow_hash));
 
    /* Find inversed flow. */
    if (!found && !m_split_biflow) {
@@ -342,7 +1246,7 @@ int NHTFlowCache::put_pkt(Packet &pkt)
       uint64_t line_index_inv = hashval_inv & m_line_mask;
       uint64_t next_line_inv = line_index_inv + m_line_size;
       for (flow_index = line_index_inv; flow_index < next_line_inv; flow_index++) {
-         if (m_flow_table[flow_index]->belongs(hashval_inv)) {
+         if (m_flow_hash[flow_index] == hashval_inv) {
             found = true;
             source_flow = false;
             hashval = hashval_inv;
@@ -350,6 +1254,7 @@ int NHTFlowCache::put_pkt(Packet &pkt)
             break;
          }
       }
+      FLOW_CACHE_TOUCH(m_flow_hash + line_index_inv, (std::min<uint64_t>(flow_index + 1, next_line_inv) - line_index_inv) * sizeof(*m_flow_hash));
    }
 
    if (found) {
@@ -357,22 +1262,24 @@ int NHTFlowCache::put_pkt(Packet &pkt)
 #ifdef FLOW_CACHE_STATS
       m_lookups += (flow_index - line_index + 1);
       m_lookups2 += (flow_index - line_index + 1) * (flow_index - line_index + 1);
+      if (flow_index - line_index >= m_probes.size()) {
+         m_probes.resize(flow_index - line_index + 1, 0);
+      }
+      m_probes[flow_index - line_index]++;
 #endif /* FLOW_CACHE_STATS */
 
-      flow = m_flow_table[flow_index];
-      for (decltype(flow_index) j = flow_index; j > line_index; j--) {
-         m_flow_table[j] = m_flow_table[j - 1];
+      /* CLOCK keeps flows in place, their reference bit is set on update. */
+      if (m_evict != EvictPolicy::CLOCK) {
+         move_record(flow_index, line_index);
+         flow_index = line_index;
       }
-
-      m_flow_table[line_index] = flow;
-      flow_index = line_index;
 #ifdef FLOW_CACHE_STATS
       m_hits++;
 #endif /* FLOW_CACHE_STATS */
    } else {
       /* Existing flow record was not found. Find free place in flow line. */
       for (flow_index = line_index; flow_index < next_line; flow_index++) {
-         if (m_flow_table[flow_index]->is_empty()) {
+         if (m_flow_hash[flow_index] == 0) {
             found = true;
             break;
          }
@@ -380,23 +1287,19 @@ int NHTFlowCache::put_pkt(Packet &pkt)
       if (!found) {
          /* If free place was not found (flow line is full), find
           * record which will be replaced by new record. */
-         flow_index = next_line - 1;
-
-         // Export flow
-         plugins_pre_export(m_flow_table[flow_index]->m_flow);
-         m_flow_table[flow_index]->m_flow.end_reason = FLOW_END_NO_RES;
-         export_flow(flow_index);
+         flow_index = select_victim(line_index);
+         evict_flow(flow_index);
+         m_evicted++;
 
 #ifdef FLOW_CACHE_STATS
          m_expired++;
 #endif /* FLOW_CACHE_STATS */
+         /* New flow enters at the insertion point of line, or in place of victim closer to line start. */
          uint32_t flow_new_index = line_index + m_line_new_idx;
-         flow = m_flow_table[flow_index];
-         for (decltype(flow_index) j = flow_index; j > flow_new_index; j--) {
-            m_flow_table[j] = m_flow_table[j - 1];
+         if (m_evict != EvictPolicy::CLOCK && flow_index > flow_new_index) {
+            move_record(flow_index, flow_new_index);
+            flow_index = flow_new_index;
          }
-         flow_index = flow_new_index;
-         m_flow_table[flow_new_index] = flow;
 #ifdef FLOW_CACHE_STATS
          m_not_empty++;
       } else {
@@ -406,19 +1309,32 @@ int NHTFlowCache::put_pkt(Packet &pkt)
    }
 
    pkt.source_pkt = source_flow;
-   flow = m_flow_table[flow_index];
+   flow = get_record(flow_index);
 
    uint8_t flw_flags = source_flow ? flow->m_flow.src_tcp_flags : flow->m_flow.dst_tcp_flags;
    if ((pkt.tcp_flags & 0x02) && (flw_flags & (0x01 | 0x04))) {
       // Flows with FIN or RST TCP flags are exported when new SYN packet arrives
-      m_flow_table[flow_index]->m_flow.end_reason = FLOW_END_EOF;
+      flow->m_flow.end_reason = FLOW_END_EOF;
       export_flow(flow_index);
-      put_pkt(pkt);
+#ifdef FLOW_CACHE_STATS
+      m_packets--; /* Packet is counted again when it creates the new flow. */
+#endif /* FLOW_CACHE_STATS */
+      insert_pkt(pkt);
       return 0;
    }
 
-   if (flow->is_empty()) {
-      flow->create(pkt, hashval);
+   if (m_flow_hash[flow_index] == 0) {
+      flow->create(pkt);
+      m_flow_hash[flow_index] = hashval;
+      m_flow_last[flow_index] = pkt.ts.tv_sec;
+      init_meta(flow_index, 1);
+#ifdef FLOW_CACHE_STATS
+      m_peak_occupied = std::max(m_peak_occupied, ++m_occupied);
+#endif /* FLOW_CACHE_STATS */
+      FLOW_CACHE_TOUCH(flow, sizeof(FlowRecord));
+      if (m_grow != 0 && ++m_created >= m_cache_size) {
+         check_growth();
+      }
       ret = plugins_post_create(flow->m_flow, pkt);
 
       if (ret & FLOW_FLUSH) {
@@ -428,14 +1344,17 @@ int NHTFlowCache::put_pkt(Packet &pkt)
 #endif /* FLOW_CACHE_STATS */
       }
    } else {
+      /* Update writes hot fields at the beginning of the record and reads flags and time_first: */
+      FLOW_CACHE_TOUCH(flow, reinterpret_cast<uintptr_t>(&flow->m_flow.time_first + 1) - reinterpret_cast<uintptr_t>(flow));
       if (pkt.ts.tv_sec - flow->m_flow.time_last.tv_sec >= m_inactive) {
-         m_flow_table[flow_index]->m_flow.end_reason = get_export_reason(flow->m_flow);
+         flow->m_flow.end_reason = get_export_reason(flow->m_flow);
          plugins_pre_export(flow->m_flow);
          export_flow(flow_index);
    #ifdef FLOW_CACHE_STATS
          m_expired++;
+         m_packets--;
    #endif /* FLOW_CACHE_STATS */
-         return put_pkt(pkt);
+         return insert_pkt(pkt);
       }
       ret = plugins_pre_update(flow->m_flow, pkt);
       if (ret & FLOW_FLUSH) {
@@ -443,6 +1362,8 @@ int NHTFlowCache::put_pkt(Packet &pkt)
          return 0;
       } else {
          flow->update(pkt, source_flow);
+         m_flow_last[flow_index] = pkt.ts.tv_sec;
+         update_meta(flow_index);
          ret = plugins_post_update(flow->m_flow, pkt);
 
          if (ret & FLOW_FLUSH) {
@@ -453,7 +1374,7 @@ int NHTFlowCache::put_pkt(Packet &pkt)
 
       /* Check if flow record is expired. */
       if (pkt.ts.tv_sec - flow->m_flow.time_first.tv_sec >= m_active) {
-         m_flow_table[flow_index]->m_flow.end_reason = FLOW_END_ACTIVE;
+         flow->m_flow.end_reason = FLOW_END_ACTIVE;
          plugins_pre_export(flow->m_flow);
          export_flow(flow_index);
 #ifdef FLOW_CACHE_STATS
@@ -478,10 +1399,16 @@ uint8_t NHTFlowCache::get_export_reason(Flow &flow)
 
 void NHTFlowCache::export_expired(time_t ts)
 {
+   if (m_old.mem != nullptr || !m_retired.empty() || m_resize_request.load(std::memory_order_relaxed) != 0) {
+      resize_step();
+   }
+   FLOW_CACHE_TOUCH(m_flow_hash + m_timeout_idx, m_line_new_idx * sizeof(*m_flow_hash));
+   FLOW_CACHE_TOUCH(m_flow_last + m_timeout_idx, m_line_new_idx * sizeof(*m_flow_last));
    for (decltype(m_timeout_idx) i = m_timeout_idx; i < m_timeout_idx + m_line_new_idx; i++) {
-      if (!m_flow_table[i]->is_empty() && ts - m_flow_table[i]->m_flow.time_last.tv_sec >= m_inactive) {
-         m_flow_table[i]->m_flow.end_reason = get_export_reason(m_flow_table[i]->m_flow);
-         plugins_pre_export(m_flow_table[i]->m_flow);
+      if (m_flow_hash[i] != 0 && ts - m_flow_last[i] >= m_inactive) {
+         FlowRecord *flow = get_record(i);
+         flow->m_flow.end_reason = get_export_reason(flow->m_flow);
+         plugins_pre_export(flow->m_flow);
          export_flow(i);
 #ifdef FLOW_CACHE_STATS
          m_expired++;
@@ -540,17 +1467,30 @@ bool NHTFlowCache::create_hash_key(Packet &pkt)
 }
 
 #ifdef FLOW_CACHE_STATS
+void NHTFlowCache::get_stats(FlowCacheStats &stats) const
+{
+   stats.packets = m_packets;
+   stats.hits = m_hits;
+   stats.empty = m_empty;
+   stats.not_empty = m_not_empty;
+   stats.lines = m_lines;
+   stats.occupied = m_occupied;
+   stats.peak_occupied = m_peak_occupied;
+   stats.probes = m_probes;
+}
+
 void NHTFlowCache::print_report()
 {
    float tmp = float(m_lookups) / m_hits;
 
-   cout << "Hits: " << m_hits << endl;
-   cout << "Empty: " << m_empty << endl;
-   cout << "Not empty: " << m_not_empty << endl;
-   cout << "Expired: " << m_expired << endl;
-   cout << "Flushed: " << m_flushed << endl;
-   cout << "Average Lookup:  " << tmp << endl;
-   cout << "Variance Lookup: " << float(m_lookups2) / m_hits - tmp * tmp << endl;
+   std::cout << "Hits: " << m_hits << std::endl;
+   std::cout << "Empty: " << m_empty << std::endl;
+   std::cout << "Not empty: " << m_not_empty << std::endl;
+   std::cout << "Expired: " << m_expired << std::endl;
+   std::cout << "Flushed: " << m_flushed << std::endl;
+   std::cout << "Average Lookup:  " << tmp << std::endl;
+   std::cout << "Variance Lookup: " << float(m_lookups2) / m_hits - tmp * tmp << std::endl;
+   std::cout << "Cache lines per packet: " << float(m_lines) / m_packets << std::endl;
 }
 #endif /* FLOW_CACHE_STATS */
 
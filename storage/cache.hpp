@@ -47,7 +47,11 @@
 #ifndef IPXP_STORAGE_CACHE_HPP
 #define IPXP_STORAGE_CACHE_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <string>
+#include <vector>
 
 #include <ipfixprobe/storage.hpp>
 #include <ipfixprobe/options.hpp>
@@ -91,6 +95,18 @@ static const uint32_t DEFAULT_FLOW_LINE_SIZE = 4; // 16 records per line
 static const uint32_t DEFAULT_INACTIVE_TIMEOUT = 30;
 static const uint32_t DEFAULT_ACTIVE_TIMEOUT = 300;
 
+/**
+ * \brief Choice of flow evicted when a new flow maps to a full flow line.
+ */
+enum class EvictPolicy : uint8_t {
+   LRU,      /**< Least recently used flow, new flows enter in the middle of line. */
+   PACKETS,  /**< Flow with the fewest packets, least recently used one on tie. */
+   CLOCK,    /**< Second chance, flows keep their slots and hits set reference bit cleared by per line hand. */
+   PROBATION /**< Least recently used flow which has seen a single packet, least recently used flow when none has. */
+};
+
+static const char *const EVICT_POLICY_NAMES[] = {"lru", "packets", "clock", "probation"};
+
 static_assert(std::is_unsigned<decltype(DEFAULT_FLOW_CACHE_SIZE)>(), "Static checks of default cache sizes won't properly work without unsigned type.");
 static_assert(bitcount<decltype(DEFAULT_FLOW_CACHE_SIZE)>(-1) > DEFAULT_FLOW_CACHE_SIZE, "Flow cache size is too big to fit in variable!");
 static_assert(bitcount<decltype(DEFAULT_FLOW_LINE_SIZE)>(-1) > DEFAULT_FLOW_LINE_SIZE, "Flow cache line size is too big to fit in variable!");
@@ -106,10 +122,19 @@ public:
    uint32_t m_active;
    uint32_t m_inactive;
    bool m_split_biflow;
+   bool m_hugepages;
+   std::string m_snapshot;
+   uint32_t m_grow;
+   uint32_t m_max_size;
+   EvictPolicy m_evict;
+   SamplingMode m_sampling;
+   uint32_t m_sampling_interval;
 
    CacheOptParser() : OptionsParser("cache", "Storage plugin implemented as a hash table"),
       m_cache_size(1 << DEFAULT_FLOW_CACHE_SIZE), m_line_size(1 << DEFAULT_FLOW_LINE_SIZE),
-      m_active(DEFAULT_ACTIVE_TIMEOUT), m_inactive(DEFAULT_INACTIVE_TIMEOUT), m_split_biflow(false)
+      m_active(DEFAULT_ACTIVE_TIMEOUT), m_inactive(DEFAULT_INACTIVE_TIMEOUT), m_split_biflow(false),
+      m_hugepages(false), m_snapshot(""), m_grow(0), m_max_size(0), m_evict(EvictPolicy::LRU),
+      m_sampling(SamplingMode::NONE), m_sampling_interval(1)
    {
       register_option("s", "size", "EXPONENT", "Cache size exponent to the power of two",
          [this](const char *arg){try {unsigned exp = str2num<decltype(exp)>(arg);
@@ -134,28 +159,183 @@ public:
          OptionFlags::RequiredArgument);
       register_option("S", "split", "", "Split biflows into uniflows",
          [this](const char *arg){ m_split_biflow = true; return true;}, OptionFlags::NoArgument);
+      register_option("H", "hugepages", "", "Allocate flow table in hugepage backed memory",
+         [this](const char *arg){ m_hugepages = true; return true;}, OptionFlags::NoArgument);
+      register_option("p", "snapshot", "FILE", "Save flows to snapshot file on exit instead of exporting them, restore them from the file on start",
+         [this](const char *arg){ m_snapshot = arg; return true;}, OptionFlags::RequiredArgument);
+      register_option("g", "grow", "PERCENT", "Double cache size when more than PERCENT of new flows evict a flow for lack of space",
+         [this](const char *arg){try {m_grow = str2num<decltype(m_grow)>(arg);
+               if (m_grow == 0 || m_grow > 100) {
+                  throw PluginError("Flow cache grow threshold must be between 1 and 100 percent");
+               }
+            } catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("m", "max-size", "EXPONENT", "Largest cache size exponent reached by automatic growth, cache size + 4 by default",
+         [this](const char *arg){try {unsigned exp = str2num<decltype(exp)>(arg);
+               if (exp < 4 || exp > 30) {
+                  throw PluginError("Flow cache size must be between 4 and 30");
+               }
+               m_max_size = static_cast<uint32_t>(1) << exp;
+            } catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
+      register_option("e", "evict", "POLICY", "Flow evicted from full line: lru (default), packets (fewest packets), clock (second chance) or probation (single packet flows first)",
+         [this](const char *arg){for (size_t i = 0; i < sizeof(EVICT_POLICY_NAMES) / sizeof(EVICT_POLICY_NAMES[0]); i++) {
+               if (!strcmp(arg, EVICT_POLICY_NAMES[i])) {
+                  m_evict = static_cast<EvictPolicy>(i);
+                  return true;
+               }
+            } return false;},
+         OptionFlags::RequiredArgument);
+      register_option("x", "sampling", "MODE", "Sample packets: count (every N-th packet), random (packet with probability 1/N) or flow (one of N flows with both directions)",
+         [this](const char *arg){if (!strcmp(arg, "count")) {
+               m_sampling = SamplingMode::COUNT;
+            } else if (!strcmp(arg, "random")) {
+               m_sampling = SamplingMode::RANDOM;
+            } else if (!strcmp(arg, "flow")) {
+               m_sampling = SamplingMode::FLOW;
+            } else {
+               return false;
+            } return true;},
+         OptionFlags::RequiredArgument);
+      register_option("n", "interval", "N", "Sampling interval N, count sampling is used when mode is not set",
+         [this](const char *arg){try {m_sampling_interval = str2num<decltype(m_sampling_interval)>(arg);
+               if (m_sampling_interval == 0) {
+                  throw PluginError("Sampling interval must be at least 1");
+               }
+            } catch(std::invalid_argument &e) {return false;} return true;},
+         OptionFlags::RequiredArgument);
    }
 };
 
-class FlowRecord
-{
-   uint64_t m_hash;
+#define FLOW_CACHE_LINE 64
+
+#define FLOW_CACHE_HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+#define FLOW_CACHE_RESIZE_LINES 2 /**< Number of flow lines migrated in background per packet during resize. */
+
+#define FLOW_CACHE_SNAPSHOT_MAGIC "IPXPSNAP"
+#define FLOW_CACHE_SNAPSHOT_VERSION 1
+#define FLOW_CACHE_SNAPSHOT_NAME_LEN 32
+#define FLOW_CACHE_SNAPSHOT_EXT_MAX 65536 /**< Maximal size of serialized extension. */
+
+/**
+ * \brief Header of flow cache snapshot file.
+ *
+ * Header is followed by plugin table, flows with their extensions follow the table.
+ * Snapshot is meant to be restored by the same build on the same machine,
+ * integers are stored in host byte order.
+ */
+struct FlowCacheSnapshotHeader {
+   char magic[8];
+   uint32_t version;
+   uint32_t flow_size; /**< Size of FlowCacheSnapshotFlow, rejects snapshots of other layout. */
+   uint32_t plugin_cnt;
+   uint32_t reserved;
+   uint64_t flow_cnt;
+   uint64_t size; /**< Size of whole snapshot file. */
+};
+
+/**
+ * \brief Plugin table entry, indexes of plugins in snapshot are remapped by name on restore.
+ */
+struct FlowCacheSnapshotPlugin {
+   char name[FLOW_CACHE_SNAPSHOT_NAME_LEN];
+};
+
+/**
+ * \brief Basic flow state in snapshot, followed by ext_cnt extensions.
+ */
+struct FlowCacheSnapshotFlow {
+   struct timeval time_first;
+   struct timeval time_last;
+   uint64_t src_bytes;
+   uint64_t dst_bytes;
+   uint64_t plugins_active; /**< Bitmask of plugins indexed by snapshot plugin table. */
+   ipaddr_t src_ip;
+   ipaddr_t dst_ip;
+   uint32_t src_packets;
+   uint32_t dst_packets;
+   uint16_t src_port;
+   uint16_t dst_port;
+   uint8_t ip_version;
+   uint8_t ip_proto;
+   uint8_t src_tcp_flags;
+   uint8_t dst_tcp_flags;
+   uint8_t src_mac[6];
+   uint8_t dst_mac[6];
+   uint16_t ext_cnt;
+   uint16_t reserved;
+};
+
+/**
+ * \brief Extension in snapshot, followed by data padded to 8 bytes.
+ */
+struct FlowCacheSnapshotExt {
+   uint16_t plugin; /**< Index of plugin in snapshot plugin table. */
+   uint16_t version; /**< Version returned by RecordExt::snapshot_version(). */
+   uint32_t size; /**< Size of data without padding. */
+};
 
+/**
+ * \brief Cold part of flow cache record, touched when flow is found, created or exported.
+ *
+ * Hash and last seen time used by lookups and timeout scans are kept by NHTFlowCache
+ * in separate arrays in table order, so probing a flow line does not dereference records.
+ * Records live in zero filled memory of the cache which is a valid empty record,
+ * they are never constructed nor destructed.
+ */
+class alignas(FLOW_CACHE_LINE) FlowRecord
+{
 public:
    Flow m_flow;
 
-   FlowRecord();
-   ~FlowRecord();
-
    void erase();
    void reuse();
 
-   inline bool is_empty() const;
-   inline bool belongs(uint64_t pkt_hash) const;
-   void create(const Packet &pkt, uint64_t pkt_hash);
+   void create(const Packet &pkt);
    void update(const Packet &pkt, bool src);
 };
 
+/**
+ * \brief Memory of flow table, records, hot arrays and slot table are placed in one region.
+ */
+struct FlowTable {
+   void *mem; /**< Memory region holding all the arrays below, nullptr when table is not allocated. */
+   size_t mem_size;
+   uint32_t size; /**< Number of records, spare records of export queue are not included. */
+   uint32_t line_mask;
+   uint32_t *table;
+   FlowRecord *records;
+   uint64_t *hash;
+   uint32_t *last;
+   uint8_t *meta;
+   uint32_t *hand;
+
+   /**
+    * \brief Get record stored in slot of flow table.
+    */
+   FlowRecord *get_record(uint32_t slot) const
+   {
+      return records + (table[slot] ? table[slot] - 1 : slot);
+   }
+};
+
+#ifdef FLOW_CACHE_STATS
+/**
+ * \brief Lookup statistics of flow cache.
+ */
+struct FlowCacheStats {
+   uint64_t packets;
+   uint64_t hits; /**< Packets of flows found in cache. */
+   uint64_t empty; /**< New flows placed in empty slot. */
+   uint64_t not_empty; /**< New flows which evicted another flow. */
+   uint64_t lines; /**< Cache lines touched. */
+   uint64_t occupied; /**< Flows in cache. */
+   uint64_t peak_occupied;
+   std::vector<uint64_t> probes; /**< Hits by number of probed slots, index 0 is one slot. */
+};
+#endif /* FLOW_CACHE_STATS */
+
 class NHTFlowCache : public StoragePlugin
 {
 public:
@@ -169,6 +349,15 @@ public:
 
    int put_pkt(Packet &pkt);
    void export_expired(time_t ts);
+   void start();
+   bool resize(uint32_t size);
+   SamplingMode get_sampling(uint32_t &interval) const;
+#ifdef FLOW_CACHE_STATS
+   void get_stats(FlowCacheStats &stats) const;
+#endif /* FLOW_CACHE_STATS */
+
+protected:
+   bool set_overload_sampling(uint32_t interval);
 
 private:
    uint32_t m_cache_size;
@@ -186,6 +375,11 @@ private:
    uint64_t m_flushed;
    uint64_t m_lookups;
    uint64_t m_lookups2;
+   uint64_t m_packets;
+   uint64_t m_lines;
+   uint64_t m_occupied;
+   uint64_t m_peak_occupied;
+   std::vector<uint64_t> m_probes;
 #endif /* FLOW_CACHE_STATS */
    uint32_t m_active;
    uint32_t m_inactive;
@@ -193,14 +387,105 @@ private:
    uint8_t m_keylen;
    char m_key[MAX_KEY_LENGTH];
    char m_key_inv[MAX_KEY_LENGTH];
-   FlowRecord **m_flow_table;
+   std::string m_snapshot; /**< Path of snapshot file, empty when disabled. */
+   void *m_mem; /**< Memory region holding all the arrays below. */
+   size_t m_mem_size;
+   uint32_t *m_flow_table; /**< Index of record in m_flow_records plus one, 0 when slot holds record of the same index. */
    FlowRecord *m_flow_records;
+   uint64_t *m_flow_hash; /**< Hash of record at the same index of m_flow_table, 0 for empty record. */
+   uint32_t *m_flow_last; /**< Seconds of last packet of record at the same index of m_flow_table. */
+   uint8_t *m_flow_meta; /**< Eviction state of record at the same index of m_flow_table, packet count saturated
+                              at 255 or CLOCK reference bit, unused by LRU policy. */
+   uint32_t *m_line_hand; /**< CLOCK hand of every flow line, index of slot within line. */
+   bool m_hugepages;
+   EvictPolicy m_evict;
+   uint64_t m_evict_cnt; /**< Flows evicted for lack of space. */
+   uint64_t m_evict_single; /**< Evicted flows which have seen a single packet. */
+   uint64_t m_evict_packets; /**< Packets of evicted flows. */
+   SamplingMode m_sampling;
+   uint32_t m_sampling_interval;
+   uint32_t m_sampling_cnt; /**< Packets skipped since last selected one by count sampling. */
+   uint64_t m_sampling_threshold; /**< Random value or flow hash below threshold selects packet, 2^32 / interval. */
+   uint64_t m_sampling_state; /**< State of random generator. */
+   uint64_t m_sampling_seen; /**< Packets offered to sampling. */
+   uint64_t m_sampling_selected; /**< Packets selected by sampling. */
+   bool m_overload_sampling; /**< Sampling was enabled by overload control. */
+
+   FlowTable m_old; /**< Table migrated to the current one during resize. */
+   uint32_t m_old_line; /**< Next line of old table migrated in background. */
+   std::vector<std::pair<FlowTable, uint64_t>> m_retired; /**< Migrated tables kept until output releases their spare records,
+                                                              paired with value of m_pushed when they can be freed. */
+   uint64_t m_pushed; /**< Number of records pushed to export queue. */
+   std::atomic<uint32_t> m_resize_request; /**< Requested number of records, 0 when none. */
+   uint32_t m_grow; /**< Eviction threshold triggering growth in percents, 0 disables growth. */
+   uint32_t m_max_size;
+   uint32_t m_created; /**< New flows since last growth check. */
+   uint32_t m_evicted; /**< Flows evicted for lack of space since last growth check. */
+
+   /**
+    * \brief Get record stored in slot of flow table.
+    */
+   FlowRecord *get_record(uint32_t slot) const
+   {
+      return m_flow_records + (m_flow_table[slot] ? m_flow_table[slot] - 1 : slot);
+   }
+
+   /**
+    * \brief Store record in slot of flow table.
+    */
+   void set_record(uint32_t slot, FlowRecord *flow)
+   {
+      m_flow_table[slot] = (flow - m_flow_records) + 1;
+   }
+
+   /**
+    * \brief Initialize eviction state of flow stored in slot.
+    * \param [in] slot Slot of flow table.
+    * \param [in] packets Packets of flow.
+    */
+   void init_meta(uint32_t slot, uint64_t packets)
+   {
+      if (m_evict != EvictPolicy::LRU) {
+         m_flow_meta[slot] = m_evict == EvictPolicy::CLOCK ? 0 : std::min<uint64_t>(packets, UINT8_MAX);
+      }
+   }
+
+   /**
+    * \brief Update eviction state of flow stored in slot by another packet.
+    */
+   void update_meta(uint32_t slot)
+   {
+      if (m_evict == EvictPolicy::CLOCK) {
+         m_flow_meta[slot] = 1;
+      } else if (m_evict != EvictPolicy::LRU && m_flow_meta[slot] < UINT8_MAX) {
+         m_flow_meta[slot]++;
+      }
+   }
 
+   void *alloc_mem(size_t &size, bool hugepages);
+   void alloc_table(FlowTable &tab, uint32_t size);
+   void free_table(FlowTable &tab);
+   FlowTable get_table() const;
+   void set_table(const FlowTable &tab);
+   void start_resize(uint32_t size);
+   void resize_step();
+   void migrate_line(uint32_t line);
+   void check_growth();
+   uint32_t select_victim(uint32_t line_index);
+   void evict_flow(uint32_t index);
+   void swap_spare(uint32_t slot);
+   bool select_pkt(Packet &pkt);
+   int insert_pkt(Packet &pkt);
    void flush(Packet &pkt, size_t flow_index, int ret, bool source_flow);
+   void move_record(uint32_t from, uint32_t to);
    bool create_hash_key(Packet &pkt);
    void export_flow(size_t index);
    static uint8_t get_export_reason(Flow &flow);
    void finish();
+   bool save_snapshot();
+   void load_snapshot();
+   bool restore_flow(const FlowCacheSnapshotFlow &snap, const uint8_t *ext, const uint8_t *end,
+      const std::vector<int> &plugin_map, time_t now);
 
 #ifdef FLOW_CACHE_STATS
    void print_report();
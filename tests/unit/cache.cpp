@@ -0,0 +1,751 @@
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "ipfixprobe/ring.h"
+#include "../../input/parser.hpp"
+#include "../../storage/cache.hpp"
+#include "../../process/appid.hpp"
+#include "../../process/basicplus.hpp"
+#include "../../process/bstats.hpp"
+#include "../../process/ovpn.hpp"
+#include "../../process/phists.hpp"
+#include "../../process/pstats.hpp"
+#include "../../process/tls.hpp"
+#include "../../process/wg.hpp"
+
+namespace ipxp_test {
+
+using namespace ipxp;
+
+static const uint8_t payload[64] = {0};
+
+Packet udp_packet(uint32_t src_ip, uint16_t src_port, time_t sec)
+{
+   Packet pkt;
+   pkt.ts.tv_sec = sec;
+   pkt.ip_version = IP::v4;
+   pkt.ip_proto = IPPROTO_UDP;
+   pkt.src_ip.v4 = htonl(src_ip);
+   pkt.dst_ip.v4 = htonl(0xC0000201);
+   pkt.src_port = src_port;
+   pkt.dst_port = 1194;
+   pkt.ip_len = 28 + sizeof(payload);
+   pkt.ip_ttl = 64;
+   pkt.payload = payload;
+   pkt.payload_len = sizeof(payload);
+   pkt.payload_len_wire = sizeof(payload);
+   pkt.packet = payload;
+   pkt.packet_len = sizeof(payload);
+   pkt.packet_len_wire = sizeof(payload);
+   return pkt;
+}
+
+/**
+ * \brief Flow cache exporting to a ring buffer read by the test.
+ */
+class CacheRun
+{
+public:
+   NHTFlowCache cache;
+   ipx_ring_t *queue;
+   std::vector<ProcessPlugin *> plugins;
+
+   CacheRun(const std::string &params, std::vector<ProcessPlugin *> process = {}) : plugins(process)
+   {
+      queue = ipx_ring_init(4096, 0);
+      cache.set_queue(queue);
+      for (auto it : plugins) {
+         it->init("");
+         cache.add_plugin(it);
+      }
+      cache.init(params.c_str());
+      cache.start();
+   }
+
+   ~CacheRun()
+   {
+      cache.close();
+      ipx_ring_destroy(queue);
+      for (auto it : plugins) {
+         delete it;
+      }
+   }
+
+   void put(Packet pkt)
+   {
+      cache.put_pkt(pkt);
+   }
+
+   /**
+    * \brief Export all flows of cache.
+    * \return Exported flows, valid until the cache is closed.
+    */
+   std::vector<Flow *> finish()
+   {
+      std::vector<Flow *> flows;
+      Flow *flow;
+      static_cast<StoragePlugin &>(cache).finish();
+      while ((flow = static_cast<Flow *>(ipx_ring_pop(queue))) != nullptr) {
+         flows.push_back(flow);
+      }
+      return flows;
+   }
+};
+
+TEST(cache, shedPluginPreExport) {
+   std::vector<std::function<ProcessPlugin *()>> factories = {
+      []() { return new APPIDPlugin(); },
+      []() { return new BSTATSPlugin(); },
+      []() { return new OVPNPlugin(); },
+      []() { return new PHISTSPlugin(); },
+      []() { return new PSTATSPlugin(); },
+      []() { return new TLSPlugin(); },
+      []() { return new WGPlugin(); },
+   };
+
+   for (auto &factory : factories) {
+      ProcessPlugin *plugin = factory();
+      SCOPED_TRACE(plugin->get_name());
+      CacheRun run("size=4;line=2", {plugin});
+
+      /* The first flow is created with plugin active, the second one while plugin is shed. */
+      run.put(udp_packet(0x0A000001, 1000, 1));
+      run.cache.set_degradation(1, 1);
+      run.put(udp_packet(0x0A000002, 2000, 1));
+      run.put(udp_packet(0x0A000002, 2000, 2));
+      run.put(udp_packet(0x0A000001, 1000, 2));
+
+      std::vector<Flow *> flows = run.finish();
+      ASSERT_EQ(2U, flows.size());
+      for (auto flow : flows) {
+         bool shed = flow->src_port == 2000;
+         EXPECT_EQ(2U, flow->src_packets);
+         EXPECT_EQ(shed ? FLOW_DEGRADED_DPI : 0, flow->degraded);
+         EXPECT_EQ(shed ? 0U : 1U, flow->plugins_created);
+         if (shed) {
+            EXPECT_EQ(nullptr, flow->m_exts);
+         }
+      }
+   }
+}
+
+/**
+ * \brief Process plugin counting packets it was called with.
+ */
+class CountingPlugin : public ProcessPlugin
+{
+public:
+   bool payload_only;
+   uint32_t packets;
+
+   CountingPlugin(bool payload_only) : payload_only(payload_only), packets(0) {}
+   OptionsParser *get_parser() const { return new OptionsParser("count", "Count packets"); }
+   std::string get_name() const { return "count"; }
+   ProcessPlugin *copy() { return new CountingPlugin(*this); }
+   PluginInterest get_interest() const { return PluginInterest({}, {}, payload_only); }
+   int post_create(Flow &rec, const Packet &pkt) { packets++; return 0; }
+   int post_update(Flow &rec, const Packet &pkt) { packets++; return 0; }
+};
+
+TEST(cache, metaWithoutPayload) {
+   CountingPlugin *dpi = new CountingPlugin(true);
+   CountingPlugin *stats = new CountingPlugin(false);
+   CacheRun run("size=4;line=2", {dpi, stats});
+   PacketBlock block(2);
+   parser_opt_t opt = {&block, false, false, 0};
+
+   /* Slot still holds fields of a packet parsed into the previous block. */
+   block.pkts[0] = udp_packet(0x0A000001, 1000, 1);
+   block.pkts[0].meta = PKT_META_FLOW;
+   ASSERT_TRUE(parse_packet_meta(&opt, nullptr, 0, 0));
+   const Packet &pkt = block.pkts[0];
+   EXPECT_EQ(1, pkt.ts.tv_sec);
+   EXPECT_EQ(1000, pkt.src_port);
+   EXPECT_EQ(sizeof(payload), pkt.packet_len_wire);
+   EXPECT_EQ(0, pkt.ip_ttl);
+   EXPECT_EQ(nullptr, pkt.packet);
+   EXPECT_EQ(nullptr, pkt.payload);
+   EXPECT_EQ(0, pkt.payload_len);
+   EXPECT_EQ(0, pkt.payload_len_wire);
+   EXPECT_EQ(1U, block.cnt);
+   EXPECT_EQ(sizeof(payload), block.bytes);
+
+   /* Plugins inspecting payload skip packets without it. */
+   run.put(block.pkts[0]);
+   run.put(udp_packet(0x0A000001, 1000, 2));
+   std::vector<Flow *> flows = run.finish();
+   ASSERT_EQ(1U, flows.size());
+   EXPECT_EQ(2U, flows[0]->src_packets);
+   EXPECT_EQ(1U, dpi->packets);
+   EXPECT_EQ(2U, stats->packets);
+}
+
+TEST(cache, metaIncomplete) {
+   PacketBlock block(2);
+   parser_opt_t opt = {&block, false, false, DLT_EN10MB};
+   const uint8_t frame[] = {
+      0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 2, 0x08, 0x00,
+      0x45, 0, 0, 28, 0, 0, 0, 0, 64, IPPROTO_UDP, 0, 0, 10, 0, 0, 1, 10, 0, 0, 2,
+      0x03, 0xE8, 0, 53, 0, 8, 0, 0
+   };
+
+   /* Incomplete metadata without packet data is dropped. */
+   block.pkts[0] = udp_packet(0x0A000001, 1000, 1);
+   block.pkts[0].meta = PKT_META_TS | PKT_META_L3;
+   EXPECT_FALSE(parse_packet_meta(&opt, nullptr, 0, 0));
+   EXPECT_EQ(0U, block.cnt);
+
+   /* Otherwise the frame is parsed, stale timestamp of the slot is not used. */
+   block.pkts[0].meta = PKT_META_L3 | PKT_META_L4;
+   time_t now = time(nullptr);
+   ASSERT_TRUE(parse_packet_meta(&opt, frame, sizeof(frame), sizeof(frame)));
+   EXPECT_EQ(1U, block.cnt);
+   EXPECT_GE(block.pkts[0].ts.tv_sec, now);
+   EXPECT_EQ(1000, block.pkts[0].src_port);
+   EXPECT_EQ(53, block.pkts[0].dst_port);
+   EXPECT_EQ(PKT_META_ALL, block.pkts[0].meta);
+
+   block.pkts[1].meta = PKT_META_TS | PKT_META_L3 | PKT_META_L4;
+   block.pkts[1].ts.tv_sec = 5;
+   ASSERT_TRUE(parse_packet_meta(&opt, nullptr, 0, 0));
+   EXPECT_EQ(5, block.pkts[1].ts.tv_sec);
+   EXPECT_FALSE(parse_packet_meta(&opt, frame, sizeof(frame), sizeof(frame)));
+}
+
+/**
+ * \brief Get snapshot file used by the next cache instance created with snapshot.
+ *
+ * Every pipeline has its own cache, instances after the first one of process use numbered files.
+ */
+std::string instance_snapshot(const std::string &path)
+{
+   static uint32_t instances = 0;
+   uint32_t instance = instances++;
+   return instance ? path + "." + std::to_string(instance) : path;
+}
+
+/**
+ * \brief Parsed snapshot file.
+ */
+struct SnapshotContent {
+   size_t file_size;
+   FlowCacheSnapshotHeader hdr;
+   std::vector<std::string> plugins;
+   std::vector<FlowCacheSnapshotFlow> flows;
+   std::vector<std::vector<FlowCacheSnapshotExt>> exts; /**< Extensions of every flow. */
+};
+
+std::vector<uint8_t> read_file(const std::string &file)
+{
+   std::ifstream in(file, std::ios::binary);
+   return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void write_file(const std::string &file, const std::vector<uint8_t> &data)
+{
+   std::ofstream out(file, std::ios::binary | std::ios::trunc);
+   out.write(reinterpret_cast<const char *>(data.data()), data.size());
+}
+
+SnapshotContent read_snapshot(const std::string &file)
+{
+   SnapshotContent content;
+   std::vector<uint8_t> data = read_file(file);
+   const uint8_t *pos = data.data();
+
+   content.file_size = data.size();
+   memset(&content.hdr, 0, sizeof(content.hdr));
+   if (data.size() < sizeof(content.hdr)) {
+      return content;
+   }
+   memcpy(&content.hdr, pos, sizeof(content.hdr));
+   pos += sizeof(content.hdr);
+   for (uint32_t i = 0; i < content.hdr.plugin_cnt; i++) {
+      const FlowCacheSnapshotPlugin *plugin = reinterpret_cast<const FlowCacheSnapshotPlugin *>(pos);
+      content.plugins.push_back(std::string(plugin->name, strnlen(plugin->name, sizeof(plugin->name))));
+      pos += sizeof(*plugin);
+   }
+   for (uint64_t i = 0; i < content.hdr.flow_cnt; i++) {
+      FlowCacheSnapshotFlow flow;
+      memcpy(&flow, pos, sizeof(flow));
+      pos += sizeof(flow);
+      content.flows.push_back(flow);
+      content.exts.emplace_back();
+      for (uint16_t j = 0; j < flow.ext_cnt; j++) {
+         FlowCacheSnapshotExt ext;
+         memcpy(&ext, pos, sizeof(ext));
+         pos += sizeof(ext) + ((ext.size + 7) & ~7);
+         content.exts.back().push_back(ext);
+      }
+   }
+   EXPECT_EQ(data.data() + data.size(), pos);
+   return content;
+}
+
+class Snapshot : public ::testing::Test
+{
+protected:
+   std::string path;
+   std::string params;
+   time_t now;
+
+   void SetUp()
+   {
+      path = ::testing::TempDir() + "ipxp_cache_snapshot";
+      params = "size=4;line=2;inactive=30;active=300;snapshot=" + path;
+      now = time(nullptr);
+   }
+
+   /**
+    * \brief Save flows with given source ports into snapshot.
+    * \return Snapshot file written by cache.
+    */
+   std::string save(const std::vector<uint16_t> &ports, time_t sec)
+   {
+      std::string file = instance_snapshot(path);
+      unlink(file.c_str());
+      CacheRun run(params, {new BASICPLUSPlugin(), new OVPNPlugin()});
+      for (auto port : ports) {
+         run.put(udp_packet(0x0A000001, port, sec));
+      }
+      EXPECT_TRUE(run.finish().empty());
+      return file;
+   }
+
+   /**
+    * \brief Restore snapshot by a new cache instance, which saves its flows again on finish.
+    * \param [in] file Snapshot written by previous instance.
+    * \param [in] plugins Process plugins of new instance.
+    * \param [out] log Messages printed while restoring.
+    * \param [out] exported Flows exported while restoring.
+    * \return Snapshot saved by new instance.
+    */
+   SnapshotContent restore(const std::string &file, std::vector<ProcessPlugin *> plugins, std::string &log,
+      std::vector<uint16_t> *exported = nullptr)
+   {
+      std::string next = instance_snapshot(path);
+      EXPECT_EQ(0, rename(file.c_str(), next.c_str()));
+      {
+         ::testing::internal::CaptureStderr();
+         CacheRun run(params, plugins);
+         log = ::testing::internal::GetCapturedStderr();
+         Flow *flow;
+         while ((flow = static_cast<Flow *>(ipx_ring_pop(run.queue))) != nullptr) {
+            EXPECT_EQ(FLOW_END_INACTIVE, flow->end_reason);
+            if (exported != nullptr) {
+               exported->push_back(flow->src_port);
+            }
+         }
+         EXPECT_TRUE(run.finish().empty());
+      }
+      SnapshotContent content = read_snapshot(next);
+      EXPECT_EQ(0, unlink(next.c_str()));
+      return content;
+   }
+};
+
+TEST_F(Snapshot, roundTrip) {
+   std::string saved = instance_snapshot(path);
+   unlink(saved.c_str());
+   {
+      CacheRun run(params, {new BASICPLUSPlugin(), new OVPNPlugin()});
+      run.put(udp_packet(0x0A000001, 1000, now - 2));
+      run.put(udp_packet(0x0A000001, 1000, now - 1));
+      EXPECT_TRUE(run.finish().empty());
+   }
+   std::string restored = instance_snapshot(path);
+   ASSERT_EQ(0, rename(saved.c_str(), restored.c_str()));
+
+   CacheRun run(params, {new BASICPLUSPlugin(), new OVPNPlugin()});
+   EXPECT_NE(0, access(restored.c_str(), F_OK));
+
+   /* Restored flow is updated, then exported by inactive timeout when the next packet arrives. */
+   run.put(udp_packet(0x0A000001, 1000, now));
+   run.put(udp_packet(0x0A000001, 1000, now + 31));
+   Flow *flow = static_cast<Flow *>(ipx_ring_pop(run.queue));
+   ASSERT_NE(nullptr, flow);
+   EXPECT_EQ(3U, flow->src_packets);
+   EXPECT_EQ(now - 2, flow->time_first.tv_sec);
+   EXPECT_EQ(now, flow->time_last.tv_sec);
+   EXPECT_EQ(1000, flow->src_port);
+   EXPECT_EQ(1U, flow->plugins_created);
+   EXPECT_EQ(1U, flow->plugins_active);
+
+   /* Extension without snapshot support is not restored, its plugin stays inactive. */
+   EXPECT_EQ(nullptr, flow->get_extension(RecordExtOVPN::REGISTERED_ID));
+   RecordExtBASICPLUS *ext = static_cast<RecordExtBASICPLUS *>(flow->get_extension(RecordExtBASICPLUS::REGISTERED_ID));
+   ASSERT_NE(nullptr, ext);
+   EXPECT_EQ(64, ext->ip_ttl[0]);
+
+   /* Flow created by the last packet is saved again on finish. */
+   EXPECT_TRUE(run.finish().empty());
+   EXPECT_EQ(0, unlink(restored.c_str()));
+}
+
+TEST_F(Snapshot, format) {
+   std::string file = save({1, 2, 3}, now - 1);
+   SnapshotContent content = read_snapshot(file);
+   RecordExtBASICPLUS basicplus;
+   uint8_t buffer[FLOW_CACHE_SNAPSHOT_EXT_MAX];
+
+   EXPECT_EQ(0, memcmp(FLOW_CACHE_SNAPSHOT_MAGIC, content.hdr.magic, sizeof(content.hdr.magic)));
+   EXPECT_EQ(static_cast<uint32_t>(FLOW_CACHE_SNAPSHOT_VERSION), content.hdr.version);
+   EXPECT_EQ(sizeof(FlowCacheSnapshotFlow), content.hdr.flow_size);
+   EXPECT_EQ(content.file_size, content.hdr.size);
+   EXPECT_EQ(std::vector<std::string>({"basicplus", "ovpn"}), content.plugins);
+   ASSERT_EQ(3U, content.hdr.flow_cnt);
+
+   std::vector<uint16_t> ports;
+   for (size_t i = 0; i < content.flows.size(); i++) {
+      const FlowCacheSnapshotFlow &flow = content.flows[i];
+      ports.push_back(flow.src_port);
+      EXPECT_EQ(1194, flow.dst_port);
+      EXPECT_EQ(IPPROTO_UDP, flow.ip_proto);
+      EXPECT_EQ(1U, flow.src_packets);
+      EXPECT_EQ(now - 1, flow.time_first.tv_sec);
+      EXPECT_EQ(3U, flow.plugins_active);
+      /* OVPN extension does not support snapshots. */
+      ASSERT_EQ(1U, content.exts[i].size());
+      EXPECT_EQ(0, content.exts[i][0].plugin);
+      EXPECT_EQ(1, content.exts[i][0].version);
+      EXPECT_EQ(static_cast<uint32_t>(basicplus.save_snapshot(buffer, sizeof(buffer))), content.exts[i][0].size);
+   }
+   std::sort(ports.begin(), ports.end());
+   EXPECT_EQ(std::vector<uint16_t>({1, 2, 3}), ports);
+
+   std::string log;
+   content = restore(file, {new BASICPLUSPlugin(), new OVPNPlugin()}, log);
+   EXPECT_EQ("", log);
+   EXPECT_EQ(3U, content.hdr.flow_cnt);
+}
+
+TEST_F(Snapshot, incompatible) {
+   std::string log;
+   std::string file = save({1, 2, 3}, now - 1);
+   std::vector<uint8_t> data = read_file(file);
+   ASSERT_GT(data.size(), sizeof(FlowCacheSnapshotHeader));
+
+   /* Snapshot of other version. */
+   reinterpret_cast<FlowCacheSnapshotHeader *>(data.data())->version++;
+   write_file(file, data);
+   SnapshotContent content = restore(file, {new BASICPLUSPlugin(), new OVPNPlugin()}, log);
+   EXPECT_NE(std::string::npos, log.find("ignoring incompatible snapshot"));
+   EXPECT_EQ(0U, content.hdr.flow_cnt);
+
+   /* File cut without updating header. */
+   reinterpret_cast<FlowCacheSnapshotHeader *>(data.data())->version--;
+   data.resize(data.size() - 8);
+   write_file(file, data);
+   content = restore(file, {new BASICPLUSPlugin(), new OVPNPlugin()}, log);
+   EXPECT_NE(std::string::npos, log.find("ignoring incompatible snapshot"));
+   EXPECT_EQ(0U, content.hdr.flow_cnt);
+
+   /* File shorter than header. */
+   data.resize(sizeof(FlowCacheSnapshotHeader) - 1);
+   write_file(file, data);
+   content = restore(file, {new BASICPLUSPlugin(), new OVPNPlugin()}, log);
+   EXPECT_NE(std::string::npos, log.find("unable to read snapshot"));
+   EXPECT_EQ(0U, content.hdr.flow_cnt);
+}
+
+TEST_F(Snapshot, truncated) {
+   std::string log;
+   std::string file = save({1, 2, 3}, now - 1);
+   std::vector<uint8_t> data = read_file(file);
+   ASSERT_GT(data.size(), sizeof(FlowCacheSnapshotHeader));
+
+   /* The last flow is cut inside its extension. */
+   data.resize(data.size() - 8);
+   reinterpret_cast<FlowCacheSnapshotHeader *>(data.data())->size = data.size();
+   write_file(file, data);
+   SnapshotContent content = restore(file, {new BASICPLUSPlugin(), new OVPNPlugin()}, log);
+   EXPECT_NE(std::string::npos, log.find("is truncated, restored 2 of 3 flows"));
+   EXPECT_EQ(2U, content.hdr.flow_cnt);
+}
+
+TEST_F(Snapshot, timestamps) {
+   std::string log;
+   std::vector<uint16_t> exported;
+
+   /* Flows from the future are dropped. */
+   SnapshotContent content = restore(save({1, 2}, now + 100), {new BASICPLUSPlugin(), new OVPNPlugin()}, log);
+   EXPECT_NE(std::string::npos, log.find("dropped 2 flows with invalid timestamps"));
+   EXPECT_EQ(0U, content.hdr.flow_cnt);
+
+   /* Flows whose inactive timeout elapsed while exporter was down are exported on restore. */
+   content = restore(save({1, 2}, now - 31), {new BASICPLUSPlugin(), new OVPNPlugin()}, log, &exported);
+   EXPECT_EQ("", log);
+   std::sort(exported.begin(), exported.end());
+   EXPECT_EQ(std::vector<uint16_t>({1, 2}), exported);
+   EXPECT_EQ(0U, content.hdr.flow_cnt);
+}
+
+TEST_F(Snapshot, pluginsByName) {
+   std::string log;
+
+   /* Plugins are matched by name, not by position. */
+   SnapshotContent content = restore(save({1}, now - 1), {new OVPNPlugin(), new BASICPLUSPlugin()}, log);
+   ASSERT_EQ(1U, content.hdr.flow_cnt);
+   EXPECT_EQ(std::vector<std::string>({"ovpn", "basicplus"}), content.plugins);
+   ASSERT_EQ(1U, content.exts[0].size());
+   EXPECT_EQ(1, content.exts[0][0].plugin);
+   EXPECT_EQ(2U, content.flows[0].plugins_active);
+
+   /* Extension of plugin missing in configuration is dropped, flow is kept. */
+   content = restore(save({1}, now - 1), {new OVPNPlugin()}, log);
+   ASSERT_EQ(1U, content.hdr.flow_cnt);
+   EXPECT_EQ(0U, content.flows[0].ext_cnt);
+   EXPECT_EQ(0U, content.flows[0].plugins_active);
+}
+
+TEST_F(Snapshot, saveFailure) {
+   /* Flows are exported when snapshot cannot be written. */
+   path = ::testing::TempDir() + "ipxp_missing_dir/snapshot";
+   params = "snapshot=" + path;
+   instance_snapshot(path);
+   CacheRun run(params);
+   run.put(udp_packet(0x0A000001, 1, now));
+
+   ::testing::internal::CaptureStderr();
+   std::vector<Flow *> flows = run.finish();
+   EXPECT_NE(std::string::npos, ::testing::internal::GetCapturedStderr().find("unable to create snapshot"));
+   ASSERT_EQ(1U, flows.size());
+   EXPECT_EQ(FLOW_END_FORCED, flows[0]->end_reason);
+}
+
+/**
+ * \brief Fill single line cache and add two more flows.
+ *
+ * Flows 0-14 have 2 packets and are more recent than flow 15 with 4 packets.
+ * Flow 100 replaces the first victim, flow 101 the second one.
+ * \param [in] policy Eviction policy.
+ * \param [out] stats Eviction statistics printed on finish.
+ * \return Source ports of evicted flows in order of eviction.
+ */
+std::vector<uint16_t> evicted_flows(const std::string &policy, std::string &stats)
+{
+   std::vector<uint16_t> evicted;
+   CacheRun run("size=4;line=4;evict=" + policy);
+
+   for (uint16_t i = 0; i < 16; i++) {
+      run.put(udp_packet(0x0A000001, 1000 + i, 1));
+   }
+   for (int i = 0; i < 3; i++) {
+      run.put(udp_packet(0x0A000001, 1015, 2));
+   }
+   for (uint16_t i = 0; i < 15; i++) {
+      run.put(udp_packet(0x0A000001, 1000 + i, 3));
+   }
+   run.put(udp_packet(0x0A000001, 100, 4));
+   run.put(udp_packet(0x0A000001, 101, 5));
+
+   ::testing::internal::CaptureStderr();
+   std::vector<Flow *> flows = run.finish();
+   stats = ::testing::internal::GetCapturedStderr();
+   EXPECT_EQ(18U, flows.size());
+   for (auto flow : flows) {
+      if (flow->end_reason == FLOW_END_NO_RES) {
+         evicted.push_back(flow->src_port);
+      }
+   }
+   return evicted;
+}
+
+TEST(cache, evictLru) {
+   std::string stats;
+   EXPECT_EQ(std::vector<uint16_t>({1015, 1000}), evicted_flows("lru", stats));
+   EXPECT_EQ("cache: lru policy evicted 2 flows for lack of space, 0 of them single packet, 3 packets per evicted flow\n", stats);
+}
+
+TEST(cache, evictPackets) {
+   /* Least recently used of flows with fewest packets, single packet flow is taken at once. */
+   std::string stats;
+   EXPECT_EQ(std::vector<uint16_t>({1000, 100}), evicted_flows("packets", stats));
+   EXPECT_EQ("cache: packets policy evicted 2 flows for lack of space, 1 of them single packet, 1.5 packets per evicted flow\n", stats);
+}
+
+TEST(cache, evictClock) {
+   /* Hand clears all reference bits on the first pass, then takes the next slot. */
+   std::string stats;
+   EXPECT_EQ(std::vector<uint16_t>({1000, 1001}), evicted_flows("clock", stats));
+   EXPECT_EQ("cache: clock policy evicted 2 flows for lack of space, 0 of them single packet, 2 packets per evicted flow\n", stats);
+}
+
+TEST(cache, evictProbation) {
+   /* Least recently used flow while there is no single packet flow. */
+   std::string stats;
+   EXPECT_EQ(std::vector<uint16_t>({1015, 100}), evicted_flows("probation", stats));
+   EXPECT_EQ("cache: probation policy evicted 2 flows for lack of space, 1 of them single packet, 2.5 packets per evicted flow\n", stats);
+}
+
+TEST(cache, evictPolicyInvalid) {
+   NHTFlowCache cache;
+   ipx_ring_t *queue = ipx_ring_init(16, 0);
+   cache.set_queue(queue);
+   EXPECT_THROW(cache.init("evict=random"), PluginError);
+   ipx_ring_destroy(queue);
+}
+
+/**
+ * \brief Put packets of both directions of flows with source ports [1, flows].
+ * \return Number of flows exported by cache.
+ */
+size_t sample_flows(CacheRun &run, uint16_t flows, uint32_t packets)
+{
+   for (uint16_t port = 1; port <= flows; port++) {
+      for (uint32_t i = 0; i < packets; i++) {
+         Packet pkt = udp_packet(0x0A000001, port, 1);
+         if (i % 2) {
+            std::swap(pkt.src_ip, pkt.dst_ip);
+            std::swap(pkt.src_port, pkt.dst_port);
+         }
+         run.put(pkt);
+      }
+   }
+   return run.finish().size();
+}
+
+TEST(cache, samplingCount) {
+   CacheRun run("sampling=count;interval=4");
+   uint32_t interval;
+   EXPECT_EQ(SamplingMode::COUNT, run.cache.get_sampling(interval));
+   EXPECT_EQ(4U, interval);
+
+   for (int i = 0; i < 102; i++) {
+      run.put(udp_packet(0x0A000001, 1000, 1));
+   }
+   ::testing::internal::CaptureStderr();
+   std::vector<Flow *> flows = run.finish();
+   EXPECT_EQ("cache: sampling selected 25 of 102 packets\n", ::testing::internal::GetCapturedStderr());
+   ASSERT_EQ(1U, flows.size());
+   EXPECT_EQ(25U, flows[0]->src_packets);
+}
+
+TEST(cache, samplingInterval) {
+   uint32_t interval;
+   {
+      /* Interval alone selects count sampling. */
+      CacheRun run("interval=3");
+      EXPECT_EQ(SamplingMode::COUNT, run.cache.get_sampling(interval));
+      EXPECT_EQ(3U, interval);
+   }
+   {
+      /* Interval 1 selects every packet, sampling is off. */
+      CacheRun run("sampling=random;interval=1");
+      EXPECT_EQ(SamplingMode::NONE, run.cache.get_sampling(interval));
+      EXPECT_EQ(10U, sample_flows(run, 10, 1));
+   }
+
+   NHTFlowCache cache;
+   ipx_ring_t *queue = ipx_ring_init(16, 0);
+   cache.set_queue(queue);
+   EXPECT_THROW(cache.init("interval=0"), PluginError);
+   EXPECT_THROW(cache.init("sampling=bernoulli"), PluginError);
+   ipx_ring_destroy(queue);
+}
+
+TEST(cache, samplingRandom) {
+   CacheRun run("size=16;sampling=random;interval=4");
+
+   /* 1000 single packet flows, about a quarter of them is selected. */
+   size_t selected = sample_flows(run, 1000, 1);
+   EXPECT_GT(selected, 150U);
+   EXPECT_LT(selected, 350U);
+}
+
+TEST(cache, samplingFlow) {
+   CacheRun forward("size=16;sampling=flow;interval=4");
+   CacheRun reverse("size=16;sampling=flow;interval=4");
+
+   /* Decision depends on flow key only, so another cache selects the same flows in the other direction. */
+   for (uint16_t port = 1; port <= 1000; port++) {
+      Packet pkt = udp_packet(0x0A000001, port, 1);
+      forward.put(pkt);
+      std::swap(pkt.src_ip, pkt.dst_ip);
+      std::swap(pkt.src_port, pkt.dst_port);
+      reverse.put(pkt);
+   }
+   std::vector<Flow *> flows = forward.finish();
+   std::vector<Flow *> reverse_flows = reverse.finish();
+   EXPECT_GT(flows.size(), 150U);
+   EXPECT_LT(flows.size(), 350U);
+
+   std::vector<uint16_t> ports;
+   std::vector<uint16_t> reverse_ports;
+   for (auto flow : flows) {
+      ports.push_back(flow->src_port);
+   }
+   for (auto flow : reverse_flows) {
+      reverse_ports.push_back(flow->dst_port);
+   }
+   std::sort(ports.begin(), ports.end());
+   std::sort(reverse_ports.begin(), reverse_ports.end());
+   EXPECT_EQ(ports, reverse_ports);
+}
+
+TEST(cache, samplingBiflow) {
+   CacheRun run("size=16;sampling=flow;interval=4");
+
+   for (uint16_t port = 1; port <= 1000; port++) {
+      for (int i = 0; i < 4; i++) {
+         Packet pkt = udp_packet(0x0A000001, port, 1);
+         if (i % 2) {
+            std::swap(pkt.src_ip, pkt.dst_ip);
+            std::swap(pkt.src_port, pkt.dst_port);
+         }
+         run.put(pkt);
+      }
+   }
+   std::vector<Flow *> flows = run.finish();
+   EXPECT_GT(flows.size(), 150U);
+   for (auto flow : flows) {
+      EXPECT_EQ(2U, flow->src_packets);
+      EXPECT_EQ(2U, flow->dst_packets);
+   }
+}
+
+TEST(cache, samplingOverload) {
+   uint32_t interval;
+   {
+      CacheRun run("");
+      run.cache.set_degradation(0, 2);
+      EXPECT_EQ(SamplingMode::COUNT, run.cache.get_sampling(interval));
+      EXPECT_EQ(2U, interval);
+      for (int i = 0; i < 10; i++) {
+         run.put(udp_packet(0x0A000001, 1000, 1));
+      }
+      run.cache.set_degradation(0, 1);
+      EXPECT_EQ(SamplingMode::NONE, run.cache.get_sampling(interval));
+      for (int i = 0; i < 10; i++) {
+         run.put(udp_packet(0x0A000001, 1000, 1));
+      }
+      std::vector<Flow *> flows = run.finish();
+      ASSERT_EQ(1U, flows.size());
+      EXPECT_EQ(15U, flows[0]->src_packets);
+      EXPECT_EQ(FLOW_DEGRADED_SAMPLED, flows[0]->degraded);
+   }
+   {
+      /* Sampling configured by options is not changed. */
+      CacheRun run("sampling=random;interval=8");
+      run.cache.set_degradation(0, 2);
+      EXPECT_EQ(SamplingMode::RANDOM, run.cache.get_sampling(interval));
+      EXPECT_EQ(8U, interval);
+   }
+}
+
+}
+
+int main(int argc, char **argv)
+{
+   // invoking the tests
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,155 @@
+#include <memory>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "../../process/dns-parser.hpp"
+
+namespace ipxp_test {
+
+using namespace ipxp;
+
+/* Query of www.example.com A, id 0x1234, recursion desired. */
+static const std::vector<uint8_t> query = {
+   0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+   0x03, 'w', 'w', 'w', 0x07, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0x03, 'c', 'o', 'm', 0x00,
+   0x00, 0x01, 0x00, 0x01
+};
+
+/* Response with answer, authority and additional record, names compressed to the question. */
+static const std::vector<uint8_t> response = {
+   0x12, 0x34, 0x81, 0x80, 0x00, 0x01, 0x00, 0x01, 0x00, 0x01, 0x00, 0x01,
+   0x03, 'w', 'w', 'w', 0x07, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0x03, 'c', 'o', 'm', 0x00,
+   0x00, 0x01, 0x00, 0x01,
+   /* www.example.com A 300 93.184.216.34 */
+   0xC0, 0x0C, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x01, 0x2C, 0x00, 0x04, 93, 184, 216, 34,
+   /* example.com NS 3600 ns.example.com */
+   0xC0, 0x10, 0x00, 0x02, 0x00, 0x01, 0x00, 0x00, 0x0E, 0x10, 0x00, 0x05, 0x02, 'n', 's', 0xC0, 0x10,
+   /* ns.example.com A 3600 192.0.2.53 */
+   0xC0, 0x3D, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x0E, 0x10, 0x00, 0x04, 192, 0, 2, 53
+};
+
+class DnsParser : public ::testing::Test
+{
+protected:
+   std::unique_ptr<DnsMessage> msg;
+
+   void SetUp()
+   {
+      msg.reset(new DnsMessage());
+   }
+
+   DnsStatus parse(const std::vector<uint8_t> &data, bool tcp = false)
+   {
+      return msg->parse(data.data(), data.size(), tcp);
+   }
+};
+
+TEST_F(DnsParser, query) {
+   ASSERT_EQ(DNS_MSG_OK, parse(query));
+   EXPECT_EQ(0x1234, msg->id);
+   EXPECT_EQ(0x0100, msg->flags);
+   EXPECT_EQ(1, msg->question_cnt);
+   ASSERT_EQ(1, msg->questions_parsed);
+   EXPECT_STREQ("www.example.com", msg->name(msg->questions[0].name));
+   EXPECT_EQ(15, msg->questions[0].name.length);
+   EXPECT_EQ(1, msg->questions[0].qtype);
+   EXPECT_EQ(1, msg->questions[0].qclass);
+   EXPECT_EQ(0, msg->rrs_parsed);
+}
+
+TEST_F(DnsParser, responseSections) {
+   ASSERT_EQ(DNS_MSG_OK, parse(response));
+   ASSERT_EQ(3, msg->rrs_parsed);
+
+   const DnsRr &answer = msg->rrs[0];
+   EXPECT_EQ(DNS_SECTION_ANSWER, answer.section);
+   EXPECT_STREQ("www.example.com", msg->name(answer.name));
+   EXPECT_EQ(1, answer.type);
+   EXPECT_EQ(300U, answer.ttl);
+   ASSERT_EQ(4, answer.rdlength);
+   EXPECT_EQ(std::vector<uint8_t>({93, 184, 216, 34}),
+      std::vector<uint8_t>(msg->data + answer.rdata, msg->data + answer.rdata + 4));
+   EXPECT_TRUE(msg->rdata_has(answer, 0, 4));
+   EXPECT_FALSE(msg->rdata_has(answer, 1, 4));
+
+   const DnsRr &authority = msg->rrs[1];
+   EXPECT_EQ(DNS_SECTION_AUTHORITY, authority.section);
+   EXPECT_STREQ("example.com", msg->name(authority.name));
+   EXPECT_EQ(2, authority.type);
+   EXPECT_EQ(3600U, authority.ttl);
+   char ns[DNS_MAX_NAME_LEN + 1];
+   uint32_t next;
+   EXPECT_EQ(14, msg->decode_name(authority.rdata, ns, sizeof(ns), &next));
+   EXPECT_STREQ("ns.example.com", ns);
+   EXPECT_EQ(authority.rdata + authority.rdlength, next);
+
+   const DnsRr &additional = msg->rrs[2];
+   EXPECT_EQ(DNS_SECTION_ADDITIONAL, additional.section);
+   EXPECT_STREQ("ns.example.com", msg->name(additional.name));
+}
+
+TEST_F(DnsParser, tcpLengthPrefix) {
+   std::vector<uint8_t> tcp = {0x00, static_cast<uint8_t>(query.size())};
+   tcp.insert(tcp.end(), query.begin(), query.end());
+   ASSERT_EQ(DNS_MSG_OK, parse(tcp, true));
+   EXPECT_STREQ("www.example.com", msg->name(msg->questions[0].name));
+
+   /* Message split to more segments is not decoded. */
+   tcp[1]++;
+   EXPECT_EQ(DNS_MSG_INVALID, parse(tcp, true));
+   EXPECT_EQ(DNS_MSG_INVALID, parse(query, true));
+}
+
+TEST_F(DnsParser, invalid) {
+   EXPECT_EQ(DNS_MSG_INVALID, parse(std::vector<uint8_t>(query.begin(), query.begin() + 11)));
+   EXPECT_EQ(DNS_MSG_INVALID, msg->status);
+}
+
+TEST_F(DnsParser, truncated) {
+   /* Answer record is cut in the middle of its RDATA. */
+   std::vector<uint8_t> data(response.begin(), response.begin() + 47);
+   ASSERT_EQ(DNS_MSG_TRUNCATED, parse(data));
+   EXPECT_EQ(1, msg->questions_parsed);
+   EXPECT_EQ(0, msg->rrs_parsed);
+
+   /* Records before the cut are kept. */
+   data.assign(response.begin(), response.begin() + 60);
+   ASSERT_EQ(DNS_MSG_TRUNCATED, parse(data));
+   EXPECT_EQ(1, msg->rrs_parsed);
+}
+
+TEST_F(DnsParser, malformedNames) {
+   /* Pointer to itself never terminates. */
+   std::vector<uint8_t> loop(query.begin(), query.begin() + 12);
+   loop.insert(loop.end(), {0xC0, 0x0C, 0x00, 0x01, 0x00, 0x01});
+   EXPECT_EQ(DNS_MSG_MALFORMED, parse(loop));
+   EXPECT_EQ(0, msg->questions_parsed);
+
+   /* Label longer than 63 bytes. */
+   std::vector<uint8_t> label(query);
+   label[12] = 0x40;
+   EXPECT_EQ(DNS_MSG_MALFORMED, parse(label));
+
+   /* Pointer past the end of message. */
+   std::vector<uint8_t> pointer(query.begin(), query.begin() + 12);
+   pointer.insert(pointer.end(), {0xC0, 0xFF, 0x00, 0x01, 0x00, 0x01});
+   EXPECT_EQ(DNS_MSG_MALFORMED, parse(pointer));
+}
+
+TEST_F(DnsParser, decodeNameTruncation) {
+   ASSERT_EQ(DNS_MSG_OK, parse(query));
+   char out[8];
+   EXPECT_EQ(7, msg->decode_name(12, out, sizeof(out)));
+   EXPECT_STREQ("www.exa", out);
+   EXPECT_GE(msg->decode_name(12, nullptr, 0), 0);
+   EXPECT_EQ(-1, msg->decode_name(query.size(), out, sizeof(out)));
+}
+
+}
+
+int main(int argc, char **argv)
+{
+   // invoking the tests
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,245 @@
+#include <cstring>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include "gtest/gtest.h"
+
+#include "../../export-filter.hpp"
+#include "../../process/basicplus.hpp"
+#include "../../process/tls.hpp"
+
+namespace ipxp_test {
+
+using namespace ipxp;
+
+/**
+ * \brief Flow between 10.1.2.3:50000 and 192.0.2.1:PORT, 3 + 2 packets lasting 1.5 seconds.
+ */
+Flow flow_v4(uint8_t proto, uint16_t dst_port)
+{
+   Flow flow{};
+   flow.ip_version = IP::v4;
+   flow.ip_proto = proto;
+   inet_pton(AF_INET, "10.1.2.3", &flow.src_ip.v4);
+   inet_pton(AF_INET, "192.0.2.1", &flow.dst_ip.v4);
+   flow.src_port = 50000;
+   flow.dst_port = dst_port;
+   flow.src_packets = 3;
+   flow.dst_packets = 2;
+   flow.src_bytes = 300;
+   flow.dst_bytes = 1200;
+   flow.src_tcp_flags = 0x02;
+   flow.dst_tcp_flags = 0x12;
+   flow.time_first.tv_sec = 10;
+   flow.time_first.tv_usec = 700000;
+   flow.time_last.tv_sec = 12;
+   flow.time_last.tv_usec = 200000;
+   flow.end_reason = FLOW_END_INACTIVE;
+   return flow;
+}
+
+Flow flow_v6(const char *src, const char *dst)
+{
+   Flow flow = flow_v4(IPPROTO_TCP, 443);
+   flow.ip_version = IP::v6;
+   inet_pton(AF_INET6, src, flow.src_ip.v6);
+   inet_pton(AF_INET6, dst, flow.dst_ip.v6);
+   return flow;
+}
+
+class ExportFilterTest : public ::testing::Test
+{
+protected:
+   TLSPlugin tls;
+   BASICPLUSPlugin basicplus;
+   OutputPlugin::Plugins plugins;
+
+   void SetUp()
+   {
+      plugins = {{"tls", &tls}, {"basicplus", &basicplus}};
+   }
+
+   /**
+    * \brief Evaluate single rule on flow.
+    * \return True when rule matches.
+    */
+   bool matches(const std::string &expr, Flow flow)
+   {
+      ExportFilter filter({"drop if " + expr}, plugins);
+      return !filter.apply(flow);
+   }
+
+   std::string stats(const ExportFilter &filter)
+   {
+      ::testing::internal::CaptureStderr();
+      filter.print_stats();
+      return ::testing::internal::GetCapturedStderr();
+   }
+};
+
+TEST_F(ExportFilterTest, noRules) {
+   ExportFilter filter({}, plugins);
+   Flow flow = flow_v4(IPPROTO_UDP, 53);
+   EXPECT_TRUE(filter.apply(flow));
+   EXPECT_EQ("export filter: dropped 0 of 1 flows, stripped 0 extensions (0 instructions)\n", stats(filter));
+}
+
+TEST_F(ExportFilterTest, comparisons) {
+   Flow flow = flow_v4(IPPROTO_TCP, 443);
+   EXPECT_TRUE(matches("proto == 6", flow));
+   EXPECT_FALSE(matches("proto != 6", flow));
+   EXPECT_TRUE(matches("ip_version == 4", flow));
+   EXPECT_TRUE(matches("packets == 5", flow));
+   EXPECT_TRUE(matches("packets > 4", flow));
+   EXPECT_FALSE(matches("packets > 5", flow));
+   EXPECT_TRUE(matches("packets >= 5", flow));
+   EXPECT_FALSE(matches("packets < 5", flow));
+   EXPECT_TRUE(matches("packets <= 5", flow));
+   EXPECT_TRUE(matches("src_packets == 3", flow));
+   EXPECT_TRUE(matches("dst_packets == 2", flow));
+   EXPECT_TRUE(matches("bytes == 1500", flow));
+   EXPECT_TRUE(matches("src_bytes < 301", flow));
+   EXPECT_TRUE(matches("dst_bytes >= 1200", flow));
+   EXPECT_TRUE(matches("src_port == 50000", flow));
+   EXPECT_TRUE(matches("end_reason == 1", flow));
+   /* Duration is in milliseconds. */
+   EXPECT_TRUE(matches("duration == 1500", flow));
+   EXPECT_TRUE(matches("packets == 0x5", flow));
+}
+
+TEST_F(ExportFilterTest, tcpFlags) {
+   Flow flow = flow_v4(IPPROTO_TCP, 443);
+   EXPECT_TRUE(matches("tcp_flags & 0x10", flow));
+   EXPECT_FALSE(matches("src_tcp_flags & 0x10", flow));
+   EXPECT_TRUE(matches("dst_tcp_flags & 0x10", flow));
+   EXPECT_FALSE(matches("tcp_flags & 0x05", flow));
+   EXPECT_TRUE(matches("tcp_flags == 0x12", flow));
+}
+
+TEST_F(ExportFilterTest, bothDirections) {
+   Flow flow = flow_v4(IPPROTO_UDP, 53);
+   EXPECT_TRUE(matches("port == 53", flow));
+   EXPECT_TRUE(matches("port == 50000", flow));
+   EXPECT_FALSE(matches("port == 80", flow));
+   /* Negation holds only when neither direction matches. */
+   EXPECT_FALSE(matches("port != 53", flow));
+   EXPECT_TRUE(matches("port != 80", flow));
+   /* Ordering holds when either direction holds too. */
+   EXPECT_TRUE(matches("port < 1024", flow));
+   EXPECT_TRUE(matches("port <= 53", flow));
+   EXPECT_FALSE(matches("port < 53", flow));
+   EXPECT_TRUE(matches("port > 1024", flow));
+   EXPECT_TRUE(matches("ip == 192.0.2.1", flow));
+   EXPECT_FALSE(matches("ip != 10.0.0.0/8", flow));
+}
+
+TEST_F(ExportFilterTest, networks) {
+   Flow flow = flow_v4(IPPROTO_UDP, 53);
+   EXPECT_TRUE(matches("src_ip == 10.0.0.0/8", flow));
+   EXPECT_TRUE(matches("src_ip == 10.1.2.3", flow));
+   EXPECT_FALSE(matches("src_ip == 10.1.2.4", flow));
+   /* Prefix not aligned to byte. */
+   EXPECT_TRUE(matches("src_ip == 10.0.0.0/15", flow));
+   EXPECT_FALSE(matches("src_ip == 10.2.0.0/15", flow));
+   EXPECT_FALSE(matches("src_ip == 10.0.0.0/16", flow));
+   EXPECT_TRUE(matches("dst_ip == 192.0.2.0/24", flow));
+   EXPECT_TRUE(matches("dst_ip == 0.0.0.0/0", flow));
+   EXPECT_FALSE(matches("dst_ip == ::/0", flow));
+
+   Flow flow6 = flow_v6("2001:db8::1", "2001:db8:ffff::2");
+   EXPECT_TRUE(matches("src_ip == 2001:db8::/32", flow6));
+   EXPECT_TRUE(matches("dst_ip == 2001:db8:ff00::/40", flow6));
+   EXPECT_FALSE(matches("dst_ip == 2001:db8:fe00::/40", flow6));
+   EXPECT_TRUE(matches("ip == 2001:db8::1", flow6));
+   EXPECT_FALSE(matches("ip == 10.0.0.0/8", flow6));
+}
+
+TEST_F(ExportFilterTest, precedence) {
+   Flow flow = flow_v4(IPPROTO_UDP, 53);
+   /* and binds tighter than or. */
+   EXPECT_TRUE(matches("proto == 17 or proto == 6 and port == 80", flow));
+   EXPECT_FALSE(matches("(proto == 17 or proto == 6) and port == 80", flow));
+   EXPECT_TRUE(matches("not proto == 6 and not (port == 80 or port == 443)", flow));
+   EXPECT_FALSE(matches("not not proto == 6", flow));
+}
+
+TEST_F(ExportFilterTest, firstMatchingRule) {
+   ExportFilter filter({"keep if port == 443", "drop if proto == 6", "drop if packets < 2"}, plugins);
+   Flow https = flow_v4(IPPROTO_TCP, 443);
+   Flow http = flow_v4(IPPROTO_TCP, 80);
+   Flow dns = flow_v4(IPPROTO_UDP, 53);
+   Flow single = flow_v4(IPPROTO_UDP, 53);
+   single.src_packets = 1;
+   single.dst_packets = 0;
+
+   EXPECT_TRUE(filter.apply(https));
+   EXPECT_FALSE(filter.apply(http));
+   EXPECT_TRUE(filter.apply(dns));
+   EXPECT_FALSE(filter.apply(single));
+   /* port expands to two tests. */
+   EXPECT_EQ("export filter: dropped 2 of 4 flows, stripped 0 extensions (4 instructions)\n", stats(filter));
+}
+
+TEST_F(ExportFilterTest, extensions) {
+   ExportFilter filter({"keep if tls contains \"example.com\" strip basicplus", "drop if has tls", "keep strip tls,basicplus"}, plugins);
+
+   Flow sni = flow_v4(IPPROTO_TCP, 443);
+   RecordExtTLS *ext = new RecordExtTLS();
+   strcpy(ext->sni, "www.example.com");
+   sni.add_extension(ext);
+   sni.add_extension(new RecordExtBASICPLUS());
+   EXPECT_TRUE(filter.apply(sni));
+   EXPECT_NE(nullptr, sni.get_extension(RecordExtTLS::REGISTERED_ID));
+   EXPECT_EQ(nullptr, sni.get_extension(RecordExtBASICPLUS::REGISTERED_ID));
+
+   Flow other = flow_v4(IPPROTO_TCP, 443);
+   ext = new RecordExtTLS();
+   strcpy(ext->sni, "example.org");
+   other.add_extension(ext);
+   EXPECT_FALSE(filter.apply(other));
+
+   /* Stripping extension which the flow does not have is not counted. */
+   Flow plain = flow_v4(IPPROTO_TCP, 80);
+   plain.add_extension(new RecordExtBASICPLUS());
+   EXPECT_TRUE(filter.apply(plain));
+   EXPECT_EQ(nullptr, plain.m_exts);
+   EXPECT_EQ("export filter: dropped 1 of 3 flows, stripped 2 extensions (2 instructions)\n", stats(filter));
+}
+
+TEST_F(ExportFilterTest, invalidRules) {
+   std::vector<std::string> rules = {
+      "",
+      "pass",
+      "drop if",
+      "drop if proto",
+      "drop if foo == 1",
+      "drop if proto ~ 1",
+      "drop if proto == abc",
+      "drop if proto == 1 proto == 2",
+      "drop if (proto == 1",
+      "drop if src_ip > 10.0.0.1",
+      "drop if src_ip == 10.0.0.256",
+      "drop if src_ip == 10.0.0.0/33",
+      "drop if dst_ip == ::/129",
+      "drop if has",
+      "drop if has http",
+      "drop if tls contains example",
+      "drop if tls contains \"example",
+      "drop strip tls",
+      "keep strip",
+      "keep strip dns",
+   };
+
+   for (const auto &rule : rules) {
+      EXPECT_THROW(ExportFilter({rule}, plugins), PluginError) << rule;
+   }
+}
+
+}
+
+int main(int argc, char **argv)
+{
+   // invoking the tests
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
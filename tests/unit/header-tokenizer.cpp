@@ -0,0 +1,191 @@
+#include <cstring>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "../../process/header-tokenizer.hpp"
+
+namespace ipxp_test {
+
+using namespace ipxp;
+
+/**
+ * \brief Tokenize whole data.
+ * \return Lines as strings, unterminated line is prefixed with '!'.
+ */
+std::vector<std::string> tokenize(const std::string &data, bool crlf)
+{
+   std::vector<std::string> lines;
+   HeaderTokenizer tokenizer(data.data(), data.size(), crlf);
+   HeaderLine line;
+
+   while (tokenizer.next(line)) {
+      lines.push_back((line.terminated ? "" : "!") + std::string(line.begin, line.end));
+   }
+   EXPECT_EQ(data.data() + data.size(), tokenizer.position());
+   return lines;
+}
+
+TEST(headerTokenizer, httpLines) {
+   std::string data = "Host: example.com\r\nUser-Agent:\tcurl/8.0\r\nX-Empty:\r\n\r\nbody";
+   HeaderTokenizer tokenizer(data.data(), data.size(), true);
+   HeaderLine line;
+
+   ASSERT_TRUE(tokenizer.next(line));
+   EXPECT_EQ(std::string("Host: example.com\r"), std::string(line.begin, line.end));
+   ASSERT_EQ(data.data() + 4, line.colon);
+   EXPECT_EQ(std::string("example.com\r"), std::string(line.value(), line.end));
+   EXPECT_FALSE(line.blank());
+
+   ASSERT_TRUE(tokenizer.next(line));
+   EXPECT_EQ(std::string("curl/8.0\r"), std::string(line.value(), line.end));
+
+   ASSERT_TRUE(tokenizer.next(line));
+   EXPECT_EQ(std::string("\r"), std::string(line.value(), line.end));
+
+   ASSERT_TRUE(tokenizer.next(line));
+   EXPECT_TRUE(line.blank());
+   EXPECT_EQ(nullptr, line.colon);
+   EXPECT_EQ(std::string("body"), std::string(tokenizer.position()));
+
+   ASSERT_TRUE(tokenizer.next(line));
+   EXPECT_FALSE(line.terminated);
+   EXPECT_FALSE(line.blank());
+   EXPECT_FALSE(tokenizer.next(line));
+}
+
+TEST(headerTokenizer, lineDelimiters) {
+   /* Bare LF does not end the line in CRLF mode, colon of the whole line is kept. */
+   EXPECT_EQ(std::vector<std::string>({"a\nb: c\r", "!d\n"}), tokenize("a\nb: c\r\nd\n", true));
+   EXPECT_EQ(std::vector<std::string>({"a", "b: c\r", "d"}), tokenize("a\nb: c\r\nd\n", false));
+   EXPECT_EQ(std::vector<std::string>({"a: b\r", "!c: d"}), tokenize("a: b\r\nc: d", true));
+   EXPECT_EQ(std::vector<std::string>({"", "\r"}), tokenize("\n\r\n", false));
+   EXPECT_TRUE(tokenize("", true).empty());
+
+   std::string data = "a\nb: c\r\n";
+   HeaderTokenizer tokenizer(data.data(), data.size(), true);
+   HeaderLine line;
+   ASSERT_TRUE(tokenizer.next(line));
+   EXPECT_EQ(data.data() + 3, line.colon);
+}
+
+TEST(headerTokenizer, blankLine) {
+   HeaderLine line;
+   const char *data = "\r\n";
+
+   line = {data, data + 1, nullptr, true};
+   EXPECT_TRUE(line.blank());
+   line = {data + 1, data + 1, nullptr, true};
+   EXPECT_TRUE(line.blank());
+   line = {data, data + 1, nullptr, false};
+   EXPECT_FALSE(line.blank());
+}
+
+/**
+ * \brief Reference of header_find_line() processing one byte at a time.
+ */
+const char *find_line(const char *begin, const char *end, const char **colon)
+{
+   *colon = nullptr;
+   for (const char *p = begin; p < end; p++) {
+      if (*p == '\n') {
+         return p;
+      }
+      if (*p == ':' && *colon == nullptr) {
+         *colon = p;
+      }
+   }
+   return nullptr;
+}
+
+TEST(headerTokenizer, findLineBlocks) {
+   /* Delimiters at every position around 16 and 32 byte block boundaries. */
+   for (size_t len = 0; len <= 80; len++) {
+      for (size_t nl = 0; nl <= len; nl++) {
+         for (size_t colon = 0; colon <= len; colon += 3) {
+            std::string data(len, 'x');
+            if (colon < len) {
+               data[colon] = ':';
+            }
+            if (nl < len) {
+               data[nl] = '\n';
+            }
+            const char *expected_colon;
+            const char *found_colon;
+            const char *expected = find_line(data.data(), data.data() + len, &expected_colon);
+            const char *found = header_find_line(data.data(), data.data() + len, &found_colon);
+            ASSERT_EQ(expected, found) << "len " << len << " nl " << nl << " colon " << colon;
+            ASSERT_EQ(expected_colon, found_colon) << "len " << len << " nl " << nl << " colon " << colon;
+         }
+      }
+   }
+}
+
+TEST(headerTokenizer, findLineColonAfterDelimiter) {
+   /* Colons after the first line delimiter in the same block are ignored. */
+   std::string data = std::string(20, 'x') + "\n" + std::string(20, ':') + std::string(40, 'y');
+   const char *colon;
+   EXPECT_EQ(data.data() + 20, header_find_line(data.data(), data.data() + data.size(), &colon));
+   EXPECT_EQ(nullptr, colon);
+
+   /* Colon of the first block is kept when the delimiter is in a later block. */
+   data = "a:" + std::string(70, 'x') + "\n";
+   EXPECT_EQ(data.data() + 72, header_find_line(data.data(), data.data() + data.size(), &colon));
+   EXPECT_EQ(data.data() + 1, colon);
+}
+
+TEST(headerTokenizer, fieldLookup) {
+   struct {
+      const char *name;
+      HeaderField field;
+   } names[] = {
+      { "Host",         HeaderField::HOST },
+      { "User-Agent",   HeaderField::USER_AGENT },
+      { "Referer",      HeaderField::REFERER },
+      { "Content-Type", HeaderField::CONTENT_TYPE },
+      { "Server",       HeaderField::SERVER },
+      { "From",         HeaderField::FROM },
+      { "f",            HeaderField::FROM },
+      { "To",           HeaderField::TO },
+      { "t",            HeaderField::TO },
+      { "Via",          HeaderField::VIA },
+      { "v",            HeaderField::VIA },
+      { "Call-ID",      HeaderField::CALL_ID },
+      { "i",            HeaderField::CALL_ID },
+      { "CSeq",         HeaderField::CSEQ },
+   };
+
+   for (const auto &it : names) {
+      EXPECT_EQ(it.field, header_field_lookup(it.name, strlen(it.name), false)) << it.name;
+      EXPECT_EQ(it.field, header_field_lookup(it.name, strlen(it.name), true)) << it.name;
+   }
+}
+
+TEST(headerTokenizer, fieldLookupCase) {
+   EXPECT_EQ(HeaderField::UNKNOWN, header_field_lookup("host", 4, false));
+   EXPECT_EQ(HeaderField::HOST, header_field_lookup("host", 4, true));
+   EXPECT_EQ(HeaderField::CALL_ID, header_field_lookup("CALL-id", 7, true));
+   EXPECT_EQ(HeaderField::FROM, header_field_lookup("F", 1, true));
+   EXPECT_EQ(HeaderField::UNKNOWN, header_field_lookup("F", 1, false));
+}
+
+TEST(headerTokenizer, fieldLookupUnknown) {
+   /* Same length, first and last character as a known name share its hash slot. */
+   EXPECT_EQ(HeaderField::UNKNOWN, header_field_lookup("Hxxt", 4, false));
+   EXPECT_EQ(HeaderField::UNKNOWN, header_field_lookup("Hxxt", 4, true));
+   EXPECT_EQ(HeaderField::UNKNOWN, header_field_lookup("Hos", 3, true));
+   EXPECT_EQ(HeaderField::UNKNOWN, header_field_lookup("Accept", 6, true));
+   EXPECT_EQ(HeaderField::UNKNOWN, header_field_lookup("x", 1, true));
+   EXPECT_EQ(HeaderField::UNKNOWN, header_field_lookup("Host", 0, true));
+   /* Name is compared up to the given length only. */
+   EXPECT_EQ(HeaderField::HOST, header_field_lookup("Host: example.com", 4, false));
+}
+
+}
+
+int main(int argc, char **argv)
+{
+   // invoking the tests
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,374 @@
+#include <cstring>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "../../process/sha256.hpp"
+#include "../../process/tls.hpp"
+
+namespace ipxp_test {
+
+using namespace ipxp;
+
+/*
+ * ClientHello to example.com with GREASE cipher, extension and supported version,
+ * ALPN h2 and http/1.1, TLS 1.3 offered by supported_versions.
+ */
+static const std::vector<uint8_t> client_hello = {
+   0x16, 0x03, 0x01, 0x00, 0x88, 0x01, 0x00, 0x00, 0x84, 0x03, 0x03, 0x00, 0x01, 0x02, 0x03, 0x04,
+   0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14,
+   0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x00, 0x00, 0x0a, 0x0a, 0x0a,
+   0x13, 0x01, 0x13, 0x02, 0xc0, 0x2b, 0x00, 0x2f, 0x01, 0x00, 0x00, 0x51, 0x1a, 0x1a, 0x00, 0x00,
+   0x00, 0x00, 0x00, 0x10, 0x00, 0x0e, 0x00, 0x00, 0x0b, 0x65, 0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65,
+   0x2e, 0x63, 0x6f, 0x6d, 0x00, 0x0a, 0x00, 0x06, 0x00, 0x04, 0x00, 0x1d, 0x00, 0x17, 0x00, 0x0b,
+   0x00, 0x02, 0x01, 0x00, 0x00, 0x0d, 0x00, 0x08, 0x00, 0x06, 0x04, 0x03, 0x08, 0x04, 0x04, 0x01,
+   0x00, 0x10, 0x00, 0x0e, 0x00, 0x0c, 0x02, 0x68, 0x32, 0x08, 0x68, 0x74, 0x74, 0x70, 0x2f, 0x31,
+   0x2e, 0x31, 0x00, 0x2b, 0x00, 0x07, 0x06, 0x3a, 0x3a, 0x03, 0x04, 0x03, 0x03
+};
+
+/* ServerHello selecting TLS 1.3 by supported_versions, without ALPN. */
+static const std::vector<uint8_t> server_hello = {
+   0x16, 0x03, 0x03, 0x00, 0x32, 0x02, 0x00, 0x00, 0x2e, 0x03, 0x03, 0x20, 0x21, 0x22, 0x23, 0x24,
+   0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0x34,
+   0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x3e, 0x3f, 0x00, 0x13, 0x01, 0x00, 0x00,
+   0x06, 0x00, 0x2b, 0x00, 0x02, 0x03, 0x04
+};
+
+/* MD5 of "771,4865-4866-49195-47,0-10-11-13-16-43,29-23,0" */
+static const char *client_hello_ja3 = "85dfd04b48599755b61acdcbd24dbec8";
+static const char *client_hello_ja4 = "t13d0406h2_52f89ac5ce33_0d385148b956";
+
+std::string hex(const uint8_t *data, size_t len)
+{
+   static const char digits[] = "0123456789abcdef";
+   std::string out;
+
+   for (size_t i = 0; i < len; i++) {
+      out += digits[data[i] >> 4];
+      out += digits[data[i] & 0x0F];
+   }
+   return out;
+}
+
+std::string sha256(const std::string &data)
+{
+   SHA256 sha;
+   sha.update(data.data(), data.size());
+   return hex(sha.finalize().binary_digest(), SHA256_DIGEST_LENGTH_BYTES);
+}
+
+Packet tcp_packet(const std::vector<uint8_t> &payload)
+{
+   Packet pkt;
+   pkt.ip_version = IP::v4;
+   pkt.ip_proto = IPPROTO_TCP;
+   pkt.src_port = 50000;
+   pkt.dst_port = 443;
+   pkt.tcp_seq = 1000;
+   pkt.payload = payload.data();
+   pkt.payload_len = payload.size();
+   pkt.payload_len_wire = payload.size();
+   return pkt;
+}
+
+/**
+ * \brief Parse payload of one packet by tls plugin.
+ * \return Extension of the flow, nullptr when nothing was parsed.
+ */
+RecordExtTLS *parse(TLSPlugin &plugin, Flow &flow, const std::vector<uint8_t> &payload)
+{
+   Packet pkt = tcp_packet(payload);
+   plugin.post_create(flow, pkt);
+   return static_cast<RecordExtTLS *>(flow.get_extension(RecordExtTLS::REGISTERED_ID));
+}
+
+TEST(sha256, knownAnswers) {
+   EXPECT_EQ("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", sha256(""));
+   EXPECT_EQ("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", sha256("abc"));
+   /* Padding does not fit into the last block. */
+   EXPECT_EQ("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",
+      sha256("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"));
+}
+
+TEST(sha256, incrementalUpdate) {
+   std::string data(1000, 'a');
+   SHA256 sha;
+
+   /* Chunks not aligned to block size give the same digest as one update. */
+   for (size_t pos = 0; pos < data.size(); pos += 37) {
+      sha.update(data.data() + pos, std::min<size_t>(37, data.size() - pos));
+   }
+   EXPECT_EQ(sha256(data), hex(sha.finalize().binary_digest(), SHA256_DIGEST_LENGTH_BYTES));
+   EXPECT_EQ("41edece42d63e8d9bf515a9ba6932e1c20cbc9f5a5d134645adb5db1b9737ea3", sha256(data));
+}
+
+TEST(tls, ja3) {
+   TLSPlugin plugin;
+   Flow flow{};
+   plugin.init("");
+
+   RecordExtTLS *ext = parse(plugin, flow, client_hello);
+   ASSERT_NE(nullptr, ext);
+   EXPECT_STREQ("example.com", ext->sni);
+   EXPECT_EQ(0x0303, ext->version);
+   EXPECT_EQ(client_hello_ja3, hex(ext->ja3_hash_bin, sizeof(ext->ja3_hash_bin)));
+   EXPECT_STREQ("", ext->ja4);
+}
+
+TEST(tls, ja4) {
+   TLSPlugin plugin;
+   Flow flow{};
+   plugin.init("ja4");
+
+   RecordExtTLS *ext = parse(plugin, flow, client_hello);
+   ASSERT_NE(nullptr, ext);
+   EXPECT_STREQ(client_hello_ja4, ext->ja4);
+   EXPECT_EQ(TLS_JA4_LENGTH, strlen(ext->ja4));
+   /* JA3 does not change when JA4 is computed. */
+   EXPECT_EQ(client_hello_ja3, hex(ext->ja3_hash_bin, sizeof(ext->ja3_hash_bin)));
+   EXPECT_NE(std::string::npos, ext->get_text().find(std::string("tlsja4=\"") + client_hello_ja4 + "\""));
+}
+
+TEST(tls, ja4Compute) {
+   TLSJA4Data data;
+   char out[TLS_JA4_LENGTH + 1];
+
+   /* Nothing collected, hashes are replaced by zeros. */
+   data.compute(out, false);
+   EXPECT_STREQ("t00i000000_000000000000_000000000000", out);
+
+   data.version = 0x0303;
+   data.add_cipher(0x1301);
+   data.add_extension(TLS_EXT_EC_POINT_FORMATS);
+   data.has_alpn = true;
+   data.alpn[0] = 0xAB;
+   data.alpn[1] = 0xCD;
+   data.compute(out, true);
+   /* Non alphanumeric ALPN is written as the first and the last hex digit. */
+   EXPECT_STREQ("q12i0101ad_0f2cb44170f4_bcb145a8c2a7", out);
+
+   /* Ciphers are sorted, counts are capped at 99, values over the limit are not stored. */
+   TLSJA4Data many;
+   many.version = 0x0304;
+   many.add_cipher(0x1302);
+   many.add_cipher(0x1301);
+   for (int i = 2; i < TLS_JA4_MAX_VALUES + 10; i++) {
+      many.add_extension(TLS_EXT_SERVER_NAME);
+   }
+   EXPECT_EQ(TLS_JA4_MAX_VALUES + 8, many.extension_cnt);
+   many.compute(out, false);
+   /* Only SNI was seen, so nothing is left to hash in the extension part. */
+   EXPECT_EQ(std::string("t13i029900_") + sha256("1301,1302").substr(0, 12) + "_000000000000", out);
+
+   /* Signature algorithms alone are not hashed either. */
+   TLSJA4Data named;
+   named.add_extension(TLS_EXT_SERVER_NAME);
+   named.add_extension(TLS_EXT_ALPN);
+   named.sig_algs[0] = 0x0403;
+   named.sig_alg_cnt = 1;
+   named.compute(out, false);
+   EXPECT_STREQ("t00i000200_000000000000_000000000000", out);
+}
+
+TEST(tls, ja4PerInstance) {
+   TLSPlugin with_ja4;
+   TLSPlugin without_ja4;
+   Flow flow{};
+   Flow other{};
+   with_ja4.init("ja4");
+   without_ja4.init("");
+
+   /* Initialization of another instance does not change templates of records of the first one. */
+   RecordExtTLS *ext = parse(with_ja4, flow, client_hello);
+   ASSERT_NE(nullptr, ext);
+   EXPECT_NE(std::string::npos, ext->get_text().find("tlsja4="));
+   ext = parse(without_ja4, other, client_hello);
+   ASSERT_NE(nullptr, ext);
+   EXPECT_EQ(std::string::npos, ext->get_text().find("tlsja4="));
+}
+
+TEST(tls, notHello) {
+   TLSPlugin plugin;
+   Flow flow{};
+   plugin.init("ja4");
+
+   /* Application data record. */
+   std::vector<uint8_t> data = {0x17, 0x03, 0x03, 0x00, 0x02, 0x00, 0x00};
+   EXPECT_EQ(FLOW_PLUGIN_DETACH, plugin.post_create(flow, tcp_packet(data)));
+   EXPECT_EQ(nullptr, flow.get_extension(RecordExtTLS::REGISTERED_ID));
+
+   /* Hello cut inside cipher suites. */
+   data.assign(client_hello.begin(), client_hello.begin() + 50);
+   Packet pkt = tcp_packet(data);
+   pkt.ip_proto = IPPROTO_UDP;
+   plugin.post_create(flow, pkt);
+   EXPECT_EQ(nullptr, flow.get_extension(RecordExtTLS::REGISTERED_ID));
+}
+
+TEST(tls, detachAfterServerHello) {
+   TLSPlugin plugin;
+   Flow flow{};
+   plugin.init("");
+   RecordExtTLS *ext = parse(plugin, flow, client_hello);
+   ASSERT_NE(nullptr, ext);
+
+   /* Bare ACK of server does not end the hellos. */
+   std::vector<uint8_t> empty;
+   Packet ack = tcp_packet(empty);
+   ack.source_pkt = false;
+   EXPECT_EQ(0, plugin.pre_update(flow, ack));
+
+   /* Server hello without ALPN is the last packet inspected. */
+   Packet hello = tcp_packet(server_hello);
+   hello.source_pkt = false;
+   EXPECT_EQ(FLOW_PLUGIN_DETACH, plugin.pre_update(flow, hello));
+   EXPECT_STREQ("", ext->alpn);
+   EXPECT_STREQ("example.com", ext->sni);
+}
+
+TEST(tls, detachAfterHandshake) {
+   TLSPlugin plugin;
+   Flow flow{};
+   plugin.init("");
+   ASSERT_NE(nullptr, parse(plugin, flow, client_hello));
+
+   /* Flow of client direction only, application data follows the hello. */
+   std::vector<uint8_t> data = {0x17, 0x03, 0x03, 0x00, 0x02, 0xaa, 0xbb};
+   Packet pkt = tcp_packet(data);
+   EXPECT_EQ(FLOW_PLUGIN_DETACH, plugin.pre_update(flow, pkt));
+}
+
+/**
+ * \brief TCP segment carrying bytes [begin, end) of the ClientHello.
+ */
+Packet segment(const std::vector<uint8_t> &hello, size_t begin, size_t end)
+{
+   Packet pkt = tcp_packet(hello);
+   pkt.tcp_seq += begin;
+   pkt.payload += begin;
+   pkt.payload_len = end - begin;
+   pkt.payload_len_wire = end - begin;
+   return pkt;
+}
+
+std::string stats(TLSPlugin &plugin)
+{
+   ::testing::internal::CaptureStdout();
+   plugin.finish(true);
+   return ::testing::internal::GetCapturedStdout();
+}
+
+TEST(tlsReassembly, segments) {
+   TLSPlugin plugin;
+   Flow flow{};
+   plugin.init("ja4");
+
+   Packet pkt = segment(client_hello, 0, 40);
+   EXPECT_EQ(0, plugin.post_create(flow, pkt));
+   EXPECT_EQ(nullptr, flow.get_extension(RecordExtTLS::REGISTERED_ID));
+
+   /* Opposite direction, bare ACK and retransmission are skipped. */
+   pkt = segment(client_hello, 0, 20);
+   pkt.src_port = 443;
+   EXPECT_EQ(0, plugin.pre_update(flow, pkt));
+   pkt = segment(client_hello, 40, 40);
+   EXPECT_EQ(0, plugin.pre_update(flow, pkt));
+   pkt = segment(client_hello, 10, 40);
+   EXPECT_EQ(0, plugin.pre_update(flow, pkt));
+
+   /* Overlapping segment contributes only the new bytes. */
+   pkt = segment(client_hello, 30, 100);
+   EXPECT_EQ(0, plugin.pre_update(flow, pkt));
+   EXPECT_EQ(nullptr, flow.get_extension(RecordExtTLS::REGISTERED_ID));
+   pkt = segment(client_hello, 100, client_hello.size());
+   EXPECT_EQ(0, plugin.pre_update(flow, pkt));
+
+   RecordExtTLS *ext = static_cast<RecordExtTLS *>(flow.get_extension(RecordExtTLS::REGISTERED_ID));
+   ASSERT_NE(nullptr, ext);
+   EXPECT_STREQ("example.com", ext->sni);
+   EXPECT_EQ(client_hello_ja3, hex(ext->ja3_hash_bin, sizeof(ext->ja3_hash_bin)));
+   EXPECT_STREQ(client_hello_ja4, ext->ja4);
+   EXPECT_NE(std::string::npos, stats(plugin).find("Reassembled hellos: 1\n"));
+}
+
+TEST(tlsReassembly, gap) {
+   TLSPlugin plugin;
+   Flow flow{};
+   plugin.init("");
+
+   Packet pkt = segment(client_hello, 0, 40);
+   EXPECT_EQ(0, plugin.post_create(flow, pkt));
+   pkt = segment(client_hello, 60, client_hello.size());
+   EXPECT_EQ(FLOW_PLUGIN_DETACH, plugin.pre_update(flow, pkt));
+   EXPECT_EQ(nullptr, flow.get_extension(RecordExtTLS::REGISTERED_ID));
+   EXPECT_NE(std::string::npos, stats(plugin).find("Failed reassemblies: 1\n"));
+}
+
+TEST(tlsReassembly, disabled) {
+   TLSPlugin plugin;
+   Flow flow{};
+   plugin.init("buffers=0");
+
+   /* Without buffers only hellos in one segment are parsed. */
+   Packet pkt = segment(client_hello, 0, 40);
+   EXPECT_EQ(0, plugin.post_create(flow, pkt));
+   pkt = segment(client_hello, 40, client_hello.size());
+   EXPECT_EQ(0, plugin.pre_update(flow, pkt));
+   EXPECT_EQ(nullptr, flow.get_extension(RecordExtTLS::REGISTERED_ID));
+}
+
+TEST(tlsReassembly, poolExhausted) {
+   TLSPlugin plugin;
+   Flow first{};
+   Flow second{};
+   plugin.init("buffers=1");
+
+   /* The only buffer is taken over by the second flow. */
+   Packet pkt = segment(client_hello, 0, 40);
+   pkt.ts.tv_sec = 1;
+   EXPECT_EQ(0, plugin.post_create(first, pkt));
+   pkt.ts.tv_sec = 2;
+   EXPECT_EQ(0, plugin.post_create(second, pkt));
+
+   pkt = segment(client_hello, 40, client_hello.size());
+   EXPECT_EQ(0, plugin.pre_update(first, pkt));
+   EXPECT_EQ(nullptr, first.get_extension(RecordExtTLS::REGISTERED_ID));
+   EXPECT_EQ(0, plugin.pre_update(second, pkt));
+   EXPECT_NE(nullptr, second.get_extension(RecordExtTLS::REGISTERED_ID));
+   EXPECT_NE(std::string::npos, stats(plugin).find("Failed reassemblies: 1\n"));
+}
+
+TEST(tlsReassembly, releasedOnExport) {
+   TLSPlugin plugin;
+   Flow first{};
+   Flow second{};
+   plugin.init("buffers=1");
+
+   Packet pkt = segment(client_hello, 0, 40);
+   EXPECT_EQ(0, plugin.post_create(first, pkt));
+   plugin.pre_export(first);
+
+   /* Buffer is free again, the next flow does not steal it. */
+   EXPECT_EQ(0, plugin.post_create(second, pkt));
+   pkt = segment(client_hello, 40, client_hello.size());
+   EXPECT_EQ(0, plugin.pre_update(second, pkt));
+   EXPECT_NE(nullptr, second.get_extension(RecordExtTLS::REGISTERED_ID));
+   EXPECT_NE(std::string::npos, stats(plugin).find("Failed reassemblies: 0\n"));
+
+   /* Record reused for a new flow does not continue reassembly of the old one. */
+   pkt = segment(client_hello, 0, 40);
+   EXPECT_EQ(0, plugin.post_create(first, pkt));
+   first.time_first.tv_sec = 10;
+   pkt = segment(client_hello, 40, client_hello.size());
+   plugin.pre_update(first, pkt);
+   EXPECT_EQ(nullptr, first.get_extension(RecordExtTLS::REGISTERED_ID));
+}
+
+}
+
+int main(int argc, char **argv)
+{
+   // invoking the tests
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -51,8 +51,15 @@ namespace ipxp {
 
 #define MICRO_SEC 1000000L
 
+/**
+ * \brief Markers sent by ordered pipelines to output worker after every packet block and at the end.
+ */
+static Flow block_marker;
+static Flow end_marker;
+
 void input_storage_worker(InputPlugin *plugin, StoragePlugin *cache, size_t queue_size, uint64_t pkt_limit,
-                  std::promise<WorkerResult> *out, std::atomic<InputStats> *out_stats)
+                  std::promise<WorkerResult> *out, std::atomic<InputStats> *out_stats, ipx_ring_t *ordered_queue,
+                  OverloadControl *overload)
 {
    struct timespec start_cache;
    struct timespec end_cache;
@@ -72,6 +79,7 @@ void input_storage_worker(InputPlugin *plugin, StoragePlugin *cache, size_t queu
    const clockid_t clk_id = CLOCK_MONOTONIC;
 #endif
 
+   cache->start();
    while (!terminate_input) {
       block.cnt = 0;
       block.bytes = 0;
@@ -90,6 +98,11 @@ void input_storage_worker(InputPlugin *plugin, StoragePlugin *cache, size_t queu
          break;
       }
       if (ret == InputPlugin::Result::TIMEOUT) {
+         if (ordered_queue != nullptr) {
+            // Exporting by wall clock would make the order of exported flows nondeterministic
+            usleep(1);
+            continue;
+         }
          clock_gettime(clk_id, &end);
          if (!timeout) {
             timeout = true;
@@ -101,6 +114,9 @@ void input_storage_worker(InputPlugin *plugin, StoragePlugin *cache, size_t queu
             diff.tv_sec--;
          }
          cache->export_expired(ts.tv_sec + diff.tv_sec);
+         if (overload != nullptr) {
+            overload->check(end.tv_sec, plugin->m_seen, plugin->m_dropped);
+         }
          usleep(1);
          continue;
       } else if (ret == InputPlugin::Result::PARSED) {
@@ -113,7 +129,9 @@ void input_storage_worker(InputPlugin *plugin, StoragePlugin *cache, size_t queu
             for (unsigned i = 0; i < block.cnt; i++) {
                cache->put_pkt(block.pkts[i]);
             }
-            ts = block.pkts[block.cnt - 1].ts;
+            if (block.cnt) {
+               ts = block.pkts[block.cnt - 1].ts;
+            }
          } catch (PluginError &e) {
             res.error = true;
             res.msg = e.what();
@@ -121,6 +139,10 @@ void input_storage_worker(InputPlugin *plugin, StoragePlugin *cache, size_t queu
          }
          timeout = false;
          clock_gettime(clk_id, &end_cache);
+         if (overload != nullptr) {
+            overload->add_block(block.cnt, block.size);
+            overload->check(end_cache.tv_sec, plugin->m_seen, plugin->m_dropped);
+         }
 
          int64_t time = end_cache.tv_nsec - start_cache.tv_nsec;
          if (start_cache.tv_sec != end_cache.tv_sec) {
@@ -129,6 +151,9 @@ void input_storage_worker(InputPlugin *plugin, StoragePlugin *cache, size_t queu
          stats.qtime += time;
 
          out_stats->store(stats);
+         if (ordered_queue != nullptr) {
+            ipx_ring_push(ordered_queue, &block_marker);
+         }
       } else if (ret == InputPlugin::Result::ERROR) {
          res.error = true;
          res.msg = "error occured during reading";
@@ -143,6 +168,9 @@ void input_storage_worker(InputPlugin *plugin, StoragePlugin *cache, size_t queu
    stats.dropped = plugin->m_dropped;
    out_stats->store(stats);
    cache->finish();
+   if (ordered_queue != nullptr) {
+      ipx_ring_push(ordered_queue, &end_marker);
+   }
    auto outq = cache->get_queue();
    while (ipx_ring_cnt(outq)) {
       usleep(1);
@@ -156,8 +184,50 @@ static long timeval_diff(const struct timeval *start, const struct timeval *end)
           + (end->tv_usec - start->tv_usec);
 }
 
-void output_worker(OutputPlugin *exp, ipx_ring_t *queue, std::promise<WorkerResult> *out, std::atomic<OutputStats> *out_stats,
-   uint32_t fps)
+/**
+ * \brief Get next flow from queues of ordered pipelines.
+ *
+ * Queues are read round-robin, flows exported by one pipeline while processing one packet block
+ * are read before switching to the next pipeline.
+ * \param [in] queues Queues of ordered pipelines.
+ * \param [in,out] finished Flags of pipelines which sent all flows.
+ * \param [in,out] cur Index of currently read queue.
+ * \param [in,out] active Number of pipelines which did not send all flows yet.
+ * \param [in] drain All pipelines were terminated, empty queue will not receive any more flows.
+ * \return Flow or nullptr when current queue is empty.
+ */
+static Flow *ordered_pop(std::vector<ipx_ring_t *> &queues, std::vector<bool> &finished, size_t &cur, size_t &active,
+   bool drain)
+{
+   while (active) {
+      Flow *flow = static_cast<Flow *>(ipx_ring_pop(queues[cur]));
+      if (flow == nullptr && !drain) {
+         return nullptr;
+      }
+      if (flow == &end_marker) {
+         // Release the marker, pipeline waits until its queue is empty
+         ipx_ring_pop(queues[cur]);
+      }
+      if (flow == nullptr || flow == &end_marker) {
+         finished[cur] = true;
+         active--;
+      }
+      if (flow == nullptr || flow == &block_marker || flow == &end_marker) {
+         for (size_t i = 0; i < queues.size() && active; i++) {
+            cur = (cur + 1) % queues.size();
+            if (!finished[cur]) {
+               break;
+            }
+         }
+         continue;
+      }
+      return flow;
+   }
+   return nullptr;
+}
+
+void output_worker(OutputPlugin *exp, ipx_ring_t *queue, std::vector<ipx_ring_t *> ordered_queues,
+   std::promise<WorkerResult> *out, std::atomic<OutputStats> *out_stats, uint32_t fps, ExportFilter *filter)
 {
    WorkerResult res = {false, ""};
    OutputStats stats = {0, 0, 0, 0};
@@ -167,6 +237,10 @@ void output_worker(OutputPlugin *exp, ipx_ring_t *queue, std::promise<WorkerResu
    struct timeval last_flush;
    uint32_t pkts_from_begin = 0;
    double time_per_pkt = 0;
+   bool ordered = !ordered_queues.empty();
+   std::vector<bool> finished(ordered_queues.size(), false);
+   size_t active = ordered_queues.size();
+   size_t cur = 0;
 
    if (fps != 0) {
       time_per_pkt = 1000000.0 / fps; // [micro seconds]
@@ -178,18 +252,27 @@ void output_worker(OutputPlugin *exp, ipx_ring_t *queue, std::promise<WorkerResu
    while (1) {
       gettimeofday(&end, nullptr);
 
-      Flow *flow = static_cast<Flow *>(ipx_ring_pop(queue));
+      Flow *flow;
+      if (ordered) {
+         flow = ordered_pop(ordered_queues, finished, cur, active, terminate_export);
+      } else {
+         flow = static_cast<Flow *>(ipx_ring_pop(queue));
+      }
       if (!flow) {
          if (end.tv_sec - last_flush.tv_sec > 1) {
             last_flush = end;
             exp->flush();
          }
-         if (terminate_export && !ipx_ring_cnt(queue)) {
+         if (terminate_export && (ordered ? !active : !ipx_ring_cnt(queue))) {
             break;
          }
          continue;
       }
 
+      /* Flows dropped by export filter are counted by the filter only. */
+      if (filter != nullptr && !filter->apply(*flow)) {
+         continue;
+      }
       stats.biflows++;
       stats.bytes += flow->src_bytes + flow->dst_bytes;
       stats.packets += flow->src_packets + flow->dst_packets;
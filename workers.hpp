@@ -46,6 +46,7 @@
 
 #include <future>
 #include <atomic>
+#include <vector>
 
 #include <ipfixprobe/input.hpp>
 #include <ipfixprobe/storage.hpp>
@@ -55,6 +56,8 @@
 #include <ipfixprobe/ring.h>
 
 #include "stats.hpp"
+#include "overload.hpp"
+#include "export-filter.hpp"
 
 namespace ipxp {
 
@@ -75,6 +78,7 @@ struct WorkPipeline {
    struct {
       StoragePlugin *plugin;
       std::vector<ProcessPlugin *> plugins;
+      OverloadControl *overload;
    } storage;
 };
 
@@ -84,12 +88,15 @@ struct OutputWorker {
    std::promise<WorkerResult> *promise;
    std::atomic<OutputStats> *stats;
    ipx_ring_t *queue;
+   std::vector<ipx_ring_t *> ordered_queues; /**< Separate queues of ordered pipelines */
+   ExportFilter *filter;
 };
 
 void input_storage_worker(InputPlugin *plugin, StoragePlugin *cache, size_t queue_size, uint64_t pkt_limit, 
-      std::promise<WorkerResult> *out, std::atomic<InputStats> *out_stats);
-void output_worker(OutputPlugin *exp, ipx_ring_t *queue, std::promise<WorkerResult> *out, std::atomic<OutputStats> *out_stats,
-      uint32_t fps);
+      std::promise<WorkerResult> *out, std::atomic<InputStats> *out_stats, ipx_ring_t *ordered_queue,
+      OverloadControl *overload);
+void output_worker(OutputPlugin *exp, ipx_ring_t *queue, std::vector<ipx_ring_t *> ordered_queues,
+      std::promise<WorkerResult> *out, std::atomic<OutputStats> *out_stats, uint32_t fps, ExportFilter *filter);
 
 }
 